@@ -0,0 +1,24 @@
+if(TARGET lz4::lz4)
+    return()
+endif()
+
+find_library(lz4_LIBRARY_FILE NAMES lz4)
+find_path(lz4_INCLUDE_DIR NAMES lz4.h)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(lz4 DEFAULT_MSG
+    lz4_LIBRARY_FILE
+    lz4_INCLUDE_DIR)
+
+if(lz4_LIBRARY_FILE AND lz4_INCLUDE_DIR)
+    set(lz4_FOUND ON)
+    add_library(lz4::lz4 SHARED IMPORTED)
+    set_target_properties(lz4::lz4 PROPERTIES
+        IMPORTED_LOCATION "${lz4_LIBRARY_FILE}"
+        INTERFACE_INCLUDE_DIRECTORIES "${lz4_INCLUDE_DIR}")
+else()
+    set(lz4_FOUND OFF)
+endif()
+
+unset(lz4_LIBRARY_FILE CACHE)
+unset(lz4_INCLUDE_DIR CACHE)
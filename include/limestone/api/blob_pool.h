@@ -16,6 +16,9 @@
 #pragma once
 
 #include "blob_id_type.h"
+#include <exception>
+#include <future>
+#include <string>
 #include <boost/filesystem.hpp>
 
 namespace limestone::api {
@@ -91,6 +94,45 @@ public:
      */
     [[nodiscard]] virtual blob_id_type duplicate_data(blob_id_type reference) = 0;
 
+    /**
+     * @brief registers a BLOB file provisionally into this BLOB pool, without waiting for its I/O.
+     * @param file the source BLOB file, which must be kept until the returned future becomes ready
+     * @param is_temporary_file true to allow remove the source file, or false to copy the source file
+     * @return the future of the corresponding BLOB reference, which throws the exceptions of register_file() instead
+     * @attention release() waits for the registrations in progress, and the registrations not yet started fail
+     *     with std::logic_error.
+     * @note The default implementation registers the file synchronously, and returns a future already ready.
+     */
+    [[nodiscard]] virtual std::future<blob_id_type> register_file_async(
+            boost::filesystem::path file,
+            bool is_temporary_file) {
+        std::promise<blob_id_type> promise{};
+        try {
+            promise.set_value(register_file(file, is_temporary_file));
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+        return promise.get_future();
+    }
+
+    /**
+     * @brief registers a BLOB data provisionally into this BLOB pool, without waiting for its I/O.
+     * @param data the target BLOB data, which this pool keeps until the registration completes
+     * @return the future of the corresponding BLOB reference, which throws the exceptions of register_data() instead
+     * @attention release() waits for the registrations in progress, and the registrations not yet started fail
+     *     with std::logic_error.
+     * @note The default implementation registers the data synchronously, and returns a future already ready.
+     */
+    [[nodiscard]] virtual std::future<blob_id_type> register_data_async(std::string data) {
+        std::promise<blob_id_type> promise{};
+        try {
+            promise.set_value(register_data(data));
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+        return promise.get_future();
+    }
+
 };
 
 } // namespace limestone::api
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+namespace limestone::api {
+
+/**
+ * @brief the contents of a BLOB file mapped into memory.
+ * @details the contents stay readable while this object or its copies are alive,
+ *   even after the BLOB file has been removed.
+ */
+class blob_view {
+private:
+    std::shared_ptr<const void> holder_{};
+    std::string_view data_{};
+
+public:
+    /**
+     * @brief creates an unavailable BLOB view.
+     */
+    blob_view() noexcept = default;
+
+    /**
+     * @brief creates an available BLOB view.
+     * @param holder the object that keeps data valid while it is alive
+     * @param data the contents of the BLOB file
+     */
+    blob_view(std::shared_ptr<const void> holder, std::string_view data) noexcept;
+
+    /**
+     * @brief returns the contents of the BLOB file.
+     * @return the contents, or an empty view if this is not available
+     */
+    [[nodiscard]] std::string_view data() const noexcept;
+
+    /**
+     * @brief returns whether this BLOB view is available.
+     * @return true if this object is available
+     * @return false otherwise
+     */
+    [[nodiscard]] explicit operator bool() const noexcept;
+};
+
+} // namespace limestone::api
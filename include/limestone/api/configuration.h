@@ -15,7 +15,10 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -28,6 +31,7 @@ class datastore;
 
 /**
  * @brief configuration for datastore
+ * @details a tunable left unset falls back to its environment variable, and then to its default value
  */
 class configuration {
     /**
@@ -65,6 +69,62 @@ public:
      */
     void set_recover_max_parallelism(int recover_max_parallelism) noexcept;
 
+    /**
+     * @brief setter for the largest BLOB packed into a segment file, overriding LIMESTONE_BLOB_PACK_MAX_BYTES
+     * @param max_blob_bytes the size in bytes, 0 to store each new BLOB in a file of its own
+     */
+    void set_blob_pack_max_bytes(std::uint64_t max_blob_bytes) noexcept;
+
+    /**
+     * @brief setter for the size of a BLOB segment file, overriding LIMESTONE_BLOB_PACK_SEGMENT_MB
+     * @param segment_bytes the size in bytes at which a new segment file is started
+     */
+    void set_blob_pack_segment_bytes(std::uint64_t segment_bytes) noexcept;
+
+    /**
+     * @brief setter for the number of BLOB digests kept for deduplication, overriding LIMESTONE_BLOB_DEDUP_ENTRIES
+     * @param entries the number of digests, 0 not to deduplicate BLOBs
+     */
+    void set_blob_dedup_entries(std::size_t entries) noexcept;
+
+    /**
+     * @brief setter for the largest BLOB file hashed for deduplication
+     * @param max_file_bytes the size in bytes
+     */
+    void set_blob_dedup_max_file_bytes(std::uint64_t max_file_bytes) noexcept;
+
+    /**
+     * @brief setter for the number of BLOB files kept mapped for reading, overriding LIMESTONE_BLOB_READ_CACHE_ENTRIES
+     * @param entries the number of files, 0 to disable the cache
+     */
+    void set_blob_read_cache_entries(std::size_t entries) noexcept;
+
+    /**
+     * @brief setter for the number of BLOB I/O threads, overriding LIMESTONE_BLOB_IO_THREADS
+     * @param threads the number of threads, 0 for the default
+     */
+    void set_blob_io_threads(std::size_t threads) noexcept;
+
+    /**
+     * @brief setter for the memory used by the BLOB GC snapshot before it spills, overriding LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY
+     * @param memory_bytes the size in bytes
+     */
+    void set_blob_gc_snapshot_memory(std::size_t memory_bytes) noexcept;
+
+    /**
+     * @brief setter for the I/O bandwidth of online compaction, overriding LIMESTONE_COMPACTION_IO_RATE_MB
+     * @param bytes_per_second the bandwidth in bytes per second, 0 for unlimited
+     */
+    void set_compaction_io_rate(std::uint64_t bytes_per_second) noexcept;
+
+    /**
+     * @brief setter for the key-range sharding of the compacted files,
+     * overriding LIMESTONE_COMPACTION_SHARDS and LIMESTONE_COMPACTION_MIN_SHARD_MB
+     * @param max_shards the maximum number of shards, 0 for the recover parallelism
+     * @param min_shard_bytes the minimum size of a shard in bytes
+     */
+    void set_compaction_sharding(std::size_t max_shards, std::uint64_t min_shard_bytes) noexcept;
+
 private:
     boost::filesystem::path data_location_{};
 
@@ -73,6 +133,17 @@ private:
 
     int recover_max_parallelism_{default_recover_max_parallelism};
 
+    std::optional<std::uint64_t> blob_pack_max_bytes_{};
+    std::optional<std::uint64_t> blob_pack_segment_bytes_{};
+    std::optional<std::size_t> blob_dedup_entries_{};
+    std::optional<std::uint64_t> blob_dedup_max_file_bytes_{};
+    std::optional<std::size_t> blob_read_cache_entries_{};
+    std::optional<std::size_t> blob_io_threads_{};
+    std::optional<std::size_t> blob_gc_snapshot_memory_{};
+    std::optional<std::uint64_t> compaction_io_rate_{};
+    std::optional<std::size_t> compaction_max_shards_{};
+    std::optional<std::uint64_t> compaction_min_shard_bytes_{};
+
     friend class datastore;
 };
 
@@ -30,6 +30,7 @@
 #include <limestone/status.h>
 #include <limestone/api/blob_pool.h>
 #include <limestone/api/blob_file.h>
+#include <limestone/api/blob_view.h>
 #include <limestone/api/backup.h>
 #include <limestone/api/backup_detail.h>
 #include <limestone/api/log_channel.h>
@@ -46,6 +47,12 @@ namespace limestone::internal {
     class compaction_catalog;
     class blob_file_resolver; 
     class blob_file_garbage_collector;
+    class blob_pack_store;
+    class blob_file_syncer;
+    class blob_io_executor;
+    class persistent_blob_id_set;
+    class blob_read_cache;
+    class blob_dedup_index;
 }
 namespace limestone::api {
 
@@ -299,6 +306,20 @@ public:
      */
     [[nodiscard]] blob_file get_blob_file(blob_id_type reference);
 
+    /**
+     * @brief returns the contents of the BLOB file for the BLOB reference, mapped into memory.
+     * @details the recently read BLOB files are kept mapped, so that reading them again
+     *   needs neither opening nor copying them.
+     * @param reference the target BLOB reference
+     * @return the contents of the corresponding BLOB file
+     * @return unavailable BLOB view if there is no BLOB file for the reference,
+     *   that is, the BLOB file has not been registered or has already been removed.
+     * @throws limestone_io_exception if the BLOB file exists but cannot be read
+     * @attention the returned BLOB view is only effective
+     *    during the transaction that has provided the corresponded BLOB reference.
+     */
+    [[nodiscard]] blob_view read_blob(blob_id_type reference);
+
 
     /**
      * @brief change the available boundary version that the entries may be read.
@@ -355,6 +376,16 @@ public:
      */
     datastore_impl* get_impl() noexcept { return impl_.get(); }
 
+    /**
+     * @brief Retrieves the cache of BLOB files mapped into memory.
+     *
+     * NOTE: This method is intended for internal use only. It is used by the replication
+     * to send BLOB files, which may not have become available on this datastore yet.
+     *
+     * @return The cache of mapped BLOB files.
+     */
+    limestone::internal::blob_read_cache& get_blob_read_cache() noexcept { return *blob_read_cache_; }
+
     /**
      * @brief Writes the specified epoch id to the epoch file and notifies replicas if needed.
      *
@@ -376,11 +407,9 @@ protected:  // for tests
     auto next_blob_id_for_tests() const noexcept { return next_blob_id_.load(); }
     auto& files_for_tests() const noexcept { return files_; }
     void rotate_epoch_file_for_tests() { rotate_epoch_file(); }
+    std::future<rotation_result> rotate_log_files_async_for_tests() { return rotate_log_files_async(); }
     void set_next_blob_id_for_tests(blob_id_type next_blob_id) noexcept { next_blob_id_.store(next_blob_id); }
-    std::set<blob_id_type> get_persistent_blob_ids_for_tests() noexcept {
-        std::lock_guard<std::mutex> lock(persistent_blob_ids_mutex_);
-        return persistent_blob_ids_;
-    }
+    std::set<blob_id_type> get_persistent_blob_ids_for_tests() noexcept;
     write_version_type get_available_boundary_version_for_tests() const noexcept { return available_boundary_version_; }
     void wait_for_blob_file_garbace_collector_for_tests() const noexcept;
 
@@ -512,6 +541,9 @@ private:
     // opposite of add_file
     void subtract_file(const boost::filesystem::path& file);
 
+    // subtract_file(from) and add_file(to) under one lock
+    void replace_file(const boost::filesystem::path& from, const boost::filesystem::path& to);
+
     std::set<boost::filesystem::path> get_files();
 
     epoch_id_type search_max_durable_epock_id() noexcept;
@@ -534,13 +566,37 @@ private:
 
 
     /**
-     * @brief requests the data store to rotate log files
+     * @brief requests the data store to rotate log files, and waits for the rotation to complete
      */
     rotation_result rotate_log_files();
 
-    // Mutex to protect rotate_log_files from concurrent access
+    /**
+     * @brief requests the data store to rotate log files
+     * @details the rotation is cut at the current epoch: a log channel rotates its file at its next
+     * begin_session(), and the channels not in a session are rotated by the returned task, which completes
+     * when all the channels have rotated and epoch_id_informed_ has caught up with the cut.
+     * @return the future of the rotation result
+     * @exception limestone_exception if the current epoch is 0
+     */
+    std::future<rotation_result> rotate_log_files_async();
+
+    /**
+     * @brief wakes up the rotation tasks waiting for the log channels to rotate their files
+     */
+    void notify_rotation_progress();
+
+    // Mutex to serialize the rotation requests
     std::mutex rotate_mutex;
 
+    // The cuts of the rotations not completed yet, guarded by rotate_mutex
+    std::multiset<epoch_id_type> rotation_cuts_{};
+
+    // Mutex and condition variable for waiting for the log channels to rotate their files.
+    // rotation_progress_ counts the notifications, so that none is missed between the waits.
+    std::mutex rotation_progress_mutex;
+    std::condition_variable cv_rotation_progress;
+    std::uint64_t rotation_progress_{};
+
     // Mutex and condition variable for synchronizing epoch_id_informed_ updates.
     std::mutex informed_mutex;
     std::condition_variable cv_epoch_informed;
@@ -562,11 +618,22 @@ private:
 
     std::unique_ptr<limestone::internal::blob_file_resolver> blob_file_resolver_;
 
+    std::unique_ptr<limestone::internal::blob_pack_store> blob_pack_store_;
+
+    std::unique_ptr<limestone::internal::blob_file_syncer> blob_file_syncer_;
+
+    // nullptr unless BLOBs are deduplicated
+    std::unique_ptr<limestone::internal::blob_dedup_index> blob_dedup_index_;
+
+    // declared after the BLOB stores its tasks write to, so that it is destroyed first
+    std::unique_ptr<limestone::internal::blob_io_executor> blob_io_executor_;
+
     std::atomic<std::uint64_t> next_blob_id_{0};
 
-    std::set<blob_id_type> persistent_blob_ids_;
+    std::unique_ptr<limestone::internal::persistent_blob_id_set> persistent_blob_ids_;
 
-    std::mutex persistent_blob_ids_mutex_;
+    // declared before the garbage collector, which evicts the BLOB files it removes
+    std::unique_ptr<limestone::internal::blob_read_cache> blob_read_cache_;
 
     std::unique_ptr<limestone::internal::blob_file_garbage_collector> blob_file_garbage_collector_;
 
@@ -20,8 +20,10 @@
 #include <string_view>
 #include <cstdint>
 #include <atomic>
+#include <map>
 #include <set>
 #include <memory>
+#include <mutex>
 #include <condition_variable>
 
 #include <boost/filesystem.hpp>
@@ -199,6 +201,51 @@ private:
 
     std::string do_rotate_file(epoch_id_type epoch = 0);
 
+    /**
+     * @brief asks this channel to rotate its file for the rotation cut at the given epoch
+     * @details the channel rotates at its next begin_session(), so that the rotated file holds no session
+     * of an epoch beyond the cut; a channel not in a session, including one whose session has ended since,
+     * is rotated by the rotating thread with rotate_if_idle().
+     */
+    void request_rotation(epoch_id_type epoch) noexcept;
+
+    /**
+     * @brief rotates the file now if a rotation is requested and the channel is not in a session
+     */
+    void rotate_if_idle();
+
+    /**
+     * @brief returns whether the rotation cut at the given epoch (or a later one) is done
+     */
+    [[nodiscard]] bool has_rotated(epoch_id_type epoch);
+
+    /**
+     * @brief returns the name of the file rotated for the rotation cut at the given epoch
+     * @details a rotation done for a later cut serves the earlier cuts requested before it
+     * @return the name of the rotated file, empty if the channel had no file to rotate
+     */
+    [[nodiscard]] std::string rotated_file(epoch_id_type epoch);
+
+    /**
+     * @brief forgets the files rotated for the rotation cuts before the given epoch
+     */
+    void forget_rotations_before(epoch_id_type epoch);
+
+    // rotates the file if a rotation is requested; the caller holds mtx_rotation_
+    bool rotate_if_requested_locked();
+
+    // protects registered_, in_session_ and the rotation state against the rotating thread
+    std::mutex mtx_rotation_{};
+
+    bool in_session_{};
+
+    std::atomic<epoch_id_type> rotation_requested_epoch_{0};
+
+    epoch_id_type rotated_epoch_{0};
+
+    // the file rotated for each rotation cut done, empty if there was no file to rotate
+    std::map<epoch_id_type, std::string> rotated_files_{};
+
     std::unique_ptr<log_channel_impl> impl_;
 
 
@@ -37,6 +37,7 @@ public:
     [[nodiscard]] const std::set<boost::filesystem::path>& get_rotation_end_files() const;
     void set_rotation_end_files(const std::set<boost::filesystem::path>& files);
     void add_rotated_file(const std::string& filename);
+    [[nodiscard]] const std::set<std::string>& get_rotated_files() const;
 
 private:
     // A set of filenames that were rotated in this rotation process.
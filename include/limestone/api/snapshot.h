@@ -18,6 +18,7 @@
 #include <memory>
 #include <string_view>
 #include <map>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 #include <limestone/api/cursor.h>
@@ -64,6 +65,18 @@ public:
      */
     [[nodiscard]] std::unique_ptr<cursor> get_cursor() const;
 
+    /**
+     * @brief create a cursor to read the contents of a single storage in the snapshot and returns it
+     * @details the returned cursor points to the first element of the storage by calling cursor::next().
+     * The cursor seeks directly to the key range of the storage when the snapshot files carry
+     * a storage offset table, so the entries of other storages are not read.
+     * @param storage_id the storage ID whose entries are returned
+     * @attention this function is thread-safe.
+     * @exception limestone_exception if the file stream of the cursor is not good.
+     * @return unique pointer of the cursor
+     */
+    [[nodiscard]] std::unique_ptr<cursor> get_cursor(storage_id_type storage_id) const;
+
     /**
      * @brief Returns multiple cursors, each responsible for a distinct partition of the snapshot.
      * @details This method partitions the snapshot data into at most @p n disjoint logical ranges
@@ -78,15 +91,17 @@ public:
      * This method is intended for parallel processing. Each cursor must be processed independently
      * and exclusively by a single thread. The cursor class is not thread-safe.
      *
-     * This method must be called at most once per snapshot instance. Calling it more than once will
-     * result in a limestone_exception being thrown. The result of the partitioning is not guaranteed
-     * to be stable across calls or implementations.
+     * This method may be called any number of times, also concurrently, on the same snapshot instance;
+     * each call starts an independent scan. Scans of the same snapshot share the decoded blocks of the
+     * snapshot file, so concurrent scans do not read and decode the same data more than once.
+     * The result of the partitioning is not guaranteed to be stable across calls or implementations.
+     *
+     * @attention this function is thread-safe.
      *
      * @param n The maximum number of partitions (and thus cursors) to return. Must be greater than 0.
      * @return A vector containing between 1 and @p n unique pointers to cursors. Each cursor is valid and non-null.
      *
      * @throws std::invalid_argument if @p n is 0.
-     * @throws limestone_exception if this method is called more than once on the same snapshot instance.
      * @throws limestone_exception or limestone_io_exception if a fatal error occurs during setup.
      *         These exceptions are unrecoverable and may indicate serious corruption or I/O failure.
      *
@@ -98,6 +113,23 @@ public:
      */
     [[nodiscard]] std::vector<std::unique_ptr<cursor>> get_partitioned_cursors(std::size_t n);
 
+    /**
+     * @brief Returns multiple cursors, each responsible for a distinct partition of a single storage in the snapshot.
+     * @details This method behaves like get_partitioned_cursors(std::size_t), except that only the entries
+     * of the storage @p storage_id are returned. The snapshot files are read only within the key range
+     * of the storage when they carry a storage offset table.
+     *
+     * @attention this function is thread-safe.
+     *
+     * @param n The maximum number of partitions (and thus cursors) to return. Must be greater than 0.
+     * @param storage_id The storage ID whose entries are returned.
+     * @return A vector containing between 1 and @p n unique pointers to cursors. Each cursor is valid and non-null.
+     *
+     * @throws std::invalid_argument if @p n is 0.
+     * @throws limestone_exception or limestone_io_exception if a fatal error occurs during setup.
+     */
+    [[nodiscard]] std::vector<std::unique_ptr<cursor>> get_partitioned_cursors(std::size_t n, storage_id_type storage_id);
+
     /**
      * @brief create a cursor for an entry at a given location on the snapshot and returns it
      * @details the returned cursor will point to the target element by calling cursor::next().
@@ -125,6 +157,10 @@ private:
 
     explicit snapshot(boost::filesystem::path location, std::map<storage_id_type, write_version_type> clear_storage) noexcept;
 
+    // compacted_files: the compacted files to merge, ordered from the newest generation to the oldest
+    snapshot(boost::filesystem::path location, std::map<storage_id_type, write_version_type> clear_storage,
+             std::vector<boost::filesystem::path> compacted_files) noexcept;
+
     friend class datastore;
 };
 
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_dedup_index.h"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "environment_helper.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+blob_dedup_index::hasher::hasher() : ctx_(EVP_MD_CTX_new()) {
+    if (ctx_ == nullptr || EVP_DigestInit_ex(ctx_, EVP_blake2b512(), nullptr) != 1) {
+        EVP_MD_CTX_free(ctx_);
+        LOG_AND_THROW_BLOB_EXCEPTION_NO_ERRNO("Failed to initialize the BLOB digest");
+    }
+}
+
+blob_dedup_index::hasher::~hasher() {
+    EVP_MD_CTX_free(ctx_);
+}
+
+void blob_dedup_index::hasher::update(const void* data, std::size_t size) {
+    if (EVP_DigestUpdate(ctx_, data, size) != 1) {
+        LOG_AND_THROW_BLOB_EXCEPTION_NO_ERRNO("Failed to compute the BLOB digest");
+    }
+}
+
+blob_dedup_index::digest_type blob_dedup_index::hasher::finish() {
+    std::array<unsigned char, EVP_MAX_MD_SIZE> full{};
+    unsigned int full_size = 0;
+    if (EVP_DigestFinal_ex(ctx_, full.data(), &full_size) != 1 || full_size < digest_size) {
+        LOG_AND_THROW_BLOB_EXCEPTION_NO_ERRNO("Failed to compute the BLOB digest");
+    }
+    digest_type digest{};
+    std::copy_n(full.begin(), digest_size, digest.begin());
+    return digest;
+}
+
+blob_dedup_index::blob_dedup_index(std::size_t capacity, std::uint64_t max_file_bytes)
+    : capacity_(std::max<std::size_t>(capacity, 1)), max_file_bytes_(max_file_bytes) {}
+
+std::size_t blob_dedup_index::capacity_from_environment() {
+    auto value = read_unsigned_environment("LIMESTONE_BLOB_DEDUP_ENTRIES");
+    return value ? static_cast<std::size_t>(*value) : 0;
+}
+
+blob_dedup_index::digest_type blob_dedup_index::digest_of(std::string_view data) {
+    hasher h{};
+    h.update(data.data(), data.size());
+    return h.finish();
+}
+
+std::optional<blob_id_type> blob_dedup_index::find(const digest_type& digest) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (auto it = ids_.find(digest); it != ids_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void blob_dedup_index::add(const digest_type& digest, blob_id_type id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto [it, inserted] = ids_.try_emplace(digest, id);
+    if (!inserted) {
+        // the previous BLOB could not be linked, so this one takes its place
+        it->second = id;
+        return;
+    }
+    order_.push_back(digest);
+    // order_ may still hold the digests removed since, so it bounds the size of ids_
+    while (order_.size() > capacity_) {
+        ids_.erase(order_.front());
+        order_.pop_front();
+    }
+}
+
+void blob_dedup_index::remove(const digest_type& digest, blob_id_type id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (auto it = ids_.find(digest); it != ids_.end() && it->second == id) {
+        ids_.erase(it);
+    }
+}
+
+std::size_t blob_dedup_index::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return ids_.size();
+}
+
+}  // namespace limestone::internal
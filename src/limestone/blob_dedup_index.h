@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include <limestone/api/blob_id_type.h>
+
+// NOLINTNEXTLINE(readability-identifier-naming)
+struct evp_md_ctx_st;
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+
+/**
+ * @brief The index from the contents of the recently registered BLOB files to their BLOB IDs.
+ * @details blob_pool_impl looks a BLOB up here before writing it, and hard-links the BLOB file found
+ *          instead, as duplicate_data() does. The contents are identified by their BLAKE2b digest
+ *          truncated to 256 bits, which is trusted without comparing the files beyond their sizes.
+ *          Registered files are read to compute their digests only up to max_file_bytes(), and files
+ *          registered as temporary are never read, as moving them costs nothing to save.
+ *          The index is kept in memory only, and holds the last registered BLOBs up to its capacity.
+ */
+class blob_dedup_index {
+public:
+    /// the size of a digest in bytes
+    static constexpr std::size_t digest_size = 32;
+
+    /// the largest registered file read to compute its digest, by default
+    static constexpr std::uint64_t default_max_file_bytes = 16UL * 1024UL * 1024UL;
+
+    using digest_type = std::array<unsigned char, digest_size>;
+
+    /**
+     * @brief Computes the digest of data given in pieces.
+     */
+    class hasher {
+    public:
+        hasher();
+
+        hasher(const hasher&) = delete;
+        hasher& operator=(const hasher&) = delete;
+        hasher(hasher&&) = delete;
+        hasher& operator=(hasher&&) = delete;
+        ~hasher();
+
+        /**
+         * @brief Appends a piece of the data.
+         */
+        void update(const void* data, std::size_t size);
+
+        /**
+         * @brief Returns the digest of the data appended so far.
+         */
+        [[nodiscard]] digest_type finish();
+
+    private:
+        evp_md_ctx_st* ctx_;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param capacity The maximum number of BLOBs indexed, at least 1.
+     * @param max_file_bytes The largest registered file read to compute its digest.
+     */
+    explicit blob_dedup_index(std::size_t capacity, std::uint64_t max_file_bytes = default_max_file_bytes);
+
+    /**
+     * @brief Returns the capacity, read from LIMESTONE_BLOB_DEDUP_ENTRIES if set.
+     * @details An invalid value is ignored with a warning.
+     * @return The capacity, or 0 if BLOBs are not deduplicated.
+     */
+    static std::size_t capacity_from_environment();
+
+    /**
+     * @brief Returns the digest of the given data.
+     */
+    static digest_type digest_of(std::string_view data);
+
+    /**
+     * @brief Looks up a BLOB with the given contents.
+     * @return The ID of the BLOB, or std::nullopt if none is indexed.
+     */
+    [[nodiscard]] std::optional<blob_id_type> find(const digest_type& digest) const;
+
+    /**
+     * @brief Indexes a BLOB, replacing the BLOB indexed with the same contents if any.
+     */
+    void add(const digest_type& digest, blob_id_type id);
+
+    /**
+     * @brief Removes a BLOB which can no longer be linked, unless the contents have been indexed again since.
+     */
+    void remove(const digest_type& digest, blob_id_type id);
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+    [[nodiscard]] std::uint64_t max_file_bytes() const noexcept { return max_file_bytes_; }
+
+    /**
+     * @brief Returns the number of BLOBs indexed.
+     */
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    struct digest_hash {
+        std::size_t operator()(const digest_type& digest) const noexcept {
+            // the digest is uniformly distributed, so any part of it serves as a hash
+            std::size_t value = 0;
+            std::memcpy(&value, digest.data(), sizeof(value));
+            return value;
+        }
+    };
+
+    const std::size_t capacity_;
+    const std::uint64_t max_file_bytes_;
+    mutable std::mutex mtx_{};
+    std::unordered_map<digest_type, blob_id_type, digest_hash> ids_{};
+    // the digests in the order they were added, to drop the oldest first
+    std::deque<digest_type> order_{};
+};
+
+}  // namespace limestone::internal
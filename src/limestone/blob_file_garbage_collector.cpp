@@ -16,11 +16,16 @@
  
  #include "blob_file_garbage_collector.h"
  #include "blob_file_scanner.h"
+ #include "blob_pack_store.h"
+ #include "blob_read_cache.h"
+ #include "blob_scan_state.h"
  #include "logging_helper.h"
  #include "cursor_impl.h"
  #include "log_entry.h"
  
  #include <boost/filesystem.hpp>
+ #include <algorithm>
+ #include <iterator>
  #include <sstream>
  #include <iomanip>
  #include <iostream>
@@ -47,8 +52,11 @@
     using limestone::api::log_entry;    
   
  // Constructor now takes a blob_file_resolver and sets the resolver_ member.
- blob_file_garbage_collector::blob_file_garbage_collector(const blob_file_resolver& resolver)
+ blob_file_garbage_collector::blob_file_garbage_collector(const blob_file_resolver& resolver, blob_pack_store* pack_store,
+                                                          blob_read_cache* read_cache)
      : resolver_(&resolver),
+       pack_store_(pack_store),
+       read_cache_(read_cache),
        scanned_blobs_(std::make_unique<blob_id_container>()),
        gc_exempt_blob_(std::make_unique<blob_id_container>()) {
      file_ops_ = std::make_unique<real_file_operations>();
@@ -77,17 +85,20 @@
         // Initialize blob_file_scanner with the resolver
         blob_file_scanner scanner(resolver_);
 
-        // Iterate over each blob file using the scanner
-        for (const auto& file_path : scanner) {
-            if (shutdown_requested_.load(std::memory_order_acquire)) {
-                break;
-            }
-
-            blob_id_type id = resolver_->extract_blob_id(file_path);
-            VLOG_LP(log_trace) << "Scanned blob file: " << file_path.string();
-            if (id <= max_existing_blob_id_) {
-                scanned_blobs_->add_blob_id(id);
-                VLOG_LP(log_trace) << "Added blob id: " << id;
+        std::vector<blob_id_type> ids = list_blob_files(scanner);
+        for (const auto& id : ids) {
+            scanned_blobs_->add_blob_id(id);
+            VLOG_LP(log_trace) << "Added blob id: " << id;
+        }
+        if (!shutdown_requested_.load(std::memory_order_acquire)) {
+            existing_blob_files_ = std::move(ids);
+        }
+        // The packed BLOBs are collected in the same way as the BLOB files.
+        if (pack_store_ != nullptr && !shutdown_requested_.load(std::memory_order_acquire)) {
+            for (const auto& id : pack_store_->blob_ids()) {
+                if (id <= max_existing_blob_id_) {
+                    scanned_blobs_->add_blob_id(id);
+                }
             }
         }
         VLOG_LP(log_trace) << "Blob file scan complete.";
@@ -97,6 +108,51 @@
     state_machine_.complete_blob_scan();
     blob_file_scan_cv_.notify_all();
 }
+
+std::vector<blob_id_type> blob_file_garbage_collector::list_blob_files(const blob_file_scanner& scanner) {
+    std::size_t thread_count = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, max_scan_threads);
+    auto state = blob_scan_state::load(resolver_->get_scan_state_path());
+    if (state && state->max_scanned_blob_id() <= max_existing_blob_id_ && state->incremental_scans() < blob_scan_state::full_scan_interval) {
+        blob_id_type new_range = max_existing_blob_id_ - state->max_scanned_blob_id();
+        if (new_range <= std::max<blob_id_type>(state->blob_ids().size(), min_probe_range)) {
+            // the maximum itself is looked up again, as its file may have been created after the previous scan
+            std::vector<blob_id_type> ids = state->blob_ids();
+            auto probed = scanner.probe_blob_ids(state->max_scanned_blob_id(), max_existing_blob_id_, thread_count, &shutdown_requested_);
+            if (!ids.empty() && !probed.empty() && ids.back() == probed.front()) {
+                ids.pop_back();
+            }
+            ids.insert(ids.end(), probed.begin(), probed.end());
+            incremental_scans_ = state->incremental_scans() + 1;
+            VLOG_LP(log_debug) << "incremental BLOB file scan from blob id " << state->max_scanned_blob_id() << ", found " << probed.size()
+                               << " new BLOB files";
+            return ids;
+        }
+    }
+    auto ids = scanner.scan_blob_ids(thread_count, &shutdown_requested_);
+    ids.erase(std::upper_bound(ids.begin(), ids.end(), max_existing_blob_id_), ids.end());
+    incremental_scans_ = 0;
+    return ids;
+}
+
+void blob_file_garbage_collector::save_scan_state(std::vector<blob_id_type> removed_ids) noexcept {
+    try {
+        if (!existing_blob_files_ || !boost::filesystem::exists(resolver_->get_blob_root())) {
+            // nothing is saved unless the scan has completed
+            return;
+        }
+        std::sort(removed_ids.begin(), removed_ids.end());
+        std::vector<blob_id_type> remaining{};
+        remaining.reserve(existing_blob_files_->size());
+        std::set_difference(existing_blob_files_->begin(), existing_blob_files_->end(), removed_ids.begin(), removed_ids.end(),
+                            std::back_inserter(remaining));
+        blob_scan_state{max_existing_blob_id_, std::move(remaining), incremental_scans_}.save(resolver_->get_scan_state_path());
+    } catch (const std::exception &e) {
+        // the next scan lists the directories again
+        LOG_LP(WARNING) << "Failed to save the BLOB scan state: " << e.what();
+        boost::system::error_code ec;
+        boost::filesystem::remove(resolver_->get_scan_state_path(), ec);
+    }
+}
   
  void blob_file_garbage_collector::add_gc_exempt_blob_id(blob_id_type id) {
     VLOG_LP(log_trace) << "Adding blob id to gc_exempt_blob_: " << id;
@@ -119,10 +175,15 @@
          scanned_blobs_->diff(*gc_exempt_blob_);
          VLOG_LP(log_debug) << "Scanned blobs after: " << scanned_blobs_->debug_string();
 
+         std::vector<blob_id_type> garbage_ids{};
+         std::vector<blob_id_type> removed_ids{};
          for (const auto &id : *scanned_blobs_) {
             if (shutdown_requested_.load(std::memory_order_acquire)) {
                 break;
             }
+             if (pack_store_ != nullptr) {
+                 garbage_ids.emplace_back(id);
+             }
              boost::filesystem::path file_path = resolver_->resolve_path(id);
              boost::system::error_code ec;
              VLOG_LP(log_trace) << "Removing blob id: " << id;
@@ -131,6 +192,21 @@
              if (ec && ec != boost::system::errc::no_such_file_or_directory) {
                  LOG_LP(ERROR) << "Failed to remove file: " << file_path.string()
                                << " Error: " << ec.message();
+             } else {
+                 removed_ids.emplace_back(id);
+             }
+         }
+         if (read_cache_ != nullptr) {
+             read_cache_->evict(removed_ids);
+         }
+         if (!shutdown_requested_.load(std::memory_order_acquire)) {
+             save_scan_state(std::move(removed_ids));
+         }
+         if (pack_store_ != nullptr && !shutdown_requested_.load(std::memory_order_acquire)) {
+             try {
+                 pack_store_->collect_garbage(garbage_ids);
+             } catch (const std::exception &e) {
+                 LOG_LP(ERROR) << "Exception in BLOB segment garbage collection: " << e.what();
              }
          }
          state_machine_.complete_cleanup();
@@ -236,14 +312,19 @@ void blob_file_garbage_collector::wait_for_all_threads() {
 }
 
 void blob_file_garbage_collector::scan_snapshot(const boost::filesystem::path &snapshot_file, const boost::filesystem::path &compacted_file) {
+    scan_snapshot(snapshot_file, std::vector<boost::filesystem::path>{compacted_file});
+}
+
+void blob_file_garbage_collector::scan_snapshot(const boost::filesystem::path &snapshot_file, const std::vector<boost::filesystem::path> &compacted_files) {
     state_machine_.start_snapshot_scan(blob_file_gc_state_machine::snapshot_scan_mode::internal);
-    std::unique_ptr<my_cursor> cur;
     std::map<storage_id_type, write_version_type> clear_storage_map{};
-    if (boost::filesystem::exists(compacted_file)) {
-        cur = std::make_unique<my_cursor>(snapshot_file, compacted_file, clear_storage_map);
-    } else {
-        cur = std::make_unique<my_cursor>(snapshot_file, clear_storage_map);
+    std::vector<boost::filesystem::path> files{snapshot_file};
+    for (const auto &compacted_file : compacted_files) {
+        if (boost::filesystem::exists(compacted_file)) {
+            files.emplace_back(compacted_file);
+        }
     }
+    auto cur = std::make_unique<my_cursor>(files, clear_storage_map);
     // Launch the snapshot scanning thread with the pre-created cursor.
     snapshot_scan_thread_ = std::thread([this, cur = std::move(cur)]() {
         try {
@@ -317,6 +398,8 @@ void blob_file_garbage_collector::wait_for_scan_snapshot() {
      scanned_blobs_ = std::make_unique<blob_id_container>();
      gc_exempt_blob_ = std::make_unique<blob_id_container>();
      max_existing_blob_id_ = 0;
+     existing_blob_files_.reset();
+     incremental_scans_ = 0;
  }
 
  bool blob_file_garbage_collector::is_active() const {
@@ -18,6 +18,7 @@
 #include <limestone/api/blob_id_type.h>
 #include <boost/filesystem.hpp>
 #include <condition_variable>
+#include <cstdint>
 #include <future>
 #include <mutex>
 #include <thread>
@@ -32,6 +33,10 @@
 
 namespace limestone::internal {
 
+class blob_pack_store;
+class blob_file_scanner;
+class blob_read_cache;
+
 
 /**
  * @brief The blob_file_garbage_collector class is responsible for scanning the BLOB directory,
@@ -47,6 +52,10 @@ namespace limestone::internal {
  *
  * This class is intended for internal use only.
  *
+ * The IDs of the BLOB files left after each cleanup are saved in a blob_scan_state file, so that
+ * the next scan only has to look up the IDs above the maximum covered by the previous one.
+ * A full scan lists the subdirectories of the blob root in parallel.
+ *
  * @note The scanning process is initiated by calling scan_blob_files() exactly once.
  *       Subsequent calls will throw a std::logic_error.
  *
@@ -62,11 +71,20 @@ namespace limestone::internal {
  */
 class blob_file_garbage_collector {
 public:
+    /// the maximum number of threads listing the BLOB directories
+    static constexpr std::size_t max_scan_threads = 8;
+
+    /// the range of new IDs always looked up one by one instead of listing the directories
+    static constexpr blob_id_type min_probe_range = 65536;
+
     /**
      * @brief Constructor.
      * @param resolver The blob_file_resolver to be used for scanning.
+     * @param pack_store The store of packed BLOBs, whose BLOBs are scanned and collected as well, or nullptr.
+     * @param read_cache The cache of mapped BLOB files, from which the removed BLOB files are evicted, or nullptr.
      */
-    explicit blob_file_garbage_collector(const blob_file_resolver& resolver);
+    explicit blob_file_garbage_collector(const blob_file_resolver& resolver, blob_pack_store* pack_store = nullptr,
+                                         blob_read_cache* read_cache = nullptr);
 
     /**
      * @brief Destructor.
@@ -134,6 +152,17 @@ public:
      */
     void scan_snapshot(const boost::filesystem::path &snapshot_file, const boost::filesystem::path &compacted_file);
 
+    /**
+     * @brief Starts scanning snapshots in a background thread.
+     *
+     * Same as above, for the compacted files of several generations.
+     * Compacted files that do not exist are ignored.
+     *
+     * @param snapshot_file The snapshot file.
+     * @param compacted_files The compacted files, ordered from the newest generation to the oldest.
+     */
+    void scan_snapshot(const boost::filesystem::path &snapshot_file, const std::vector<boost::filesystem::path> &compacted_files);
+
 
     /**
      * @brief Shuts down the garbage collection process.
@@ -238,9 +267,13 @@ private:
 
     // --- Resolver and Blob Containers ---
     const blob_file_resolver* resolver_ = nullptr;         ///< Pointer to the blob_file_resolver instance.
+    blob_pack_store* pack_store_ = nullptr;                 ///< Pointer to the store of packed BLOBs, if any.
+    blob_read_cache* read_cache_ = nullptr;                 ///< Pointer to the cache of mapped BLOB files, if any.
     std::unique_ptr<blob_id_container> scanned_blobs_;      ///< Container for storing scanned blob ids.
     std::unique_ptr<blob_id_container> gc_exempt_blob_;     ///< Container for storing blob ids exempt from garbage collection.
     blob_id_type max_existing_blob_id_ = 0;                 ///< Maximum blob_id that existed at startup.
+    std::optional<std::vector<blob_id_type>> existing_blob_files_;  ///< IDs of the BLOB files found by a completed scan, in ascending order.
+    std::uint32_t incremental_scans_ = 0;                   ///< Number of incremental scans since the last full scan.
 
     // --- Blob File Scanning Process Fields ---
     std::thread blob_file_scan_thread_;             ///< Background thread for scanning the BLOB directory.
@@ -270,6 +303,21 @@ private:
      */
     void scan_directory();
 
+    /**
+     * @brief Lists the IDs of the BLOB files up to max_existing_blob_id_, in ascending order.
+     *
+     * If the blob_scan_state saved by the previous cleanup covers a maximum not above max_existing_blob_id_,
+     * and the IDs above it are few enough, only those IDs are looked up. Otherwise the directories are listed.
+     */
+    std::vector<blob_id_type> list_blob_files(const blob_file_scanner& scanner);
+
+    /**
+     * @brief Saves the BLOB files left after the cleanup as the blob_scan_state for the next scan.
+     *
+     * @param removed_ids The IDs whose BLOB files have been removed or did not exist.
+     */
+    void save_scan_state(std::vector<blob_id_type> removed_ids) noexcept;
+
     /**
      * @brief Cleans up internal container resources.
      *
@@ -15,26 +15,25 @@
  */
 
 #include "blob_file_gc_snapshot.h"
-#include "log_entry_container.h"
-#include "log_entry_comparator.h"
 #include <algorithm>
+#include <utility>
 
 namespace limestone::internal {
 
 // ----------------- Implementation of blob_file_gc_snapshot methods -----------------
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-thread_local std::shared_ptr<log_entry_container> blob_file_gc_snapshot::tls_low_container_ = nullptr;
-// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-thread_local std::shared_ptr<log_entry_container> blob_file_gc_snapshot::tls_high_container_ = nullptr;
+thread_local std::shared_ptr<blob_file_gc_snapshot::local_entries> blob_file_gc_snapshot::tls_entries_ = nullptr;
 
-blob_file_gc_snapshot::blob_file_gc_snapshot(const write_version_type& boundary_version) : boundary_version_(boundary_version) {
-    // The thread_low_containers_, thread_high_containers_ and aggregated_entries are default-constructed.
+blob_file_gc_snapshot::blob_file_gc_snapshot(const write_version_type& boundary_version,
+                                             boost::filesystem::path spill_directory,
+                                             std::size_t memory_limit)
+    : boundary_version_(boundary_version), sorter_(std::move(spill_directory), memory_limit) {
+    // The thread_entries_ is default-constructed.
 }
 
 blob_file_gc_snapshot::~blob_file_gc_snapshot() {
-    // Reset the thread-local containers to avoid state leakage between tests or re-use in the same thread.
-    tls_low_container_.reset();
-    tls_high_container_.reset();
+    // Reset the thread-local entries to avoid state leakage between tests or re-use in the same thread.
+    tls_entries_.reset();
 }
 
 void blob_file_gc_snapshot::sanitize_and_add_entry(const log_entry& entry) {
@@ -43,90 +42,111 @@ void blob_file_gc_snapshot::sanitize_and_add_entry(const log_entry& entry) {
         return;
     }
 
-    // Create a modifiable copy of the entry.
-    // NOLINTNEXTLINE(performance-unnecessary-copy-initialization)
-    log_entry modified_entry = entry;
+    // Obtain the write_version from the entry.
+    write_version_type entry_wv;
+    entry.write_version(entry_wv);
+    add_reference(entry.key_sid(), entry_wv, entry.raw_blob_ids());
+}
 
-    // Truncate unnecessary data from the value_etc field.
-    modified_entry.truncate_value_from_normal_entry();
+void blob_file_gc_snapshot::add_reference(std::string_view key_sid, const write_version_type& version, std::string_view raw_blob_ids) {
+    if (!tls_entries_) {
+        tls_entries_ = std::make_shared<local_entries>();
+        {
+            std::lock_guard<std::mutex> lock(global_mtx_);
+            thread_entries_.push_back(tls_entries_);
+        }
+    }
 
-    // Obtain the write_version from the modified entry.
-    write_version_type entry_wv;
-    modified_entry.write_version(entry_wv);
-
-    // Dispatch entry to the appropriate container based on write_version.
-    if (entry_wv < boundary_version_) {
-        // Process low container.
-        if (!tls_low_container_) {
-            tls_low_container_ = std::make_shared<log_entry_container>();
-            {
-                std::lock_guard<std::mutex> lock(global_mtx_);
-                thread_low_containers_.push_back(tls_low_container_);
-            }
+    // Dispatch entry to the appropriate group based on write_version.
+    if (version < boundary_version_) {
+        // Keep only what deduplication by key needs, instead of the whole entry.
+        auto& r = tls_entries_->low_run.emplace_back();
+        r.key_sid = key_sid;
+        r.version = version;
+        r.blob_ids = raw_blob_ids;
+        tls_entries_->low_run_bytes += r.footprint();
+        if (tls_entries_->low_run_bytes >= sorter_.run_limit()) {
+            flush_low_run(*tls_entries_);
         }
-        tls_low_container_->append(modified_entry);
     } else {
-        // Process high container.
-        if (!tls_high_container_) {
-            tls_high_container_ = std::make_shared<log_entry_container>();
-            {
-                std::lock_guard<std::mutex> lock(global_mtx_);
-                thread_high_containers_.push_back(tls_high_container_);
-            }
+        for (const auto& blob_id : log_entry::parse_blob_ids(raw_blob_ids)) {
+            tls_entries_->high_blob_ids.push_back(blob_id);
+        }
+        if (tls_entries_->high_blob_ids.size() * sizeof(blob_id_type) >= sorter_.run_limit()) {
+            flush_high_blob_ids(*tls_entries_);
         }
-        tls_high_container_->append(modified_entry);
     }
 }
 
-void blob_file_gc_snapshot::finalize_local_entries() {
-    if (tls_low_container_) {
-        tls_low_container_->sort_descending();
-        tls_low_container_.reset();
+void blob_file_gc_snapshot::flush_low_run(local_entries& entries) {
+    if (entries.low_run.empty()) {
+        return;
     }
-    if (tls_high_container_) {
-        // For high container, no sorting is required.
-        tls_high_container_.reset();
+    blob_reference_sorter::sort_run(entries.low_run);
+    sorter_.add_run(std::move(entries.low_run));
+    entries.low_run.clear();
+    entries.low_run_bytes = 0;
+}
+
+void blob_file_gc_snapshot::flush_high_blob_ids(local_entries& entries) {
+    if (entries.high_blob_ids.empty()) {
+        return;
+    }
+    // not required, but a BLOB referenced by many versions is written out once
+    std::sort(entries.high_blob_ids.begin(), entries.high_blob_ids.end());
+    entries.high_blob_ids.erase(std::unique(entries.high_blob_ids.begin(), entries.high_blob_ids.end()), entries.high_blob_ids.end());
+    sorter_.add_blob_ids(std::move(entries.high_blob_ids));
+    entries.high_blob_ids.clear();
+}
+
+void blob_file_gc_snapshot::finalize_local_entries() {
+    if (tls_entries_) {
+        flush_low_run(*tls_entries_);
+        flush_high_blob_ids(*tls_entries_);
+        tls_entries_.reset();
     }
 }
 
-log_entry_container blob_file_gc_snapshot::finalize_low_entries_impl() {
-    // Merge and sort low containers, then remove duplicate entries.
-    log_entry_container low_merged = log_entry_container::merge_sorted_collections(thread_low_containers_);
-    std::string last_key;
-    for (const auto& entry : low_merged) {
-        const std::string& current_key = entry.key_sid();
-        if (last_key.empty() || current_key != last_key) {
-            aggregated_entries.append(entry);
-            last_key = current_key;
+void blob_file_gc_snapshot::finalize_low_entries_impl(const std::function<void(blob_id_type)>& consumer) {
+    {
+        // Hand over the entries of threads which have not called finalize_local_entries().
+        std::lock_guard<std::mutex> lock(global_mtx_);
+        for (const auto& entries : thread_entries_) {
+            flush_low_run(*entries);
         }
     }
-    return aggregated_entries;
+    // Merge and sort low runs, removing duplicate entries.
+    sorter_.merge([&consumer](const blob_reference_sorter::record& r) {
+        for (const auto& blob_id : log_entry::parse_blob_ids(r.blob_ids)) {
+            consumer(blob_id);
+        }
+    });
 }
 
-log_entry_container blob_file_gc_snapshot::finalize_high_entries_impl() {
-    for (const auto& high_container : thread_high_containers_) {
-        for (const auto& entry : *high_container) {
-            aggregated_entries.append(entry);
+void blob_file_gc_snapshot::finalize_high_entries_impl(const std::function<void(blob_id_type)>& consumer) {
+    {
+        // Hand over the entries of threads which have not called finalize_local_entries().
+        std::lock_guard<std::mutex> lock(global_mtx_);
+        for (const auto& entries : thread_entries_) {
+            flush_high_blob_ids(*entries);
+            entries->high_blob_ids.shrink_to_fit();
         }
     }
-    return aggregated_entries;
+    sorter_.drain_blob_ids(consumer);
 }
 
-const log_entry_container& blob_file_gc_snapshot::finalize_snapshot() {
-    aggregated_entries.clear();
-    finalize_low_entries_impl();
-    finalize_high_entries_impl();
-    return aggregated_entries;
+void blob_file_gc_snapshot::finalize_snapshot(const std::function<void(blob_id_type)>& consumer) {
+    finalize_low_entries_impl(consumer);
+    finalize_high_entries_impl(consumer);
 }
 
 void blob_file_gc_snapshot::reset() {
     {
         std::lock_guard<std::mutex> lock(global_mtx_);
-        thread_low_containers_.clear();
-        thread_high_containers_.clear();
+        thread_entries_.clear();
     }
-    aggregated_entries.clear();
-    // Note: The thread_local containers remain set in each thread.
+    sorter_.clear();
+    // Note: The thread_local entries remain set in each thread.
     // Their lifetime is managed per thread; if needed, threads can reset them.
 }
 
@@ -16,33 +16,48 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <mutex>
-#include "log_entry_container.h"
+#include <boost/filesystem.hpp>
+#include "blob_reference_sorter.h"
+#include "log_entry.h"
 #include "limestone/api/blob_id_type.h"
 
 namespace limestone::internal {
 
+using limestone::api::blob_id_type;
+using limestone::api::log_entry;
+
 /*
  * blob_file_gc_snapshot
  *
- * This class maintains a snapshot of log entries for blob file garbage collection.
+ * This class maintains a snapshot of the BLOB IDs referenced from log entries for blob file garbage collection.
  * It collects entries from multiple threads in two separate groups:
  *
- *   - Low entries container: Contains log entries with write_version below boundary_version.
- *     These entries will be merged, sorted, and deduplicated.
+ *   - Low entries: log entries with write_version below boundary_version.
+ *     Only their key, write_version and BLOB IDs are kept, which are sorted in runs per thread,
+ *     handed to a blob_reference_sorter, and merged with only the newest entry of each key kept.
+ *     The sorter writes the runs beyond its memory limit to the spill directory.
  *
- *   - High entries container: Contains log entries with write_version greater than or equal to boundary_version.
- *     These entries are not processed with merge/sort/duplicate removal and will be directly appended.
+ *   - High entries: log entries with write_version greater than or equal to boundary_version.
+ *     Only their BLOB IDs are kept, without merge, and handed to the same sorter in batches,
+ *     so that they are written to the spill directory within the same memory limit.
  */
 class blob_file_gc_snapshot {
 public:
     /* 
      * Constructs a blob_file_gc_snapshot with the given boundary_version.
      * @param boundary_version The boundary_version for garbage collection.
+     * @param spill_directory The directory to write the sorted runs of low entries and the BLOB IDs of high entries into,
+     *        or empty to keep them all in memory.
+     * @param memory_limit The memory used for the entries before they are written to the spill directory.
      */
-    explicit blob_file_gc_snapshot(const write_version_type& boundary_version);
+    explicit blob_file_gc_snapshot(const write_version_type& boundary_version,
+                                   boost::filesystem::path spill_directory = {},
+                                   std::size_t memory_limit = blob_reference_sorter::default_memory_limit);
 
     // Disable copy and move semantics.
     blob_file_gc_snapshot(const blob_file_gc_snapshot&) = delete;
@@ -59,31 +74,41 @@ public:
      * Sanitizes and adds a log entry to the snapshot.
      *
      * Only entries of type normal_with_blob are processed.
-     * The method clears the payload from the entry’s value_etc (keeping the write_version header)
-     * and adds the entry into the appropriate container based on its write_version:
-     *   - write_version below boundary_version goes to the low entries container.
-     *   - write_version greater than or equal to boundary_version goes to the high entries container.
+     * The method keeps only the key, write_version and BLOB IDs of the entry, and adds them
+     * to the appropriate group based on its write_version:
+     *   - write_version below boundary_version goes to the low entries.
+     *   - write_version greater than or equal to boundary_version goes to the high entries.
      *
      * @param entry The log_entry to be processed and potentially added.
      */
     void sanitize_and_add_entry(const log_entry& entry);
 
+    /**
+     * @brief Adds the BLOB reference of an entry with BLOBs to the snapshot, as sanitize_and_add_entry() does.
+     *
+     * @param key_sid The key_sid of the entry.
+     * @param version The write_version of the entry.
+     * @param raw_blob_ids The BLOB IDs of the entry, as in log_entry::raw_blob_ids().
+     */
+    void add_reference(std::string_view key_sid, const write_version_type& version, std::string_view raw_blob_ids);
+
     /* 
      * Notifies that the add_entry operations in the current thread are complete,
-     * and finalizes (sorts) the low container for later merging.
-     * For the high container, no sorting is performed.
+     * and sorts the low entries of the thread into a run for later merging.
+     * For the high entries, no sorting is performed.
      */
     void finalize_local_entries();
 
     /**
-     * @brief Finalizes the snapshot after all entries have been added and returns the snapshot.
+     * @brief Finalizes the snapshot after all entries have been added and passes its BLOB IDs to the consumer.
      *
      * This method calls the two protected methods finalize_low_entries_impl() and
-     * finalize_high_entries_impl() sequentially, and combines their results.
+     * finalize_high_entries_impl() sequentially. The entries are consumed, leaving the snapshot empty.
      *
-     * @return const log_entry_container& The finalized snapshot of log entries.
+     * @param consumer The function called with each BLOB ID in the snapshot.
+     * @throws limestone_io_exception if the spilled runs cannot be read.
      */
-    const log_entry_container& finalize_snapshot();
+    void finalize_snapshot(const std::function<void(blob_id_type)>& consumer);
     
     /* 
      * Resets the internal state for a new garbage collection cycle.
@@ -101,42 +126,51 @@ protected:
     // Protected methods for unit testing.
 
     /**
-     * @brief Finalizes low entries: merges, sorts and removes duplicates.
+     * @brief Finalizes low entries: merges, sorts and removes duplicates, and consumes their BLOB IDs.
      *
-     * @return log_entry_container The merged low entries container.
+     * @param consumer The function called with each BLOB ID of the newest low entry of each key.
      */
-    log_entry_container finalize_low_entries_impl();
+    void finalize_low_entries_impl(const std::function<void(blob_id_type)>& consumer);
 
     /**
-     * @brief Finalizes high entries: appends all high container entries.
+     * @brief Finalizes high entries: consumes the BLOB IDs of all high entries.
      *
-     * @return log_entry_container The container holding all high entries.
+     * @param consumer The function called with each BLOB ID of the high entries.
      */
-    log_entry_container finalize_high_entries_impl();
+    void finalize_high_entries_impl(const std::function<void(blob_id_type)>& consumer);
 
 private:
-    // Thread-local pointer to each thread's low log_entry_container.
-    // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-    static thread_local std::shared_ptr<log_entry_container> tls_low_container_;
-
-    // Thread-local pointer to each thread's high log_entry_container.
+    // The entries added by a thread.
+    struct local_entries {
+        // The low entries not yet handed to the sorter.
+        blob_reference_sorter::run_type low_run;
+        std::size_t low_run_bytes = 0;
+        // The BLOB IDs of the high entries not yet handed to the sorter.
+        std::vector<blob_id_type> high_blob_ids;
+    };
+
+    // Sorts the low entries of a thread and hands them to the sorter.
+    void flush_low_run(local_entries& entries);
+
+    // Hands the BLOB IDs of the high entries of a thread to the sorter, without duplicates.
+    void flush_high_blob_ids(local_entries& entries);
+
+    // Thread-local pointer to each thread's entries.
     // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-    static thread_local std::shared_ptr<log_entry_container> tls_high_container_;
+    static thread_local std::shared_ptr<local_entries> tls_entries_;
 
     // The boundary version for write_version used in garbage collection.
     write_version_type boundary_version_;
 
-    // Final snapshot after merging low containers (with deduplication) and appending high entries.
-    log_entry_container aggregated_entries;
+    // Sorts and deduplicates the low entries, and keeps the BLOB IDs of the high entries,
+    // spilling them beyond its memory limit.
+    blob_reference_sorter sorter_;
 
-    // Global mutex to ensure thread-safe access to thread-local container vectors.
+    // Global mutex to ensure thread-safe access to the list of thread-local entries.
     mutable std::mutex global_mtx_;
 
-    // List of thread-local low containers to be merged into the final snapshot.
-    std::vector<std::shared_ptr<log_entry_container>> thread_low_containers_;
-
-    // List of thread-local high containers whose entries are directly appended.
-    std::vector<std::shared_ptr<log_entry_container>> thread_high_containers_;
+    // List of thread-local entries to be merged into the final snapshot.
+    std::vector<std::shared_ptr<local_entries>> thread_entries_;
 };
 
 } // namespace limestone::internal
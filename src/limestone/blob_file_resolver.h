@@ -16,8 +16,16 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <sstream>
 #include <iomanip>
+#include <string_view>
 #include <vector>
 
 #include <limestone/api/blob_file.h>
@@ -42,6 +50,9 @@ using limestone::api::blob_file;
  */
 class blob_file_resolver {
 public:
+    /// the length of the file name of a BLOB file, 16 hexadecimal digits and ".blob"
+    static constexpr std::size_t blob_file_name_length = 16 + 5;
+
     /**
      * @brief Constructs a blob_file_resolver with the given base directory.
      * 
@@ -63,16 +74,14 @@ public:
      * @return The resolved file path.
      */
     [[nodiscard]] boost::filesystem::path resolve_path(blob_id_type blob_id) const noexcept {
-        std::size_t directory_index = hash_function_(blob_id) % directory_count_;
-
         // Retrieve precomputed directory path
-        const boost::filesystem::path& subdirectory = directory_cache_[directory_index];
+        const boost::filesystem::path& subdirectory = directory_cache_[directory_index(blob_id)];
 
         // Generate the file name
-        std::ostringstream file_name;
-        file_name << std::hex << std::setw(16) << std::setfill('0') << blob_id << ".blob";
+        std::array<char, blob_file_name_length + 1> file_name{};
+        format_blob_file_name(blob_id, file_name.data());
 
-        return subdirectory / file_name.str();
+        return subdirectory / file_name.data();
     }
 
     /**
@@ -84,23 +93,8 @@ public:
      * @return true if the file is a valid blob_file, false otherwise.
      */
     [[nodiscard]] bool is_blob_file(const boost::filesystem::path& path) const noexcept {
-        std::string filename = path.filename().string();
-        if (filename.size() != 16 + 5) { // 16 hex digits + ".blob"
-            return false;
-        }
-        if (filename.substr(16) != ".blob") {
-            return false;
-        }
-        for (size_t i = 0; i < 16; ++i) {
-            char c = filename[i];
-            // NOLINTNEXTLINE(readability-simplify-boolean-expr)
-            if (!((c >= '0' && c <= '9') ||
-                  (c >= 'A' && c <= 'F') ||
-                  (c >= 'a' && c <= 'f'))) {
-                return false; 
-            }
-        }
-        return true;
+        blob_id_type id = 0;
+        return parse_blob_file_name(file_name_of(path), id);
     }
 
     /**
@@ -114,12 +108,55 @@ public:
      * @note Behavior is undefined if the file name does not conform to the expected format.
      */
     [[nodiscard]] blob_id_type extract_blob_id(const boost::filesystem::path& path) const noexcept {
-        std::string filename = path.filename().string();
-        std::istringstream iss(filename.substr(0, 16));
-        iss >> std::hex;
         blob_id_type id = 0;
-        iss >> id;
-        return id;
+        return parse_blob_file_name(file_name_of(path), id) ? id : 0;
+    }
+
+    /**
+     * @brief Parses a file name formatted as 16 hexadecimal digits followed by the ".blob" extension.
+     *
+     * The name is examined in place, so that directory scans can call this for every entry without allocating.
+     *
+     * @param name The file name, without the directory part.
+     * @param id Receives the BLOB ID if the name is valid.
+     * @return true if the name is that of a blob_file, false otherwise.
+     */
+    [[nodiscard]] static bool parse_blob_file_name(std::string_view name, blob_id_type& id) noexcept {
+        if (name.size() != blob_file_name_length || name.substr(16) != ".blob") { // 16 hex digits + ".blob"
+            return false;
+        }
+        blob_id_type value = 0;
+        for (std::size_t i = 0; i < 16; ++i) {
+            char c = name[i];
+            unsigned int digit = 0;
+            if (c >= '0' && c <= '9') {
+                digit = static_cast<unsigned int>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                digit = static_cast<unsigned int>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                digit = static_cast<unsigned int>(c - 'A' + 10);
+            } else {
+                return false;
+            }
+            value = (value << 4U) | digit;
+        }
+        id = value;
+        return true;
+    }
+
+    /**
+     * @brief Writes the file name of the given BLOB ID, 16 lowercase hexadecimal digits followed by ".blob".
+     *
+     * @param blob_id The ID of the BLOB.
+     * @param buffer Receives the file name and a terminating null character, blob_file_name_length + 1 bytes.
+     */
+    static void format_blob_file_name(blob_id_type blob_id, char* buffer) noexcept {
+        static constexpr std::string_view digits{"0123456789abcdef"};
+        for (std::size_t i = 16; i > 0; --i) {
+            buffer[i - 1] = digits[blob_id & 0xfU];
+            blob_id >>= 4U;
+        }
+        std::memcpy(buffer + 16, ".blob", 6);
     }
 
     /**
@@ -131,7 +168,93 @@ public:
         return blob_directory_;
     }
 
+    /**
+     * @brief Returns the directory holding the segment files of packed BLOBs (see blob_pack_store).
+     *
+     * @return The pack directory path, `<blob root>/pack`.
+     */
+    [[nodiscard]] boost::filesystem::path get_pack_directory() const noexcept {
+        return blob_directory_ / "pack";
+    }
+
+    /**
+     * @brief Returns the file where blob_file_garbage_collector keeps the result of its last scan (see blob_scan_state).
+     *
+     * @return The scan state file path, `<blob root>/gc_scan_state`.
+     */
+    [[nodiscard]] boost::filesystem::path get_scan_state_path() const noexcept {
+        return blob_directory_ / "gc_scan_state";
+    }
+
+    /**
+     * @brief Resolves the path of the segment file with the given sequence number.
+     *
+     * @param sequence The sequence number of the segment.
+     * @return The segment file path, named `pack_` followed by 16 hexadecimal digits and the ".pack" extension.
+     */
+    [[nodiscard]] boost::filesystem::path resolve_pack_path(std::uint64_t sequence) const noexcept {
+        std::ostringstream file_name;
+        file_name << "pack_" << std::hex << std::setw(16) << std::setfill('0') << sequence << ".pack";
+        return get_pack_directory() / file_name.str();
+    }
+
+    /**
+     * @brief Checks whether the file at the specified path is named as a segment file of packed BLOBs.
+     *
+     * @param path The file path to check.
+     * @return true if the file name is that of a segment file, false otherwise.
+     */
+    [[nodiscard]] bool is_pack_file(const boost::filesystem::path& path) const noexcept {
+        std::string filename = path.filename().string();
+        if (filename.size() != 5 + 16 + 5 || filename.compare(0, 5, "pack_") != 0 || filename.compare(21, 5, ".pack") != 0) {
+            return false;
+        }
+        return std::all_of(filename.begin() + 5, filename.begin() + 21, [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; });
+    }
+
+    /**
+     * @brief Extracts the sequence number from the given segment file path.
+     *
+     * @param path The segment file path.
+     * @return The extracted sequence number.
+     * @note Behavior is undefined if the file name does not conform to the expected format.
+     */
+    [[nodiscard]] std::uint64_t extract_pack_sequence(const boost::filesystem::path& path) const noexcept {
+        return std::strtoull(path.filename().string().substr(5, 16).c_str(), nullptr, 16);
+    }
+
+    /**
+     * @brief Returns the number of subdirectories the BLOB files are distributed among.
+     */
+    [[nodiscard]] std::size_t directory_count() const noexcept {
+        return directory_count_;
+    }
+
+    /**
+     * @brief Returns the subdirectory with the given index.
+     *
+     * @param index The index of the subdirectory, less than directory_count().
+     * @return The subdirectory path, `<blob root>/dir_XX`.
+     */
+    [[nodiscard]] const boost::filesystem::path& get_directory(std::size_t index) const noexcept {
+        return directory_cache_[index];
+    }
+
+    /**
+     * @brief Returns the index of the subdirectory holding the BLOB file of the given ID.
+     */
+    [[nodiscard]] std::size_t directory_index(blob_id_type blob_id) const noexcept {
+        return hash_function_(blob_id) % directory_count_;
+    }
+
 private:
+    // returns the last component of the path as a view into it, without the copy made by filename()
+    static std::string_view file_name_of(const boost::filesystem::path& path) noexcept {
+        std::string_view native{path.native()};
+        std::size_t pos = native.find_last_of('/');
+        return pos == std::string_view::npos ? native : native.substr(pos + 1);
+    }
+
     /**
      * @brief Precomputes all directory paths and stores them in the cache.
      */
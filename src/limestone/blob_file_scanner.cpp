@@ -16,12 +16,149 @@
 
 #include "blob_file_scanner.h"
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <thread>
+
 #include "blob_file_resolver.h"
 #include "limestone/logging.h"
+#include "limestone_exception_helper.h"
 #include "logging_helper.h"
 
 namespace limestone::internal {
 
+using namespace limestone::api;
+
+namespace {
+
+// the size of the buffer passed to each getdents64 call
+constexpr std::size_t dirent_buffer_size = 128UL * 1024UL;
+
+// offsets in struct linux_dirent64, which is not declared by glibc
+constexpr std::size_t dirent_reclen_offset = 16;
+constexpr std::size_t dirent_type_offset = 18;
+constexpr std::size_t dirent_name_offset = 19;
+
+bool is_cancelled(const std::atomic_bool* cancel) {
+    return cancel != nullptr && cancel->load(std::memory_order_acquire);
+}
+
+// opens the directory, returning -1 if it does not exist
+int open_directory(const boost::filesystem::path& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0 && errno != ENOENT) {
+        int error_code = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to open BLOB directory: " + directory.string(), error_code);
+    }
+    return fd;
+}
+
+// follows symbolic links, as boost::filesystem::is_regular_file() does
+bool is_regular_file_at(int dir_fd, const char* name) {
+    struct stat st{};
+    return ::fstatat(dir_fd, name, &st, 0) == 0 && S_ISREG(st.st_mode);
+}
+
+// appends the IDs of the BLOB files in the directory; a missing directory has none
+void list_directory(const boost::filesystem::path& directory, std::vector<blob_id_type>& ids, const std::atomic_bool* cancel) {
+    int fd = open_directory(directory);
+    if (fd < 0) {
+        return;
+    }
+    auto buffer = std::make_unique<char[]>(dirent_buffer_size);  // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    while (!is_cancelled(cancel)) {
+        auto nread = ::syscall(SYS_getdents64, fd, buffer.get(), dirent_buffer_size);
+        if (nread < 0) {
+            int error_code = errno;
+            ::close(fd);
+            LOG_AND_THROW_IO_EXCEPTION("Failed to read BLOB directory: " + directory.string(), error_code);
+        }
+        if (nread == 0) {
+            break;
+        }
+        for (decltype(nread) pos = 0; pos < nread;) {
+            const char* entry = buffer.get() + pos;
+            std::uint16_t reclen = 0;
+            std::memcpy(&reclen, entry + dirent_reclen_offset, sizeof(reclen));
+            pos += reclen;
+
+            auto type = static_cast<unsigned char>(entry[dirent_type_offset]);
+            const char* name = entry + dirent_name_offset;
+            blob_id_type id = 0;
+            if (type != DT_REG && type != DT_LNK && type != DT_UNKNOWN) {
+                continue;
+            }
+            if (!blob_file_resolver::parse_blob_file_name(std::string_view{name}, id)) {
+                continue;
+            }
+            if (type == DT_REG || is_regular_file_at(fd, name)) {
+                ids.emplace_back(id);
+            }
+        }
+    }
+    ::close(fd);
+}
+
+// runs task(index, ids) for every index in [0, task_count) on up to thread_count threads,
+// and returns the IDs appended by the tasks in ascending order
+template <class Task>
+std::vector<blob_id_type> run_in_parallel(std::size_t task_count, std::size_t thread_count, const Task& task) {
+    thread_count = std::clamp<std::size_t>(thread_count, 1, std::max<std::size_t>(task_count, 1));
+    std::atomic_size_t next_task{0};
+    std::vector<std::vector<blob_id_type>> results(thread_count);
+    std::vector<std::exception_ptr> errors(thread_count);
+    auto worker = [&](std::size_t worker_index) {
+        try {
+            for (std::size_t i = next_task++; i < task_count; i = next_task++) {
+                task(i, results[worker_index]);
+            }
+        } catch (...) {
+            errors[worker_index] = std::current_exception();
+            next_task = task_count;
+        }
+    };
+    std::vector<std::thread> threads{};
+    threads.reserve(thread_count - 1);
+    for (std::size_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::size_t total = 0;
+    for (const auto& ids : results) {
+        total += ids.size();
+    }
+    std::vector<blob_id_type> merged{};
+    merged.reserve(total);
+    for (const auto& ids : results) {
+        merged.insert(merged.end(), ids.begin(), ids.end());
+    }
+    std::sort(merged.begin(), merged.end());
+    return merged;
+}
+
+}  // namespace
+
 blob_file_scanner::blob_file_scanner(const blob_file_resolver* resolver)
     : resolver_(resolver) {}
 
@@ -64,4 +201,49 @@ blob_file_scanner::iterator blob_file_scanner::begin() const {
      return {};
  }
 
+std::vector<blob_id_type> blob_file_scanner::scan_blob_ids(std::size_t thread_count, const std::atomic_bool* cancel) const {
+    auto ids = run_in_parallel(resolver_->directory_count(), thread_count, [this, cancel](std::size_t index, std::vector<blob_id_type>& found) {
+        list_directory(resolver_->get_directory(index), found, cancel);
+    });
+    VLOG_LP(log_debug) << "scanned " << ids.size() << " BLOB files";
+    return ids;
+}
+
+std::vector<blob_id_type> blob_file_scanner::probe_blob_ids(blob_id_type first, blob_id_type last, std::size_t thread_count,
+                                                            const std::atomic_bool* cancel) const {
+    if (first > last) {
+        return {};
+    }
+    const std::size_t directory_count = resolver_->directory_count();
+    auto ids = run_in_parallel(directory_count, thread_count, [&](std::size_t index, std::vector<blob_id_type>& found) {
+        // the IDs in a directory are congruent modulo the number of directories, so only
+        // the first one in the range has to be searched for
+        blob_id_type id = first;
+        while (resolver_->directory_index(id) != index) {
+            if (id == last) {
+                return;
+            }
+            id++;
+        }
+        int fd = open_directory(resolver_->get_directory(index));
+        if (fd < 0) {
+            return;
+        }
+        std::array<char, blob_file_resolver::blob_file_name_length + 1> name{};
+        while (!is_cancelled(cancel)) {
+            blob_file_resolver::format_blob_file_name(id, name.data());
+            if (is_regular_file_at(fd, name.data())) {
+                found.emplace_back(id);
+            }
+            if (last - id < directory_count) {
+                break;
+            }
+            id += directory_count;
+        }
+        ::close(fd);
+    });
+    VLOG_LP(log_debug) << "probed BLOB IDs " << first << " to " << last << ", found " << ids.size() << " BLOB files";
+    return ids;
+}
+
  }  // namespace limestone::internal
@@ -17,10 +17,17 @@
  #pragma once
 
  #include <boost/filesystem.hpp>
+ #include <atomic>
+ #include <cstddef>
  #include <iterator>
+ #include <vector>
+
+ #include <limestone/api/blob_id_type.h>
  
  namespace limestone::internal {
  
+ using limestone::api::blob_id_type;
+
  class blob_file_resolver;
  
  /**
@@ -111,6 +118,35 @@
       */
      [[nodiscard]] iterator end() const;
 
+     /**
+      * @brief Lists the IDs of the BLOB files in the subdirectories of the blob root.
+      *
+      * The subdirectories are distributed among up to thread_count threads, each reading its
+      * directories with large batched getdents64 calls and parsing the names in place.
+      * Unlike the iterator, files placed outside the subdirectories are not listed.
+      *
+      * @param thread_count The maximum number of threads to use.
+      * @param cancel If not null, the scan stops early once it becomes true.
+      * @return The IDs in ascending order.
+      * @throws limestone_io_exception if a subdirectory cannot be read.
+      */
+     [[nodiscard]] std::vector<blob_id_type> scan_blob_ids(std::size_t thread_count, const std::atomic_bool* cancel = nullptr) const;
+
+     /**
+      * @brief Lists the IDs in the range [first, last] whose BLOB files exist, by looking each of them up.
+      *
+      * This is cheaper than scan_blob_ids() when the range is small compared to the number of BLOB files.
+      *
+      * @param first The first ID of the range.
+      * @param last The last ID of the range.
+      * @param thread_count The maximum number of threads to use.
+      * @param cancel If not null, the lookup stops early once it becomes true.
+      * @return The IDs in ascending order.
+      * @throws limestone_io_exception if a subdirectory cannot be read.
+      */
+     [[nodiscard]] std::vector<blob_id_type> probe_blob_ids(blob_id_type first, blob_id_type last, std::size_t thread_count,
+                                                            const std::atomic_bool* cancel = nullptr) const;
+
  private:
      const blob_file_resolver* resolver_;  ///< Reference to the blob_file_resolver instance.
  };
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_file_syncer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <set>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "blob_pack_store.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+// returns 0 on success, ENOENT if the file does not exist, or the errno of the failure
+int sync_path(const boost::filesystem::path& path, int flags) {
+    int fd = ::open(path.c_str(), flags);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0) {
+        return errno;
+    }
+    int error_code = ::fsync(fd) == 0 ? 0 : errno;
+    ::close(fd);
+    return error_code;
+}
+
+}  // namespace
+
+void blob_file_syncer::add(blob_id_type id, const boost::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.insert_or_assign(id, path);
+}
+
+void blob_file_syncer::discard(const std::vector<blob_id_type>& ids) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& id : ids) {
+        pending_.erase(id);
+    }
+}
+
+std::size_t blob_file_syncer::pending_count() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return pending_.size();
+}
+
+void blob_file_syncer::sync() {
+    std::lock_guard<std::mutex> sync_lock(sync_mtx_);
+    std::map<blob_id_type, boost::filesystem::path> files{};
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        files.swap(pending_);
+    }
+
+    // the files not synchronized are put back, to be retried by the next sync()
+    auto restore = [this, &files](std::map<blob_id_type, boost::filesystem::path>::const_iterator from) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_.insert(from, files.cend());
+    };
+
+    std::set<boost::filesystem::path> directories{};
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        int error_code = sync_path(it->second, O_RDONLY);
+        if (error_code == ENOENT) {
+            // removed by the release of its pool, or by the garbage collector
+            continue;
+        }
+        if (error_code != 0) {
+            restore(it);
+            LOG_AND_THROW_IO_EXCEPTION("Failed to synchronize BLOB file: " + it->second.string(), error_code);
+        }
+        directories.emplace(it->second.parent_path());
+    }
+    for (const auto& directory : directories) {
+        int error_code = sync_path(directory, O_RDONLY | O_DIRECTORY);
+        if (error_code != 0 && error_code != ENOENT) {
+            restore(files.cbegin());
+            LOG_AND_THROW_IO_EXCEPTION("Failed to synchronize BLOB directory: " + directory.string(), error_code);
+        }
+    }
+    if (pack_store_ != nullptr) {
+        pack_store_->sync();
+    }
+    if (!files.empty()) {
+        VLOG_LP(log_debug) << "synchronized " << files.size() << " BLOB files in " << directories.size() << " directories";
+    }
+}
+
+}  // namespace limestone::internal
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/blob_id_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+
+class blob_pack_store;
+
+/**
+ * @brief Tracks the BLOB files written without fsync, and makes them durable together.
+ * @details A BLOB only has to be durable once a log entry referencing it is, that is, once the epoch
+ *          of the entry is recorded in the epoch file. Instead of synchronizing every BLOB file when it
+ *          is registered, blob_pool_impl adds it here, and the datastore calls sync() right before it
+ *          records an epoch. As a BLOB is registered before the entry referencing it is written, every
+ *          BLOB referenced by the epochs to be recorded is synchronized by then.
+ *          sync() synchronizes the pending files, then their parent directories once each, and then the
+ *          current segment of the blob_pack_store if any.
+ */
+class blob_file_syncer {
+public:
+    /**
+     * @brief Constructor.
+     * @param pack_store The store of packed BLOBs appended without fsync, or nullptr.
+     */
+    explicit blob_file_syncer(blob_pack_store* pack_store = nullptr) noexcept : pack_store_(pack_store) {}
+
+    /**
+     * @brief Adds a BLOB file written or linked without fsync.
+     * @param id The blob_id of the BLOB.
+     * @param path The path of the BLOB file.
+     */
+    void add(blob_id_type id, const boost::filesystem::path& path);
+
+    /**
+     * @brief Forgets BLOBs which will never be referenced, e.g. the provisional BLOBs of a released pool.
+     * @param ids The blob_ids to forget; those not pending are ignored.
+     */
+    void discard(const std::vector<blob_id_type>& ids);
+
+    /**
+     * @brief Synchronizes all pending BLOB files and their parent directories.
+     * @details A pending file removed in the meantime is skipped, as it is no longer referenced.
+     *          If synchronization fails, the files not yet synchronized are kept pending.
+     * @exception limestone_io_exception if a file or directory cannot be synchronized
+     */
+    void sync();
+
+    /**
+     * @brief Returns the number of pending BLOB files.
+     */
+    [[nodiscard]] std::size_t pending_count() const;
+
+private:
+    blob_pack_store* pack_store_;
+
+    mutable std::mutex mtx_{};
+    std::map<blob_id_type, boost::filesystem::path> pending_{};
+
+    // serializes sync(), so that it returns only after the files added before are synchronized
+    std::mutex sync_mtx_{};
+};
+
+}  // namespace limestone::internal
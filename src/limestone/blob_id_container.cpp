@@ -17,89 +17,312 @@
 #include "blob_id_container.h"
 #include <stdexcept>
 #include <algorithm>
+#include <iterator>
 #include <sstream> // added for debug_string
 
 namespace limestone::internal {
 
-void blob_id_container::add_blob_id(blob_id_type id) {
-    if (iterator_used_) {
-        throw std::logic_error("Cannot modify blob_id_container once an iterator has been obtained.");
+namespace {
+
+constexpr unsigned int low_bits = 16;
+constexpr blob_id_type low_mask = (1U << low_bits) - 1U;
+constexpr std::size_t bitmap_words = (std::size_t{1} << low_bits) / 64;
+
+constexpr blob_id_type key_of(blob_id_type id) noexcept { return id >> low_bits; }
+
+constexpr std::uint16_t low_of(blob_id_type id) noexcept { return static_cast<std::uint16_t>(id & low_mask); }
+
+bool test_bit(const std::vector<std::uint64_t>& bitmap, std::uint16_t low) noexcept {
+    return ((bitmap[low >> 6U] >> (low & 63U)) & 1U) != 0;
+}
+
+void set_bit(std::vector<std::uint64_t>& bitmap, std::uint16_t low) noexcept {
+    bitmap[low >> 6U] |= std::uint64_t{1} << (low & 63U);
+}
+
+}  // namespace
+
+void blob_id_container::chunk::add(const blob_id_type* first, const blob_id_type* last) {
+    if (is_bitmap()) {
+        for (const auto* it = first; it != last; ++it) {
+            set_bit(bitmap, low_of(*it));
+        }
+        compact_bitmap();
+        return;
+    }
+    std::vector<std::uint16_t> lows{};
+    lows.reserve(last - first);
+    for (const auto* it = first; it != last; ++it) {
+        lows.emplace_back(low_of(*it));
+    }
+    if (array.empty() || array.back() < lows.front()) {
+        // the common case, as IDs are allocated in ascending order
+        array.insert(array.end(), lows.begin(), lows.end());
+    } else {
+        std::vector<std::uint16_t> merged{};
+        merged.reserve(array.size() + lows.size());
+        std::set_union(array.begin(), array.end(), lows.begin(), lows.end(), std::back_inserter(merged));
+        array.swap(merged);
+    }
+    cardinality = array.size();
+    if (cardinality > array_max_size) {
+        to_bitmap();
     }
-    ids_.push_back(id);
 }
 
-void blob_id_container::diff(const blob_id_container &other) {
+void blob_id_container::chunk::subtract(const chunk& other) {
+    if (is_bitmap()) {
+        if (other.is_bitmap()) {
+            for (std::size_t i = 0; i < bitmap_words; i++) {
+                bitmap[i] &= ~other.bitmap[i];
+            }
+        } else {
+            for (auto low : other.array) {
+                bitmap[low >> 6U] &= ~(std::uint64_t{1} << (low & 63U));
+            }
+        }
+        compact_bitmap();
+        return;
+    }
+    if (other.is_bitmap()) {
+        array.erase(std::remove_if(array.begin(), array.end(), [&other](std::uint16_t low) { return test_bit(other.bitmap, low); }),
+                    array.end());
+    } else {
+        std::vector<std::uint16_t> remaining{};
+        remaining.reserve(array.size());
+        std::set_difference(array.begin(), array.end(), other.array.begin(), other.array.end(), std::back_inserter(remaining));
+        array.swap(remaining);
+    }
+    cardinality = array.size();
+}
+
+void blob_id_container::chunk::unite(const chunk& other) {
+    if (!is_bitmap() && !other.is_bitmap()) {
+        std::vector<std::uint16_t> merged{};
+        merged.reserve(array.size() + other.array.size());
+        std::set_union(array.begin(), array.end(), other.array.begin(), other.array.end(), std::back_inserter(merged));
+        array.swap(merged);
+        cardinality = array.size();
+        if (cardinality > array_max_size) {
+            to_bitmap();
+        }
+        return;
+    }
+    if (!is_bitmap()) {
+        to_bitmap();
+    }
+    if (other.is_bitmap()) {
+        for (std::size_t i = 0; i < bitmap_words; i++) {
+            bitmap[i] |= other.bitmap[i];
+        }
+    } else {
+        for (auto low : other.array) {
+            set_bit(bitmap, low);
+        }
+    }
+    compact_bitmap();
+}
+
+void blob_id_container::chunk::to_bitmap() {
+    bitmap.assign(bitmap_words, 0);
+    for (auto low : array) {
+        set_bit(bitmap, low);
+    }
+    std::vector<std::uint16_t>{}.swap(array);
+}
+
+void blob_id_container::chunk::compact_bitmap() {
+    cardinality = 0;
+    for (auto word : bitmap) {
+        cardinality += static_cast<std::size_t>(__builtin_popcountll(word));
+    }
+    if (cardinality > array_max_size) {
+        return;
+    }
+    array.clear();
+    array.reserve(cardinality);
+    for (std::size_t i = 0; i < bitmap_words; i++) {
+        for (std::uint64_t word = bitmap[i]; word != 0; word &= word - 1) {
+            array.emplace_back(static_cast<std::uint16_t>(i * 64 + static_cast<std::size_t>(__builtin_ctzll(word))));
+        }
+    }
+    std::vector<std::uint64_t>{}.swap(bitmap);
+}
+
+blob_id_container::const_iterator::const_iterator(const std::vector<chunk>* chunks, std::size_t chunk_index) noexcept
+    : chunks_(chunks), chunk_index_(chunk_index) {
+    settle();
+}
+
+blob_id_container::const_iterator& blob_id_container::const_iterator::operator++() {
+    position_++;
+    settle();
+    return *this;
+}
+
+blob_id_container::const_iterator blob_id_container::const_iterator::operator++(int) {
+    const_iterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+void blob_id_container::const_iterator::settle() noexcept {
+    while (chunks_ != nullptr && chunk_index_ < chunks_->size()) {
+        const chunk& c = (*chunks_)[chunk_index_];
+        if (c.is_bitmap()) {
+            for (std::size_t word_index = position_ / 64; word_index < bitmap_words; word_index++) {
+                std::uint64_t word = c.bitmap[word_index];
+                if (word_index == position_ / 64) {
+                    word &= ~std::uint64_t{0} << (position_ % 64);
+                }
+                if (word != 0) {
+                    position_ = word_index * 64 + static_cast<std::size_t>(__builtin_ctzll(word));
+                    current_ = (c.key << low_bits) | position_;
+                    return;
+                }
+            }
+        } else if (position_ < c.array.size()) {
+            current_ = (c.key << low_bits) | c.array[position_];
+            return;
+        }
+        chunk_index_++;
+        position_ = 0;
+    }
+}
+
+void blob_id_container::check_modifiable() const {
     if (iterator_used_) {
         throw std::logic_error("Cannot modify blob_id_container once an iterator has been obtained.");
     }
+}
+
+void blob_id_container::add_blob_id(blob_id_type id) {
+    check_modifiable();
+    pending_.push_back(id);
+    if (pending_.size() >= pending_max_size) {
+        flush_pending();
+    }
+}
+
+void blob_id_container::flush_pending() const {
+    if (pending_.empty()) {
+        return;
+    }
+    std::sort(pending_.begin(), pending_.end());
+    pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
+
+    // the existing chunks and the pending groups are both sorted by key, so they are merged into a new list
+    std::vector<chunk> merged{};
+    merged.reserve(chunks_.size());
+    auto existing = chunks_.begin();
+    for (auto first = pending_.cbegin(); first != pending_.cend();) {
+        blob_id_type key = key_of(*first);
+        auto last = std::find_if(first, pending_.cend(), [key](blob_id_type id) { return key_of(id) != key; });
+        while (existing != chunks_.end() && existing->key < key) {
+            merged.emplace_back(std::move(*existing++));
+        }
+        if (existing != chunks_.end() && existing->key == key) {
+            merged.emplace_back(std::move(*existing++));
+        } else {
+            merged.emplace_back().key = key;
+        }
+        merged.back().add(&*first, &*first + (last - first));
+        first = last;
+    }
+    std::move(existing, chunks_.end(), std::back_inserter(merged));
+    chunks_.swap(merged);
+    pending_.clear();
+}
+
+void blob_id_container::diff(const blob_id_container &other) {
+    check_modifiable();
     // If 'other' is the same container as 'this', then clear the container.
     if (&other == this) {
-        ids_.clear();
+        chunks_.clear();
+        pending_.clear();
         return;
     }
-    
-    container_type old_ids = std::move(ids_);
-    ids_.clear();
-    std::sort(old_ids.begin(), old_ids.end());
-    
-    container_type sorted_other = other.ids_;
-    std::sort(sorted_other.begin(), sorted_other.end());
-
-    auto it1 = old_ids.begin();
-    auto end1 = old_ids.end();
-    auto it2 = sorted_other.begin();
-    auto end2 = sorted_other.end();
-
-    while (it1 != end1) {
-        while (it2 != end2 && *it2 < *it1) {
-            ++it2;
-        }
-        if (it2 != end2 && *it1 == *it2) {
-            ++it1;
-            continue;
+    flush_pending();
+    other.flush_pending();
+
+    std::vector<chunk> remaining{};
+    remaining.reserve(chunks_.size());
+    auto it2 = other.chunks_.cbegin();
+    for (auto& c : chunks_) {
+        it2 = std::lower_bound(it2, other.chunks_.cend(), c.key, [](const chunk& o, blob_id_type k) { return o.key < k; });
+        if (it2 != other.chunks_.cend() && it2->key == c.key) {
+            c.subtract(*it2);
         }
-        if (ids_.empty() || ids_.back() != *it1) {
-            ids_.push_back(*it1);
+        if (c.cardinality > 0) {
+            remaining.emplace_back(std::move(c));
         }
-        ++it1;
     }
+    chunks_.swap(remaining);
 }
 
 void blob_id_container::merge(const blob_id_container &other) {
-    if (iterator_used_) {
-        throw std::logic_error("Cannot modify blob_id_container once an iterator has been obtained.");
+    check_modifiable();
+    if (&other == this) {
+        return;
     }
-    for (const auto &id : other.ids_) {
-        ids_.push_back(id);
+    flush_pending();
+    other.flush_pending();
+
+    std::vector<chunk> merged{};
+    merged.reserve(chunks_.size() + other.chunks_.size());
+    auto it1 = chunks_.begin();
+    auto it2 = other.chunks_.cbegin();
+    while (it1 != chunks_.end() || it2 != other.chunks_.cend()) {
+        if (it2 == other.chunks_.cend() || (it1 != chunks_.end() && it1->key < it2->key)) {
+            merged.emplace_back(std::move(*it1++));
+        } else if (it1 == chunks_.end() || it2->key < it1->key) {
+            merged.emplace_back(*it2++);
+        } else {
+            it1->unite(*it2++);
+            merged.emplace_back(std::move(*it1++));
+        }
     }
-    sort();
+    chunks_.swap(merged);
 }
 
 typename blob_id_container::const_iterator blob_id_container::begin() const {
-    auto self = const_cast<blob_id_container*>(this);
-    if (!self->iterator_used_) {
-        self->sort();
-        self->iterator_used_ = true;
-    }
-    return ids_.cbegin();
+    freeze();
+    return const_iterator{&chunks_, 0};
 }
 
 typename blob_id_container::const_iterator blob_id_container::end() const {
-    return ids_.cend();
+    // also freezes, as end() may be called before begin()
+    freeze();
+    return const_iterator{&chunks_, chunks_.size()};
 }
 
-void blob_id_container::sort() {
-    std::sort(ids_.begin(), ids_.end());
+void blob_id_container::freeze() const {
+    if (!iterator_used_) {
+        flush_pending();
+        iterator_used_ = true;
+    }
+}
+
+std::size_t blob_id_container::size() const {
+    flush_pending();
+    std::size_t total = 0;
+    for (const auto& c : chunks_) {
+        total += c.cardinality;
+    }
+    return total;
 }
 
 std::string blob_id_container::debug_string() const {
+    flush_pending();
     std::ostringstream oss;
     oss << "[";
-    for (std::size_t i = 0; i < ids_.size(); ++i) {
-        oss << ids_[i];
-        if (i + 1 < ids_.size()) {
+    bool first = true;
+    for (const_iterator it{&chunks_, 0}; it != const_iterator{&chunks_, chunks_.size()}; ++it) {
+        if (!first) {
             oss << ", ";
         }
+        oss << *it;
+        first = false;
     }
     oss << "]";
     return oss.str();
@@ -15,7 +15,10 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <string>
 #include <vector>
 #include <memory>
 #include <algorithm>
@@ -27,18 +30,69 @@ namespace limestone::internal {
 using limestone::api::blob_id_type;    
 
 /**
- * @brief The blob_id_container class manages a collection of blob_id_type values.
+ * @brief The blob_id_container class manages a set of blob_id_type values.
  *
  * It provides functions for adding blob IDs, removing blob IDs (diff) and merging
- * contents (merge), as well as iterating over all elements.
+ * contents (merge), as well as iterating over all elements in ascending order.
+ * Each blob ID is held once, however many times it is added.
+ *
+ * The IDs are held as a compressed bitmap in the manner of Roaring bitmaps: they are
+ * grouped into chunks by their upper 48 bits, and each chunk holds the lower 16 bits
+ * as a sorted array while it has at most array_max_size IDs, or as a 65536-bit bitmap
+ * otherwise. As blob IDs are allocated sequentially, the sets handled by the garbage
+ * collector are mostly dense, taking about one bit per ID, and diff() and merge()
+ * work chunk by chunk without sorting.
+ * Added IDs are buffered and folded into the chunks in sorted batches.
  *
  * Once an iterator is obtained, the container becomes read-only.
  */
 class blob_id_container {
+    struct chunk;
+
 public:
-    using container_type = std::vector<blob_id_type>;
-    using iterator = container_type::const_iterator;
-    using const_iterator = container_type::const_iterator;
+    /// the maximum number of IDs a chunk holds as an array, beyond which it becomes a bitmap
+    static constexpr std::size_t array_max_size = 4096;
+
+    /// the number of added IDs buffered before they are folded into the chunks
+    static constexpr std::size_t pending_max_size = 65536;
+
+    /**
+     * @brief Iterator over the blob IDs in ascending order.
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = blob_id_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const blob_id_type*;
+        using reference = const blob_id_type&;
+
+        const_iterator() = default;
+
+        reference operator*() const noexcept { return current_; }
+        pointer operator->() const noexcept { return &current_; }
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator& other) const noexcept {
+            return chunk_index_ == other.chunk_index_ && position_ == other.position_;
+        }
+        bool operator!=(const const_iterator& other) const noexcept { return !(*this == other); }
+
+    private:
+        friend class blob_id_container;
+
+        const_iterator(const std::vector<chunk>* chunks, std::size_t chunk_index) noexcept;
+
+        /// moves to the first ID at or after the current position
+        void settle() noexcept;
+
+        const std::vector<chunk>* chunks_ = nullptr;
+        std::size_t chunk_index_ = 0;
+        std::size_t position_ = 0;  ///< index in the array, or bit number in the bitmap
+        blob_id_type current_ = 0;
+    };
+    using iterator = const_iterator;
 
     blob_id_container() = default;
     ~blob_id_container() = default;
@@ -61,8 +115,6 @@ public:
     /**
      * @brief Removes from this container all blob_ids that are present in the other container.
      *
-     * Duplicate blob_ids are eliminated.
-     *
      * @param other The container containing blob_ids to be removed.
      * @throws std::logic_error if the container is locked for modifications.
      */
@@ -79,15 +131,48 @@ public:
     [[nodiscard]] const_iterator begin() const;
     [[nodiscard]] const_iterator end() const;
 
+    /**
+     * @brief Returns the number of blob_ids in the container.
+     */
+    [[nodiscard]] std::size_t size() const;
+
     // Returns a string representation of the blob IDs for debugging.
     [[nodiscard]] std::string debug_string() const;
 
 private:
-    bool iterator_used_ = false;
-    container_type ids_;
+    /// the IDs sharing the upper 48 bits, given by key
+    struct chunk {
+        blob_id_type key = 0;
+        std::size_t cardinality = 0;
+        std::vector<std::uint16_t> array{};   ///< the sorted lower 16 bits, while the chunk is sparse
+        std::vector<std::uint64_t> bitmap{};  ///< 1024 words of the lower 16 bits, while the chunk is dense
+
+        [[nodiscard]] bool is_bitmap() const noexcept { return !bitmap.empty(); }
+
+        /// adds the lower 16 bits of the given sorted IDs without duplicates
+        void add(const blob_id_type* first, const blob_id_type* last);
+        void subtract(const chunk& other);
+        void unite(const chunk& other);
+
+    private:
+        void to_bitmap();
+        /// recomputes the cardinality of a bitmap, and turns it back into an array if sparse enough
+        void compact_bitmap();
+    };
+
+    // The pending IDs are folded into the chunks lazily, also by the const functions reading the contents,
+    // so the representation is mutable while the set of IDs it holds is not.
+    mutable bool iterator_used_ = false;
+    mutable std::vector<chunk> chunks_;          ///< sorted by key
+    mutable std::vector<blob_id_type> pending_;  ///< IDs added but not yet folded into chunks_
+
+    void check_modifiable() const;
+
+    /// folds the pending IDs and makes the container read-only, when an iterator is obtained
+    void freeze() const;
 
-    /// @brief Helper function to sort the blob IDs.
-    void sort();
+    /// folds the pending IDs into the chunks
+    void flush_pending() const;
 };
 
 } // namespace limestone::internal
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_io_executor.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "environment_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+blob_io_executor::blob_io_executor(std::size_t thread_count) : thread_count_(std::max<std::size_t>(thread_count, 1)) {}
+
+blob_io_executor::~blob_io_executor() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::size_t blob_io_executor::thread_count_from_environment() {
+    auto value = read_unsigned_environment("LIMESTONE_BLOB_IO_THREADS");
+    if (!value) {
+        return default_thread_count;
+    }
+    if (*value == 0) {
+        LOG_LP(WARNING) << "Invalid LIMESTONE_BLOB_IO_THREADS: 0; " << default_thread_count << " is used";
+        return default_thread_count;
+    }
+    return static_cast<std::size_t>(*value);
+}
+
+void blob_io_executor::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        tasks_.emplace_back(std::move(task));
+        if (threads_.empty()) {
+            threads_.reserve(thread_count_);
+            for (std::size_t i = 0; i < thread_count_; i++) {
+                threads_.emplace_back(&blob_io_executor::run, this);
+            }
+            VLOG_LP(log_debug) << "started " << thread_count_ << " BLOB I/O threads";
+        }
+    }
+    cv_.notify_one();
+}
+
+void blob_io_executor::run() {
+    while (true) {
+        std::function<void()> task{};
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace limestone::internal
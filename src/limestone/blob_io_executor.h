@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace limestone::internal {
+
+/**
+ * @brief A fixed pool of threads running the asynchronous BLOB registrations of blob_pool_impl.
+ * @details The threads are started on the first submission, so that a datastore not using the
+ *          asynchronous API has none. The destructor runs the tasks already submitted, then joins
+ *          the threads.
+ */
+class blob_io_executor {
+public:
+    /// the number of threads used unless LIMESTONE_BLOB_IO_THREADS is set
+    static constexpr std::size_t default_thread_count = 4;
+
+    /**
+     * @brief Constructor.
+     * @param thread_count The number of threads, at least 1.
+     */
+    explicit blob_io_executor(std::size_t thread_count);
+
+    blob_io_executor(const blob_io_executor&) = delete;
+    blob_io_executor& operator=(const blob_io_executor&) = delete;
+    blob_io_executor(blob_io_executor&&) = delete;
+    blob_io_executor& operator=(blob_io_executor&&) = delete;
+    ~blob_io_executor();
+
+    /**
+     * @brief Returns the number of threads, read from LIMESTONE_BLOB_IO_THREADS if set.
+     * @details An invalid value is ignored with a warning.
+     */
+    static std::size_t thread_count_from_environment();
+
+    /**
+     * @brief Queues a task to run on one of the threads.
+     * @param task The task, which must not throw.
+     */
+    void submit(std::function<void()> task);
+
+    [[nodiscard]] std::size_t thread_count() const noexcept { return thread_count_; }
+
+private:
+    void run();
+
+    const std::size_t thread_count_;
+    std::mutex mtx_{};
+    std::condition_variable cv_{};
+    std::deque<std::function<void()>> tasks_{};
+    bool stopping_{false};
+    std::vector<std::thread> threads_{};
+};
+
+}  // namespace limestone::internal
@@ -0,0 +1,527 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_pack_store.h"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "crc32c.h"
+#include "environment_helper.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+std::array<char, blob_pack_store::header_size> make_header(blob_id_type id, std::string_view data) {
+    std::array<char, blob_pack_store::header_size> header{};
+    std::uint64_t id_le = htole64(id);
+    std::uint32_t length_le = htole32(static_cast<std::uint32_t>(data.size()));
+    std::uint32_t crc_le = htole32(crc32c(data.data(), data.size()));
+    std::memcpy(header.data(), &id_le, sizeof(id_le));
+    std::memcpy(header.data() + sizeof(id_le), &length_le, sizeof(length_le));
+    std::memcpy(header.data() + sizeof(id_le) + sizeof(length_le), &crc_le, sizeof(crc_le));
+    return header;
+}
+
+}  // namespace
+
+blob_pack_store::settings blob_pack_store::settings::from_environment() {
+    settings config{};
+    if (auto value = read_unsigned_environment("LIMESTONE_BLOB_PACK_MAX_BYTES")) {
+        config.max_blob_bytes = *value;
+    }
+    if (auto value = read_unsigned_environment("LIMESTONE_BLOB_PACK_SEGMENT_MB"); value && *value > 0) {
+        config.segment_bytes = *value * 1024UL * 1024UL;
+    }
+    return config;
+}
+
+blob_pack_store::blob_pack_store(const blob_file_resolver& resolver, const settings& config)
+    : resolver_(resolver), settings_(config), cache_directory_(resolver.get_pack_directory() / "cache") {}
+
+blob_pack_store::~blob_pack_store() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (current_file_ != nullptr && current_dirty_ && fsync(fileno(current_file_)) != 0) {
+        LOG_LP(ERROR) << "failed to synchronize the BLOB segment file: " << resolver_.resolve_pack_path(current_segment_).string();
+    }
+    close_current_locked();
+}
+
+boost::filesystem::path blob_pack_store::cache_path(blob_id_type id) const {
+    std::ostringstream file_name;
+    file_name << std::hex << std::setw(16) << std::setfill('0') << id << ".extracted";
+    return cache_directory_ / file_name.str();
+}
+
+void blob_pack_store::load() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    close_current_locked();
+    index_.clear();
+    segments_.clear();
+    next_segment_ = 1;
+
+    const boost::filesystem::path directory = resolver_.get_pack_directory();
+    boost::system::error_code error;
+    if (!boost::filesystem::exists(directory, error)) {
+        return;
+    }
+    boost::filesystem::remove_all(cache_directory_, error);
+    if (error) {
+        LOG_LP(WARNING) << "failed to clear the extracted BLOB files: " << cache_directory_.string() << ", " << error.message();
+    }
+
+    std::map<std::uint64_t, boost::filesystem::path> files{};
+    boost::filesystem::directory_iterator it(directory, error);
+    if (error) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to access directory: " + directory.string(), error.value());
+    }
+    for (; it != boost::filesystem::directory_iterator(); it.increment(error)) {
+        if (error) {
+            LOG_AND_THROW_BLOB_EXCEPTION("Failed to iterate directory: " + directory.string(), error.value());
+        }
+        if (resolver_.is_pack_file(it->path())) {
+            files.emplace(resolver_.extract_pack_sequence(it->path()), it->path());
+        }
+    }
+    // in sequence order, so that a BLOB copied by an interrupted rewrite resolves to the newer copy
+    for (const auto& [sequence, path] : files) {
+        segments_[sequence].bytes = load_segment(sequence, path);
+        next_segment_ = sequence + 1;
+    }
+    for (auto seg = segments_.begin(); seg != segments_.end();) {
+        auto next = std::next(seg);
+        if (seg->second.live_count == 0) {
+            remove_segment_locked(seg->first);
+        }
+        seg = next;
+    }
+    VLOG_LP(log_info) << "loaded " << index_.size() << " packed BLOBs in " << segments_.size() << " segments";
+}
+
+std::uint64_t blob_pack_store::load_segment(std::uint64_t sequence, const boost::filesystem::path& path) {
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to open the BLOB segment file: " + path.string(), errno);
+    }
+    segments_[sequence];
+    std::uint64_t valid_bytes = 0;
+    std::array<char, header_size> header{};
+    std::string data{};
+    while (in.read(header.data(), header.size())) {
+        std::uint64_t id_le = 0;
+        std::uint32_t length_le = 0;
+        std::uint32_t crc_le = 0;
+        std::memcpy(&id_le, header.data(), sizeof(id_le));
+        std::memcpy(&length_le, header.data() + sizeof(id_le), sizeof(length_le));
+        std::memcpy(&crc_le, header.data() + sizeof(id_le) + sizeof(length_le), sizeof(crc_le));
+        data.resize(le32toh(length_le));
+        if (!in.read(data.data(), static_cast<std::streamsize>(data.size())) || crc32c(data.data(), data.size()) != le32toh(crc_le)) {
+            break;
+        }
+        put_locked(le64toh(id_le), location{sequence, valid_bytes + header_size, static_cast<std::uint32_t>(data.size())});
+        valid_bytes += header_size + data.size();
+    }
+    in.close();
+
+    boost::system::error_code error;
+    auto file_size = boost::filesystem::file_size(path, error);
+    if (!error && file_size > valid_bytes) {
+        // only the last record written before a crash can be torn, and it has never been acknowledged
+        LOG_LP(WARNING) << "truncating the torn record at offset " << valid_bytes << " of the BLOB segment file: " << path.string();
+        boost::filesystem::resize_file(path, valid_bytes, error);
+        if (error) {
+            LOG_AND_THROW_BLOB_EXCEPTION("Failed to truncate the BLOB segment file: " + path.string(), error.value());
+        }
+    }
+    return valid_bytes;
+}
+
+void blob_pack_store::append(blob_id_type id, std::string_view data, bool durable) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    location loc = append_locked(id, data);
+    if (durable) {
+        sync_locked(loc.offset - header_size);
+    } else {
+        current_dirty_ = true;
+    }
+    put_locked(id, loc);
+}
+
+void blob_pack_store::sync() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (sync_error_ != 0) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to synchronize an abandoned BLOB segment file", sync_error_);
+    }
+    if (current_file_ != nullptr && current_dirty_) {
+        sync_locked(segments_[current_segment_].bytes);
+    }
+    sync_directory_locked();
+}
+
+blob_pack_store::location blob_pack_store::append_locked(blob_id_type id, std::string_view data) {
+    if (current_file_ != nullptr && segments_[current_segment_].bytes >= settings_.segment_bytes) {
+        if (current_dirty_) {
+            sync_locked(segments_[current_segment_].bytes);
+        }
+        close_current_locked();
+    }
+    if (current_file_ == nullptr) {
+        const boost::filesystem::path directory = resolver_.get_pack_directory();
+        boost::system::error_code error;
+        if (!boost::filesystem::exists(directory, error)) {
+            boost::filesystem::create_directories(directory, error);
+            if (error) {
+                LOG_AND_THROW_BLOB_EXCEPTION("Failed to create directories: " + directory.string(), error.value());
+            }
+        }
+        std::uint64_t sequence = next_segment_;
+        boost::filesystem::path path = resolver_.resolve_pack_path(sequence);
+        FILE* file = fopen(path.c_str(), "wb");  // NOLINT(*-owning-memory)
+        if (file == nullptr) {
+            LOG_AND_THROW_BLOB_EXCEPTION("Failed to create the BLOB segment file: " + path.string(), errno);
+        }
+        next_segment_++;
+        current_segment_ = sequence;
+        current_file_ = file;
+        directory_dirty_ = true;
+        segments_[sequence];
+    }
+
+    auto& segment = segments_[current_segment_];
+    const std::uint64_t start = segment.bytes;
+    auto header = make_header(id, data);
+    if (fwrite(header.data(), 1, header.size(), current_file_) != header.size()
+        || fwrite(data.data(), 1, data.size(), current_file_) != data.size()
+        || fflush(current_file_) != 0) {
+        int error_code = errno;
+        boost::filesystem::path path = resolver_.resolve_pack_path(current_segment_);
+        abandon_current_locked(start);
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to write the BLOB segment file: " + path.string(), error_code);
+    }
+    segment.bytes = start + header_size + data.size();
+    return location{current_segment_, start + header_size, static_cast<std::uint32_t>(data.size())};
+}
+
+void blob_pack_store::sync_locked(std::uint64_t rollback_bytes) {
+    if (fsync(fileno(current_file_)) != 0) {
+        int error_code = errno;
+        boost::filesystem::path path = resolver_.resolve_pack_path(current_segment_);
+        abandon_current_locked(rollback_bytes);
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to synchronize the BLOB segment file: " + path.string(), error_code);
+    }
+    current_dirty_ = false;
+    sync_directory_locked();
+}
+
+void blob_pack_store::sync_directory_locked() {
+    if (!directory_dirty_) {
+        return;
+    }
+    const boost::filesystem::path directory = resolver_.get_pack_directory();
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0 || ::fsync(fd) != 0) {
+        int error_code = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to synchronize the BLOB segment directory: " + directory.string(), error_code);
+    }
+    ::close(fd);
+    directory_dirty_ = false;
+}
+
+void blob_pack_store::abandon_current_locked(std::uint64_t bytes) noexcept {
+    // The segment is closed and cut back to the records written before, and appending continues in a new one.
+    std::uint64_t sequence = current_segment_;
+    if (current_dirty_ && fsync(fileno(current_file_)) != 0) {
+        // the records appended without being made durable may be lost, which is reported by the next sync()
+        sync_error_ = errno;
+        LOG_LP(ERROR) << "failed to synchronize the BLOB segment file: " << resolver_.resolve_pack_path(sequence).string();
+    }
+    current_dirty_ = false;
+    close_current_locked();
+    boost::filesystem::path path = resolver_.resolve_pack_path(sequence);
+    boost::system::error_code error;
+    boost::filesystem::resize_file(path, bytes, error);
+    if (error) {
+        LOG_LP(ERROR) << "failed to truncate the BLOB segment file: " << path.string() << ", " << error.message();
+    }
+    auto& segment = segments_[sequence];
+    segment.bytes = bytes;
+    if (segment.live_count == 0) {
+        remove_segment_locked(sequence);
+    }
+}
+
+void blob_pack_store::close_current_locked() noexcept {
+    if (current_file_ != nullptr) {
+        if (fclose(current_file_) != 0) {  // NOLINT(*-owning-memory)
+            LOG_LP(ERROR) << "failed to close the BLOB segment file: " << resolver_.resolve_pack_path(current_segment_).string();
+        }
+        current_file_ = nullptr;
+        current_segment_ = 0;
+    }
+}
+
+void blob_pack_store::put_locked(blob_id_type id, const location& loc) {
+    auto [it, inserted] = index_.try_emplace(id, loc);
+    if (!inserted) {
+        auto& old = segments_[it->second.segment];
+        old.live_count--;
+        old.live_bytes -= header_size + it->second.length;
+        it->second = loc;
+    }
+    auto& segment = segments_[loc.segment];
+    segment.live_count++;
+    segment.live_bytes += header_size + loc.length;
+}
+
+void blob_pack_store::forget_locked(blob_id_type id) {
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        return;
+    }
+    auto& segment = segments_[it->second.segment];
+    segment.live_count--;
+    segment.live_bytes -= header_size + it->second.length;
+    index_.erase(it);
+    boost::system::error_code error;
+    boost::filesystem::remove(cache_path(id), error);
+}
+
+void blob_pack_store::remove_segment_locked(std::uint64_t sequence) {
+    boost::filesystem::path path = resolver_.resolve_pack_path(sequence);
+    boost::system::error_code error;
+    boost::filesystem::remove(path, error);
+    if (error && error != boost::system::errc::no_such_file_or_directory) {
+        LOG_LP(ERROR) << "failed to remove the BLOB segment file: " << path.string() << ", " << error.message();
+        return;
+    }
+    VLOG_LP(log_debug) << "removed the BLOB segment file: " << path.string();
+    segments_.erase(sequence);
+}
+
+void blob_pack_store::rewrite_segment_locked(std::uint64_t sequence) {
+    std::vector<std::pair<blob_id_type, location>> live{};
+    for (const auto& [id, loc] : index_) {
+        if (loc.segment == sequence) {
+            live.emplace_back(id, loc);
+        }
+    }
+    std::vector<location> copies{};
+    copies.reserve(live.size());
+    for (const auto& [id, loc] : live) {
+        copies.emplace_back(append_locked(id, read_locked(loc)));
+    }
+    if (!copies.empty()) {
+        sync_locked(segments_[current_segment_].bytes);
+    }
+    // the index is switched to the copies only after they are durable
+    for (std::size_t i = 0; i < live.size(); i++) {
+        put_locked(live[i].first, copies[i]);
+    }
+    VLOG_LP(log_debug) << "rewrote " << live.size() << " live BLOBs of the segment " << sequence;
+    remove_segment_locked(sequence);
+}
+
+bool blob_pack_store::contains(blob_id_type id) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return index_.find(id) != index_.end();
+}
+
+std::string blob_pack_store::read(blob_id_type id) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        LOG_AND_THROW_BLOB_EXCEPTION_NO_ERRNO("BLOB is not packed: " + std::to_string(id));
+    }
+    return read_locked(it->second);
+}
+
+std::string blob_pack_store::read_locked(const location& loc) const {
+    boost::filesystem::path path = resolver_.resolve_pack_path(loc.segment);
+    int fd = ::open(path.c_str(), O_RDONLY);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to open the BLOB segment file: " + path.string(), errno);
+    }
+    std::string data(loc.length, '\0');
+    std::size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::pread(fd, data.data() + done, data.size() - done, static_cast<off_t>(loc.offset + done));
+        if (n <= 0) {
+            int error_code = n < 0 ? errno : EIO;
+            ::close(fd);
+            LOG_AND_THROW_BLOB_EXCEPTION("Failed to read the BLOB segment file: " + path.string(), error_code);
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    ::close(fd);
+    return data;
+}
+
+std::optional<boost::filesystem::path> blob_pack_store::extract(blob_id_type id) {
+    boost::filesystem::path path = cache_path(id);
+    std::string data{};
+    {
+        // only the extraction of the same BLOB is waited for
+        std::unique_lock<std::mutex> lock(mtx_);
+        extracting_cv_.wait(lock, [this, id]() { return extracting_.count(id) == 0; });
+        auto it = index_.find(id);
+        if (it == index_.end()) {
+            return std::nullopt;
+        }
+        boost::system::error_code error;
+        if (boost::filesystem::exists(path, error)) {
+            return path;
+        }
+        data = read_locked(it->second);
+        extracting_.insert(id);
+    }
+    auto finish = [this, id]() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            extracting_.erase(id);
+        }
+        extracting_cv_.notify_all();
+    };
+
+    // The copy is not synchronized: the cache directory is cleared on load(), so a copy torn by a crash is never read.
+    try {
+        write_extracted(path, data);
+    } catch (...) {
+        finish();
+        throw;
+    }
+    bool removed = false;
+    {
+        // the BLOB may have been removed while it was extracted, leaving the copy behind
+        std::lock_guard<std::mutex> lock(mtx_);
+        extracting_.erase(id);
+        if (index_.find(id) == index_.end()) {
+            boost::system::error_code error;
+            boost::filesystem::remove(path, error);
+            removed = true;
+        }
+    }
+    extracting_cv_.notify_all();
+    if (removed) {
+        return std::nullopt;
+    }
+    return path;
+}
+
+void blob_pack_store::write_extracted(const boost::filesystem::path& path, std::string_view data) const {
+    boost::system::error_code error;
+    boost::filesystem::create_directories(cache_directory_, error);
+    if (error) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to create directories: " + cache_directory_.string(), error.value());
+    }
+    boost::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");  // NOLINT(*-owning-memory)
+    if (file == nullptr) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to open the extracted BLOB file: " + tmp_path.string(), errno);
+    }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    int error_code = errno;
+    if (fclose(file) != 0 || !written) {  // NOLINT(*-owning-memory)
+        error_code = written ? errno : error_code;
+        boost::filesystem::remove(tmp_path, error);
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to write the extracted BLOB file: " + tmp_path.string(), error_code);
+    }
+    boost::filesystem::rename(tmp_path, path, error);
+    if (error) {
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to rename the extracted BLOB file: " + tmp_path.string(), error.value());
+    }
+}
+
+void blob_pack_store::remove(blob_id_type id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        return;
+    }
+    std::uint64_t sequence = it->second.segment;
+    forget_locked(id);
+    if (sequence != current_segment_ && segments_[sequence].live_count == 0) {
+        remove_segment_locked(sequence);
+    }
+}
+
+void blob_pack_store::collect_garbage(const std::vector<blob_id_type>& ids) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::size_t before = index_.size();
+    for (const auto& id : ids) {
+        forget_locked(id);
+    }
+    std::vector<std::uint64_t> dead{};
+    std::vector<std::uint64_t> sparse{};
+    for (const auto& [sequence, segment] : segments_) {
+        if (sequence == current_segment_) {
+            continue;
+        }
+        if (segment.live_count == 0) {
+            dead.emplace_back(sequence);
+        } else if (static_cast<double>(segment.live_bytes) < static_cast<double>(segment.bytes) * rewrite_live_ratio) {
+            sparse.emplace_back(sequence);
+        }
+    }
+    for (auto sequence : dead) {
+        remove_segment_locked(sequence);
+    }
+    for (auto sequence : sparse) {
+        rewrite_segment_locked(sequence);
+    }
+    VLOG_LP(log_info) << "BLOB segment garbage collection: " << (before - index_.size()) << " BLOBs dropped, "
+                      << dead.size() << " segments removed, " << sparse.size() << " segments rewritten";
+}
+
+std::vector<blob_id_type> blob_pack_store::blob_ids() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<blob_id_type> ids{};
+    ids.reserve(index_.size());
+    for (const auto& [id, loc] : index_) {
+        ids.emplace_back(id);
+    }
+    return ids;
+}
+
+std::vector<boost::filesystem::path> blob_pack_store::segment_files() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<boost::filesystem::path> files{};
+    files.reserve(segments_.size());
+    for (const auto& [sequence, segment] : segments_) {
+        files.emplace_back(resolver_.resolve_pack_path(sequence));
+    }
+    return files;
+}
+
+}  // namespace limestone::internal
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/blob_id_type.h>
+#include "blob_file_resolver.h"
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+
+/**
+ * @brief Append-only segment files holding small BLOBs.
+ * @details Storing a BLOB as a file of its own costs a file creation and an fsync of the file,
+ *          which dominates the cost of small BLOBs. Instead, BLOBs up to max_blob_bytes are appended
+ *          to a segment file in the pack directory of the resolver, and located through an index of
+ *          (segment, offset, length).
+ *          A segment is a sequence of records: the blob_id (8 bytes), the length (4 bytes) and the
+ *          CRC32C of the data (4 bytes) in little endian, followed by the data. The index is rebuilt
+ *          from the segments by load(); a record torn by a crash, which has never been acknowledged,
+ *          is truncated away.
+ *          A BLOB appended with durable = false is made durable by sync(), which blob_file_syncer calls
+ *          before an epoch referencing it is recorded, so appends between two epochs share one fsync.
+ *          As readers are given a BLOB as a file, extract() copies a packed BLOB once into a cache
+ *          directory, which is cleared on load().
+ *          Garbage collection works on segments: a segment is removed when none of its BLOBs is alive
+ *          any more, and a segment mostly of dead BLOBs is rewritten by copying the live ones into the
+ *          current segment.
+ */
+class blob_pack_store {
+public:
+    /**
+     * @brief Settings of the store.
+     */
+    struct settings {
+        /// BLOBs up to this size are packed, 0 disables packing of new BLOBs
+        std::uint64_t max_blob_bytes{0};
+
+        /// a new segment is started once the current one has reached this size
+        std::uint64_t segment_bytes{64UL * 1024UL * 1024UL};
+
+        /**
+         * @brief Returns the default settings, overridden by the environment variables if set.
+         * @details LIMESTONE_BLOB_PACK_MAX_BYTES and LIMESTONE_BLOB_PACK_SEGMENT_MB (MiB) are read.
+         *          Invalid values are ignored with a warning.
+         */
+        static settings from_environment();
+    };
+
+    /// size of the record header
+    static constexpr std::size_t header_size = sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+
+    /// a segment whose live BLOBs take less than this fraction of it is rewritten by collect_garbage()
+    static constexpr double rewrite_live_ratio = 0.5;
+
+    blob_pack_store(const blob_file_resolver& resolver, const settings& config);
+
+    blob_pack_store(const blob_pack_store&) = delete;
+    blob_pack_store& operator=(const blob_pack_store&) = delete;
+    blob_pack_store(blob_pack_store&&) = delete;
+    blob_pack_store& operator=(blob_pack_store&&) = delete;
+    ~blob_pack_store();
+
+    [[nodiscard]] const settings& get_settings() const noexcept { return settings_; }
+
+    /**
+     * @brief Returns whether a new BLOB of the given size is to be packed.
+     */
+    [[nodiscard]] bool accepts(std::uint64_t size) const noexcept {
+        return size <= settings_.max_blob_bytes && size <= UINT32_MAX;
+    }
+
+    /**
+     * @brief Rebuilds the index from the segment files, and clears the extracted copies.
+     * @exception limestone_blob_exception if the segment files cannot be read
+     */
+    void load();
+
+    /**
+     * @brief Appends a BLOB to the current segment.
+     * @param durable whether to make the BLOB durable before returning; if false, it is made durable
+     *        by the next sync(), or when the segment is closed
+     * @exception limestone_blob_exception if an I/O error occurs; the segment is then left as before
+     */
+    void append(blob_id_type id, std::string_view data, bool durable = true);
+
+    /**
+     * @brief Makes the BLOBs appended without being made durable so.
+     * @exception limestone_blob_exception if an I/O error occurs
+     */
+    void sync();
+
+    /**
+     * @brief Returns whether the BLOB is packed in this store.
+     */
+    [[nodiscard]] bool contains(blob_id_type id) const;
+
+    /**
+     * @brief Reads a packed BLOB.
+     * @exception limestone_blob_exception if the BLOB is not packed, or cannot be read
+     */
+    [[nodiscard]] std::string read(blob_id_type id) const;
+
+    /**
+     * @brief Returns a file holding a packed BLOB, extracting it into the cache directory if not yet.
+     * @return the path of the extracted copy, or std::nullopt if the BLOB is not packed in this store
+     * @exception limestone_blob_exception if the BLOB cannot be read or extracted
+     */
+    [[nodiscard]] std::optional<boost::filesystem::path> extract(blob_id_type id);
+
+    /**
+     * @brief Forgets a BLOB which will never be referenced, e.g. a provisional BLOB of a released pool.
+     * @details A segment left without live BLOBs is removed.
+     */
+    void remove(blob_id_type id);
+
+    /**
+     * @brief Forgets the given garbage BLOBs, and reclaims the space of their segments.
+     * @param ids the BLOBs found to be garbage; those not packed in this store are ignored
+     */
+    void collect_garbage(const std::vector<blob_id_type>& ids);
+
+    /**
+     * @brief Returns the ids of the packed BLOBs, in ascending order.
+     */
+    [[nodiscard]] std::vector<blob_id_type> blob_ids() const;
+
+    /**
+     * @brief Returns the paths of the segment files, for backup.
+     */
+    [[nodiscard]] std::vector<boost::filesystem::path> segment_files() const;
+
+    /**
+     * @brief Returns the path the extracted copy of a BLOB is placed at.
+     */
+    [[nodiscard]] boost::filesystem::path cache_path(blob_id_type id) const;
+
+private:
+    struct location {
+        std::uint64_t segment;
+        std::uint64_t offset;  // of the data, after the header
+        std::uint32_t length;
+    };
+
+    struct segment_state {
+        std::uint64_t bytes{0};
+        std::uint64_t live_bytes{0};
+        std::size_t live_count{0};
+    };
+
+    std::uint64_t load_segment(std::uint64_t sequence, const boost::filesystem::path& path);
+    // writes a record to the current segment; the index is updated by put_locked()
+    location append_locked(blob_id_type id, std::string_view data);
+    void sync_locked(std::uint64_t rollback_bytes);
+    void sync_directory_locked();
+    void abandon_current_locked(std::uint64_t bytes) noexcept;
+    void close_current_locked() noexcept;
+    void put_locked(blob_id_type id, const location& loc);
+    void forget_locked(blob_id_type id);
+    void remove_segment_locked(std::uint64_t sequence);
+    void rewrite_segment_locked(std::uint64_t sequence);
+    [[nodiscard]] std::string read_locked(const location& loc) const;
+    void write_extracted(const boost::filesystem::path& path, std::string_view data) const;
+
+    const blob_file_resolver& resolver_;
+    settings settings_;
+    boost::filesystem::path cache_directory_;
+
+    mutable std::mutex mtx_{};
+    std::map<blob_id_type, location> index_{};
+    std::map<std::uint64_t, segment_state> segments_{};
+    std::uint64_t next_segment_{1};
+    std::uint64_t current_segment_{0};  // 0 if no segment is open for appending
+    FILE* current_file_{nullptr};
+    bool current_dirty_{false};     // the current segment has records not synchronized yet
+    bool directory_dirty_{false};   // a segment has been created since the pack directory was synchronized
+    int sync_error_{0};             // errno of a failure to synchronize records of an abandoned segment
+
+    // the BLOBs being extracted into the cache directory, so that each is extracted once while others proceed
+    std::set<blob_id_type> extracting_{};
+    std::condition_variable extracting_cv_{};
+};
+
+}  // namespace limestone::internal
@@ -15,6 +15,9 @@
  */
 
 #include "blob_pool_impl.h"
+#include "blob_file_syncer.h"
+#include "blob_io_executor.h"
+#include "blob_pack_store.h"
 #include "limestone_exception_helper.h"
 #include "limestone/api/datastore.h"
 #include "datastore_impl.h"
@@ -24,6 +27,7 @@
 #include <fstream>
 #include <cstdio>
 #include <memory>
+#include <optional>
 #include <cstring>
 
 #include <openssl/hmac.h>
@@ -59,12 +63,25 @@ void blob_pool_impl::handle_hmac_result(unsigned char const* result) {
 
 blob_pool_impl::blob_pool_impl(std::function<blob_id_type()> id_generator,
                                limestone::internal::blob_file_resolver& resolver,
-                               limestone::api::datastore& datastore)
+                               limestone::api::datastore& datastore,
+                               blob_pack_store* pack_store,
+                               blob_file_syncer* syncer,
+                               blob_io_executor* executor,
+                               blob_dedup_index* dedup_index)
     : id_generator_(std::move(id_generator)),
       resolver_(resolver),
       datastore_(datastore),
+      pack_store_(pack_store),
+      syncer_(syncer),
       real_file_ops_(),
-      file_ops_(&real_file_ops_) {}   // Use the address of the member variable
+      file_ops_(&real_file_ops_),   // Use the address of the member variable
+      executor_(executor),
+      dedup_index_(dedup_index) {}
+
+blob_pool_impl::~blob_pool_impl() {
+    // The registrations refer to this pool until they complete
+    wait_for_async_registrations();
+}
 
 blob_id_type blob_pool_impl::generate_blob_id() {
     return id_generator_();
@@ -73,16 +90,25 @@ void blob_pool_impl::release() {
     // Release the pool
     is_released_.store(true, std::memory_order_release);
 
+    // Let the asynchronous registrations complete, or fail if not yet started, before removing their BLOBs
+    wait_for_async_registrations();
+
     // Remove all provisional BLOBs
     std::lock_guard<std::mutex> lock(mutex_);
     boost::system::error_code ec;
     auto blob_ids_to_remove = datastore_.check_and_remove_persistent_blob_ids(blob_ids_);
+    if (syncer_ != nullptr) {
+        syncer_->discard(blob_ids_to_remove);
+    }
     for (const auto& id : blob_ids_to_remove) {
         boost::filesystem::path path = resolver_.resolve_path(id);
         file_ops_->remove(path, ec);
         if (ec && ec != boost::system::errc::no_such_file_or_directory) {
             VLOG_LP(log_error) << "Failed to remove file: " << path.string() << ". Error: " << ec.message();
         }
+        if (pack_store_ != nullptr) {
+            pack_store_->remove(id);
+        }
     }
     blob_ids_.clear();
 }
@@ -103,6 +129,23 @@ blob_id_type blob_pool_impl::register_file(boost::filesystem::path const& file,
     blob_id_type id = generate_blob_id();
     boost::filesystem::path target_path = resolver_.resolve_path(id);
 
+    // Link the file of a BLOB registered with the same contents instead of copying the source file.
+    // A temporary file is moved without being read, so it is not read for its digest either,
+    // and neither is a file too large to read at the cost of a copy.
+    std::optional<blob_dedup_index::digest_type> digest{};
+    if (dedup_index_ != nullptr && !is_temporary_file) {
+        boost::system::error_code size_ec;
+        std::uintmax_t size = boost::filesystem::file_size(file, size_ec);
+        if (!size_ec && size <= dedup_index_->max_file_bytes()) {
+            digest = digest_of_file(file);
+            if (link_duplicate(*digest, size, id)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                blob_ids_.push_back(id);
+                return id;
+            }
+        }
+    }
+
     // Ensure the target directory exists
     boost::filesystem::path target_dir = target_path.parent_path();
     create_directories_if_needed(target_dir);
@@ -113,6 +156,14 @@ blob_id_type blob_pool_impl::register_file(boost::filesystem::path const& file,
     } else {
         copy_file(file, target_path);
     }
+    if (syncer_ != nullptr) {
+        syncer_->add(id, target_path);
+    }
+    if (digest) {
+        // The source may have been modified since its digest was taken, so the copy is indexed by its own digest;
+        // it was written just now and is read back from the page cache.
+        dedup_index_->add(digest_of_file(target_path), id);
+    }
 
     // Add the blob_id to the internal list
     {
@@ -129,6 +180,15 @@ blob_id_type blob_pool_impl::duplicate_data(blob_id_type reference) {
         throw std::logic_error("This pool is already released.");
     }
 
+    // A packed BLOB is copied into the pack, as it has no file to link
+    if (pack_store_ != nullptr && pack_store_->contains(reference)) {
+        blob_id_type new_id = generate_blob_id();
+        pack_store_->append(new_id, pack_store_->read(reference), syncer_ == nullptr);
+        std::lock_guard<std::mutex> lock(mutex_);
+        blob_ids_.push_back(new_id);
+        return new_id;
+    }
+
     // Resolve the source and destination paths
     boost::filesystem::path existing_path = resolver_.resolve_path(reference);
     boost::system::error_code ec;
@@ -148,6 +208,9 @@ blob_id_type blob_pool_impl::duplicate_data(blob_id_type reference) {
     if (ec) {
         LOG_AND_THROW_BLOB_EXCEPTION("Failed to create hard link from " + existing_path.string() + " to " + link_path.string(), ec.value());
     }
+    if (syncer_ != nullptr) {
+        syncer_->add(new_id, link_path);
+    }
 
     // Add the blob_id to the internal list
     {
@@ -157,6 +220,46 @@ blob_id_type blob_pool_impl::duplicate_data(blob_id_type reference) {
     return new_id;
 }
 
+std::future<blob_id_type> blob_pool_impl::register_file_async(boost::filesystem::path file, bool is_temporary_file) {
+    if (executor_ == nullptr) {
+        return blob_pool::register_file_async(std::move(file), is_temporary_file);
+    }
+    return submit_async([this, file = std::move(file), is_temporary_file]() {
+        return register_file(file, is_temporary_file);
+    });
+}
+
+std::future<blob_id_type> blob_pool_impl::register_data_async(std::string data) {
+    if (executor_ == nullptr) {
+        return blob_pool::register_data_async(std::move(data));
+    }
+    return submit_async([this, data = std::move(data)]() {
+        return register_data(data);
+    });
+}
+
+std::future<blob_id_type> blob_pool_impl::submit_async(std::function<blob_id_type()> registration) {
+    auto task = std::make_shared<std::packaged_task<blob_id_type()>>(std::move(registration));
+    std::future<blob_id_type> result = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        async_in_progress_++;
+    }
+    executor_->submit([this, task]() {
+        (*task)();
+        // nothing of this pool may be touched once the count is released, as it may be destroyed then
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        async_in_progress_--;
+        async_cv_.notify_all();
+    });
+    return result;
+}
+
+void blob_pool_impl::wait_for_async_registrations() {
+    std::unique_lock<std::mutex> lock(async_mutex_);
+    async_cv_.wait(lock, [this] { return async_in_progress_ == 0; });
+}
+
 void blob_pool_impl::set_file_operations(file_operations& file_ops) {
     file_ops_ = &file_ops;
 }
@@ -203,23 +306,26 @@ void blob_pool_impl::copy_file(const boost::filesystem::path& source, const boos
     auto dest_file = std::unique_ptr<FILE, FileCloser>(dest_raw, FileCloser{file_ops_});
 
     try {
-        // Buffer for copying
-        std::array<char, copy_buffer_size> buffer = {};
-        size_t bytes_read = 0;
-
-        // Copy loop
-        while ((bytes_read = file_ops_->fread(buffer.data(), 1, copy_buffer_size, src_file.get())) > 0) {
-            size_t bytes_written = file_ops_->fwrite(buffer.data(), 1, bytes_read, dest_file.get());
-            if (bytes_written != bytes_read) {
-                int error_code = errno;
-                LOG_AND_THROW_BLOB_EXCEPTION("Failed to write data to destination file: " + destination.string(), error_code);
+        // Copy in the kernel if possible, otherwise through the buffer below
+        if (!copy_file_in_kernel(file_ops_->fileno(src_file.get()), file_ops_->fileno(dest_file.get()), destination)) {
+            // Buffer for copying
+            std::array<char, copy_buffer_size> buffer = {};
+            size_t bytes_read = 0;
+
+            // Copy loop
+            while ((bytes_read = file_ops_->fread(buffer.data(), 1, copy_buffer_size, src_file.get())) > 0) {
+                size_t bytes_written = file_ops_->fwrite(buffer.data(), 1, bytes_read, dest_file.get());
+                if (bytes_written != bytes_read) {
+                    int error_code = errno;
+                    LOG_AND_THROW_BLOB_EXCEPTION("Failed to write data to destination file: " + destination.string(), error_code);
+                }
             }
-        }
 
-        // Check for read errors
-        if (file_ops_->ferror(src_file.get()) != 0) {
-            int error_code = errno;
-            LOG_AND_THROW_BLOB_EXCEPTION("Error reading from source file: " + source.string(), error_code);
+            // Check for read errors
+            if (file_ops_->ferror(src_file.get()) != 0) {
+                int error_code = errno;
+                LOG_AND_THROW_BLOB_EXCEPTION("Error reading from source file: " + source.string(), error_code);
+            }
         }
 
         // Flush destination file
@@ -228,8 +334,8 @@ void blob_pool_impl::copy_file(const boost::filesystem::path& source, const boos
             LOG_AND_THROW_BLOB_EXCEPTION("Failed to flush data to destination file: " + destination.string(), error_code);
         }
 
-        // Synchronize destination file to disk
-        if (file_ops_->fsync(file_ops_->fileno(dest_file.get())) != 0) {
+        // Synchronize destination file to disk, unless it is left to the syncer
+        if (syncer_ == nullptr && file_ops_->fsync(file_ops_->fileno(dest_file.get())) != 0) {
             int error_code = errno;
             LOG_AND_THROW_BLOB_EXCEPTION("Failed to synchronize destination file to disk: " + destination.string(), error_code);
         }
@@ -244,6 +350,42 @@ void blob_pool_impl::copy_file(const boost::filesystem::path& source, const boos
     }
 }
 
+bool blob_pool_impl::copy_file_in_kernel(int src_fd, int dest_fd, const boost::filesystem::path& destination) {
+    // A reflink shares the extents of the source, so nothing is copied at all
+    if (file_ops_->ficlone(dest_fd, src_fd) == 0) {
+        return true;
+    }
+
+    // These errors only tell that the method is not available for the pair of files
+    auto is_unsupported = [](int error_code) {
+        return error_code == EXDEV || error_code == ENOSYS || error_code == EOPNOTSUPP || error_code == EINVAL;
+    };
+    for (bool use_sendfile : {false, true}) {
+        bool copied_any = false;
+        while (true) {
+            ssize_t copied = use_sendfile
+                ? file_ops_->sendfile(dest_fd, src_fd, nullptr, kernel_copy_chunk_size)
+                : file_ops_->copy_file_range(src_fd, nullptr, dest_fd, nullptr, kernel_copy_chunk_size, 0);
+            if (copied > 0) {
+                copied_any = true;
+                continue;
+            }
+            if (copied == 0) {
+                return true;
+            }
+            int error_code = errno;
+            if (error_code == EINTR) {
+                continue;
+            }
+            if (!copied_any && is_unsupported(error_code)) {
+                break;
+            }
+            LOG_AND_THROW_BLOB_EXCEPTION("Failed to write data to destination file: " + destination.string(), error_code);
+        }
+    }
+    return false;
+}
+
 void blob_pool_impl::move_file(const boost::filesystem::path& source, const boost::filesystem::path& destination) {
     // Ensure the destination directory exists
     boost::filesystem::path destination_dir = destination.parent_path();
@@ -286,8 +428,29 @@ blob_id_type blob_pool_impl::register_data(std::string_view data) {
         throw std::logic_error("This pool is already released.");
     }
 
-    // Generate a unique BLOB ID and resolve the target path
+    // Generate a unique BLOB ID
     blob_id_type id = generate_blob_id();
+
+    // A small BLOB is appended to the pack instead of being written to a file of its own
+    if (pack_store_ != nullptr && pack_store_->accepts(data.size())) {
+        pack_store_->append(id, data, syncer_ == nullptr);
+        std::lock_guard<std::mutex> lock(mutex_);
+        blob_ids_.push_back(id);
+        return id;
+    }
+
+    // Link the file of a BLOB registered with the same contents instead of writing the data
+    std::optional<blob_dedup_index::digest_type> digest{};
+    if (dedup_index_ != nullptr) {
+        digest = blob_dedup_index::digest_of(data);
+        if (link_duplicate(*digest, data.size(), id)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blob_ids_.push_back(id);
+            return id;
+        }
+    }
+
+    // Resolve the target path
     boost::filesystem::path target_path = resolver_.resolve_path(id);
 
     // Ensure the destination directory exists
@@ -319,8 +482,8 @@ blob_id_type blob_pool_impl::register_data(std::string_view data) {
             LOG_AND_THROW_BLOB_EXCEPTION("Failed to flush data to destination file: " + target_path.string(), error_code);
         }
 
-        // Synchronize destination file to disk
-        if (file_ops_->fsync(file_ops_->fileno(dest_file.get())) != 0) {
+        // Synchronize destination file to disk, unless it is left to the syncer
+        if (syncer_ == nullptr && file_ops_->fsync(file_ops_->fileno(dest_file.get())) != 0) {
             int error_code = errno;
             LOG_AND_THROW_BLOB_EXCEPTION("Failed to synchronize destination file: " + target_path.string(), error_code);
         }
@@ -332,6 +495,14 @@ blob_id_type blob_pool_impl::register_data(std::string_view data) {
         }
         throw;
     }
+    if (syncer_ != nullptr) {
+        syncer_->add(id, target_path);
+    }
+    if (digest) {
+        // The source may have been modified since its digest was taken, so the copy is indexed by its own digest;
+        // it was written just now and is read back from the page cache.
+        dedup_index_->add(digest_of_file(target_path), id);
+    }
 
     // Add the blob_id to the internal list
     {
@@ -341,4 +512,60 @@ blob_id_type blob_pool_impl::register_data(std::string_view data) {
     return id;
 }
 
+bool blob_pool_impl::link_duplicate(const blob_dedup_index::digest_type& digest, std::uintmax_t size, blob_id_type id) {
+    auto existing_id = dedup_index_->find(digest);
+    if (!existing_id) {
+        return false;
+    }
+    boost::filesystem::path existing_path = resolver_.resolve_path(*existing_id);
+
+    // The digest is trusted without comparing the contents, but a file of another size cannot hold them,
+    // which also catches an indexed BLOB whose file has been replaced since
+    boost::system::error_code ec;
+    std::uintmax_t existing_size = boost::filesystem::file_size(existing_path, ec);
+    if (ec || existing_size != size) {
+        VLOG_LP(log_debug) << "BLOB " << *existing_id << " cannot be linked as " << id
+                           << (ec ? ": " + ec.message() : ": its size differs");
+        dedup_index_->remove(digest, *existing_id);
+        return false;
+    }
+
+    boost::filesystem::path link_path = resolver_.resolve_path(id);
+    create_directories_if_needed(link_path.parent_path());
+
+    // The link keeps the contents even if the existing BLOB is removed afterwards
+    file_ops_->create_hard_link(existing_path, link_path, ec);
+    if (ec) {
+        // The existing BLOB has been removed, or its file has too many links; the new one is written instead
+        VLOG_LP(log_debug) << "Failed to link BLOB " << *existing_id << " as " << id << ": " << ec.message();
+        dedup_index_->remove(digest, *existing_id);
+        return false;
+    }
+    if (syncer_ != nullptr) {
+        syncer_->add(id, link_path);
+    }
+    return true;
+}
+
+blob_dedup_index::digest_type blob_pool_impl::digest_of_file(const boost::filesystem::path& file) {
+    FILE* src_raw = file_ops_->fopen(file.string().c_str(), "rb");
+    if (!src_raw) {
+        int error_code = errno;
+        LOG_AND_THROW_BLOB_EXCEPTION("Failed to open source file: " + file.string(), error_code);
+    }
+    auto src_file = std::unique_ptr<FILE, FileCloser>(src_raw, FileCloser{file_ops_});
+
+    blob_dedup_index::hasher hasher{};
+    std::array<char, copy_buffer_size> buffer = {};
+    size_t bytes_read = 0;
+    while ((bytes_read = file_ops_->fread(buffer.data(), 1, copy_buffer_size, src_file.get())) > 0) {
+        hasher.update(buffer.data(), bytes_read);
+    }
+    if (file_ops_->ferror(src_file.get()) != 0) {
+        int error_code = errno;
+        LOG_AND_THROW_BLOB_EXCEPTION("Error reading from source file: " + file.string(), error_code);
+    }
+    return hasher.finish();
+}
+
 } // namespace limestone::internal
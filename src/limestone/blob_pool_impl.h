@@ -3,10 +3,19 @@
 #include <limestone/api/blob_pool.h>
 #include <functional>
 #include <atomic>
+#include <condition_variable>
+#include <future>
 #include "limestone/api/datastore.h"
+#include "blob_dedup_index.h"
 #include "blob_file_resolver.h"
 #include "file_operations.h"
 
+namespace limestone::internal {
+class blob_pack_store;
+class blob_file_syncer;
+class blob_io_executor;
+}
+
 namespace limestone::internal {
 
 using namespace limestone::api;
@@ -21,8 +30,26 @@ public:
      * @param id_generator A callable object that generates unique IDs of type blob_id_type.
      * @param resolver Reference to a blob_file_resolver instance.
      * @param datastore Reference to a datastore instance.
+     * @param pack_store The store of packed small BLOBs, or nullptr to store every BLOB as a file of its own.
+     * @param syncer The syncer the BLOBs are left to for being made durable, or nullptr to synchronize
+     *        each BLOB as it is registered.
+     * @param executor The threads running the asynchronous registrations, or nullptr to run them synchronously.
+     * @param dedup_index The index of the contents of the BLOBs, through which a BLOB registered again is
+     *        hard-linked instead of written, or nullptr to write every BLOB.
+     */
+    blob_pool_impl(std::function<blob_id_type()> id_generator, blob_file_resolver& resolver, datastore& datastore,
+                   blob_pack_store* pack_store = nullptr, blob_file_syncer* syncer = nullptr,
+                   blob_io_executor* executor = nullptr, blob_dedup_index* dedup_index = nullptr);
+
+    blob_pool_impl(const blob_pool_impl&) = delete;
+    blob_pool_impl& operator=(const blob_pool_impl&) = delete;
+    blob_pool_impl(blob_pool_impl&&) = delete;
+    blob_pool_impl& operator=(blob_pool_impl&&) = delete;
+
+    /**
+     * @brief Destructor, waiting for the asynchronous registrations in progress.
      */
-    blob_pool_impl(std::function<blob_id_type()> id_generator, blob_file_resolver& resolver, datastore& datastore);
+    ~blob_pool_impl() override;
 
     void release() override;
 
@@ -33,6 +60,11 @@ public:
 
     [[nodiscard]] blob_id_type duplicate_data(blob_id_type reference) override;
 
+    [[nodiscard]] std::future<blob_id_type> register_file_async(boost::filesystem::path file,
+                                                                bool is_temporary_file) override;
+
+    [[nodiscard]] std::future<blob_id_type> register_data_async(std::string data) override;
+
 
 protected:
     // These protected fields and methods include:
@@ -41,6 +73,8 @@ protected:
 
     static constexpr size_t copy_buffer_size = 65536;  // Buffer size for file copy operations
 
+    static constexpr size_t kernel_copy_chunk_size = 1UL << 30U;  // Bytes requested per in-kernel copy call
+
     /**
      * @brief Sets a custom file_operations implementation.
      * @param file_ops A reference to the file_operations implementation.
@@ -54,7 +88,11 @@ protected:
      * 
      * This function uses Boost.Filesystem to copy a file from the specified source
      * path to the specified destination path. If the destination file already exists,
-     * it will be overwritten.
+     * it will be overwritten. The destination file is synchronized unless a blob_file_syncer is given,
+     * in which case the caller leaves it to the syncer.
+     * The data is shared by a reflink if the filesystem supports it, and otherwise copied in the kernel
+     * by copy_file_range or sendfile. The copy goes through a user-space buffer only if neither is
+     * supported.
      * 
      * @param source The path to the source file to be copied.
      * @param destination The path to the destination where the file should be copied.
@@ -62,6 +100,20 @@ protected:
      */
     void copy_file(const boost::filesystem::path& source, const boost::filesystem::path& destination);
 
+    /**
+     * @brief Copies the whole source file to the destination file without user-space buffers.
+     *
+     * FICLONE is tried first, then copy_file_range, and then sendfile. A method is given up only if it
+     * fails as unsupported before copying anything.
+     *
+     * @param src_fd The file descriptor of the source file, positioned at its beginning.
+     * @param dest_fd The file descriptor of the empty destination file.
+     * @param destination The path to the destination file, for error messages.
+     * @return true if the file has been copied, false if no method is supported.
+     * @throws limestone_blob_exception if the copy fails otherwise.
+     */
+    bool copy_file_in_kernel(int src_fd, int dest_fd, const boost::filesystem::path& destination);
+
     /**
      * @brief Moves a file from the source path to the destination path.
      * 
@@ -110,6 +162,34 @@ private:
      */
     [[nodiscard]] blob_id_type generate_blob_id();
 
+    /**
+     * @brief Hard-links the BLOB file indexed with the given contents, if any, as the file of a new BLOB.
+     * @details The indexed file is linked only if it is of the same size as the contents.
+     * @param digest The digest of the contents of the new BLOB.
+     * @param size The size of the contents of the new BLOB.
+     * @param id The ID of the new BLOB.
+     * @return true if the new BLOB has been linked, false if it has to be written.
+     * @throws limestone_blob_exception if the directory of the new BLOB cannot be created.
+     */
+    [[nodiscard]] bool link_duplicate(const blob_dedup_index::digest_type& digest, std::uintmax_t size, blob_id_type id);
+
+    /**
+     * @brief Computes the digest of the contents of a file.
+     * @throws limestone_blob_exception if the file cannot be read.
+     */
+    [[nodiscard]] blob_dedup_index::digest_type digest_of_file(const boost::filesystem::path& file);
+
+    /**
+     * @brief Runs a registration on the executor, counting it as in progress until it completes.
+     * @param registration The registration, whose result or exception is passed to the returned future.
+     */
+    [[nodiscard]] std::future<blob_id_type> submit_async(std::function<blob_id_type()> registration);
+
+    /**
+     * @brief Waits until no asynchronous registration is in progress.
+     */
+    void wait_for_async_registrations();
+
     // Callable object for ID generation
     std::function<blob_id_type()> id_generator_;
 
@@ -119,6 +199,12 @@ private:
     // Reference to the datastore for managing BLOB data
     limestone::api::datastore& datastore_;
 
+    // Store of packed small BLOBs, nullptr if not used
+    blob_pack_store* pack_store_;
+
+    // Syncer making the BLOBs durable before an epoch referencing them is recorded, nullptr to sync on registration
+    blob_file_syncer* syncer_;
+
     // Holds the default file_operations implementation
     real_file_operations real_file_ops_;
 
@@ -134,6 +220,17 @@ private:
     // Ensures thread-safe access to blob_ids_
     std::mutex mutex_;
 
+    // Threads running the asynchronous registrations, nullptr to run them synchronously
+    blob_io_executor* executor_;
+
+    // Index of the contents of the registered BLOBs, nullptr not to deduplicate them
+    blob_dedup_index* dedup_index_;
+
+    // Number of asynchronous registrations submitted and not completed yet, guarded by async_mutex_
+    std::size_t async_in_progress_{0};
+    std::mutex async_mutex_;
+    std::condition_variable async_cv_;
+
 };
 
 } // namespace limestone::internal
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_read_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "environment_helper.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+class blob_read_cache::mapping {
+public:
+    mapping(void* address, std::size_t size) noexcept : address_(address), size_(size) {}
+
+    mapping(const mapping&) = delete;
+    mapping& operator=(const mapping&) = delete;
+    mapping(mapping&&) = delete;
+    mapping& operator=(mapping&&) = delete;
+
+    ~mapping() {
+        if (address_ != nullptr && ::munmap(address_, size_) != 0) {
+            LOG_LP(WARNING) << "munmap failed for a BLOB file: " << strerror(errno);
+        }
+    }
+
+    [[nodiscard]] std::string_view data() const noexcept {
+        return address_ == nullptr ? std::string_view{} : std::string_view{static_cast<const char*>(address_), size_};
+    }
+
+private:
+    void* address_;
+    std::size_t size_;
+};
+
+bool blob_read_cache::file_identity::operator==(const file_identity& other) const noexcept {
+    return dev == other.dev && ino == other.ino && size == other.size
+        && mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec;
+}
+
+blob_read_cache::file_identity blob_read_cache::file_identity::of(const struct stat& st) noexcept {
+    return file_identity{st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+}
+
+blob_read_cache::blob_read_cache(std::size_t capacity) : capacity_(capacity) {}
+
+std::size_t blob_read_cache::capacity_from_environment() {
+    auto value = read_unsigned_environment("LIMESTONE_BLOB_READ_CACHE_ENTRIES");
+    return value ? static_cast<std::size_t>(*value) : default_capacity;
+}
+
+blob_view blob_read_cache::read(blob_id_type id, const boost::filesystem::path& path) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0) {
+        int error_code = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to stat blob file: " + path.string(), error_code);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        LOG_AND_THROW_IO_EXCEPTION("Unsupported blob path type: " + path.string(), EINVAL);
+    }
+    auto identity = file_identity::of(st);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (auto it = index_.find(id); it != index_.end()) {
+            if (it->second->identity == identity) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                const auto& map = it->second->map;
+                return blob_view{map, map->data()};
+            }
+            // the BLOB file has been replaced since it was mapped
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    // mapped without the lock, so that reads of other BLOBs do not wait for the I/O
+    auto map = map_file(path, identity);
+    if (capacity_ > 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (auto it = index_.find(id); it != index_.end()) {
+            // mapped by another reader meanwhile
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+        lru_.push_front(entry{id, identity, map});
+        index_.emplace(id, lru_.begin());
+        while (lru_.size() > capacity_) {
+            index_.erase(lru_.back().id);
+            lru_.pop_back();
+        }
+    }
+    return blob_view{map, map->data()};
+}
+
+std::shared_ptr<const blob_read_cache::mapping> blob_read_cache::map_file(const boost::filesystem::path& path, file_identity& identity) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0) {
+        int error_code = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to open blob for reading: " + path.string(), error_code);
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        int error_code = errno;
+        ::close(fd);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to stat blob file: " + path.string(), error_code);
+    }
+    identity = file_identity::of(st);
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* address = nullptr;
+    if (size > 0) {
+        address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+            int error_code = errno;
+            ::close(fd);
+            LOG_AND_THROW_IO_EXCEPTION("Failed to map blob file: " + path.string(), error_code);
+        }
+    }
+    // the mapping does not need the descriptor
+    ::close(fd);
+    return std::make_shared<const mapping>(address, size);
+}
+
+void blob_read_cache::evict(const std::vector<blob_id_type>& ids) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& id : ids) {
+        if (auto it = index_.find(id); it != index_.end()) {
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+}
+
+void blob_read_cache::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    index_.clear();
+    lru_.clear();
+}
+
+std::size_t blob_read_cache::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return lru_.size();
+}
+
+}  // namespace limestone::internal
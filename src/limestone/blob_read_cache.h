@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/blob_id_type.h>
+#include <limestone/api/blob_view.h>
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+using limestone::api::blob_view;
+
+/**
+ * @brief Maps BLOB files into memory for reading, keeping the recently read ones mapped.
+ * @details A read of a BLOB still mapped costs a stat(2) of its path, which detects a BLOB file
+ *          replaced or removed since it was mapped, instead of an open, a read and a copy.
+ *          The mappings are reference counted, so a view handed out stays valid after its entry
+ *          is evicted. With a capacity of 0, every read maps the file afresh.
+ */
+class blob_read_cache {
+public:
+    /// the number of mapped BLOB files kept unless LIMESTONE_BLOB_READ_CACHE_ENTRIES is set
+    static constexpr std::size_t default_capacity = 256;
+
+    /**
+     * @brief Constructor.
+     * @param capacity The maximum number of BLOB files kept mapped.
+     */
+    explicit blob_read_cache(std::size_t capacity);
+
+    /**
+     * @brief Returns the capacity, read from LIMESTONE_BLOB_READ_CACHE_ENTRIES if set.
+     * @details An invalid value is ignored with a warning.
+     */
+    static std::size_t capacity_from_environment();
+
+    /**
+     * @brief Returns the contents of a BLOB file.
+     * @param id The BLOB ID, the key of the cache.
+     * @param path The path of the BLOB file, which may be a symbolic link.
+     * @return The mapped contents.
+     * @throws limestone_io_exception if the file is not a regular file or cannot be mapped.
+     */
+    blob_view read(blob_id_type id, const boost::filesystem::path& path);
+
+    /**
+     * @brief Unmaps the given BLOB files, unless views of them are still alive.
+     * @param ids The IDs of the BLOB files being removed.
+     */
+    void evict(const std::vector<blob_id_type>& ids);
+
+    /**
+     * @brief Unmaps all the BLOB files, unless views of them are still alive.
+     */
+    void clear();
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+    /**
+     * @brief Returns the number of BLOB files kept mapped.
+     */
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    class mapping;
+
+    // identifies the file a mapping was made from
+    struct file_identity {
+        dev_t dev{};
+        ino_t ino{};
+        off_t size{};
+        timespec mtime{};
+
+        static file_identity of(const struct stat& st) noexcept;
+
+        [[nodiscard]] bool operator==(const file_identity& other) const noexcept;
+    };
+
+    struct entry {
+        blob_id_type id{};
+        file_identity identity{};
+        std::shared_ptr<const mapping> map{};
+    };
+
+    static std::shared_ptr<const mapping> map_file(const boost::filesystem::path& path, file_identity& identity);
+
+    const std::size_t capacity_;
+    mutable std::mutex mtx_{};
+    // the most recently read first
+    std::list<entry> lru_{};
+    std::unordered_map<blob_id_type, std::list<entry>::iterator> index_{};
+};
+
+}  // namespace limestone::internal
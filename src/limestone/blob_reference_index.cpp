@@ -0,0 +1,170 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_reference_index.h"
+
+#include <endian.h>
+
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+namespace {
+
+void write_bytes(FILE* out, const void* data, std::size_t size, const boost::filesystem::path& file) {
+    if (size > 0 && fwrite(data, size, 1, out) != 1) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot write BLOB index file (" + file.string() + ")", errno);
+    }
+}
+
+void write_uint32le(FILE* out, std::uint32_t value, const boost::filesystem::path& file) {
+    std::uint32_t buf = htole32(value);
+    write_bytes(out, &buf, sizeof(buf), file);
+}
+
+void write_uint64le(FILE* out, std::uint64_t value, const boost::filesystem::path& file) {
+    std::uint64_t buf = htole64(value);
+    write_bytes(out, &buf, sizeof(buf), file);
+}
+
+bool read_uint32le(FILE* in, std::uint32_t& value) {
+    std::uint32_t buf{};
+    if (fread(&buf, sizeof(buf), 1, in) != 1) {
+        return false;
+    }
+    value = le32toh(buf);
+    return true;
+}
+
+bool read_uint64le(FILE* in, std::uint64_t& value) {
+    std::uint64_t buf{};
+    if (fread(&buf, sizeof(buf), 1, in) != 1) {
+        return false;
+    }
+    value = le64toh(buf);
+    return true;
+}
+
+bool read_string(FILE* in, std::string& str, std::uint64_t remaining) {
+    std::uint32_t size{};
+    if (!read_uint32le(in, size) || size > remaining) {
+        return false;
+    }
+    str.resize(size);
+    return size == 0 || fread(str.data(), size, 1, in) == 1;
+}
+
+} // namespace
+
+blob_reference_index::writer::writer(boost::filesystem::path index_file) : index_file_(std::move(index_file)) {
+    ostrm_ = fopen(index_file_.c_str(), "w");  // NOLINT(*-owning-memory)
+    if (!ostrm_) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot create BLOB index file (" + index_file_.string() + ")", errno);
+    }
+    // the data size and the count are filled in by finish(); until then the file never matches its data file
+    write_uint64le(ostrm_, format_magic, index_file_);
+    write_uint64le(ostrm_, UINT64_MAX, index_file_);
+    write_uint64le(ostrm_, 0, index_file_);
+}
+
+blob_reference_index::writer::~writer() {
+    if (ostrm_ != nullptr) {
+        fclose(ostrm_);  // NOLINT(*-owning-memory)
+    }
+}
+
+void blob_reference_index::writer::record(std::string_view key_sid, const write_version_type& version, std::string_view blob_ids) {
+    write_uint32le(ostrm_, static_cast<std::uint32_t>(key_sid.size()), index_file_);
+    write_bytes(ostrm_, key_sid.data(), key_sid.size(), index_file_);
+    write_uint64le(ostrm_, static_cast<std::uint64_t>(version.get_major()), index_file_);
+    write_uint64le(ostrm_, version.get_minor(), index_file_);
+    write_uint32le(ostrm_, static_cast<std::uint32_t>(blob_ids.size()), index_file_);
+    write_bytes(ostrm_, blob_ids.data(), blob_ids.size(), index_file_);
+    count_++;
+}
+
+void blob_reference_index::writer::finish(std::uint64_t data_size) {
+    if (fseek(ostrm_, static_cast<long>(sizeof(format_magic)), SEEK_SET) != 0) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot seek BLOB index file (" + index_file_.string() + ")", errno);
+    }
+    write_uint64le(ostrm_, data_size, index_file_);
+    write_uint64le(ostrm_, count_, index_file_);
+    FILE* ostrm = std::exchange(ostrm_, nullptr);
+    if (fclose(ostrm) != 0) {  // NOLINT(*-owning-memory)
+        LOG_AND_THROW_IO_EXCEPTION("cannot close BLOB index file (" + index_file_.string() + ")", errno);
+    }
+}
+
+bool blob_reference_index::read_for(const boost::filesystem::path& data_file, const consumer_type& consumer) {
+    boost::filesystem::path index_file = index_file_path(data_file);
+    boost::system::error_code error;
+    if (!boost::filesystem::exists(index_file, error) || error) {
+        return false;
+    }
+    std::uint64_t actual_size = boost::filesystem::file_size(data_file, error);
+    if (error) {
+        return false;
+    }
+    std::uint64_t index_size = boost::filesystem::file_size(index_file, error);
+    if (error) {
+        return false;
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE*)> istrm(fopen(index_file.c_str(), "r"), &fclose);  // NOLINT(*-owning-memory)
+    if (!istrm) {
+        return false;
+    }
+    std::uint64_t magic{};
+    std::uint64_t data_size{};
+    std::uint64_t count{};
+    if (!read_uint64le(istrm.get(), magic) || magic != format_magic
+        || !read_uint64le(istrm.get(), data_size) || !read_uint64le(istrm.get(), count)) {
+        VLOG_LP(log_info) << "ignoring broken BLOB index file: " << index_file;
+        return false;
+    }
+    if (data_size != actual_size) {
+        VLOG_LP(log_info) << "ignoring stale BLOB index file: " << index_file;
+        return false;
+    }
+
+    std::string key_sid{};
+    std::string blob_ids{};
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::uint64_t major{};
+        std::uint64_t minor{};
+        if (!read_string(istrm.get(), key_sid, index_size) || !read_uint64le(istrm.get(), major) || !read_uint64le(istrm.get(), minor)
+            || !read_string(istrm.get(), blob_ids, index_size)) {
+            VLOG_LP(log_info) << "ignoring broken BLOB index file: " << index_file;
+            return false;
+        }
+        consumer(key_sid, write_version_type(static_cast<limestone::api::epoch_id_type>(major), minor), blob_ids);
+    }
+    return true;
+}
+
+boost::filesystem::path blob_reference_index::index_file_path(const boost::filesystem::path& data_file) {
+    return data_file.parent_path() / (std::string(index_file_prefix) + data_file.filename().string());
+}
+
+} // namespace limestone::internal
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string_view>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/write_version_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::write_version_type;
+
+/**
+ * @brief List of the BLOB references of a compacted file.
+ *
+ * The key, write version and BLOB IDs of every entry with BLOBs in a compacted file are recorded
+ * in a sidecar file (see index_file_path()) while the compacted file is written, in file order.
+ * Online compaction reads the list of a generation it does not merge to find the BLOBs the
+ * generation still refers to, instead of reading the whole generation.
+ *
+ * Like the storage index, the sidecar is an optional accelerator: readers must fall back to
+ * a sequential scan of the compacted file if it is missing or does not match the file.
+ */
+class blob_reference_index {
+public:
+    /**
+     * @brief Function called with the key_sid, the write version and the raw BLOB IDs of an entry.
+     */
+    using consumer_type = std::function<void(std::string_view, const write_version_type&, std::string_view)>;
+
+    /**
+     * @brief Writes the sidecar of a compacted file.
+     */
+    class writer {
+    public:
+        /**
+         * @brief Creates the sidecar file.
+         * @exception limestone_io_exception if the file cannot be created
+         */
+        explicit writer(boost::filesystem::path index_file);
+
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+        writer(writer&&) = delete;
+        writer& operator=(writer&&) = delete;
+        ~writer();
+
+        /**
+         * @brief Records an entry with BLOBs, with the write version as stored in the compacted file.
+         * @exception limestone_io_exception if the file cannot be written
+         */
+        void record(std::string_view key_sid, const write_version_type& version, std::string_view blob_ids);
+
+        /**
+         * @brief Completes and closes the sidecar file.
+         * @param data_size the size of the compacted file
+         * @exception limestone_io_exception if the file cannot be written
+         */
+        void finish(std::uint64_t data_size);
+
+    private:
+        boost::filesystem::path index_file_;
+        FILE* ostrm_{};
+        std::uint64_t count_{0};
+    };
+
+    /**
+     * @brief Passes the entries recorded in the sidecar of the given compacted file to the consumer.
+     * @details If the sidecar turns out to be broken while it is read, the entries before the broken one
+     *          have been passed already; they are passed again by the sequential scan, which the caller
+     *          does to fall back, so the consumer must tolerate duplicates.
+     * @param data_file the compacted file
+     * @return false if the sidecar is missing, broken, or stale (i.e. it was written for a file of a different size)
+     */
+    static bool read_for(const boost::filesystem::path& data_file, const consumer_type& consumer);
+
+    /**
+     * @brief Returns the path of the sidecar file for the given compacted file.
+     * @details The sidecar is placed next to the compacted file with index_file_prefix prepended to its name.
+     */
+    static boost::filesystem::path index_file_path(const boost::filesystem::path& data_file);
+
+    /**
+     * @brief Prefix of sidecar file names.
+     */
+    static constexpr std::string_view index_file_prefix = "blob_index.";
+
+private:
+    static constexpr std::uint64_t format_magic = 0x3130305842494c53ULL;  // "SLIBX001" in little endian
+};
+
+} // namespace limestone::internal
@@ -0,0 +1,450 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_reference_sorter.h"
+
+#include <endian.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "crc32c.h"
+#include "environment_helper.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+// key_sid ascending, then the newest version first
+bool precedes(const blob_reference_sorter::record& a, const blob_reference_sorter::record& b) {
+    int c = a.key_sid.compare(b.key_sid);
+    if (c != 0) {
+        return c < 0;
+    }
+    return b.version < a.version;
+}
+
+/*
+ * A run file is written by a single thread and read back by the same process, but it lives on disk
+ * long enough to be damaged, so it is checked as the other files of the log directory are:
+ *   header := magic:u64 count:u64 crc:u32
+ *   body   := record{count}
+ * where the integers are little endian and crc is the CRC32C of the body.
+ */
+constexpr std::uint64_t record_run_magic = 0x3130305243474c53ULL;  // "SLGCR001" in little endian
+constexpr std::uint64_t blob_id_run_magic = 0x3130304943474c53ULL;  // "SLGCI001" in little endian
+
+class run_file_writer {
+public:
+    run_file_writer(boost::filesystem::path path, std::uint64_t magic) : path_(std::move(path)), strm_(std::fopen(path_.c_str(), "wb")) {
+        if (strm_ == nullptr) {
+            int error_code = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to create the run file: " + path_.string(), error_code);
+        }
+        // the count is filled in by finish(); until then the file is rejected by run_file_reader
+        write_header(magic, UINT64_MAX, 0);
+    }
+
+    run_file_writer(const run_file_writer&) = delete;
+    run_file_writer& operator=(const run_file_writer&) = delete;
+    run_file_writer(run_file_writer&&) = delete;
+    run_file_writer& operator=(run_file_writer&&) = delete;
+
+    ~run_file_writer() {
+        if (strm_ != nullptr) {
+            std::fclose(strm_);
+        }
+    }
+
+    void put_bytes(const void* data, std::size_t size) {
+        crc_ = crc32c(data, size, crc_);
+        write_bytes(data, size);
+    }
+
+    void put_uint32(std::uint32_t value) {
+        std::uint32_t buf = htole32(value);
+        put_bytes(&buf, sizeof(buf));
+    }
+
+    void put_uint64(std::uint64_t value) {
+        std::uint64_t buf = htole64(value);
+        put_bytes(&buf, sizeof(buf));
+    }
+
+    void put_string(const std::string& str) {
+        put_uint32(static_cast<std::uint32_t>(str.size()));
+        put_bytes(str.data(), str.size());
+    }
+
+    void finish(std::uint64_t magic, std::uint64_t count) {
+        if (std::fseek(strm_, 0, SEEK_SET) != 0) {
+            int error_code = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to seek the run file: " + path_.string(), error_code);
+        }
+        write_header(magic, count, crc_);
+        if (std::fclose(std::exchange(strm_, nullptr)) != 0) {
+            int error_code = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to close the run file: " + path_.string(), error_code);
+        }
+    }
+
+private:
+    void write_bytes(const void* data, std::size_t size) {
+        if (size > 0 && std::fwrite(data, size, 1, strm_) != 1) {
+            int error_code = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to write the run file: " + path_.string(), error_code);
+        }
+    }
+
+    void write_header(std::uint64_t magic, std::uint64_t count, std::uint32_t crc) {
+        std::uint64_t magic_le = htole64(magic);
+        std::uint64_t count_le = htole64(count);
+        std::uint32_t crc_le = htole32(crc);
+        write_bytes(&magic_le, sizeof(magic_le));
+        write_bytes(&count_le, sizeof(count_le));
+        write_bytes(&crc_le, sizeof(crc_le));
+    }
+
+    boost::filesystem::path path_;
+    FILE* strm_;
+    std::uint32_t crc_{0};
+};
+
+class run_file_reader {
+public:
+    run_file_reader(boost::filesystem::path path, std::uint64_t magic) : path_(std::move(path)), strm_(std::fopen(path_.c_str(), "rb")) {
+        if (strm_ == nullptr) {
+            int error_code = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to open the run file: " + path_.string(), error_code);
+        }
+        std::uint64_t magic_le = 0;
+        std::uint64_t count_le = 0;
+        std::uint32_t crc_le = 0;
+        if (std::fread(&magic_le, sizeof(magic_le), 1, strm_) != 1 || std::fread(&count_le, sizeof(count_le), 1, strm_) != 1
+            || std::fread(&crc_le, sizeof(crc_le), 1, strm_) != 1 || le64toh(magic_le) != magic || le64toh(count_le) == UINT64_MAX) {
+            std::fclose(std::exchange(strm_, nullptr));
+            LOG_AND_THROW_IO_EXCEPTION("Broken run file header: " + path_.string(), EIO);
+        }
+        remaining_ = le64toh(count_le);
+        expected_crc_ = le32toh(crc_le);
+    }
+
+    run_file_reader(const run_file_reader&) = delete;
+    run_file_reader& operator=(const run_file_reader&) = delete;
+    run_file_reader(run_file_reader&&) = delete;
+    run_file_reader& operator=(run_file_reader&&) = delete;
+
+    ~run_file_reader() {
+        if (strm_ != nullptr) {
+            std::fclose(strm_);
+        }
+    }
+
+    /**
+     * @brief Starts reading the next record.
+     * @return false if all the records have been read, after the checksum is verified.
+     */
+    bool next_record() {
+        if (remaining_ == 0) {
+            if (crc_ != expected_crc_ || std::fgetc(strm_) != EOF) {
+                LOG_AND_THROW_IO_EXCEPTION("Broken run file, checksum mismatch: " + path_.string(), EIO);
+            }
+            return false;
+        }
+        remaining_--;
+        return true;
+    }
+
+    void get_bytes(void* data, std::size_t size) {
+        if (size > 0 && std::fread(data, size, 1, strm_) != 1) {
+            int error_code = std::feof(strm_) != 0 ? EIO : errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to read the run file: " + path_.string(), error_code);
+        }
+        crc_ = crc32c(data, size, crc_);
+    }
+
+    std::uint32_t get_uint32() {
+        std::uint32_t buf = 0;
+        get_bytes(&buf, sizeof(buf));
+        return le32toh(buf);
+    }
+
+    std::uint64_t get_uint64() {
+        std::uint64_t buf = 0;
+        get_bytes(&buf, sizeof(buf));
+        return le64toh(buf);
+    }
+
+    void get_string(std::string& str) {
+        str.resize(get_uint32());
+        get_bytes(str.data(), str.size());
+    }
+
+private:
+    boost::filesystem::path path_;
+    FILE* strm_;
+    std::uint64_t remaining_{};
+    std::uint32_t expected_crc_{};
+    std::uint32_t crc_{0};
+};
+
+}  // namespace
+
+/**
+ * @brief Reads the records of a run in order, from memory or from a run file.
+ */
+class blob_reference_sorter::run_reader {
+public:
+    explicit run_reader(run_type run) : run_(std::move(run)) {}
+
+    explicit run_reader(const boost::filesystem::path& path) : file_(std::make_unique<run_file_reader>(path, record_run_magic)) {}
+
+    /**
+     * @brief Moves to the next record.
+     * @return false if the run has ended.
+     */
+    bool next() {
+        if (file_ == nullptr) {
+            if (index_ >= run_.size()) {
+                return false;
+            }
+            current_ = std::move(run_[index_++]);
+            return true;
+        }
+        if (!file_->next_record()) {
+            return false;
+        }
+        file_->get_string(current_.key_sid);
+        std::uint64_t major = file_->get_uint64();
+        std::uint64_t minor = file_->get_uint64();
+        current_.version = write_version_type(static_cast<epoch_id_type>(major), minor);
+        file_->get_string(current_.blob_ids);
+        return true;
+    }
+
+    [[nodiscard]] const record& current() const noexcept { return current_; }
+
+private:
+    run_type run_{};
+    std::size_t index_{};
+    std::unique_ptr<run_file_reader> file_{};
+    record current_{};
+};
+
+blob_reference_sorter::blob_reference_sorter(boost::filesystem::path spill_directory, std::size_t memory_limit)
+    : spill_directory_(std::move(spill_directory)), memory_limit_(memory_limit) {}
+
+blob_reference_sorter::~blob_reference_sorter() {
+    remove_run_files(run_files_);
+    remove_run_files(blob_id_files_);
+}
+
+std::size_t blob_reference_sorter::memory_limit_from_environment() {
+    auto value = read_unsigned_environment("LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY");
+    return value ? static_cast<std::size_t>(*value) : default_memory_limit;
+}
+
+std::size_t blob_reference_sorter::run_limit() const noexcept {
+    return std::max<std::size_t>(memory_limit_ / runs_in_memory, 1);
+}
+
+void blob_reference_sorter::sort_run(run_type& run) {
+    std::sort(run.begin(), run.end(), precedes);
+    // the newest reference of each key comes first
+    auto last = std::unique(run.begin(), run.end(), [](const record& a, const record& b) { return a.key_sid == b.key_sid; });
+    run.erase(last, run.end());
+}
+
+void blob_reference_sorter::add_run(run_type&& run) {
+    if (run.empty()) {
+        return;
+    }
+    std::size_t bytes = 0;
+    for (const auto& r : run) {
+        bytes += r.footprint();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (spill_directory_.empty() || memory_bytes_ + blob_id_memory_bytes_ + bytes <= memory_limit_) {
+            memory_bytes_ += bytes;
+            memory_runs_.emplace_back(std::move(run));
+            return;
+        }
+    }
+    write_run_file(run);
+}
+
+void blob_reference_sorter::add_blob_ids(std::vector<blob_id_type>&& blob_ids) {
+    if (blob_ids.empty()) {
+        return;
+    }
+    std::size_t bytes = blob_ids.size() * sizeof(blob_id_type);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (spill_directory_.empty() || memory_bytes_ + blob_id_memory_bytes_ + bytes <= memory_limit_) {
+            blob_id_memory_bytes_ += bytes;
+            memory_blob_ids_.emplace_back(std::move(blob_ids));
+            return;
+        }
+    }
+    write_blob_id_file(blob_ids);
+}
+
+boost::filesystem::path blob_reference_sorter::new_run_file(const char* prefix, std::vector<boost::filesystem::path>& files) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    boost::filesystem::path path = spill_directory_ / (prefix + std::to_string(next_run_number_++));
+    // registered before written, so that a partial file is removed too
+    files.push_back(path);
+    return path;
+}
+
+void blob_reference_sorter::write_run_file(const run_type& run) {
+    boost::filesystem::path path = new_run_file("blob_gc_snapshot_run_", run_files_);
+    run_file_writer writer(path, record_run_magic);
+    for (const auto& r : run) {
+        writer.put_string(r.key_sid);
+        writer.put_uint64(static_cast<std::uint64_t>(r.version.get_major()));
+        writer.put_uint64(r.version.get_minor());
+        writer.put_string(r.blob_ids);
+    }
+    writer.finish(record_run_magic, run.size());
+    VLOG_LP(log_debug) << "spilled " << run.size() << " BLOB references to " << path.string();
+}
+
+void blob_reference_sorter::write_blob_id_file(const std::vector<blob_id_type>& blob_ids) {
+    boost::filesystem::path path = new_run_file("blob_gc_snapshot_ids_", blob_id_files_);
+    run_file_writer writer(path, blob_id_run_magic);
+    for (const auto& id : blob_ids) {
+        writer.put_uint64(id);
+    }
+    writer.finish(blob_id_run_magic, blob_ids.size());
+    VLOG_LP(log_debug) << "spilled " << blob_ids.size() << " BLOB IDs to " << path.string();
+}
+
+void blob_reference_sorter::merge(const std::function<void(const record&)>& consumer) {
+    std::vector<run_type> memory_runs;
+    std::vector<boost::filesystem::path> run_files;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        memory_runs.swap(memory_runs_);
+        run_files = run_files_;
+        memory_bytes_ = 0;
+    }
+
+    std::vector<std::unique_ptr<run_reader>> readers;
+    readers.reserve(memory_runs.size() + run_files.size());
+    for (auto& run : memory_runs) {
+        readers.emplace_back(std::make_unique<run_reader>(std::move(run)));
+    }
+    memory_runs.clear();
+    for (const auto& path : run_files) {
+        readers.emplace_back(std::make_unique<run_reader>(path));
+    }
+
+    // the reader with the first record on top
+    auto after = [&readers](std::size_t a, std::size_t b) { return precedes(readers[b]->current(), readers[a]->current()); };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(after)> heap(after);
+    for (std::size_t i = 0; i < readers.size(); i++) {
+        if (readers[i]->next()) {
+            heap.push(i);
+        }
+    }
+    std::string last_key;
+    bool first = true;
+    while (!heap.empty()) {
+        std::size_t i = heap.top();
+        heap.pop();
+        const record& r = readers[i]->current();
+        if (first || r.key_sid != last_key) {
+            consumer(r);
+            last_key = r.key_sid;
+            first = false;
+        }
+        if (readers[i]->next()) {
+            heap.push(i);
+        }
+    }
+    readers.clear();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    remove_run_files(run_files_);
+}
+
+void blob_reference_sorter::drain_blob_ids(const std::function<void(blob_id_type)>& consumer) {
+    std::vector<std::vector<blob_id_type>> memory_blob_ids;
+    std::vector<boost::filesystem::path> blob_id_files;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        memory_blob_ids.swap(memory_blob_ids_);
+        blob_id_files = blob_id_files_;
+        blob_id_memory_bytes_ = 0;
+    }
+    for (auto& blob_ids : memory_blob_ids) {
+        for (const auto& id : blob_ids) {
+            consumer(id);
+        }
+        blob_ids = {};
+    }
+    for (const auto& path : blob_id_files) {
+        run_file_reader reader(path, blob_id_run_magic);
+        while (reader.next_record()) {
+            consumer(reader.get_uint64());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    remove_run_files(blob_id_files_);
+}
+
+void blob_reference_sorter::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    memory_runs_.clear();
+    memory_bytes_ = 0;
+    memory_blob_ids_.clear();
+    blob_id_memory_bytes_ = 0;
+    remove_run_files(run_files_);
+    remove_run_files(blob_id_files_);
+}
+
+std::size_t blob_reference_sorter::spilled_runs() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return run_files_.size() + blob_id_files_.size();
+}
+
+void blob_reference_sorter::remove_run_files(std::vector<boost::filesystem::path>& files) noexcept {
+    for (const auto& path : files) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        if (ec) {
+            LOG_LP(WARNING) << "Failed to remove the run file: " << path.string() << ", error: " << ec.message();
+        }
+    }
+    files.clear();
+}
+
+}  // namespace limestone::internal
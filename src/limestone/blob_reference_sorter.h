@@ -0,0 +1,166 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/blob_id_type.h>
+#include <limestone/api/write_version_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+using limestone::api::write_version_type;
+
+/**
+ * @brief Sorts the BLOB references of log entries by key, keeping the newest reference of each key.
+ * @details The references are given in sorted runs, which are kept in memory up to the memory limit
+ *          and written to run files in the spill directory beyond it. merge() reads the runs back
+ *          one reference at a time, so the memory used does not grow with the number of keys.
+ *          BLOB IDs which need no sorting are held the same way within the same memory limit.
+ *          Without a spill directory, all the runs are kept in memory.
+ *          A run file starts with a header holding the number of its records and their CRC32C,
+ *          and is read back as broken if they do not match.
+ */
+class blob_reference_sorter {
+public:
+    /// the memory used for the references unless LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY is set
+    static constexpr std::size_t default_memory_limit = 64UL * 1024UL * 1024UL;
+
+    /// the number of runs of run_limit() bytes which fit in the memory limit
+    static constexpr std::size_t runs_in_memory = 8;
+
+    /**
+     * @brief A reference to BLOBs from the value of a key.
+     */
+    struct record {
+        std::string key_sid{};
+        write_version_type version{};
+        // the BLOB IDs, as in log_entry::raw_blob_ids()
+        std::string blob_ids{};
+
+        /**
+         * @brief Returns the approximate memory used by this record.
+         */
+        [[nodiscard]] std::size_t footprint() const noexcept {
+            return sizeof(record) + key_sid.size() + blob_ids.size();
+        }
+    };
+
+    using run_type = std::vector<record>;
+
+    /**
+     * @brief Constructor.
+     * @param spill_directory The directory to write run files into, or empty to keep all the runs in memory.
+     * @param memory_limit The memory used for the runs kept in memory, in bytes.
+     */
+    blob_reference_sorter(boost::filesystem::path spill_directory, std::size_t memory_limit);
+
+    blob_reference_sorter(const blob_reference_sorter&) = delete;
+    blob_reference_sorter& operator=(const blob_reference_sorter&) = delete;
+    blob_reference_sorter(blob_reference_sorter&&) = delete;
+    blob_reference_sorter& operator=(blob_reference_sorter&&) = delete;
+
+    /**
+     * @brief Destructor that removes the run files left.
+     */
+    ~blob_reference_sorter();
+
+    /**
+     * @brief Returns the memory limit, read from LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY if set.
+     * @details An invalid value is ignored with a warning.
+     */
+    static std::size_t memory_limit_from_environment();
+
+    /**
+     * @brief Returns the size in bytes a run should be given at, to keep several runs in memory.
+     */
+    [[nodiscard]] std::size_t run_limit() const noexcept;
+
+    /**
+     * @brief Sorts a run by key, and removes all the references of each key but the newest one.
+     */
+    static void sort_run(run_type& run);
+
+    /**
+     * @brief Adds a run, writing it to a run file if it does not fit in the memory limit.
+     * @details This method is thread-safe.
+     * @param run The run, sorted with sort_run().
+     * @throws limestone_io_exception if the run file cannot be written.
+     */
+    void add_run(run_type&& run);
+
+    /**
+     * @brief Adds BLOB IDs to be passed on as they are, writing them to a run file if they do not fit in the memory limit.
+     * @details This method is thread-safe.
+     * @throws limestone_io_exception if the run file cannot be written.
+     */
+    void add_blob_ids(std::vector<blob_id_type>&& blob_ids);
+
+    /**
+     * @brief Merges the runs added, and passes the newest reference of each key to the consumer in key order.
+     * @details The runs are discarded afterwards.
+     * @throws limestone_io_exception if a run file cannot be read or is broken.
+     */
+    void merge(const std::function<void(const record&)>& consumer);
+
+    /**
+     * @brief Passes the BLOB IDs added with add_blob_ids() to the consumer in no particular order.
+     * @details The BLOB IDs are discarded afterwards.
+     * @throws limestone_io_exception if a run file cannot be read or is broken.
+     */
+    void drain_blob_ids(const std::function<void(blob_id_type)>& consumer);
+
+    /**
+     * @brief Discards the runs and the BLOB IDs added.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of run files written, of both the runs and the BLOB IDs.
+     */
+    [[nodiscard]] std::size_t spilled_runs() const;
+
+private:
+    class run_reader;
+
+    boost::filesystem::path new_run_file(const char* prefix, std::vector<boost::filesystem::path>& files);
+
+    void write_run_file(const run_type& run);
+
+    void write_blob_id_file(const std::vector<blob_id_type>& blob_ids);
+
+    static void remove_run_files(std::vector<boost::filesystem::path>& files) noexcept;
+
+    const boost::filesystem::path spill_directory_;
+    const std::size_t memory_limit_;
+    mutable std::mutex mtx_{};
+    std::vector<run_type> memory_runs_{};
+    std::size_t memory_bytes_{};
+    std::vector<boost::filesystem::path> run_files_{};
+    std::vector<std::vector<blob_id_type>> memory_blob_ids_{};
+    std::size_t blob_id_memory_bytes_{};
+    std::vector<boost::filesystem::path> blob_id_files_{};
+    std::size_t next_run_number_{};
+};
+
+}  // namespace limestone::internal
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "blob_scan_state.h"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "crc32c.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+constexpr std::string_view magic{"LSBSCAN1"};
+
+// magic, max_scanned_blob_id, incremental_scans, the number of IDs
+constexpr std::size_t header_size = 8 + 8 + 4 + 8;
+constexpr std::size_t crc_size = 4;
+
+void append_u64(std::string& out, std::uint64_t value) {
+    std::uint64_t le = htole64(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+void append_u32(std::string& out, std::uint32_t value) {
+    std::uint32_t le = htole32(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+std::uint64_t read_u64(const char* in) {
+    std::uint64_t le = 0;
+    std::memcpy(&le, in, sizeof(le));
+    return le64toh(le);
+}
+
+std::uint32_t read_u32(const char* in) {
+    std::uint32_t le = 0;
+    std::memcpy(&le, in, sizeof(le));
+    return le32toh(le);
+}
+
+}  // namespace
+
+std::optional<blob_scan_state> blob_scan_state::load(const boost::filesystem::path& path) {
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::string content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    auto broken = [&path](const char* reason) -> std::optional<blob_scan_state> {
+        LOG_LP(WARNING) << "ignoring BLOB scan state file " << path.string() << ": " << reason;
+        return std::nullopt;
+    };
+    if (content.size() < header_size + crc_size || std::string_view{content}.substr(0, magic.size()) != magic) {
+        return broken("unknown format");
+    }
+    const char* data = content.data();
+    blob_id_type max_scanned_blob_id = read_u64(data + 8);
+    std::uint32_t incremental_scans = read_u32(data + 16);
+    std::uint64_t count = read_u64(data + 20);
+    if (count != (content.size() - header_size - crc_size) / sizeof(std::uint64_t)
+        || content.size() != header_size + count * sizeof(std::uint64_t) + crc_size) {
+        return broken("size mismatch");
+    }
+    std::size_t body_size = content.size() - crc_size;
+    if (read_u32(data + body_size) != crc32c(data, body_size)) {
+        return broken("checksum mismatch");
+    }
+    std::vector<blob_id_type> blob_ids(count);
+    for (std::size_t i = 0; i < count; i++) {
+        blob_ids[i] = read_u64(data + header_size + i * sizeof(std::uint64_t));
+    }
+    if (!std::is_sorted(blob_ids.begin(), blob_ids.end()) || (!blob_ids.empty() && blob_ids.back() > max_scanned_blob_id)) {
+        return broken("invalid BLOB IDs");
+    }
+    return blob_scan_state{max_scanned_blob_id, std::move(blob_ids), incremental_scans};
+}
+
+void blob_scan_state::save(const boost::filesystem::path& path) const {
+    std::string content{};
+    content.reserve(header_size + blob_ids_.size() * sizeof(std::uint64_t) + crc_size);
+    content.append(magic);
+    append_u64(content, max_scanned_blob_id_);
+    append_u32(content, incremental_scans_);
+    append_u64(content, blob_ids_.size());
+    for (const auto& id : blob_ids_) {
+        append_u64(content, id);
+    }
+    append_u32(content, crc32c(content.data(), content.size()));
+
+    boost::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0) {
+        int error_code = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to create BLOB scan state file: " + tmp_path.string(), error_code);
+    }
+    std::size_t written = 0;
+    while (written < content.size()) {
+        auto n = ::write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            int error_code = errno;
+            ::close(fd);
+            LOG_AND_THROW_IO_EXCEPTION("Failed to write BLOB scan state file: " + tmp_path.string(), error_code);
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    if (::fsync(fd) != 0) {
+        int error_code = errno;
+        ::close(fd);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to synchronize BLOB scan state file: " + tmp_path.string(), error_code);
+    }
+    ::close(fd);
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        int error_code = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to rename BLOB scan state file: " + tmp_path.string() + " to " + path.string(), error_code);
+    }
+}
+
+}  // namespace limestone::internal
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/blob_id_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+
+/**
+ * @brief The BLOB files known to exist after a garbage collection, kept for the next one.
+ * @details blob_file_garbage_collector saves the IDs of the BLOB files left after its cleanup, up to the
+ *          maximum ID it scanned. The next collection then only has to look up the IDs above that maximum
+ *          instead of listing every subdirectory. The recorded IDs may include files removed since, which
+ *          the next cleanup skips, but never miss a file that existed, so files placed by other means,
+ *          such as a restore, require the state file to be removed.
+ *          The file consists of a magic, the maximum scanned ID, the number of incremental scans since
+ *          the last full scan, the number of IDs, the IDs in ascending order, and a CRC32C of all the
+ *          preceding bytes, each field in little endian.
+ */
+class blob_scan_state {
+public:
+    /// the number of consecutive incremental scans after which a full scan is done anyway
+    static constexpr std::uint32_t full_scan_interval = 16;
+
+    /**
+     * @brief Constructor.
+     * @param max_scanned_blob_id The maximum ID covered by the scan.
+     * @param blob_ids The IDs of the existing BLOB files in ascending order, none above max_scanned_blob_id.
+     * @param incremental_scans The number of incremental scans since the last full scan.
+     */
+    blob_scan_state(blob_id_type max_scanned_blob_id, std::vector<blob_id_type> blob_ids, std::uint32_t incremental_scans) noexcept
+        : max_scanned_blob_id_(max_scanned_blob_id), blob_ids_(std::move(blob_ids)), incremental_scans_(incremental_scans) {}
+
+    /**
+     * @brief Reads the state file.
+     * @param path The path of the state file.
+     * @return The state, or std::nullopt if the file does not exist or is broken.
+     */
+    static std::optional<blob_scan_state> load(const boost::filesystem::path& path);
+
+    /**
+     * @brief Writes the state file, replacing the existing one atomically.
+     * @param path The path of the state file.
+     * @exception limestone_io_exception if the file cannot be written
+     */
+    void save(const boost::filesystem::path& path) const;
+
+    [[nodiscard]] blob_id_type max_scanned_blob_id() const noexcept { return max_scanned_blob_id_; }
+
+    [[nodiscard]] const std::vector<blob_id_type>& blob_ids() const noexcept { return blob_ids_; }
+
+    [[nodiscard]] std::uint32_t incremental_scans() const noexcept { return incremental_scans_; }
+
+private:
+    blob_id_type max_scanned_blob_id_;
+    std::vector<blob_id_type> blob_ids_;
+    std::uint32_t incremental_scans_;
+};
+
+}  // namespace limestone::internal
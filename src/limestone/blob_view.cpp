@@ -0,0 +1,32 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limestone/api/blob_view.h>
+
+namespace limestone::api {
+
+blob_view::blob_view(std::shared_ptr<const void> holder, std::string_view data) noexcept
+    : holder_(std::move(holder)), data_(data) {}
+
+std::string_view blob_view::data() const noexcept {
+    return data_;
+}
+
+blob_view::operator bool() const noexcept {
+    return holder_ != nullptr;
+}
+
+} // namespace limestone::api
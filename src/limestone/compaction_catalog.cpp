@@ -15,7 +15,10 @@
  */
 
 #include <glog/logging.h>
+#include <algorithm>
+#include <cctype>
 #include <fstream>
+#include <iterator>
 #include <stdexcept>
 #include <sstream>
 #include <fcntl.h> // for open, O_WRONLY
@@ -36,7 +39,8 @@ using limestone::api::epoch_id_type;
 // Constructor that takes a directory path and initializes file paths
 compaction_catalog::compaction_catalog(const boost::filesystem::path &directory_path)
     : catalog_file_path_(directory_path / COMPACTION_CATALOG_FILENAME),
-      backup_file_path_(directory_path / COMPACTION_CATALOG_BACKUP_FILENAME) {}
+      backup_file_path_(directory_path / COMPACTION_CATALOG_BACKUP_FILENAME),
+      journal_file_path_(directory_path / COMPACTION_CATALOG_JOURNAL_FILENAME) {}
 
 // Static method to create a compaction_catalog from a catalog file
 compaction_catalog compaction_catalog::from_catalog_file(const boost::filesystem::path& directory_path) {
@@ -53,6 +57,108 @@ void compaction_catalog::load() {
         // Handle error by trying to restore from backup
         restore_from_backup();
     }
+    boost::system::error_code ec;
+    checkpoint_bytes_ = boost::filesystem::file_size(catalog_file_path_, ec);
+    if (ec) {
+        checkpoint_bytes_ = 0;
+    }
+    has_checkpoint_ = true;
+    replay_journal();
+}
+
+// Applies the journal records written after the catalog file.
+// A record torn by a crash is at the end of the journal; it is discarded and cut off the file.
+void compaction_catalog::replay_journal() {
+    boost::system::error_code ec;
+    if (!file_ops_->exists(journal_file_path_, ec)) {
+        if (ec && ec != boost::system::errc::no_such_file_or_directory) {
+            LOG_AND_THROW_IO_EXCEPTION("Error checking journal file existence", ec.value());
+        }
+        journal_bytes_ = 0;
+        return;
+    }
+    auto strm = file_ops_->open_ifstream(journal_file_path_.string());
+    int error_num = errno;
+    if (!strm || !file_ops_->is_open(*strm)) {
+        LOG_AND_THROW_IO_EXCEPTION("Failed to open compaction catalog journal: " + journal_file_path_.string(), error_num);
+    }
+
+    const std::string begin_prefix = std::string(JOURNAL_RECORD_BEGIN_LINE) + " ";
+    const std::uint64_t checkpoint_sequence = journal_sequence_;
+    std::vector<std::string> record{};
+    std::optional<std::uint64_t> record_sequence{};
+    std::uint64_t read_bytes = 0;
+    std::uint64_t valid_bytes = 0;
+    std::string line;
+    while (file_ops_->getline(*strm, line)) {
+        if (file_ops_->is_eof(*strm)) {
+            break;  // the last line is not terminated, so the record holding it is torn
+        }
+        read_bytes += line.size() + 1;
+        if (line.rfind(begin_prefix, 0) == 0) {
+            record.clear();
+            std::istringstream iss(line.substr(begin_prefix.size()));
+            std::uint64_t sequence = 0;
+            if (iss >> sequence) {
+                record_sequence = sequence;
+            } else {
+                record_sequence.reset();
+            }
+        } else if (line == JOURNAL_RECORD_END_LINE) {
+            if (record_sequence && *record_sequence > checkpoint_sequence) {
+                for (const auto& entry : record) {
+                    apply_journal_entry(entry);
+                }
+                journal_sequence_ = std::max(journal_sequence_, *record_sequence);
+            }
+            record.clear();
+            record_sequence.reset();
+            valid_bytes = read_bytes;
+        } else if (record_sequence) {
+            record.emplace_back(line);
+        }
+    }
+    if (!file_ops_->is_eof(*strm) && file_ops_->has_error(*strm)) {
+        error_num = errno;
+        LOG_AND_THROW_IO_EXCEPTION("Failed to read line from file", error_num);
+    }
+    strm.reset();
+
+    std::uint64_t file_bytes = boost::filesystem::file_size(journal_file_path_, ec);
+    if (!ec && file_bytes > valid_bytes) {
+        LOG_LP(WARNING) << "discarding the incomplete record at the end of " << journal_file_path_.string()
+                        << ", " << (file_bytes - valid_bytes) << " bytes";
+        boost::filesystem::resize_file(journal_file_path_, valid_bytes, ec);
+        if (ec) {
+            LOG_AND_THROW_IO_EXCEPTION("Failed to truncate compaction catalog journal: " + journal_file_path_.string(), ec.value());
+        }
+    }
+    journal_bytes_ = valid_bytes;
+}
+
+void compaction_catalog::apply_journal_entry(const std::string& line) {
+    std::istringstream iss(line);
+    std::string type;
+    if (!(iss >> type)) {
+        return;
+    }
+    if (type == REMOVED_COMPACTED_FILE_KEY) {
+        std::string file_name;
+        int version = 0;
+        if (!(iss >> file_name >> version)) {
+            LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(REMOVED_COMPACTED_FILE_KEY) + ": " + line);
+        }
+        compacted_files_.erase({file_name, version});
+    } else if (type == REMOVED_DETACHED_PWAL_KEY) {
+        std::string pwal;
+        if (!(iss >> pwal)) {
+            LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(REMOVED_DETACHED_PWAL_KEY) + ": " + line);
+        }
+        detached_pwals_.erase(pwal);
+    } else {
+        bool max_epoch_id_found = false;
+        parse_catalog_entry(line, max_epoch_id_found);
+    }
 }
 
 void compaction_catalog::restore_from_backup() {
@@ -109,6 +215,7 @@ void compaction_catalog::load_catalog_file(const boost::filesystem::path& path)
     if (line != HEADER_LINE) {
         LOG_AND_THROW_EXCEPTION("Invalid header line: " + line);
     }
+    journal_sequence_ = 0;
 
     bool max_epoch_id_found = false;
     while (true) {
@@ -145,14 +252,15 @@ void compaction_catalog::parse_catalog_entry(const std::string& line, bool& max_
         std::string file_name;
         int version = 0;
         if (iss >> file_name >> version) {
-            compacted_files_.insert({file_name, version});
+            compacted_files_.emplace_hint(compacted_files_.end(), file_name, version);
         } else {
             LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(COMPACTED_FILE_KEY) + ": " + line);
         }
     } else if (type == DETACHED_PWAL_KEY) {
         std::string pwal;
         if (iss >> pwal) {
-            detached_pwals_.insert(pwal);
+            // the catalog file lists them in order, so the hint makes loading a long list linear
+            detached_pwals_.emplace_hint(detached_pwals_.end(), std::move(pwal));
         } else {
             LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(DETACHED_PWAL_KEY) + ": " + line);
         }
@@ -171,6 +279,13 @@ void compaction_catalog::parse_catalog_entry(const std::string& line, bool& max_
         } else {
             LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(MAX_BLOB_ID_KEY) + ": " + line);
         }
+    } else if (type == JOURNAL_SEQUENCE_KEY) {
+        std::uint64_t sequence = 0;
+        if (iss >> sequence) {
+            journal_sequence_ = sequence;
+        } else {
+            LOG_AND_THROW_EXCEPTION("Invalid format for " + std::string(JOURNAL_SEQUENCE_KEY) + ": " + line);
+        }
     }
     else {
         LOG_AND_THROW_EXCEPTION("Unknown entry type: " + type);
@@ -180,12 +295,45 @@ void compaction_catalog::parse_catalog_entry(const std::string& line, bool& max_
 
 // Method to update the compaction catalog
 void compaction_catalog::update_catalog_file(epoch_id_type max_epoch_id, blob_id_type max_blob_id, const std::set<compacted_file_info>& compacted_files, const std::set<std::string>& detached_pwals) {
-    // Update internal state
+    changes delta{};
+    std::set_difference(compacted_files_.begin(), compacted_files_.end(), compacted_files.begin(), compacted_files.end(),
+                        std::inserter(delta.removed_files, delta.removed_files.end()));
+    std::set_difference(compacted_files.begin(), compacted_files.end(), compacted_files_.begin(), compacted_files_.end(),
+                        std::inserter(delta.added_files, delta.added_files.end()));
+    std::set_difference(detached_pwals_.begin(), detached_pwals_.end(), detached_pwals.begin(), detached_pwals.end(),
+                        std::inserter(delta.removed_pwals, delta.removed_pwals.end()));
+    std::set_difference(detached_pwals.begin(), detached_pwals.end(), detached_pwals_.begin(), detached_pwals_.end(),
+                        std::inserter(delta.added_pwals, delta.added_pwals.end()));
+    update_catalog_file(max_epoch_id, max_blob_id, delta);
+}
+
+void compaction_catalog::update_catalog_file(epoch_id_type max_epoch_id, blob_id_type max_blob_id, const changes& delta) {
+    std::string record = create_journal_record(journal_sequence_ + 1, max_epoch_id, max_blob_id, delta);
+
+    // Update internal state, in the same order as the journal record is replayed
     max_epoch_id_ = max_epoch_id;
     max_blob_id_ = max_blob_id;
-    compacted_files_ = compacted_files;
-    detached_pwals_ = detached_pwals;
+    for (const auto& file_info : delta.removed_files) {
+        compacted_files_.erase(file_info);
+    }
+    compacted_files_.insert(delta.added_files.begin(), delta.added_files.end());
+    for (const auto& pwal : delta.removed_pwals) {
+        detached_pwals_.erase(pwal);
+    }
+    detached_pwals_.insert(delta.added_pwals.begin(), delta.added_pwals.end());
+
+    if (has_checkpoint_ && checkpoint_bytes_ >= journal_min_checkpoint_bytes_
+        && journal_bytes_ + record.size() <= checkpoint_bytes_) {
+        write_file(journal_file_path_, "a", record);
+        journal_sequence_++;
+        journal_bytes_ += record.size();
+        return;
+    }
+    write_checkpoint();
+}
 
+// Rewrites the catalog file, which then includes every journal record, and removes the journal
+void compaction_catalog::write_checkpoint() {
     // Create the catalog using std::string
     std::string catalog = create_catalog_content();
 
@@ -201,7 +349,30 @@ void compaction_catalog::update_catalog_file(epoch_id_type max_epoch_id, blob_id
         LOG_AND_THROW_IO_EXCEPTION("Error checking catalog file existence", ec.value());
     }
 
-    // Open the new catalog file using fopen and manage it with std::unique_ptr
+    write_file(catalog_file_path_, "w", catalog);
+    checkpoint_bytes_ = catalog.size();
+    has_checkpoint_ = true;
+
+    // the records left by a crash before this removal are skipped by their sequence numbers
+    remove_journal();
+}
+
+void compaction_catalog::remove_journal() {
+    boost::system::error_code ec;
+    if (file_ops_->exists(journal_file_path_, ec)) {
+        if (file_ops_->unlink(journal_file_path_.c_str()) != 0) {
+            int error_num = errno;
+            LOG_AND_THROW_IO_EXCEPTION("Failed to remove compaction catalog journal: " + journal_file_path_.string(), error_num);
+        }
+    } else if (ec && ec != boost::system::errc::no_such_file_or_directory) {
+        LOG_AND_THROW_IO_EXCEPTION("Error checking journal file existence", ec.value());
+    }
+    journal_bytes_ = 0;
+}
+
+// Writes the content to the file opened in the given mode, and syncs it to disk
+void compaction_catalog::write_file(const boost::filesystem::path& path, const char* mode, const std::string& content) {
+    // Open the file using fopen and manage it with std::unique_ptr
     auto file_closer = [this](FILE* file) {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
         if (file && file_ops_->fclose(file) != 0) {
@@ -210,26 +381,26 @@ void compaction_catalog::update_catalog_file(epoch_id_type max_epoch_id, blob_id
             LOG_LP(ERROR) << "fclose failed for file, errno = " << error_num;
         }
     };
-    std::unique_ptr<FILE, decltype(file_closer)> file_ptr(file_ops_->fopen(catalog_file_path_.c_str(), "w"), file_closer);
+    std::unique_ptr<FILE, decltype(file_closer)> file_ptr(file_ops_->fopen(path.c_str(), mode), file_closer);
 
     if (!file_ptr) {
         int error_num = errno;
-        LOG_AND_THROW_IO_EXCEPTION("Failed to open compaction catalog file: " + catalog_file_path_.string(), error_num);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to open compaction catalog file: " + path.string(), error_num);
     }
 
     // Write the data to the file using fwrite
     size_t total_written = 0;
-    size_t catalog_size = catalog.size();
-    while (total_written < catalog_size) {
-        size_t remaining_size = catalog_size - total_written;
-        std::string chunk = catalog.substr(total_written, remaining_size);  
+    size_t content_size = content.size();
+    while (total_written < content_size) {
+        size_t remaining_size = content_size - total_written;
+        std::string chunk = content.substr(total_written, remaining_size);
         size_t written = file_ops_->fwrite(chunk.data(), 1, remaining_size, file_ptr.get());
         int error_num = errno;
         if (written == 0) {
             if (file_ops_->ferror(file_ptr.get()) != 0) {
-                LOG_AND_THROW_IO_EXCEPTION("Failed to write complete data to compaction catalog file '" + catalog_file_path_.string() + "'", error_num);
+                LOG_AND_THROW_IO_EXCEPTION("Failed to write complete data to compaction catalog file '" + path.string() + "'", error_num);
             }
-            LOG_AND_THROW_EXCEPTION("Failed to write complete data to compaction catalog file '" + catalog_file_path_.string() + "'");
+            LOG_AND_THROW_EXCEPTION("Failed to write complete data to compaction catalog file '" + path.string() + "'");
         }
         total_written += written;
     }
@@ -237,23 +408,56 @@ void compaction_catalog::update_catalog_file(epoch_id_type max_epoch_id, blob_id
     // Perform fflush to ensure all data is written to the file
     if (file_ops_->fflush(file_ptr.get()) != 0) {
         int error_num = errno;
-        LOG_AND_THROW_IO_EXCEPTION("Failed to flush the output buffer to file '" + catalog_file_path_.string() + "'", error_num);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to flush the output buffer to file '" + path.string() + "'", error_num);
     }
 
     // Perform fsync to ensure data is written to disk
     int fd = file_ops_->fileno(file_ptr.get());
     if (fd == -1) {
         int error_num = errno;
-        LOG_AND_THROW_IO_EXCEPTION("Failed to get file descriptor for file '" + catalog_file_path_.string() + "'", error_num);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to get file descriptor for file '" + path.string() + "'", error_num);
     }
     if (file_ops_->fsync(fd) != 0) {
         int error_num = errno;
-        LOG_AND_THROW_IO_EXCEPTION("Failed to fsync compaction catalog file '" + catalog_file_path_.string() + "'", error_num);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to fsync compaction catalog file '" + path.string() + "'", error_num);
     }
 
     // The file will be automatically closed by unique_ptr when going out of scope
 }
 
+// Helper function to create a journal record of the given changes; the removals are replayed before the additions
+std::string compaction_catalog::create_journal_record(std::uint64_t sequence, epoch_id_type max_epoch_id, blob_id_type max_blob_id,
+                                                      const changes& delta) {
+    std::string record;
+    record += JOURNAL_RECORD_BEGIN_LINE;
+    record += " " + std::to_string(sequence) + "\n";
+
+    for (const auto &file_info : delta.removed_files) {
+        record += REMOVED_COMPACTED_FILE_KEY;
+        record += " " + file_info.get_file_name() + " " + std::to_string(file_info.get_version()) + "\n";
+    }
+    for (const auto &file_info : delta.added_files) {
+        record += COMPACTED_FILE_KEY;
+        record += " " + file_info.get_file_name() + " " + std::to_string(file_info.get_version()) + "\n";
+    }
+    for (const auto &pwal : delta.removed_pwals) {
+        record += REMOVED_DETACHED_PWAL_KEY;
+        record += " " + pwal + "\n";
+    }
+    for (const auto &pwal : delta.added_pwals) {
+        record += DETACHED_PWAL_KEY;
+        record += " " + pwal + "\n";
+    }
+
+    record += MAX_EPOCH_ID_KEY;
+    record += " " + std::to_string(max_epoch_id) + "\n";
+    record += MAX_BLOB_ID_KEY;
+    record += " " + std::to_string(max_blob_id) + "\n";
+    record += JOURNAL_RECORD_END_LINE;
+    record += "\n";
+    return record;
+}
+
 
 
 // Helper function to create the catalog content from instance fields
@@ -283,6 +487,12 @@ std::string compaction_catalog::create_catalog_content() const {
     catalog += " " + std::to_string(max_blob_id_);
     catalog += "\n";
 
+    if (journal_sequence_ > 0) {
+        catalog += JOURNAL_SEQUENCE_KEY;
+        catalog += " " + std::to_string(journal_sequence_);
+        catalog += "\n";
+    }
+
     catalog += FOOTER_LINE;
     catalog += "\n";
 
@@ -307,6 +517,86 @@ const std::set<std::string>& compaction_catalog::get_detached_pwals() const {
     return detached_pwals_;
 }
 
+std::vector<std::string> compaction_catalog::get_compacted_generations() const {
+    std::vector<std::pair<std::pair<std::uint64_t, std::size_t>, std::string>> generations;
+    for (const auto &file_info : compacted_files_) {
+        if (auto id = parse_compacted_filename(file_info.get_file_name()); id) {
+            generations.emplace_back(*id, file_info.get_file_name());
+        }
+    }
+    std::sort(generations.begin(), generations.end(), [](const auto &a, const auto &b) {
+        if (a.first.first != b.first.first) {
+            return a.first.first > b.first.first;
+        }
+        return a.first.second < b.first.second;
+    });
+    std::vector<std::string> names;
+    names.reserve(generations.size());
+    for (auto &generation : generations) {
+        names.emplace_back(std::move(generation.second));
+    }
+    return names;
+}
+
+std::string compaction_catalog::get_compacted_filename(std::uint64_t generation) {
+    if (generation == 0) {
+        return COMPACTED_FILENAME;
+    }
+    return std::string(COMPACTED_FILENAME) + "." + std::to_string(generation);
+}
+
+std::string compaction_catalog::get_compacted_filename(std::uint64_t generation, std::size_t shard) {
+    if (shard == 0) {
+        return get_compacted_filename(generation);
+    }
+    return std::string(COMPACTED_FILENAME) + "." + std::to_string(generation) + "." + std::to_string(shard);
+}
+
+namespace {
+
+// parses a decimal number written without leading zeros
+std::optional<std::uint64_t> parse_number(const std::string &str) {
+    if (str.empty() || str.size() > 19 || (str[0] == '0' && str.size() > 1)
+        || !std::all_of(str.begin(), str.end(), [](unsigned char c) { return std::isdigit(c) != 0; })) {
+        return std::nullopt;
+    }
+    return std::stoull(str);
+}
+
+}  // namespace
+
+std::optional<std::pair<std::uint64_t, std::size_t>> compaction_catalog::parse_compacted_filename(const std::string &file_name) {
+    const std::string base = COMPACTED_FILENAME;
+    if (file_name == base) {
+        return std::make_pair(std::uint64_t{0}, std::size_t{0});
+    }
+    if (file_name.size() <= base.size() + 1 || file_name.compare(0, base.size(), base) != 0 || file_name[base.size()] != '.') {
+        return std::nullopt;
+    }
+    std::string suffix = file_name.substr(base.size() + 1);
+    auto dot = suffix.find('.');
+    auto generation = parse_number(suffix.substr(0, dot));
+    if (!generation) {
+        return std::nullopt;
+    }
+    if (dot == std::string::npos) {
+        // generation 0 is never suffixed
+        return *generation == 0 ? std::nullopt : std::optional(std::make_pair(*generation, std::size_t{0}));
+    }
+    auto shard = parse_number(suffix.substr(dot + 1));
+    if (!shard || *shard == 0) {
+        return std::nullopt;
+    }
+    return std::make_pair(*generation, static_cast<std::size_t>(*shard));
+}
+
+std::optional<std::uint64_t> compaction_catalog::get_compacted_generation(const std::string &file_name) {
+    if (auto id = parse_compacted_filename(file_name); id) {
+        return id->first;
+    }
+    return std::nullopt;
+}
+
 // for Unit Testing
 
 void compaction_catalog::set_file_operations(std::unique_ptr<file_operations> file_ops) {
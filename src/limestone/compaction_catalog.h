@@ -18,9 +18,12 @@
 #define COMPACTION_CATALOG_H
 
 #include <boost/filesystem.hpp>
+#include <cstdint>
+#include <optional>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "limestone/api/epoch_id_type.h"
 #include "limestone/api/blob_id_type.h"
@@ -101,6 +104,12 @@ public:
  * This class handles the cataloging of compacted files within a specific directory.
  * It provides methods for updating, loading, and retrieving information about
  * the results of the compaction process.
+ *
+ * The catalog is stored as a checkpoint file holding the whole catalog, followed by a journal
+ * file holding the changes made since the checkpoint. An update appends only its changes to
+ * the journal, and the checkpoint is rewritten (and the journal removed) when the journal
+ * would grow larger than the checkpoint, so that the cost of an update stays proportional to
+ * its changes. Small catalogs are always rewritten.
  */
 class compaction_catalog {
 public:
@@ -135,7 +144,7 @@ public:
      * @brief Updates the compaction catalog and writes the changes to a file.
      * 
      * This method updates the catalog with new compacted files, detached PWALs, the maximum epoch ID,
-     * and the maximum blob ID, then writes the updated catalog to a file.
+     * and the maximum blob ID, then appends the changes to the journal or rewrites the checkpoint.
      * 
      * @param max_epoch_id The maximum epoch ID to be recorded in the catalog.
      * @param max_blob_id The maximum blob ID to be recorded in the catalog.
@@ -145,6 +154,27 @@ public:
     void update_catalog_file(epoch_id_type max_epoch_id, blob_id_type max_blob_id, const std::set<compacted_file_info> &compacted_files,
                         const std::set<std::string> &detached_pwals);
 
+    /**
+     * @brief The changes made to the compacted files and the detached PWALs by an update.
+     * @details The removals are applied before the additions, so an entry can be in both to be replaced.
+     */
+    struct changes {
+        std::set<compacted_file_info> added_files{};
+        std::set<compacted_file_info> removed_files{};
+        std::set<std::string> added_pwals{};
+        std::set<std::string> removed_pwals{};
+    };
+
+    /**
+     * @brief Updates the compaction catalog by the given changes and writes them to a file.
+     * @details Unlike the overload taking the whole sets, the cost of the journal record depends only on the changes,
+     *          not on the number of files in the catalog.
+     * @param max_epoch_id The maximum epoch ID to be recorded in the catalog.
+     * @param max_blob_id The maximum blob ID to be recorded in the catalog.
+     * @param delta The compacted files and detached PWALs added to and removed from the catalog.
+     */
+    void update_catalog_file(epoch_id_type max_epoch_id, blob_id_type max_blob_id, const changes &delta);
+
     /**
      * @brief Gets the maximum epoch ID from the catalog.
      * 
@@ -173,6 +203,14 @@ public:
      */
     [[nodiscard]] const std::set<std::string> &get_detached_pwals() const;
 
+    /**
+     * @brief Gets the names of the compacted files, ordered from the newest generation to the oldest,
+     *        and by shard number within a generation.
+     *
+     * @return std::vector<std::string> The names of the compacted files.
+     */
+    [[nodiscard]] std::vector<std::string> get_compacted_generations() const;
+
     /**
      * @brief Returns the filename of the compaction catalog.
      *
@@ -180,6 +218,13 @@ public:
      */
     [[nodiscard]] static inline std::string get_catalog_filename() { return COMPACTION_CATALOG_FILENAME; }
 
+    /**
+     * @brief Returns the filename of the compaction catalog journal.
+     *
+     * @return The filename of the journal holding the changes made since the catalog file was written.
+     */
+    [[nodiscard]] static inline std::string get_journal_filename() { return COMPACTION_CATALOG_JOURNAL_FILENAME; }
+
     /**
      * @brief Retrieves the name of the compaction temporary directory.
      *
@@ -194,6 +239,46 @@ public:
      */
     [[nodiscard]] static inline std::string get_compacted_filename() { return COMPACTED_FILENAME; }
 
+    /**
+     * @brief Retrieves the filename of the compacted file of the specified generation.
+     *
+     * Generation 0 is the oldest generation, stored as pwal_0000.compacted itself;
+     * newer generations are stored as pwal_0000.compacted.<generation>.
+     *
+     * @param generation The generation of the compacted file.
+     * @return A string containing the compacted filename.
+     */
+    [[nodiscard]] static std::string get_compacted_filename(std::uint64_t generation);
+
+    /**
+     * @brief Retrieves the filename of a shard of the compacted file of the specified generation.
+     *
+     * A generation may be split into several shards covering disjoint key ranges.
+     * Shard 0 is stored under the name of the generation itself (see get_compacted_filename(std::uint64_t));
+     * the other shards are stored as pwal_0000.compacted.<generation>.<shard>.
+     *
+     * @param generation The generation of the compacted file.
+     * @param shard The shard number in the generation.
+     * @return A string containing the compacted filename.
+     */
+    [[nodiscard]] static std::string get_compacted_filename(std::uint64_t generation, std::size_t shard);
+
+    /**
+     * @brief Parses the generation and the shard number of a compacted filename.
+     *
+     * @param file_name The filename to parse.
+     * @return The generation and the shard number, or std::nullopt if the filename is not that of a compacted file.
+     */
+    [[nodiscard]] static std::optional<std::pair<std::uint64_t, std::size_t>> parse_compacted_filename(const std::string &file_name);
+
+    /**
+     * @brief Parses the generation of a compacted filename.
+     *
+     * @param file_name The filename to parse.
+     * @return The generation, or std::nullopt if the filename is not that of a compacted file.
+     */
+    [[nodiscard]] static std::optional<std::uint64_t> get_compacted_generation(const std::string &file_name);
+
     /**
      * @brief Retrieves the filename of the compacted file's backup.
      *
@@ -211,6 +296,12 @@ private:
     static constexpr const char *DETACHED_PWAL_KEY = "DETACHED_PWAL";                             ///< Key for detached PWALs in the catalog file
     static constexpr const char *MAX_EPOCH_ID_KEY = "MAX_EPOCH_ID";                               ///< Key for maximum epoch ID in the catalog file
     static constexpr const char *MAX_BLOB_ID_KEY = "MAX_BLOB_ID";                                 ///< Key for maximum blob ID in the catalog file
+    static constexpr const char *JOURNAL_SEQUENCE_KEY = "JOURNAL_SEQUENCE";                       ///< Key for the last journal record included in the catalog file
+    static constexpr const char *COMPACTION_CATALOG_JOURNAL_FILENAME = "compaction_catalog.journal";  ///< Name of the journal file
+    static constexpr const char *JOURNAL_RECORD_BEGIN_LINE = "COMPACTION_CATALOG_DELTA";          ///< First line of a journal record, followed by its sequence number
+    static constexpr const char *JOURNAL_RECORD_END_LINE = "COMPACTION_CATALOG_DELTA_END";        ///< Last line of a journal record
+    static constexpr const char *REMOVED_COMPACTED_FILE_KEY = "REMOVED_COMPACTED_FILE";           ///< Key for compacted files removed in a journal record
+    static constexpr const char *REMOVED_DETACHED_PWAL_KEY = "REMOVED_DETACHED_PWAL";             ///< Key for detached PWALs removed in a journal record
     static constexpr const char *COMPACTION_TEMP_DIRNAME = "compaction_temp";                     ///< Name of the temporary directory for compaction
     static constexpr const char *COMPACTED_FILENAME = "pwal_0000.compacted";                      ///< Prefix for temporary compaction files
     static constexpr const char *COMPACTED_BACKUP_FILENAME = "pwal_0000.compacted.prev";          ///< Extension for temporary compaction files
@@ -232,6 +323,13 @@ private:
     // needed for database startup or recovery, and can be safely deleted.
     boost::filesystem::path backup_file_path_;
 
+    boost::filesystem::path journal_file_path_;
+
+    std::uint64_t journal_sequence_ = 0;    ///< Sequence number of the last journal record applied
+    std::uint64_t journal_bytes_ = 0;       ///< Size of the journal file
+    std::uint64_t checkpoint_bytes_ = 0;    ///< Size of the catalog file
+    bool has_checkpoint_ = false;           ///< Whether the catalog file holds the state this object was loaded from or wrote
+
 protected:    
     // Helper methods 
     void load();
@@ -239,6 +337,16 @@ protected:
     void load_catalog_file(const boost::filesystem::path &directory_path);
     void parse_catalog_entry(const std::string& line, bool& max_epoch_id_found);
     [[nodiscard]] std::string create_catalog_content() const;
+    void replay_journal();
+    void apply_journal_entry(const std::string& line);
+    [[nodiscard]] static std::string create_journal_record(std::uint64_t sequence, epoch_id_type max_epoch_id, blob_id_type max_blob_id,
+                                                           const changes &delta);
+    void write_checkpoint();
+    void remove_journal();
+    void write_file(const boost::filesystem::path& path, const char* mode, const std::string& content);
+
+    /// the journal is used only when the catalog file is at least this large
+    std::uint64_t journal_min_checkpoint_bytes_ = 64UL * 1024UL;
 
     // for only testing
     void set_file_operations(std::unique_ptr<file_operations> file_ops);
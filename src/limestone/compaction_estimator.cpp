@@ -0,0 +1,303 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "compaction_estimator.h"
+
+#include <cstring>
+#include <mutex>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "blob_file_resolver.h"
+#include "compaction_catalog.h"
+#include "dblog_scan.h"
+#include "limestone_exception_helper.h"
+#include "log_entry.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+// the latest version of a key in the sampled files
+struct key_version {
+    write_version_type version{};
+    std::uint64_t bytes{0};
+    bool removed{false};
+    std::vector<blob_id_type> blob_ids{};
+};
+
+storage_id_type storage_of(std::string_view key_sid) {
+    storage_id_type st_bytes = 0;
+    memcpy(static_cast<void*>(&st_bytes), key_sid.data(), sizeof(storage_id_type));
+    return le64toh(st_bytes);
+}
+
+std::uint64_t scale(std::uint64_t value, std::uint64_t numerator, std::uint64_t denominator) {
+    if (denominator == 0 || numerator == denominator) {
+        return value;
+    }
+    return static_cast<std::uint64_t>(static_cast<double>(value) * static_cast<double>(numerator) / static_cast<double>(denominator));
+}
+
+}  // namespace
+
+double compaction_estimate::dead_ratio() const noexcept {
+    storage_estimate total{};
+    for (const auto& [storage_id, storage] : storages) {
+        total.versions += storage.versions;
+        total.live_versions += storage.live_versions;
+    }
+    return total.dead_ratio();
+}
+
+std::chrono::seconds compaction_estimate::projected_duration(std::uint64_t bytes_per_second) const noexcept {
+    std::uint64_t bandwidth = bytes_per_second != 0 ? bytes_per_second : measured_bytes_per_second;
+    if (bandwidth == 0) {
+        return std::chrono::seconds(0);
+    }
+    return std::chrono::seconds((projected_io_bytes() + bandwidth - 1) / bandwidth);
+}
+
+std::ostream& operator<<(std::ostream& out, const compaction_estimate& estimate) {
+    out << "input-files: " << estimate.input_files << '\n'
+        << "input-bytes: " << estimate.input_bytes << '\n'
+        << "sampled-files: " << estimate.sampled_files << '\n'
+        << "sampled-bytes: " << estimate.sampled_bytes << '\n'
+        << "estimated-output-bytes: " << estimate.estimated_output_bytes << '\n'
+        << "reclaimable-blob-files: " << estimate.reclaimable_blob_files << '\n'
+        << "reclaimable-blob-bytes: " << estimate.reclaimable_blob_bytes << '\n'
+        << "measured-read-bytes-per-second: " << estimate.measured_bytes_per_second << '\n'
+        << "untracked-versions: " << estimate.untracked_versions << '\n'
+        << "projected-duration-seconds: " << estimate.projected_duration().count() << '\n';
+    for (const auto& [storage_id, storage] : estimate.storages) {
+        out << "storage-" << storage_id << ": versions=" << storage.versions
+            << ", live-versions=" << storage.live_versions
+            << ", bytes=" << storage.bytes
+            << ", live-bytes=" << storage.live_bytes
+            << ", dead-ratio=" << storage.dead_ratio() << '\n';
+    }
+    return out;
+}
+
+std::set<std::string> compaction_estimator::select_samples(const std::map<std::string, std::uint64_t>& files, std::uint64_t sample_bytes) {
+    std::uint64_t total = 0;
+    for (const auto& [name, size] : files) {
+        total += size;
+    }
+    std::set<std::string> selected{};
+    if (sample_bytes == 0 || total <= sample_bytes) {
+        for (const auto& [name, size] : files) {
+            selected.insert(name);
+        }
+        return selected;
+    }
+    // a file is taken whenever the selected size falls behind the sampling ratio of the files seen so far
+    std::uint64_t seen = 0;
+    std::uint64_t taken = 0;
+    for (const auto& [name, size] : files) {
+        seen += size;
+        if (static_cast<double>(taken) < static_cast<double>(seen) * static_cast<double>(sample_bytes) / static_cast<double>(total)) {
+            selected.insert(name);
+            taken += size;
+        }
+    }
+    return selected;
+}
+
+compaction_estimate compaction_estimator::estimate() {
+    const auto& from_dir = options_.get_from_dir();
+    std::map<std::string, std::uint64_t> files{};
+    auto add_file = [&files, &from_dir](const std::string& name) {
+        boost::system::error_code error;
+        auto size = boost::filesystem::file_size(from_dir / name, error);
+        if (!error) {
+            files.emplace(name, size);
+        }
+    };
+    if (options_.has_file_set()) {
+        for (const auto& name : options_.get_file_names()) {
+            add_file(name);
+        }
+    } else {
+        boost::system::error_code error;
+        boost::filesystem::directory_iterator it(from_dir, error);
+        if (error) {
+            LOG_AND_THROW_IO_EXCEPTION("Failed to access directory: " + from_dir.string(), error);
+        }
+        for (; it != boost::filesystem::directory_iterator(); it.increment(error)) {
+            if (error) {
+                LOG_AND_THROW_IO_EXCEPTION("Failed to iterate directory: " + from_dir.string(), error);
+            }
+            if (dblog_scan::is_wal(it->path()) && boost::filesystem::is_regular_file(it->path())) {
+                add_file(it->path().filename().string());
+            }
+        }
+    }
+
+    compaction_estimate result{};
+    result.input_files = files.size();
+    for (const auto& [name, size] : files) {
+        result.input_bytes += size;
+    }
+    std::set<std::string> samples = select_samples(files, sample_bytes_);
+    result.sampled_files = samples.size();
+    for (const auto& name : samples) {
+        result.sampled_bytes += files[name];
+    }
+    if (samples.empty()) {
+        return result;
+    }
+
+    std::mutex mtx{};
+    std::map<std::string, key_version> keys{};
+    std::map<storage_id_type, write_version_type> cleared{};
+    std::set<blob_id_type> referenced_blob_ids{};
+    std::uint64_t untracked_live_bytes = 0;
+    auto add_entry = [&](log_entry& e) {
+        std::lock_guard<std::mutex> lock(mtx);
+        switch (e.type()) {
+        case log_entry::entry_type::normal_entry:
+        case log_entry::entry_type::normal_with_blob:
+        case log_entry::entry_type::remove_entry: {
+            write_version_type wv;
+            e.write_version(wv);
+            std::uint64_t bytes = e.key_sid().size() + e.value_etc().size();
+            auto& storage = result.storages[storage_of(e.key_sid())];
+            storage.versions++;
+            storage.bytes += bytes;
+            auto it = keys.find(e.key_sid());
+            if (it == keys.end() && keys.size() >= max_keys_) {
+                // without the latest version of the key, the version is taken as live
+                result.untracked_versions++;
+                if (e.type() != log_entry::entry_type::remove_entry) {
+                    storage.live_versions++;
+                    storage.live_bytes += bytes;
+                    untracked_live_bytes += bytes;
+                }
+                break;
+            }
+            std::vector<blob_id_type> blob_ids{};
+            if (e.type() == log_entry::entry_type::normal_with_blob) {
+                blob_ids = e.get_blob_ids();
+                referenced_blob_ids.insert(blob_ids.begin(), blob_ids.end());
+            }
+            bool inserted = it == keys.end();
+            if (inserted) {
+                it = keys.emplace(e.key_sid(), key_version{}).first;
+            }
+            if (inserted || it->second.version < wv) {
+                it->second = key_version{wv, bytes, e.type() == log_entry::entry_type::remove_entry, std::move(blob_ids)};
+            }
+            break;
+        }
+        case log_entry::entry_type::clear_storage:
+        case log_entry::entry_type::remove_storage: {
+            write_version_type wv;
+            e.write_version(wv);
+            auto [it, inserted] = cleared.try_emplace(e.storage(), wv);
+            if (!inserted && it->second < wv) {
+                it->second = wv;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    };
+
+    compaction_options sample_options(from_dir, options_.get_num_worker(), samples);
+    dblog_scan logscan{from_dir, sample_options};
+    logscan.set_thread_num(options_.get_num_worker());
+    auto start = std::chrono::steady_clock::now();
+    logscan.scan_pwal_files_throws(logscan.last_durable_epoch_in_dir(), add_entry);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed > 0) {
+        result.measured_bytes_per_second = static_cast<std::uint64_t>(static_cast<double>(result.sampled_bytes) / elapsed);
+    }
+
+    std::uint64_t live_bytes = untracked_live_bytes;
+    std::set<blob_id_type> live_blob_ids{};
+    for (const auto& [key_sid, latest] : keys) {
+        storage_id_type st = storage_of(key_sid);
+        if (latest.removed) {
+            continue;
+        }
+        if (auto it = cleared.find(st); it != cleared.end() && latest.version < it->second) {
+            continue;
+        }
+        auto& storage = result.storages[st];
+        storage.live_versions++;
+        storage.live_bytes += latest.bytes;
+        live_bytes += latest.bytes;
+        live_blob_ids.insert(latest.blob_ids.begin(), latest.blob_ids.end());
+    }
+    result.estimated_output_bytes = scale(live_bytes, result.input_bytes, result.sampled_bytes);
+
+    blob_file_resolver resolver(from_dir);
+    std::uint64_t reclaimable_files = 0;
+    std::uint64_t reclaimable_bytes = 0;
+    for (const auto& blob_id : referenced_blob_ids) {
+        if (live_blob_ids.find(blob_id) != live_blob_ids.end()) {
+            continue;
+        }
+        boost::system::error_code error;
+        auto size = boost::filesystem::file_size(resolver.resolve_path(blob_id), error);
+        if (!error) {
+            reclaimable_files++;
+            reclaimable_bytes += size;
+        }
+    }
+    result.reclaimable_blob_files = scale(reclaimable_files, result.input_bytes, result.sampled_bytes);
+    result.reclaimable_blob_bytes = scale(reclaimable_bytes, result.input_bytes, result.sampled_bytes);
+
+    VLOG_LP(log_info) << "compaction estimate: sampled " << result.sampled_bytes << " of " << result.input_bytes
+                      << " bytes, estimated output " << result.estimated_output_bytes << " bytes";
+    if (result.untracked_versions > 0) {
+        VLOG_LP(log_info) << "compaction estimate: " << result.untracked_versions << " versions of the keys beyond the first "
+                          << max_keys_ << " were counted as live";
+    }
+    return result;
+}
+
+compaction_estimate estimate_online_compaction(const boost::filesystem::path& location, const compaction_catalog& catalog,
+                                               int num_worker, std::uint64_t sample_bytes) {
+    const std::set<std::string>& detached_pwals = catalog.get_detached_pwals();
+    std::set<std::string> file_names{};
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator it(location, error);
+    if (error) {
+        LOG_AND_THROW_IO_EXCEPTION("Failed to access directory: " + location.string(), error);
+    }
+    for (; it != boost::filesystem::directory_iterator(); it.increment(error)) {
+        if (error) {
+            LOG_AND_THROW_IO_EXCEPTION("Failed to iterate directory: " + location.string(), error);
+        }
+        std::string filename = it->path().filename().string();
+        if (!dblog_scan::is_detached_wal(it->path()) || filename.rfind(compaction_catalog::get_compacted_filename(), 0) == 0
+            || detached_pwals.find(filename) != detached_pwals.end()) {
+            continue;
+        }
+        file_names.insert(filename);
+    }
+    compaction_options options(location, num_worker, std::move(file_names));
+    compaction_estimator estimator(options, sample_bytes);
+    return estimator.estimate();
+}
+
+}  // namespace limestone::internal
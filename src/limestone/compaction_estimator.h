@@ -0,0 +1,165 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/storage_id_type.h>
+#include "compaction_options.h"
+
+namespace limestone::internal {
+
+class compaction_catalog;
+
+using limestone::api::storage_id_type;
+
+/**
+ * @brief Result of compaction_estimator::estimate().
+ * @details The counts are those of the sampled WAL files; the sizes marked as estimated are
+ *          extrapolated to all the WAL files by the ratio of the sampled size to the total size.
+ */
+struct compaction_estimate {
+    /**
+     * @brief Versions of one storage in the sampled WAL files.
+     */
+    struct storage_estimate {
+        /// entries (normal and remove) read
+        std::uint64_t versions{0};
+        /// the latest normal entries of the keys, which compaction keeps
+        std::uint64_t live_versions{0};
+        /// size of the entries read
+        std::uint64_t bytes{0};
+        /// size of the live entries
+        std::uint64_t live_bytes{0};
+
+        [[nodiscard]] double dead_ratio() const noexcept {
+            return versions == 0 ? 0.0 : static_cast<double>(versions - live_versions) / static_cast<double>(versions);
+        }
+    };
+
+    /// total size of the WAL files compaction would read
+    std::uint64_t input_bytes{0};
+    /// size of the WAL files read for the estimate
+    std::uint64_t sampled_bytes{0};
+    /// number of the WAL files, and of those read for the estimate
+    std::size_t input_files{0};
+    std::size_t sampled_files{0};
+    /// estimated size of the compacted file
+    std::uint64_t estimated_output_bytes{0};
+    /// estimated number and size of the BLOB files referenced only by dead versions, which GC would reclaim
+    std::uint64_t reclaimable_blob_files{0};
+    std::uint64_t reclaimable_blob_bytes{0};
+    /// read throughput of the estimate itself in bytes per second, 0 if too fast to measure
+    std::uint64_t measured_bytes_per_second{0};
+    /// versions of the keys found after the tracked keys reached the limit, counted as live
+    std::uint64_t untracked_versions{0};
+    std::map<storage_id_type, storage_estimate> storages{};
+
+    /**
+     * @brief Returns the ratio of dead versions over all the storages.
+     */
+    [[nodiscard]] double dead_ratio() const noexcept;
+
+    /**
+     * @brief Returns the I/O compaction would do: reading the WAL files, writing and reading back
+     *        the sort database, and writing the compacted file.
+     */
+    [[nodiscard]] std::uint64_t projected_io_bytes() const noexcept { return 2 * input_bytes + estimated_output_bytes; }
+
+    /**
+     * @brief Returns how long compaction would take at the given bandwidth.
+     * @param bytes_per_second the disk bandwidth, or 0 to use the throughput measured by the estimate
+     * @return the projected duration, or zero if no bandwidth is known
+     */
+    [[nodiscard]] std::chrono::seconds projected_duration(std::uint64_t bytes_per_second = 0) const noexcept;
+};
+
+/**
+ * @brief writes the estimate in the "key: value" lines of dblogutil
+ */
+std::ostream& operator<<(std::ostream& out, const compaction_estimate& estimate);
+
+/**
+ * @brief Estimates what a compaction would do, from a sample of the WAL files.
+ * @details The WAL files are read with dblog_scan, in the same way as compaction reads them,
+ *          but only files spread evenly over the file set and totalling about @c sample_bytes are read.
+ *          Every version of a key other than the latest normal entry is counted as dead, as are
+ *          the versions older than a clear_storage or remove_storage of the storage.
+ *          Nothing is written.
+ */
+class compaction_estimator {
+public:
+    static constexpr std::uint64_t default_sample_bytes = 256UL * 1024UL * 1024UL;
+
+    /// the amount of WAL files read to estimate an online compaction before it starts
+    static constexpr std::uint64_t online_sample_bytes = 16UL * 1024UL * 1024UL;
+
+    /// the number of keys whose latest version is tracked
+    static constexpr std::size_t default_max_keys = 4UL * 1024UL * 1024UL;
+
+    /**
+     * @param options the options of the compaction to estimate; the file set if any, otherwise
+     *        every WAL file of from_dir, and the number of scan threads are used
+     * @param sample_bytes the amount of WAL files to read, 0 to read all of them
+     * @param max_keys the number of keys whose latest version is tracked; the versions of the keys
+     *        found beyond it are counted as live, so that the memory used does not grow with the WAL files read
+     */
+    explicit compaction_estimator(compaction_options& options, std::uint64_t sample_bytes = default_sample_bytes,
+                                  std::size_t max_keys = default_max_keys) noexcept
+        : options_(options), sample_bytes_(sample_bytes), max_keys_(max_keys) {}
+
+    /**
+     * @brief reads the sampled WAL files and returns the estimate
+     * @exception limestone_exception if the WAL files cannot be read
+     */
+    [[nodiscard]] compaction_estimate estimate();
+
+    /**
+     * @brief selects the files read for the estimate
+     * @param files the names and sizes of the WAL files
+     * @param sample_bytes the amount to select, 0 to select all
+     * @return the selected names, spread evenly over the files in name order
+     */
+    [[nodiscard]] static std::set<std::string> select_samples(const std::map<std::string, std::uint64_t>& files, std::uint64_t sample_bytes);
+
+private:
+    compaction_options& options_;
+    std::uint64_t sample_bytes_;
+    std::size_t max_keys_;
+};
+
+/**
+ * @brief Estimates the next online compaction of a log directory in use.
+ * @details The rotated WAL files not yet compacted, i.e. other than the compacted files and
+ *          the detached files of the catalog, are read; the active WAL files are not, as they are
+ *          being written. The compacted generations merged by the compaction are not included either.
+ * @param location the log directory
+ * @param catalog the compaction catalog of the directory
+ * @param num_worker the number of scan threads
+ * @param sample_bytes the amount of WAL files to read, 0 to read all of them
+ */
+compaction_estimate estimate_online_compaction(const boost::filesystem::path& location, const compaction_catalog& catalog,
+                                               int num_worker, std::uint64_t sample_bytes = compaction_estimator::default_sample_bytes);
+
+}  // namespace limestone::internal
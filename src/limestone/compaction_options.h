@@ -16,11 +16,15 @@
 
  #pragma once
 
+ #include <algorithm>
  #include <set>
  #include <string>
+ #include <vector>
  #include <functional> // std::reference_wrapper
  #include <boost/filesystem.hpp>
  #include "blob_file_gc_snapshot.h"
+ #include "compaction_policy.h"
+ #include "io_rate_limiter.h"
  #include "limestone/api/write_version_type.h"
  
  namespace limestone::internal {
@@ -103,6 +107,15 @@
      // Returns true if a file set is configured.
      [[nodiscard]] bool has_file_set() const { return has_file_set_; }
 
+     // Sets the file set, for a compaction of the whole directory whose files are listed beforehand.
+     void set_file_names(std::set<std::string> file_names) {
+         file_names_ = std::move(file_names);
+         has_file_set_ = true;
+     }
+
+     // Removes a file from the file set, for a file that is read by other means than the WAL scan.
+     void remove_file_name(const std::string& file_name) { file_names_.erase(file_name); }
+
      // Check if GC is enabled.
      [[nodiscard]] bool is_gc_enabled() const { return static_cast<bool>(gc_snapshot_); }
 
@@ -115,6 +128,45 @@
          return *gc_snapshot_;
      }
 
+     // Policy selecting the compacted generations in the file set to merge; by default all of them are merged.
+     void set_policy(const compaction_policy& policy) { policy_ = policy; }
+     [[nodiscard]] const compaction_policy& get_policy() const { return policy_; }
+
+     // Key-range sharding of the compacted file: it is split into at most max_shards files
+     // written in parallel, each of them holding about min_shard_bytes or more; by default it is not split.
+     static constexpr std::uint64_t default_min_shard_bytes = 256UL * 1024UL * 1024UL;
+     void set_sharding(std::size_t max_shards, std::uint64_t min_shard_bytes) {
+         max_shards_ = std::max<std::size_t>(max_shards, 1);
+         min_shard_bytes_ = std::max<std::uint64_t>(min_shard_bytes, 1);
+     }
+     [[nodiscard]] std::size_t get_max_shards() const { return max_shards_; }
+     [[nodiscard]] std::uint64_t get_min_shard_bytes() const { return min_shard_bytes_; }
+
+     // Result of the compaction: the names of the compacted files (the shards of one generation) written to to_dir,
+     // and the compacted files of the file set merged into them.
+     void set_result(std::vector<std::string> output_file_names, std::vector<std::string> merged_generations) {
+         output_file_names_ = std::move(output_file_names);
+         merged_generations_ = std::move(merged_generations);
+     }
+     [[nodiscard]] const std::vector<std::string>& get_output_file_names() const { return output_file_names_; }
+     [[nodiscard]] const std::vector<std::string>& get_merged_generations() const { return merged_generations_; }
+
+     // Remove entries written to the compacted files, and those dropped as they hide no entry of the older generations.
+     void set_tombstone_counts(std::uint64_t kept, std::uint64_t purged) {
+         kept_tombstones_ = kept;
+         purged_tombstones_ = purged;
+     }
+     [[nodiscard]] std::uint64_t get_kept_tombstones() const { return kept_tombstones_; }
+     [[nodiscard]] std::uint64_t get_purged_tombstones() const { return purged_tombstones_; }
+
+     // Limiter charged with the I/O of the compaction; no limit if not set.
+     void set_io_limiter(io_rate_limiter* limiter) { io_limiter_ = limiter; }
+     void charge_io(std::uint64_t bytes) const {
+         if (io_limiter_ != nullptr) {
+             io_limiter_->request(bytes);
+         }
+     }
+
  private:
      // Basic compaction settings.
      boost::filesystem::path from_dir_;
@@ -127,6 +179,18 @@
 
      // Garbage collection settings.
      std::unique_ptr<blob_file_gc_snapshot> gc_snapshot_;
+
+     // Generation merge settings and result.
+     compaction_policy policy_{compaction_policy::merge_all()};
+     std::size_t max_shards_{1};
+     std::uint64_t min_shard_bytes_{default_min_shard_bytes};
+     std::vector<std::string> output_file_names_{};
+     std::vector<std::string> merged_generations_{};
+     std::uint64_t kept_tombstones_{0};
+     std::uint64_t purged_tombstones_{0};
+
+     // I/O throttling.
+     io_rate_limiter* io_limiter_{};
  };
 
  }  // namespace limestone::internal
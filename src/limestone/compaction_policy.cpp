@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "compaction_policy.h"
+
+#include <algorithm>
+
+namespace limestone::internal {
+
+compaction_policy::compaction_policy(std::uint64_t size_ratio, std::size_t max_generations, std::uint64_t min_generation_bytes) noexcept
+    : size_ratio_(std::max<std::uint64_t>(size_ratio, 1)),
+      max_generations_(std::max<std::size_t>(max_generations, 1)),
+      min_generation_bytes_(min_generation_bytes) {}
+
+compaction_policy compaction_policy::merge_all() noexcept {
+    return {1, 1, 0};
+}
+
+std::size_t compaction_policy::select(std::uint64_t new_bytes, const std::vector<std::uint64_t>& generation_bytes) const noexcept {
+    std::uint64_t merged_bytes = new_bytes;
+    std::size_t count = 0;
+    while (count < generation_bytes.size()) {
+        std::uint64_t next = generation_bytes[count];
+        bool small = next < min_generation_bytes_;
+        bool within_ratio = next / size_ratio_ + (next % size_ratio_ != 0 ? 1 : 0) <= merged_bytes;
+        // the result of this compaction is counted as a generation as well
+        bool too_many = generation_bytes.size() - count + 1 > max_generations_;
+        if (!small && !within_ratio && !too_many) {
+            break;
+        }
+        merged_bytes += next;
+        count++;
+    }
+    return count;
+}
+
+}  // namespace limestone::internal
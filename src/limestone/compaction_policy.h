@@ -0,0 +1,74 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace limestone::internal {
+
+/**
+ * @brief Size-ratio policy deciding which compacted generations are rewritten by an online compaction.
+ * @details Online compaction sorts the new WAL files and merges the result with the newest generations
+ *          of the compacted files. Starting from the newest generation, a generation is merged while
+ *          it is not larger than @c size_ratio times the data merged so far, so that each generation
+ *          ends up several times larger than the next newer one and a record is rewritten only
+ *          a logarithmic number of times.
+ *          Generations smaller than @c min_generation_bytes are always merged, and generations are
+ *          merged as well while there would be more than @c max_generations of them.
+ *          If every generation is merged, the result becomes the oldest generation (pwal_0000.compacted).
+ */
+class compaction_policy {
+public:
+    static constexpr std::uint64_t default_size_ratio = 4;
+    static constexpr std::size_t default_max_generations = 8;
+    static constexpr std::uint64_t default_min_generation_bytes = 64UL * 1024UL * 1024UL;
+
+    compaction_policy() = default;
+
+    /**
+     * @brief Creates a policy.
+     * @param size_ratio the size ratio between adjacent generations, must be at least 1
+     * @param max_generations the maximum number of generations, must be at least 1
+     * @param min_generation_bytes generations smaller than this are always merged
+     */
+    compaction_policy(std::uint64_t size_ratio, std::size_t max_generations, std::uint64_t min_generation_bytes) noexcept;
+
+    /**
+     * @brief Returns a policy that merges every generation, i.e. rewrites the whole compacted file.
+     */
+    [[nodiscard]] static compaction_policy merge_all() noexcept;
+
+    /**
+     * @brief Selects the generations to merge with the new WAL files.
+     * @param new_bytes the total size of the new WAL files
+     * @param generation_bytes the sizes of the existing generations, ordered from the newest to the oldest
+     * @return the number of the newest generations to merge
+     */
+    [[nodiscard]] std::size_t select(std::uint64_t new_bytes, const std::vector<std::uint64_t>& generation_bytes) const noexcept;
+
+    [[nodiscard]] std::uint64_t size_ratio() const noexcept { return size_ratio_; }
+    [[nodiscard]] std::size_t max_generations() const noexcept { return max_generations_; }
+    [[nodiscard]] std::uint64_t min_generation_bytes() const noexcept { return min_generation_bytes_; }
+
+private:
+    std::uint64_t size_ratio_{default_size_ratio};
+    std::size_t max_generations_{default_max_generations};
+    std::uint64_t min_generation_bytes_{default_min_generation_bytes};
+};
+
+}  // namespace limestone::internal
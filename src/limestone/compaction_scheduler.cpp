@@ -0,0 +1,167 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "compaction_scheduler.h"
+
+#include <cstdlib>
+#include <set>
+#include <string>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "compaction_catalog.h"
+#include "environment_helper.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+using namespace limestone::api;
+
+namespace {
+
+bool is_compacted_file(const std::string& filename) {
+    return filename.rfind(compaction_catalog::get_compacted_filename(), 0) == 0;
+}
+
+}  // namespace
+
+log_dir_usage log_dir_usage::measure(const boost::filesystem::path& location, const compaction_catalog& catalog) {
+    log_dir_usage usage{};
+    const std::set<std::string>& detached_pwals = catalog.get_detached_pwals();
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator it(location, error);
+    if (error) {
+        LOG_AND_THROW_IO_EXCEPTION("Failed to access directory: " + location.string(), error);
+    }
+    for (; it != boost::filesystem::directory_iterator(); it.increment(error)) {
+        if (error) {
+            LOG_AND_THROW_IO_EXCEPTION("Failed to iterate directory: " + location.string(), error);
+        }
+        std::string filename = it->path().filename().string();
+        if (filename.rfind("pwal", 0) != 0 || is_compacted_file(filename)
+            || detached_pwals.find(filename) != detached_pwals.end()) {
+            continue;
+        }
+        auto size = boost::filesystem::file_size(it->path(), error);
+        if (error) {
+            // the file may have been removed concurrently, e.g. by a backup
+            continue;
+        }
+        usage.pending_bytes += size;
+        if (filename.length() > 9) {
+            usage.pending_files++;
+        }
+    }
+    for (const auto& generation : catalog.get_compacted_generations()) {
+        auto size = boost::filesystem::file_size(location / generation, error);
+        if (!error) {
+            usage.compacted_bytes += size;
+        }
+    }
+    return usage;
+}
+
+compaction_scheduler::thresholds compaction_scheduler::thresholds::from_environment() {
+    const char* auto_val = std::getenv("LIMESTONE_COMPACTION_AUTO");
+    if (auto_val == nullptr || std::string_view{auto_val} == "0") {
+        return disabled();
+    }
+    if (std::string_view{auto_val} != "1") {
+        LOG_LP(WARNING) << "Invalid LIMESTONE_COMPACTION_AUTO: " << auto_val << "; automatic online compaction disabled";
+        return disabled();
+    }
+    LOG_LP(INFO) << "LIMESTONE_COMPACTION_AUTO: 1; automatic online compaction enabled";
+    thresholds limits{};
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_PENDING_BYTES")) {
+        limits.pending_bytes = *value;
+    }
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_PENDING_FILES")) {
+        limits.pending_files = static_cast<std::size_t>(*value);
+    }
+    if (auto value = read_ratio_environment("LIMESTONE_COMPACTION_DEAD_RATIO")) {
+        limits.dead_ratio = *value;
+    }
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_IDLE_SECONDS")) {
+        limits.idle_window = std::chrono::seconds(*value);
+    }
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_MIN_INTERVAL_SECONDS")) {
+        limits.min_interval = std::chrono::seconds(*value);
+    }
+    return limits;
+}
+
+compaction_scheduler::thresholds compaction_scheduler::thresholds::disabled() noexcept {
+    thresholds limits{};
+    limits.pending_bytes = 0;
+    limits.pending_files = 0;
+    limits.dead_ratio = 0.0;
+    limits.idle_window = std::chrono::seconds(0);
+    return limits;
+}
+
+bool compaction_scheduler::thresholds::enabled() const noexcept {
+    return pending_bytes > 0 || pending_files > 0 || dead_ratio > 0.0 || idle_window.count() > 0;
+}
+
+compaction_scheduler::compaction_scheduler(const thresholds& limits) noexcept
+    : limits_(limits) {}
+
+bool compaction_scheduler::needs_dead_ratio(const log_dir_usage& usage, clock::time_point now) const noexcept {
+    if (limits_.dead_ratio <= 0.0 || usage.pending_bytes < limits_.dead_ratio_min_bytes) {
+        return false;
+    }
+    if (last_compaction_ && now - *last_compaction_ < limits_.min_interval) {
+        return false;
+    }
+    return !last_dead_ratio_ || now - *last_dead_ratio_ >= limits_.dead_ratio_interval;
+}
+
+compaction_scheduler::trigger compaction_scheduler::check(const log_dir_usage& usage, clock::time_point now) noexcept {
+    // the idle window restarts whenever the WAL files grow
+    if (!last_pending_bytes_ || *last_pending_bytes_ != usage.pending_bytes) {
+        last_pending_bytes_ = usage.pending_bytes;
+        last_write_ = now;
+    }
+    if (last_compaction_ && now - *last_compaction_ < limits_.min_interval) {
+        return trigger::none;
+    }
+    if (limits_.pending_bytes > 0 && usage.pending_bytes >= limits_.pending_bytes) {
+        return trigger::pending_bytes;
+    }
+    if (limits_.pending_files > 0 && usage.pending_files >= limits_.pending_files) {
+        return trigger::pending_files;
+    }
+    if (usage.dead_ratio) {
+        last_dead_ratio_ = now;
+        if (limits_.dead_ratio > 0.0 && usage.pending_bytes >= limits_.dead_ratio_min_bytes
+            && *usage.dead_ratio >= limits_.dead_ratio) {
+            return trigger::dead_ratio;
+        }
+    }
+    if (limits_.idle_window.count() > 0 && usage.pending_bytes >= limits_.idle_min_bytes
+        && now - last_write_ >= limits_.idle_window) {
+        return trigger::idle;
+    }
+    return trigger::none;
+}
+
+void compaction_scheduler::compaction_finished(clock::time_point now) noexcept {
+    last_compaction_ = now;
+    last_pending_bytes_.reset();
+}
+
+}  // namespace limestone::internal
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <ostream>
+#include <string_view>
+
+#include <boost/filesystem.hpp>
+
+namespace limestone::internal {
+
+class compaction_catalog;
+
+/**
+ * @brief Usage of the log directory, as seen by the compaction scheduler.
+ */
+struct log_dir_usage {
+    /// total size of the WAL files not compacted yet, including the active ones
+    std::uint64_t pending_bytes{0};
+
+    /// number of the rotated WAL files not compacted yet
+    std::size_t pending_files{0};
+
+    /// total size of the compacted files
+    std::uint64_t compacted_bytes{0};
+
+    /// ratio of the dead versions to all the versions in the WAL files not compacted yet,
+    /// counted by compaction_estimator; not set unless the scheduler asked for it (see compaction_scheduler::needs_dead_ratio())
+    std::optional<double> dead_ratio{};
+
+    /**
+     * @brief Measures the usage of the log directory.
+     * @param location the log directory
+     * @param catalog the compaction catalog of the log directory
+     * @exception limestone_io_exception if the directory cannot be read
+     */
+    static log_dir_usage measure(const boost::filesystem::path& location, const compaction_catalog& catalog);
+};
+
+/**
+ * @brief Decides when online compaction is started without an explicit request.
+ * @details The online compaction worker polls the scheduler periodically with the usage of the log directory.
+ *          A compaction is started when any of the enabled triggers fires, but not sooner than
+ *          @c min_interval after the previous compaction.
+ *          Automatic compaction is off unless LIMESTONE_COMPACTION_AUTO=1 is set.
+ *          The ctrl/start_compaction file is still honored as an explicit request, regardless of the scheduler.
+ */
+class compaction_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Thresholds of the triggers; a trigger with the threshold 0 is disabled.
+     */
+    struct thresholds {
+        /// compact when the WAL files not compacted yet reach this size
+        std::uint64_t pending_bytes{1024UL * 1024UL * 1024UL};
+
+        /// compact when this many rotated WAL files are not compacted yet
+        std::size_t pending_files{256};
+
+        /// compact when the ratio of dead versions reaches this value, if @c dead_ratio_min_bytes are pending;
+        /// the ratio is counted from a sample of the pending WAL files at most once every @c dead_ratio_interval
+        double dead_ratio{0.5};
+        std::uint64_t dead_ratio_min_bytes{64UL * 1024UL * 1024UL};
+        std::chrono::seconds dead_ratio_interval{60};
+
+        /// compact when no WAL is written for this period, if @c idle_min_bytes are pending
+        std::chrono::seconds idle_window{300};
+        std::uint64_t idle_min_bytes{16UL * 1024UL * 1024UL};
+
+        /// minimum interval between two compactions started by the scheduler
+        std::chrono::seconds min_interval{60};
+
+        /**
+         * @brief Returns the thresholds given by the environment variables.
+         * @details Every trigger is disabled unless LIMESTONE_COMPACTION_AUTO=1 is set. If it is, the default thresholds
+         *          are overridden by LIMESTONE_COMPACTION_PENDING_BYTES, LIMESTONE_COMPACTION_PENDING_FILES,
+         *          LIMESTONE_COMPACTION_DEAD_RATIO, LIMESTONE_COMPACTION_IDLE_SECONDS and
+         *          LIMESTONE_COMPACTION_MIN_INTERVAL_SECONDS if set. Invalid values are ignored with a warning.
+         */
+        static thresholds from_environment();
+
+        /**
+         * @brief Returns thresholds with every trigger disabled.
+         */
+        static thresholds disabled() noexcept;
+
+        /**
+         * @brief Returns whether any trigger is enabled.
+         */
+        [[nodiscard]] bool enabled() const noexcept;
+    };
+
+    /**
+     * @brief The trigger that started a compaction.
+     */
+    enum class trigger {
+        none,
+        pending_bytes,
+        pending_files,
+        dead_ratio,
+        idle,
+    };
+
+    explicit compaction_scheduler(const thresholds& limits) noexcept;
+
+    /**
+     * @brief Checks whether the dead ratio should be counted before the next check().
+     * @details It is, if the dead ratio trigger is enabled, enough WAL files are pending, and it has not been
+     *          counted within @c dead_ratio_interval.
+     * @param usage the current usage of the log directory
+     * @param now the current time
+     */
+    [[nodiscard]] bool needs_dead_ratio(const log_dir_usage& usage, clock::time_point now) const noexcept;
+
+    /**
+     * @brief Checks whether a compaction should be started.
+     * @param usage the current usage of the log directory, with the dead ratio if needs_dead_ratio() asked for it
+     * @param now the current time
+     * @return the trigger that fired, or trigger::none
+     */
+    [[nodiscard]] trigger check(const log_dir_usage& usage, clock::time_point now) noexcept;
+
+    /**
+     * @brief Records that a compaction has finished, whatever started it.
+     * @param now the current time
+     */
+    void compaction_finished(clock::time_point now) noexcept;
+
+    [[nodiscard]] const thresholds& limits() const noexcept { return limits_; }
+
+private:
+    thresholds limits_;
+    std::optional<clock::time_point> last_compaction_{};
+    std::optional<std::uint64_t> last_pending_bytes_{};
+    clock::time_point last_write_{};
+    std::optional<clock::time_point> last_dead_ratio_{};
+};
+
+/**
+ * @brief returns the label of the given enum value.
+ * @param value the enum value
+ * @return the corresponded label
+ */
+[[nodiscard]] constexpr inline std::string_view to_string_view(compaction_scheduler::trigger value) noexcept {
+    using namespace std::string_view_literals;
+    switch (value) {
+        case compaction_scheduler::trigger::none: return "none"sv;
+        case compaction_scheduler::trigger::pending_bytes: return "pending_bytes"sv;
+        case compaction_scheduler::trigger::pending_files: return "pending_files"sv;
+        case compaction_scheduler::trigger::dead_ratio: return "dead_ratio"sv;
+        case compaction_scheduler::trigger::idle: return "idle"sv;
+    }
+    std::abort();
+}
+
+/**
+ * @brief appends enum label into the given stream.
+ * @param out the target stream
+ * @param value the source enum value
+ * @return the target stream
+ */
+inline std::ostream& operator<<(std::ostream& out, compaction_scheduler::trigger value) {
+    return out << to_string_view(value);
+}
+
+}  // namespace limestone::internal
@@ -35,4 +35,41 @@ void configuration::set_db_name(std::string_view db_name) noexcept {
     db_name_ = db_name;
 }
 
+void configuration::set_blob_pack_max_bytes(std::uint64_t max_blob_bytes) noexcept {
+    blob_pack_max_bytes_ = max_blob_bytes;
+}
+
+void configuration::set_blob_pack_segment_bytes(std::uint64_t segment_bytes) noexcept {
+    blob_pack_segment_bytes_ = segment_bytes;
+}
+
+void configuration::set_blob_dedup_entries(std::size_t entries) noexcept {
+    blob_dedup_entries_ = entries;
+}
+
+void configuration::set_blob_dedup_max_file_bytes(std::uint64_t max_file_bytes) noexcept {
+    blob_dedup_max_file_bytes_ = max_file_bytes;
+}
+
+void configuration::set_blob_read_cache_entries(std::size_t entries) noexcept {
+    blob_read_cache_entries_ = entries;
+}
+
+void configuration::set_blob_io_threads(std::size_t threads) noexcept {
+    blob_io_threads_ = threads;
+}
+
+void configuration::set_blob_gc_snapshot_memory(std::size_t memory_bytes) noexcept {
+    blob_gc_snapshot_memory_ = memory_bytes;
+}
+
+void configuration::set_compaction_io_rate(std::uint64_t bytes_per_second) noexcept {
+    compaction_io_rate_ = bytes_per_second;
+}
+
+void configuration::set_compaction_sharding(std::size_t max_shards, std::uint64_t min_shard_bytes) noexcept {
+    compaction_max_shards_ = max_shards;
+    compaction_min_shard_bytes_ = min_shard_bytes;
+}
+
 } // namespace limestone::api
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace limestone::internal {
+
+namespace {
+
+constexpr std::uint32_t crc32c_polynomial = 0x82f63b78U;  // reversed Castagnoli polynomial
+
+constexpr std::array<std::uint32_t, 256> make_crc32c_table() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; i++) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1U) != 0 ? (c >> 1U) ^ crc32c_polynomial : c >> 1U;
+        }
+        table.at(i) = c;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint32_t, 256> crc32c_table = make_crc32c_table();
+
+std::uint32_t crc32c_software(const unsigned char* p, std::size_t size, std::uint32_t crc) noexcept {
+    for (std::size_t i = 0; i < size; i++) {
+        crc = crc32c_table.at((crc ^ p[i]) & 0xffU) ^ (crc >> 8U);  // NOLINT(*-pointer-arithmetic)
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+std::uint32_t crc32c_sse42(const unsigned char* p, std::size_t size, std::uint32_t crc) noexcept {
+    std::uint64_t c = crc;
+    while (size >= sizeof(std::uint64_t)) {
+        std::uint64_t word{};
+        std::memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        p += sizeof(word);  // NOLINT(*-pointer-arithmetic)
+        size -= sizeof(word);
+    }
+    auto c32 = static_cast<std::uint32_t>(c);
+    while (size > 0) {
+        c32 = _mm_crc32_u8(c32, *p);
+        p++;  // NOLINT(*-pointer-arithmetic)
+        size--;
+    }
+    return c32;
+}
+
+bool has_sse42() noexcept {
+    static const bool supported = __builtin_cpu_supports("sse4.2") != 0;
+    return supported;
+}
+#endif
+
+} // namespace
+
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc) noexcept {
+    const auto* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (has_sse42()) {
+        return ~crc32c_sse42(p, size, crc);
+    }
+#endif
+    return ~crc32c_software(p, size, crc);
+}
+
+} // namespace limestone::internal
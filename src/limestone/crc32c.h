@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace limestone::internal {
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of the given data.
+ * @details The SSE4.2 crc32 instruction is used when the CPU supports it,
+ *          otherwise a table-driven implementation is used.
+ * @param data the data to checksum
+ * @param size the size of the data in bytes
+ * @param crc the checksum of the preceding data, to extend a running checksum
+ * @return the checksum
+ */
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc = 0) noexcept;
+
+} // namespace limestone::internal
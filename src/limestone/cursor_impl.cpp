@@ -13,59 +13,137 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <endian.h>
+
+#include <algorithm>
 #include <map>
 #include "cursor_impl.h"
 #include <glog/logging.h>
 #include "limestone_exception_helper.h"
+#include "storage_offset_table.h"
 
 namespace limestone::internal {
 
 using limestone::api::log_entry;
 using limestone::api::write_version_type;
 
+namespace {
+
+/**
+ * @brief returns a number whose order is the order of the storage in key_sid-sorted files
+ * @details key_sid starts with the storage ID in little endian, so storages are ordered by
+ * their byte strings rather than by their numeric values.
+ */
+std::uint64_t storage_order(storage_id_type storage_id) noexcept {
+    return be64toh(htole64(storage_id));
+}
+
+} // namespace
+
 std::unique_ptr<cursor> cursor_impl::create_cursor(
     const boost::filesystem::path& snapshot_file,
-    const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage) {
+    const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+    std::optional<storage_id_type> storage_id) {
 
-    auto impl = std::make_unique<cursor_impl>(snapshot_file, clear_storage);
+    auto impl = std::make_unique<cursor_impl>(snapshot_file, clear_storage, storage_id);
     return std::unique_ptr<cursor>(new cursor(std::move(impl)));
 }
 
 std::unique_ptr<cursor> cursor_impl::create_cursor(
     const boost::filesystem::path& snapshot_file,
     const boost::filesystem::path& compacted_file,
-    const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage) {
+    const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+    std::optional<storage_id_type> storage_id) {
+
+    auto impl = std::make_unique<cursor_impl>(snapshot_file, compacted_file, clear_storage, storage_id);
+    return std::unique_ptr<cursor>(new cursor(std::move(impl)));
+}
+
+std::unique_ptr<cursor> cursor_impl::create_cursor(
+    const std::vector<boost::filesystem::path>& files,
+    const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+    std::optional<storage_id_type> storage_id,
+    std::shared_ptr<snapshot_block_cache> block_cache) {
 
-    auto impl = std::make_unique<cursor_impl>(snapshot_file, compacted_file, clear_storage);
+    auto impl = std::make_unique<cursor_impl>(files, clear_storage, storage_id, std::move(block_cache));
     return std::unique_ptr<cursor>(new cursor(std::move(impl)));
 }
 
-cursor_impl::cursor_impl(const boost::filesystem::path& snapshot_file, std::map<api::storage_id_type, api::write_version_type> clear_storage)
-    : clear_storage_(std::move(clear_storage)) {
-    open(snapshot_file, snapshot_istrm_);
+cursor_impl::cursor_impl(const boost::filesystem::path& snapshot_file, std::map<api::storage_id_type, api::write_version_type> clear_storage,
+                         std::optional<storage_id_type> storage_id)
+    : cursor_impl(std::vector<boost::filesystem::path>{snapshot_file}, std::move(clear_storage), storage_id) {
 }
 
 cursor_impl::cursor_impl(const boost::filesystem::path& snapshot_file, const boost::filesystem::path& compacted_file,
-                         std::map<api::storage_id_type, api::write_version_type> clear_storage)
-    : clear_storage_(std::move(clear_storage)) {
-    open(snapshot_file, snapshot_istrm_);
-    open(compacted_file, compacted_istrm_);
+                         std::map<api::storage_id_type, api::write_version_type> clear_storage, std::optional<storage_id_type> storage_id)
+    : cursor_impl(std::vector<boost::filesystem::path>{snapshot_file, compacted_file}, std::move(clear_storage), storage_id) {
+}
+
+cursor_impl::cursor_impl(const std::vector<boost::filesystem::path>& files,
+                         std::map<api::storage_id_type, api::write_version_type> clear_storage, std::optional<storage_id_type> storage_id,
+                         std::shared_ptr<snapshot_block_cache> block_cache)
+    : sources_(files.size()), storage_id_(storage_id), block_cache_(std::move(block_cache)) {
+    cut_points_.reserve(clear_storage.size());
+    for (const auto& [sid, cutoff] : clear_storage) {
+        cut_points_.push_back(cut_point{storage_order(sid), cutoff});
+    }
+    std::sort(cut_points_.begin(), cut_points_.end(), [](const cut_point& a, const cut_point& b) { return a.order < b.order; });
+    for (std::size_t i = 0; i < files.size(); i++) {
+        sources_[i].name = files[i].string();
+        open(files[i], sources_[i]);
+    }
 }
 
-void cursor_impl::open(const boost::filesystem::path& file, std::optional<boost::filesystem::ifstream>& stream) {
+void cursor_impl::open(const boost::filesystem::path& file, source& src) {
+    auto& stream = src.stream;
     stream.emplace(file, std::ios_base::in | std::ios_base::binary);
     if (!stream->is_open() || !stream->good()) {
         LOG_AND_THROW_EXCEPTION("Failed to open file: " + file.string());
     }
+    // Files in the block-based snapshot format start with a magic; others are plain log_entry sequences.
+    if (snapshot_block_reader::read_file_header(*stream)) {
+        src.blocks.emplace(file.string(), block_cache_, block_cache_ ? snapshot_block_cache::identify(file) : std::nullopt);
+    }
+    if (!storage_id_ && cut_points_.empty()) {
+        return;
+    }
+    // The storage offset table lets the cursor seek directly to the target storage, and skip storages
+    // whose entries are all older than their clear_storage cutoff.
+    // Without it the stream is scanned from the beginning.
+    src.offsets = storage_offset_table::load_for(file);
+    if (!storage_id_ || !src.offsets) {
+        return;
+    }
+    auto range = src.offsets->find(*storage_id_);
+    if (!range) {
+        DVLOG_LP(log_trace) << "no entries for storage " << *storage_id_ << " in " << file;
+        stream->close();
+        stream = std::nullopt;
+        return;
+    }
+    if (const auto* cutoff = cutoff_of(src.cuts, *storage_id_); cutoff != nullptr && range->max_version < *cutoff) {
+        DVLOG_LP(log_trace) << "storage " << *storage_id_ << " is entirely cleared in " << file;
+        stream->close();
+        stream = std::nullopt;
+        return;
+    }
+    stream->seekg(static_cast<std::streamoff>(range->begin));
 }
 
 void cursor_impl::close() {
-    if (snapshot_istrm_) snapshot_istrm_->close();
-    if (compacted_istrm_) compacted_istrm_->close();
+    for (auto& src : sources_) {
+        if (src.stream) src.stream->close();
+    }
 }
 
 void cursor_impl::validate_and_read_stream(std::optional<boost::filesystem::ifstream>& stream, const std::string& stream_name,
-                                           std::optional<log_entry>& log_entry, std::string& previous_key_sid) {
+                                           std::optional<log_entry>& log_entry, std::string& previous_key_sid,
+                                           snapshot_block_reader* blocks, cut_position* cuts,
+                                           const storage_offset_table* offsets) {
+    cut_position local_cuts{};
+    if (cuts == nullptr) {
+        cuts = &local_cuts;
+    }
     while (stream) {
         // If the stream is not in good condition, close it and exit
         if (!stream->good()) {
@@ -80,7 +158,7 @@ void cursor_impl::validate_and_read_stream(std::optional<boost::filesystem::ifst
             log_entry.emplace();  // Construct a new log_entry
             // NOLINTNEXTLINE(cppcoreguidelines-avoid-do-while)
             do {
-                if (!log_entry->read(*stream)) {
+                if (blocks != nullptr ? !blocks->read(*stream, *log_entry) : !log_entry->read(*stream)) {
                     // If reading fails, close the stream and reset the log_entry
                     stream->close();
                     stream = std::nullopt;
@@ -90,6 +168,20 @@ void cursor_impl::validate_and_read_stream(std::optional<boost::filesystem::ifst
             } while (log_entry->type() != log_entry::entry_type::normal_entry &&
                      log_entry->type() != log_entry::entry_type::normal_with_blob 
                      && log_entry->type() != log_entry::entry_type::remove_entry);
+            // Restrict the stream to the target storage, if any.
+            // Entries of a storage are contiguous, so once an entry of the target storage has been
+            // accepted (previous_key_sid is set), the first entry of another storage ends the stream.
+            if (storage_id_ && log_entry->storage() != *storage_id_) {
+                if (!previous_key_sid.empty()) {
+                    DVLOG_LP(log_trace) << stream_name << " stream reached the end of storage " << *storage_id_ << ", closing it.";
+                    stream->close();
+                    stream = std::nullopt;
+                    log_entry = std::nullopt;
+                    return;
+                }
+                log_entry = std::nullopt;
+                continue;
+            }
             // Check if the key_sid is in ascending order
             // TODO: Key order violation is detected here and the process is aborted.
             // However, this check should be moved to an earlier point, and if the key order is invalid,
@@ -107,10 +199,32 @@ void cursor_impl::validate_and_read_stream(std::optional<boost::filesystem::ifst
             }
             // Update the previous key_sid to the current one
             previous_key_sid = log_entry->key_sid();
+
+            // When the entry starts a storage whose entries are all older than its clear_storage cutoff,
+            // skip the rest of the storage instead of reading and discarding each of its entries.
+            auto storage_id = log_entry->storage();
+            bool first_of_storage = !cuts->storage || *cuts->storage != storage_id;
+            const write_version_type* cutoff = cutoff_of(*cuts, storage_id);
+            if (first_of_storage && cutoff != nullptr && offsets != nullptr) {
+                if (auto range = offsets->find(storage_id); range && range->max_version < *cutoff) {
+                    DVLOG_LP(log_trace) << stream_name << " storage " << storage_id << " is entirely cleared, skipping it.";
+                    log_entry = std::nullopt;
+                    if (storage_id_) {
+                        stream->close();
+                        stream = std::nullopt;
+                        return;
+                    }
+                    stream->seekg(static_cast<std::streamoff>(range->end));
+                    if (blocks != nullptr) {
+                        blocks->reset();
+                    }
+                    continue;
+                }
+            }
         }
 
         // Check the validity of the entry
-        if (is_relevant_entry(log_entry.value())) {
+        if (is_relevant_entry(log_entry.value(), cutoff_of(*cuts, log_entry->storage()))) {
             // If a valid entry is found, return
             return;
         }
@@ -120,79 +234,123 @@ void cursor_impl::validate_and_read_stream(std::optional<boost::filesystem::ifst
     }
 }
 
+const write_version_type* cursor_impl::cutoff_of(cut_position& cuts, storage_id_type storage_id) const noexcept {
+    if (cuts.storage && *cuts.storage == storage_id) {
+        return cuts.cutoff;
+    }
+    std::uint64_t order = storage_order(storage_id);
+    if (cuts.storage && order < storage_order(*cuts.storage)) {
+        // The walk only moves forward; start over if the storages go backwards (e.g. on a key order violation).
+        cuts.index = 0;
+    }
+    while (cuts.index < cut_points_.size() && cut_points_[cuts.index].order < order) {
+        cuts.index++;
+    }
+    cuts.storage = storage_id;
+    cuts.cutoff = (cuts.index < cut_points_.size() && cut_points_[cuts.index].order == order) ? &cut_points_[cuts.index].cutoff : nullptr;
+    return cuts.cutoff;
+}
 
-bool cursor_impl::is_relevant_entry(const limestone::api::log_entry& entry) {
-        // Step 1: Check if the entry is one of normal_entry, remove_entry, or normal_with_blob
-        if (entry.type() != limestone::api::log_entry::entry_type::normal_entry &&
-            entry.type() != limestone::api::log_entry::entry_type::remove_entry &&
-            entry.type() != limestone::api::log_entry::entry_type::normal_with_blob) {
-            return false;  // Skip this entry if it's not a normal, remove, or blob entry
-        }
-
-
-        // Step 2: Get the storage ID from log_entry
-        auto storage_id = entry.storage();  // Assuming storage() returns the storage ID
-        // Step 3: Check if clear_storage_ contains the same storage ID
-        auto it = clear_storage_.find(storage_id);
-        if (it != clear_storage_.end()) {
-            // Step 4: Retrieve the write_version from log_entry (only if the storage ID is found)
-            write_version_type wv;
-            entry.write_version(wv);
-
-            // Step 5: Retrieve the write_version from clear_storage_ for the same storage ID
-            write_version_type range_ver = it->second;
-
-            // Step 6: Compare the versions
-            if (wv < range_ver) {
-                return false;  // Skip this entry as it is outdated
-            }
+bool cursor_impl::is_relevant_entry(const limestone::api::log_entry& entry, const write_version_type* cutoff) const {
+    // Skip the entry if it is not a normal, remove, or blob entry
+    if (entry.type() != limestone::api::log_entry::entry_type::normal_entry &&
+        entry.type() != limestone::api::log_entry::entry_type::remove_entry &&
+        entry.type() != limestone::api::log_entry::entry_type::normal_with_blob) {
+        return false;
+    }
+    // Skip the entry if it is older than the clear_storage cutoff of its storage
+    if (cutoff != nullptr) {
+        write_version_type wv;
+        entry.write_version(wv);
+        if (wv < *cutoff) {
+            return false;
         }
+    }
+    return true;
+}
 
-        // If everything is valid, return true
+bool cursor_impl::precedes(std::size_t a, std::size_t b) const {
+    // An exhausted source loses to any other source.
+    const auto& ea = sources_[a].log_entry;
+    const auto& eb = sources_[b].log_entry;
+    if (!ea) {
+        return false;
+    }
+    if (!eb) {
         return true;
+    }
+    int c = ea->key_sid().compare(eb->key_sid());
+    // For equal keys the source listed first is newer and wins.
+    return c < 0 || (c == 0 && a < b);
 }
 
-bool cursor_impl::next() { 
-    while (true) {
-        // Read from the snapshot stream if the snapshot_log_entry_ is empty
-        if (!snapshot_log_entry_) {
-            validate_and_read_stream(snapshot_istrm_, "Snapshot", snapshot_log_entry_, previous_snapshot_key_sid);
+void cursor_impl::build_tree() {
+    // Leaves are placed at k..2k-1 and internal nodes at 1..k-1, so the parent of node n is n / 2.
+    const std::size_t k = sources_.size();
+    tree_.assign(std::max<std::size_t>(k, 1), 0);
+    std::vector<std::size_t> winners(k, 0);
+    auto winner_of = [&](std::size_t node) { return node >= k ? node - k : winners[node]; };
+    for (std::size_t node = k - 1; node >= 1; node--) {
+        std::size_t a = winner_of(2 * node);
+        std::size_t b = winner_of(2 * node + 1);
+        if (precedes(a, b)) {
+            winners[node] = a;
+            tree_[node] = b;
+        } else {
+            winners[node] = b;
+            tree_[node] = a;
         }
+    }
+    tree_[0] = k > 1 ? winners[1] : 0;
+}
 
-        // Read from the compacted stream if the compacted_log_entry_ is empty
-        if (!compacted_log_entry_) {
-            validate_and_read_stream(compacted_istrm_, "Compacted", compacted_log_entry_, previous_compacted_key_sid);
+void cursor_impl::advance(std::size_t index) {
+    // Read the next entry of the source and replay its matches from the leaf up to the root.
+    auto& src = sources_[index];
+    src.log_entry = std::nullopt;
+    read_source(src);
+    std::size_t winner = index;
+    for (std::size_t node = (index + sources_.size()) / 2; node > 0; node /= 2) {
+        if (precedes(tree_[node], winner)) {
+            std::swap(tree_[node], winner);
         }
+    }
+    tree_[0] = winner;
+}
 
-        // Case 1: Both snapshot and compacted are empty, return false
-        if (!snapshot_log_entry_ && !compacted_log_entry_) {
-            DVLOG_LP(log_trace) << "Both snapshot and compacted streams are closed";
+void cursor_impl::read_source(source& src) {
+    validate_and_read_stream(src.stream, src.name, src.log_entry, src.previous_key_sid, src.blocks ? &*src.blocks : nullptr,
+                             &src.cuts, src.offsets ? &*src.offsets : nullptr);
+}
+
+bool cursor_impl::next() {
+    if (sources_.empty()) {
+        return false;
+    }
+    if (!started_) {
+        for (auto& src : sources_) {
+            read_source(src);
+        }
+        build_tree();
+        started_ = true;
+    }
+    while (true) {
+        std::size_t winner = tree_[0];
+        if (!sources_[winner].log_entry) {
+            DVLOG_LP(log_trace) << "all streams are closed";
             return false;
         }
-
-        // Case 2: Either snapshot or compacted has a value, use the one that is not empty
-        if (snapshot_log_entry_ && !compacted_log_entry_) {
-            log_entry_ = std::move(snapshot_log_entry_.value());
-            snapshot_log_entry_ = std::nullopt;
-        } else if (!snapshot_log_entry_ && compacted_log_entry_) {
-            log_entry_ = std::move(compacted_log_entry_.value());
-            compacted_log_entry_ = std::nullopt;
-        } else {
-            // Case 3: Both snapshot and compacted have values
-            if (snapshot_log_entry_->key_sid() < compacted_log_entry_->key_sid()) {
-                log_entry_ = std::move(snapshot_log_entry_.value());
-                snapshot_log_entry_ = std::nullopt;
-            } else if (snapshot_log_entry_->key_sid() > compacted_log_entry_->key_sid()) {
-                log_entry_ = std::move(compacted_log_entry_.value());
-                compacted_log_entry_ = std::nullopt;
-            } else {
-                // If key_sid is equal, snapshot is always newer by design
-                // Note: If snapshot contains a remove_entry, it will be filtered out 
-                // by the type check at the end of the method
-                log_entry_ = std::move(snapshot_log_entry_.value());
-                snapshot_log_entry_ = std::nullopt;
-                compacted_log_entry_ = std::nullopt;
+        log_entry_ = std::move(sources_[winner].log_entry.value());
+        advance(winner);
+
+        // Discard the older versions of the same key in the other sources.
+        // Note: If the newest version is a remove_entry, it is filtered out by the type check below.
+        while (true) {
+            std::size_t older = tree_[0];
+            if (!sources_[older].log_entry || sources_[older].log_entry->key_sid() != log_entry_.key_sid()) {
+                break;
             }
+            advance(older);
         }
 
         // Check if the current log_entry_ is a normal entry or normal_with_blob
@@ -22,51 +22,127 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <map>
+#include <memory>
 #include <optional>
+#include <vector>
 
 #include "cursor_impl_base.h"
 #include "log_entry.h"
+#include "snapshot_block_cache.h"
+#include "snapshot_block_reader.h"
+#include "storage_offset_table.h"
 
 namespace limestone::internal {
 
 using limestone::api::cursor;
 using limestone::api::storage_id_type;
 using limestone::api::write_version_type;    
+/**
+ * @brief cursor merging any number of key_sid-sorted files
+ * @details The files are merged with a loser tree. When the same key appears in several files,
+ * the entry of the file that comes first in the list is returned and the others are discarded,
+ * so the files must be given from newest to oldest.
+ */
 class cursor_impl : public cursor_impl_base {
 public:
-    cursor_impl(const boost::filesystem::path& snapshot_file, std::map<storage_id_type, write_version_type> clear_storage);
+    /**
+     * @brief create a cursor over the snapshot file
+     * @param storage_id if specified, only the entries of this storage are returned, and the
+     *        storage offset table of each file is used to seek directly to the storage
+     */
+    cursor_impl(const boost::filesystem::path& snapshot_file, std::map<storage_id_type, write_version_type> clear_storage,
+                std::optional<storage_id_type> storage_id = std::nullopt);
 
     cursor_impl(const boost::filesystem::path& snapshot_file, const boost::filesystem::path& compacted_file,
-                std::map<storage_id_type, write_version_type> clear_storage);
+                std::map<storage_id_type, write_version_type> clear_storage, std::optional<storage_id_type> storage_id = std::nullopt);
+
+    /**
+     * @brief create a cursor merging the given files
+     * @param files the files to merge, ordered from newest to oldest
+     * @param block_cache if not null, decoded blocks of block-based snapshot files are shared through this cache
+     */
+    cursor_impl(const std::vector<boost::filesystem::path>& files, std::map<storage_id_type, write_version_type> clear_storage,
+                std::optional<storage_id_type> storage_id = std::nullopt, std::shared_ptr<snapshot_block_cache> block_cache = nullptr);
 
     static std::unique_ptr<cursor> create_cursor(const boost::filesystem::path& snapshot_file,
-                                                  const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage);
+                                                  const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+                                                  std::optional<storage_id_type> storage_id = std::nullopt);
     static std::unique_ptr<cursor> create_cursor(const boost::filesystem::path& snapshot_file, const boost::filesystem::path& compacted_file,
-                                                  const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage);
+                                                  const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+                                                  std::optional<storage_id_type> storage_id = std::nullopt);
+    static std::unique_ptr<cursor> create_cursor(const std::vector<boost::filesystem::path>& files,
+                                                  const std::map<limestone::api::storage_id_type, limestone::api::write_version_type>& clear_storage,
+                                                  std::optional<storage_id_type> storage_id = std::nullopt,
+                                                  std::shared_ptr<snapshot_block_cache> block_cache = nullptr);
 private:
+    /**
+     * @brief the clear_storage cutoff of one storage
+     * @details Entries of the storage older than the cutoff are not visible.
+     */
+    struct cut_point {
+        // the storage ID in the order in which storages appear in key_sid-sorted files
+        std::uint64_t order;
+        write_version_type cutoff;
+    };
+
+    /**
+     * @brief position of a source in cut_points_
+     * @details Storages appear in ascending key_sid order in every source, so the position
+     * only moves forward and each entry needs no lookup unless it starts a new storage.
+     */
+    struct cut_position {
+        std::size_t index{0};
+        std::optional<storage_id_type> storage{};
+        const write_version_type* cutoff{nullptr};
+    };
+
+    /**
+     * @brief one input file of the merge and the entry at its head
+     */
+    struct source {
+        std::string name;
+        std::optional<boost::filesystem::ifstream> stream;
+        // set if the file is a block-based snapshot file
+        std::optional<snapshot_block_reader> blocks;
+        // set if the file has a usable storage offset table and it is needed
+        std::optional<storage_offset_table> offsets;
+        std::optional<limestone::api::log_entry> log_entry;
+        std::string previous_key_sid;
+        cut_position cuts;
+    };
+
     limestone::api::log_entry log_entry_;
-    std::optional<limestone::api::log_entry> snapshot_log_entry_;
-    std::optional<limestone::api::log_entry> compacted_log_entry_;
-    std::optional<boost::filesystem::ifstream> snapshot_istrm_;
-    std::optional<boost::filesystem::ifstream> compacted_istrm_;
-    std::string previous_snapshot_key_sid;
-    std::string previous_compacted_key_sid;
-    std::map<limestone::api::storage_id_type, limestone::api::write_version_type> clear_storage_; 
+    std::vector<source> sources_;
+    // loser tree over sources_: tree_[0] is the winner, tree_[1..k-1] hold the losers of each match
+    std::vector<std::size_t> tree_;
+    bool started_{false};
+    // the clear_storage cutoffs sorted by cut_point::order
+    std::vector<cut_point> cut_points_;
+    std::optional<storage_id_type> storage_id_;
+    std::shared_ptr<snapshot_block_cache> block_cache_;
+
+    [[nodiscard]] bool precedes(std::size_t a, std::size_t b) const;
+    void build_tree();
+    void advance(std::size_t index);
+    void read_source(source& src);
+    const write_version_type* cutoff_of(cut_position& cuts, storage_id_type storage_id) const noexcept;
 
 protected:
-    void open(const boost::filesystem::path& file, std::optional<boost::filesystem::ifstream>& stream);
+    void open(const boost::filesystem::path& file, source& src);
     void close() override;
 
     bool next() override;
     void validate_and_read_stream(std::optional<boost::filesystem::ifstream>& stream, const std::string& stream_name, 
-                                  std::optional<limestone::api::log_entry>& log_entry, std::string& previous_key_sid);
+                                  std::optional<limestone::api::log_entry>& log_entry, std::string& previous_key_sid,
+                                  snapshot_block_reader* blocks = nullptr, cut_position* cuts = nullptr,
+                                  const storage_offset_table* offsets = nullptr);
 
     [[nodiscard]] limestone::api::storage_id_type storage() const noexcept override;
     void key(std::string& buf) const noexcept override;
     void value(std::string& buf) const noexcept override;
     std::vector<limestone::api::blob_id_type> blob_ids() const override;
     [[nodiscard]] limestone::api::log_entry::entry_type type() const override;
-    bool is_relevant_entry(const limestone::api::log_entry& entry);
+    bool is_relevant_entry(const limestone::api::log_entry& entry, const write_version_type* cutoff) const;
     [[nodiscard]] log_entry& current() override;
     // Making the cursor class a friend so that it can access protected members
     friend class limestone::api::cursor;
@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <thread>
 #include <unistd.h>
 #include <chrono>
@@ -40,16 +41,27 @@
 #include "log_entry.h"
 #include "online_compaction.h"
 #include "compaction_catalog.h"
+#include "compaction_estimator.h"
 #include "compaction_options.h"
+#include "compaction_scheduler.h"
+#include "io_rate_limiter.h"
 #include "blob_file_resolver.h"
 #include "blob_pool_impl.h"
 #include "blob_file_garbage_collector.h"
 #include "blob_file_gc_snapshot.h"
 #include "blob_file_scanner.h"
+#include "blob_dedup_index.h"
+#include "blob_file_syncer.h"
+#include "blob_io_executor.h"
+#include "blob_pack_store.h"
+#include "blob_read_cache.h"
+#include "persistent_blob_id_set.h"
 #include "datastore_impl.h"
 #include "manifest.h"
 #include "log_channel_impl.h"
 #include "dblog_scan.h"
+#include "storage_offset_table.h"
+#include "blob_reference_index.h"
 
 namespace {
 
@@ -90,12 +102,20 @@ void write_epoch_to_file_internal(const std::string& file_path, epoch_id_type ep
 namespace limestone::api {
 using namespace limestone::internal;
 
-datastore::datastore() noexcept: impl_(std::make_unique<datastore_impl>()) {
+datastore::datastore() noexcept
+    : persistent_blob_ids_(std::make_unique<persistent_blob_id_set>()),
+      blob_read_cache_(std::make_unique<blob_read_cache>(blob_read_cache::capacity_from_environment())),
+      impl_(std::make_unique<datastore_impl>()) {
     impl_->set_pid(::getpid());
 }
 
 
-datastore::datastore(configuration const& conf) : location_(conf.data_location_), impl_(std::make_unique<datastore_impl>()) { // NOLINT(readability-function-cognitive-complexity)
+datastore::datastore(configuration const& conf)
+    : location_(conf.data_location_),
+      persistent_blob_ids_(std::make_unique<persistent_blob_id_set>()),
+      blob_read_cache_(std::make_unique<blob_read_cache>(
+          conf.blob_read_cache_entries_ ? *conf.blob_read_cache_entries_ : blob_read_cache::capacity_from_environment())),
+      impl_(std::make_unique<datastore_impl>()) { // NOLINT(readability-function-cognitive-complexity)
     try {
         impl_->set_instance_id(conf.instance_id_);
         impl_->set_db_name(conf.db_name_);
@@ -145,6 +165,11 @@ datastore::datastore(configuration const& conf) : location_(conf.data_location_)
 
         add_file(compaction_catalog_path);
         compaction_catalog_ = std::make_unique<compaction_catalog>(compaction_catalog::from_catalog_file(location_));
+        for (const auto& stale_file : remove_stale_compacted_files(location_, *compaction_catalog_)) {
+            subtract_file(stale_file);
+            subtract_file(storage_offset_table::index_file_path(stale_file));
+            subtract_file(blob_reference_index::index_file_path(stale_file));
+        }
 
         epoch_file_path_ = location_ / std::string(limestone::internal::epoch_file_name);
         tmp_epoch_file_path_ = location_ / std::string(limestone::internal::tmp_epoch_file_name);
@@ -180,6 +205,33 @@ datastore::datastore(configuration const& conf) : location_(conf.data_location_)
                 LOG_AND_THROW_IO_EXCEPTION("fail to create directory: " + blob_root.string(), error);
             }
         }
+        auto pack_settings = blob_pack_store::settings::from_environment();
+        if (conf.blob_pack_max_bytes_) {
+            pack_settings.max_blob_bytes = *conf.blob_pack_max_bytes_;
+        }
+        if (conf.blob_pack_segment_bytes_ && *conf.blob_pack_segment_bytes_ > 0) {
+            pack_settings.segment_bytes = *conf.blob_pack_segment_bytes_;
+        }
+        blob_pack_store_ = std::make_unique<blob_pack_store>(*blob_file_resolver_, pack_settings);
+        blob_file_syncer_ = std::make_unique<blob_file_syncer>(blob_pack_store_.get());
+        auto dedup_entries = conf.blob_dedup_entries_ ? *conf.blob_dedup_entries_ : blob_dedup_index::capacity_from_environment();
+        if (dedup_entries > 0) {
+            blob_dedup_index_ = std::make_unique<blob_dedup_index>(
+                dedup_entries, conf.blob_dedup_max_file_bytes_.value_or(blob_dedup_index::default_max_file_bytes));
+        }
+        auto io_threads = conf.blob_io_threads_ && *conf.blob_io_threads_ > 0 ? *conf.blob_io_threads_ : blob_io_executor::thread_count_from_environment();
+        blob_io_executor_ = std::make_unique<blob_io_executor>(io_threads);
+
+        if (conf.blob_gc_snapshot_memory_) {
+            impl_->set_blob_gc_snapshot_memory(*conf.blob_gc_snapshot_memory_);
+        }
+        if (conf.compaction_io_rate_) {
+            auto io_settings = impl_->get_compaction_io_limiter().get_settings();
+            io_settings.bytes_per_second = *conf.compaction_io_rate_;
+            impl_->get_compaction_io_limiter().configure(io_settings);
+        }
+        impl_->set_compaction_sharding(conf.compaction_max_shards_.value_or(impl_->get_compaction_max_shards()),
+                                       conf.compaction_min_shard_bytes_.value_or(impl_->get_compaction_min_shard_bytes()));
         VLOG_LP(log_debug) << "datastore is created, location = " << location_.string();
     } catch (...) {
         HANDLE_EXCEPTION_AND_ABORT();
@@ -330,12 +382,13 @@ void datastore::ready() {
     try {
         blob_id_type max_blob_id =
             std::max(create_snapshot_and_get_max_blob_id_with_wal_started_log(), compaction_catalog_->get_max_blob_id());
-        blob_file_garbage_collector_ = std::make_unique<blob_file_garbage_collector>(*blob_file_resolver_);
+        blob_pack_store_->load();
+        blob_file_garbage_collector_ = std::make_unique<blob_file_garbage_collector>(*blob_file_resolver_, blob_pack_store_.get(),
+                                                                                    blob_read_cache_.get());
         blob_file_garbage_collector_->scan_blob_files(max_blob_id);
 
-        boost::filesystem::path compacted_file = location_ / limestone::internal::compaction_catalog::get_compacted_filename();
         boost::filesystem::path snapshot_file = location_ / std::string(snapshot::subdirectory_name_) / std::string(snapshot::file_name_);
-        blob_file_garbage_collector_->scan_snapshot(snapshot_file, compacted_file);
+        blob_file_garbage_collector_->scan_snapshot(snapshot_file, get_compacted_file_paths(location_, *compaction_catalog_));
 
         next_blob_id_.store(max_blob_id + 1);
 
@@ -378,12 +431,12 @@ void datastore::ready() {
 
 std::unique_ptr<snapshot> datastore::get_snapshot() const {
     check_after_ready(static_cast<const char*>(__func__));
-    return std::unique_ptr<snapshot>(new snapshot(location_, clear_storage));
+    return std::unique_ptr<snapshot>(new snapshot(location_, clear_storage, get_compacted_file_paths(location_, *compaction_catalog_)));
 }
 
 std::shared_ptr<snapshot> datastore::shared_snapshot() const {
     check_after_ready(static_cast<const char*>(__func__));
-    return std::shared_ptr<snapshot>(new snapshot(location_, clear_storage));
+    return std::shared_ptr<snapshot>(new snapshot(location_, clear_storage, get_compacted_file_paths(location_, *compaction_catalog_)));
 }
 
 log_channel& datastore::create_channel() {
@@ -475,7 +528,11 @@ void datastore::update_min_epoch_id(bool from_switch_epoch) {  // NOLINT(readabi
             std::lock_guard<std::mutex> lock(mtx_epoch_file_);
             if (to_be_epoch < epoch_id_to_be_recorded_.load()) {
                 break;
-            }           
+            }
+            // the BLOBs referenced by the entries of the epoch must be durable before the epoch is
+            if (blob_file_syncer_) {
+                blob_file_syncer_->sync();
+            }
             write_epoch_callback_(static_cast<epoch_id_type>(to_be_epoch));
             epoch_id_record_finished_.store(to_be_epoch);
             TRACE_FINE << "epoch_id_record_finished_ updated to " << to_be_epoch;
@@ -606,6 +663,9 @@ backup& datastore::begin_backup() {
         for (const auto& blob_file : scanner) {
             tmp_files.insert(blob_file);
         }
+        for (const auto& segment_file : blob_pack_store_->segment_files()) {
+            tmp_files.insert(segment_file);
+        }
         
         backup_ = std::unique_ptr<backup>(new backup(tmp_files, *impl_));
         return *backup_;
@@ -688,7 +748,7 @@ std::unique_ptr<backup_detail> datastore::begin_backup(backup_type btype) {  //
                     break;
                 }
                 case 'c': {
-                    if (filename == compaction_catalog::get_catalog_filename()) {
+                    if (filename == compaction_catalog::get_catalog_filename() || filename == compaction_catalog::get_journal_filename()) {
                         entries.emplace_back(ent.string(), dst, false, false);
                     }
                     break;
@@ -705,6 +765,9 @@ std::unique_ptr<backup_detail> datastore::begin_backup(backup_type btype) {  //
         for (const auto& src : scanner) {
             entries.emplace_back(src, src.filename(), false, false);
         }
+        for (const auto& src : blob_pack_store_->segment_files()) {
+            entries.emplace_back(src, src.filename(), false, false);
+        }
         
 
         return std::unique_ptr<backup_detail>(new backup_detail(entries, epoch_id_switched_.load(), *impl_));
@@ -723,36 +786,83 @@ void datastore::recover([[maybe_unused]] const epoch_tag& tag) const noexcept {
 }
 
 rotation_result datastore::rotate_log_files() {
+    return rotate_log_files_async().get();
+}
+
+std::future<rotation_result> datastore::rotate_log_files_async() {
     TRACE_START;
-    std::lock_guard<std::mutex> lock(rotate_mutex); 
-    TRACE << "start rotate_log_files() critical section";
-    auto epoch_id = epoch_id_switched_.load();
-    if (epoch_id == 0) {
-        LOG_AND_THROW_EXCEPTION("rotation requires epoch_id > 0, but got epoch_id = 0");
-    }
-    TRACE << "epoch_id = " << epoch_id;
+    epoch_id_type epoch_id{};
     {
-        on_rotate_log_files(); // for testing
-        // Wait until epoch_id_informed_ is less than rotated_epoch_id to ensure safe rotation.
-        std::unique_lock<std::mutex> ul(informed_mutex);
-        while (epoch_id_informed_.load() < epoch_id) {
-            cv_epoch_informed.wait(ul);  
+        // only the cut is taken under the lock; the renames are done by the channels and the returned task
+        std::lock_guard<std::mutex> lock(rotate_mutex);
+        epoch_id = epoch_id_switched_.load();
+        if (epoch_id == 0) {
+            LOG_AND_THROW_EXCEPTION("rotation requires epoch_id > 0, but got epoch_id = 0");
         }
-    }
-    TRACE << "end waiting for epoch_id_informed_ to catch up";
-    rotation_result result(epoch_id);
-    for (const auto& lc : log_channels_) {
-        boost::system::error_code error;
-        bool ret = boost::filesystem::exists(lc->file_path(), error);
-        if (!ret || error) {
-            continue;  // skip if not exists
+        for (const auto& lc : log_channels_) {
+            lc->request_rotation(epoch_id);
         }
-        std::string rotated_file = lc->do_rotate_file();
-        result.add_rotated_file(rotated_file);
+        rotation_cuts_.insert(epoch_id);
     }
-    result.set_rotation_end_files(get_files());
-    TRACE_END;
-    return result;
+    TRACE_END << "epoch_id = " << epoch_id;
+    return std::async(std::launch::async, [this, epoch_id]() {
+        // the rotated files are kept for the cuts of the rotations not completed yet,
+        // so the cut is released even if this rotation fails
+        auto release_cut = [this, epoch_id]() {
+            std::lock_guard<std::mutex> lock(rotate_mutex);
+            rotation_cuts_.erase(rotation_cuts_.find(epoch_id));
+            epoch_id_type oldest_cut = rotation_cuts_.empty() ? std::numeric_limits<epoch_id_type>::max() : *rotation_cuts_.begin();
+            for (const auto& lc : log_channels_) {
+                lc->forget_rotations_before(oldest_cut);
+            }
+        };
+        rotation_result result(epoch_id);
+        try {
+            on_rotate_log_files(); // for testing
+            for (;;) {
+                // the channels in a session are rotated once the session has ended, or at the next one
+                std::uint64_t progress{};
+                {
+                    std::lock_guard<std::mutex> lock(rotation_progress_mutex);
+                    progress = rotation_progress_;
+                }
+                for (const auto& lc : log_channels_) {
+                    lc->rotate_if_idle();
+                }
+                std::unique_lock<std::mutex> ul(rotation_progress_mutex);
+                if (std::all_of(log_channels_.begin(), log_channels_.end(),
+                                [epoch_id](const auto& lc) { return lc->has_rotated(epoch_id); })) {
+                    break;
+                }
+                cv_rotation_progress.wait(ul, [this, progress]() { return rotation_progress_ != progress; });
+            }
+            {
+                // Wait until epoch_id_informed_ catches up with the cut, so that the rotated files are durable.
+                std::unique_lock<std::mutex> ul(informed_mutex);
+                while (epoch_id_informed_.load() < epoch_id) {
+                    cv_epoch_informed.wait(ul);
+                }
+            }
+            for (const auto& lc : log_channels_) {
+                std::string rotated_file = lc->rotated_file(epoch_id);
+                if (!rotated_file.empty()) {
+                    result.add_rotated_file(rotated_file);
+                }
+            }
+        } catch (...) {
+            release_cut();
+            throw;
+        }
+        release_cut();
+        result.set_rotation_end_files(get_files());
+        return result;
+    });
+}
+
+void datastore::notify_rotation_progress() {
+    std::lock_guard<std::mutex> lock(rotation_progress_mutex);
+    rotation_progress_++;
+    cv_rotation_progress.notify_all();
 }
 
 void datastore::rotate_epoch_file() {
@@ -793,6 +903,13 @@ void datastore::subtract_file(const boost::filesystem::path& file) {
     files_.erase(file);
 }
 
+void datastore::replace_file(const boost::filesystem::path& from, const boost::filesystem::path& to) {
+    std::lock_guard<std::mutex> lock(mtx_files_);
+
+    files_.erase(from);
+    files_.insert(to);
+}
+
 std::set<boost::filesystem::path> datastore::get_files() {
     std::lock_guard<std::mutex> lock(mtx_files_);
 
@@ -831,19 +948,64 @@ void datastore::online_compaction_worker() {
         } 
     }
 
+    if (impl_->get_compaction_io_limiter().get_settings().idle_io_priority && set_idle_io_priority()) {
+        LOG_LP(INFO) << "online compaction runs in the idle I/O priority class";
+    }
+    compaction_scheduler scheduler(impl_->get_compaction_thresholds());
+
     std::unique_lock<std::mutex> lock(mtx_online_compaction_worker_);
 
     while (!stop_online_compaction_worker_.load()) {
+        bool requested = false;
+        std::optional<compaction_estimate> estimate{};
         if (boost::filesystem::exists(start_file)) {
             if (!boost::filesystem::remove(start_file)) {
                 LOG_LP(ERROR) << "failed to remove file: " << start_file.string();
                 return;
             }
+            requested = true;
+        } else if (impl_->get_compaction_thresholds().enabled()) {
+            try {
+                log_dir_usage usage = log_dir_usage::measure(location_, *compaction_catalog_);
+                auto now = compaction_scheduler::clock::now();
+                if (scheduler.needs_dead_ratio(usage, now)) {
+                    estimate = estimate_online_compaction(location_, *compaction_catalog_, recover_max_parallelism_,
+                                                          compaction_estimator::online_sample_bytes);
+                    usage.dead_ratio = estimate->dead_ratio();
+                }
+                auto fired = scheduler.check(usage, now);
+                if (fired != compaction_scheduler::trigger::none) {
+                    LOG_LP(INFO) << "start online compaction, trigger: " << fired
+                                 << ", pending_bytes: " << usage.pending_bytes
+                                 << ", pending_files: " << usage.pending_files
+                                 << ", compacted_bytes: " << usage.compacted_bytes;
+                    requested = true;
+                }
+            } catch (const limestone_exception& e) {
+                LOG_LP(WARNING) << "failed to check the log directory usage: " << e.what();
+            }
+        }
+        if (requested) {
+            try {
+                if (!estimate) {
+                    estimate = estimate_online_compaction(location_, *compaction_catalog_, recover_max_parallelism_,
+                                                          compaction_estimator::online_sample_bytes);
+                }
+                LOG_LP(INFO) << "online compaction estimate, input_bytes: " << estimate->input_bytes
+                             << ", estimated_output_bytes: " << estimate->estimated_output_bytes
+                             << ", dead_ratio: " << estimate->dead_ratio()
+                             << ", reclaimable_blob_bytes: " << estimate->reclaimable_blob_bytes
+                             << ", projected_duration_seconds: "
+                             << estimate->projected_duration(impl_->get_compaction_io_limiter().get_settings().bytes_per_second).count();
+            } catch (const limestone_exception& e) {
+                LOG_LP(WARNING) << "failed to estimate the online compaction: " << e.what();
+            }
             try {
                 compact_with_online();
             } catch (const limestone_exception& e) {
                 LOG_LP(ERROR) << "failed to compact with online: " << e.what();
             }
+            scheduler.compaction_finished(compaction_scheduler::clock::now());
         }
         cv_online_compaction_worker_.wait_for(lock, std::chrono::seconds(1), [this]() {
             return stop_online_compaction_worker_.load();
@@ -896,9 +1058,9 @@ void datastore::compact_with_online() {
 
 
     std::set<std::string> need_compaction_filenames = select_files_for_compaction(result.get_rotation_end_files(), detached_pwals);
-    if (need_compaction_filenames.empty() ||
-        (need_compaction_filenames.size() == 1 &&
-         need_compaction_filenames.find(compaction_catalog::get_compacted_filename()) != need_compaction_filenames.end())) {
+    if (std::all_of(need_compaction_filenames.begin(), need_compaction_filenames.end(), [](const std::string& filename) {
+            return compaction_catalog::get_compacted_generation(filename).has_value();
+        })) {
         VLOG_LP(log_debug) << "no files to compact";
         TRACE_END << "return compact_with_online() without compaction";
         return;
@@ -916,64 +1078,130 @@ void datastore::compact_with_online() {
     VLOG_LP(log_info) << "blob_file_gc_runnable: " << blob_file_gc_runnable;
     compaction_options options = [&]() -> compaction_options {
         if (blob_file_gc_runnable) {
-            auto gc_snapshot = std::make_unique<blob_file_gc_snapshot>(boundary_version_copy);
+            // the snapshot spills its sorted runs into the temporary directory beyond its memory limit
+            auto gc_snapshot = std::make_unique<blob_file_gc_snapshot>(boundary_version_copy, compaction_temp_dir,
+                                                                       impl_->get_blob_gc_snapshot_memory());
             return compaction_options{location_, compaction_temp_dir, recover_max_parallelism_, need_compaction_filenames, std::move(gc_snapshot)};
         }
         return compaction_options{location_, compaction_temp_dir, recover_max_parallelism_, need_compaction_filenames};
     }();
+    options.set_policy(impl_->get_compaction_policy());
+    std::size_t max_shards = impl_->get_compaction_max_shards();
+    options.set_sharding(max_shards == 0 ? static_cast<std::size_t>(recover_max_parallelism_) : max_shards,
+                         impl_->get_compaction_min_shard_bytes());
+    io_rate_limiter& io_limiter = impl_->get_compaction_io_limiter();
+    io_limiter.begin();
+    options.set_io_limiter(&io_limiter);
 
     // create a compacted file
     blob_id_type max_blob_id = create_compact_pwal_and_get_max_blob_id(options);
 
 
-    // handle existing compacted file
-    handle_existing_compacted_file(location_);
+    // handle existing compacted file, if the new compacted files replace the oldest generation
+    const std::vector<std::string>& output_file_names = options.get_output_file_names();
+    const bool replaces_oldest = output_file_names.front() == compaction_catalog::get_compacted_filename();
+    if (replaces_oldest) {
+        handle_existing_compacted_file(location_);
+    }
 
-    // move pwal_0000.compacted from the temp directory to the log directory
-    boost::filesystem::path compacted_file = location_ / compaction_catalog::get_compacted_filename();
-    boost::filesystem::path temp_compacted_file = compaction_temp_dir / compaction_catalog::get_compacted_filename();
-    safe_rename(temp_compacted_file, compacted_file);
+    // move the new compacted files (the shards of one generation) from the temp directory to the log directory
+    for (const auto& output_file_name : output_file_names) {
+        boost::filesystem::path compacted_file = location_ / output_file_name;
+        boost::filesystem::path temp_compacted_file = compaction_temp_dir / output_file_name;
+        boost::filesystem::path compacted_index_file = storage_offset_table::index_file_path(compacted_file);
+        boost::filesystem::path temp_compacted_index_file = storage_offset_table::index_file_path(temp_compacted_file);
+        boost::filesystem::path compacted_blob_index_file = blob_reference_index::index_file_path(compacted_file);
+        boost::filesystem::path temp_compacted_blob_index_file = blob_reference_index::index_file_path(temp_compacted_file);
+        remove_file_safely(compacted_index_file);
+        remove_file_safely(compacted_blob_index_file);
+        safe_rename(temp_compacted_file, compacted_file);
+        if (boost::filesystem::exists(temp_compacted_index_file)) {
+            safe_rename(temp_compacted_index_file, compacted_index_file);
+        }
+        if (boost::filesystem::exists(temp_compacted_blob_index_file)) {
+            safe_rename(temp_compacted_blob_index_file, compacted_blob_index_file);
+        }
+    }
 
     // get a set of all files in the location_ directory
     std::set<std::string> files_in_location = get_files_in_directory(location_);
-    
-    // check if detached_pwals exist in location_
-    for (auto it = detached_pwals.begin(); it != detached_pwals.end();) {
-        if (files_in_location.find(*it) == files_in_location.end()) {
-            VLOG_LP(log_debug) << "File " << *it << " does not exist in the directory and will be removed from detached_pwals.";
-            auto p = location_ / *it;
-            subtract_file(p);
-            it = detached_pwals.erase(it);  // Erase and move to the next iterator
-        } else {
-            ++it;  // Move to the next iterator
+
+    // update compaction catalog: only the changes are passed, so that its journal record stays small
+    compaction_catalog::changes delta{};
+    const std::set<std::string>& cataloged_pwals = compaction_catalog_->get_detached_pwals();
+
+    // check if detached_pwals exist in location_; the compacted generations are tracked as compacted files instead
+    for (const auto& pwal : detached_pwals) {
+        bool missing = files_in_location.find(pwal) == files_in_location.end();
+        if (missing) {
+            VLOG_LP(log_debug) << "File " << pwal << " does not exist in the directory and will be removed from detached_pwals.";
+            subtract_file(location_ / pwal);
+        }
+        bool cataloged = cataloged_pwals.find(pwal) != cataloged_pwals.end();
+        if (missing || compaction_catalog::get_compacted_generation(pwal)) {
+            if (cataloged) {
+                delta.removed_pwals.insert(pwal);
+            }
+        } else if (!cataloged) {
+            delta.added_pwals.insert(pwal);
         }
     }
 
-
-    // update compaction catalog
-    compacted_file_info compacted_file_info{compacted_file.filename().string(), 1};
-    detached_pwals.erase(compacted_file.filename().string());
+    // the merged generations are replaced by the new compacted files
+    const std::vector<std::string>& merged_generations = options.get_merged_generations();
+    const std::set<compacted_file_info>& cataloged_files = compaction_catalog_->get_compacted_files();
+    for (const auto& generation : merged_generations) {
+        for (auto it = cataloged_files.lower_bound(compacted_file_info{generation, std::numeric_limits<int>::min()});
+             it != cataloged_files.end() && it->get_file_name() == generation; ++it) {
+            delta.removed_files.insert(*it);
+        }
+    }
+    for (const auto& output_file_name : output_file_names) {
+        delta.added_files.insert(compacted_file_info{output_file_name, 1});
+    }
     max_blob_id = std::max(max_blob_id, compaction_catalog_->get_max_blob_id());
-    compaction_catalog_->update_catalog_file(result.get_epoch_id(), max_blob_id, {compacted_file_info}, detached_pwals);
-    add_file(compacted_file);
+    compaction_catalog_->update_catalog_file(result.get_epoch_id(), max_blob_id, delta);
+    // the journal exists only between checkpoints of the catalog
+    boost::filesystem::path catalog_journal = location_ / compaction_catalog::get_journal_filename();
+    if (boost::filesystem::exists(catalog_journal)) {
+        add_file(catalog_journal);
+    } else {
+        subtract_file(catalog_journal);
+    }
+    for (const auto& output_file_name : output_file_names) {
+        add_file(location_ / output_file_name);
+    }
 
-    // remove pwal_0000.compacted.prev
-    remove_file_safely(location_ / compaction_catalog::get_compacted_backup_filename());
+    // remove pwal_0000.compacted.prev and the merged generations
+    if (replaces_oldest) {
+        remove_file_safely(location_ / compaction_catalog::get_compacted_backup_filename());
+    }
+    for (const auto& merged : merged_generations) {
+        if (std::find(output_file_names.begin(), output_file_names.end(), merged) != output_file_names.end()) {
+            continue;
+        }
+        boost::filesystem::path merged_file = location_ / merged;
+        remove_file_safely(storage_offset_table::index_file_path(merged_file));
+        remove_file_safely(blob_reference_index::index_file_path(merged_file));
+        remove_file_safely(merged_file);
+        subtract_file(merged_file);
+    }
 
-    LOG_LP(INFO) << "compaction finished";
+    LOG_LP(INFO) << "compaction finished, io_bytes: " << io_limiter.charged_bytes()
+                 << ", throttled_us: " << io_limiter.throttled_time().count()
+                 << ", max_commit_latency_us: " << io_limiter.max_commit_latency().count()
+                 << ", tombstones_kept: " << options.get_kept_tombstones()
+                 << ", tombstones_purged: " << options.get_purged_tombstones();
 
     // blob files garbage collection
     VLOG_LP(log_info) << "options.is_gc_enabled(): " << options.is_gc_enabled() << ", impl_->is_backup_in_progress(): " << impl_->is_backup_in_progress();
     if (options.is_gc_enabled() && !impl_->is_backup_in_progress()) {
         LOG_LP(INFO) << "start blob files garbage collection";
         blob_file_garbage_collector_->scan_blob_files(next_blob_id_copy);
-        log_entry_container log_entries = options.get_gc_snapshot().finalize_snapshot();
         blob_file_garbage_collector_->start_add_gc_exempt_blob_ids();
-        for (const auto& entry : log_entries) {
-            for (const auto& blob_id : entry.get_blob_ids()) {
-                blob_file_garbage_collector_->add_gc_exempt_blob_id(blob_id);
-            }
-        }
+        options.get_gc_snapshot().finalize_snapshot([this](blob_id_type blob_id) {
+            blob_file_garbage_collector_->add_gc_exempt_blob_id(blob_id);
+        });
         blob_file_garbage_collector_->finalize_add_gc_exempt_blob_ids();
         LOG_LP(INFO) << "blob files garbage collection finished";
     }
@@ -1006,7 +1234,9 @@ std::unique_ptr<blob_pool> datastore::acquire_blob_pool() {
 
     // Create a blob_pool_impl instance by passing the ID generator lambda and blob_file_resolver.
     // This approach allows flexible configuration and dependency injection for the blob pool.
-    auto pool = std::make_unique<limestone::internal::blob_pool_impl>(id_generator, *blob_file_resolver_, *this);
+    auto pool = std::make_unique<limestone::internal::blob_pool_impl>(id_generator, *blob_file_resolver_, *this, blob_pack_store_.get(),
+                                                                      blob_file_syncer_.get(), blob_io_executor_.get(),
+                                                                      blob_dedup_index_.get());
     TRACE_END;
     return pool; // Return the constructed blob pool.
 }
@@ -1017,6 +1247,16 @@ blob_file datastore::get_blob_file(blob_id_type reference) {
     auto path = blob_file_resolver_->resolve_path(reference);
     bool available = reference < next_blob_id_.load(std::memory_order_acquire);
     if (available) {
+        try {
+            // a packed BLOB is read through its extracted copy
+            if (auto extracted = blob_pack_store_->extract(reference); extracted) {
+                TRACE_END << "path=" << extracted->string() << ", available=" << available;
+                return blob_file(*extracted, true);
+            }
+        } catch (const limestone_exception& e) {
+            LOG_LP(ERROR) << "Failed to extract packed blob: " << e.what();
+            return blob_file(path, false);
+        }
         try {
             available = boost::filesystem::exists(path);
         } catch (const boost::filesystem::filesystem_error& e) {
@@ -1028,6 +1268,27 @@ blob_file datastore::get_blob_file(blob_id_type reference) {
     return blob_file(path, available);
 }
 
+blob_view datastore::read_blob(blob_id_type reference) {
+    TRACE_START << "reference=" << reference;
+    auto file = get_blob_file(reference);
+    if (!file) {
+        TRACE_END << "available=false";
+        return blob_view{};
+    }
+    try {
+        auto view = blob_read_cache_->read(reference, file.path());
+        TRACE_END << "size=" << view.data().size();
+        return view;
+    } catch (const limestone_io_exception& e) {
+        if (e.error_code() == ENOENT) {
+            // removed by GC after get_blob_file() found it
+            TRACE_END << "available=false";
+            return blob_view{};
+        }
+        throw;
+    }
+}
+
 void datastore::switch_available_boundary_version(write_version_type version) {
     TRACE_FINE_START << "version=" << version.get_major() << "." << version.get_minor();
     {
@@ -1045,27 +1306,19 @@ void datastore::switch_available_boundary_version(write_version_type version) {
 }
 
 void datastore::add_persistent_blob_ids(const std::vector<blob_id_type>& blob_ids) {
-    std::lock_guard<std::mutex> lock(persistent_blob_ids_mutex_);
-    for (const auto& blob_id : blob_ids) {
-        persistent_blob_ids_.insert(blob_id);
-    }
+    persistent_blob_ids_->add(blob_ids);
 }
 
 
 std::vector<blob_id_type> datastore::check_and_remove_persistent_blob_ids(const std::vector<blob_id_type>& blob_ids) {
-    std::lock_guard<std::mutex> lock(persistent_blob_ids_mutex_);
-    std::vector<blob_id_type> not_found_blob_ids;
-
-    for (const auto& blob_id : blob_ids) {
-        auto it = persistent_blob_ids_.find(blob_id);
-        if (it != persistent_blob_ids_.end()) {
-            persistent_blob_ids_.erase(it);
-        } else {
-            not_found_blob_ids.push_back(blob_id);
-        }
-    }
+    auto blob_ids_to_remove = persistent_blob_ids_->check_and_remove(blob_ids);
+    // the caller removes these BLOB files, which should not be kept mapped
+    blob_read_cache_->evict(blob_ids_to_remove);
+    return blob_ids_to_remove;
+}
 
-    return not_found_blob_ids;
+std::set<blob_id_type> datastore::get_persistent_blob_ids_for_tests() noexcept {
+    return persistent_blob_ids_->to_set();
 }
 
 void datastore::wait_for_blob_file_garbace_collector_for_tests() const noexcept {
@@ -37,6 +37,7 @@
 #endif
 
 #include <replication/replica_connector.h>
+#include <environment_helper.h>
 #include <limestone_exception_helper.h>
 #include <replication/message_session_begin.h>
 #include <replication/message_log_channel_create.h>
@@ -63,6 +64,7 @@ datastore_impl::datastore_impl()
     LOG_LP(INFO) << "REPLICATION_ASYNC_GROUP_COMMIT: "
                  << (async_group_commit_enabled_ ? "enabled" : "disabled");
     initialize_rdma_slots();
+    initialize_compaction_sharding();
 
     bool has_replica = replication_endpoint_.is_valid();
     replica_exists_.store(has_replica, std::memory_order_release);
@@ -539,6 +541,56 @@ void datastore_impl::set_migration_info(const manifest::migration_info& info) no
     migration_info_ = info;
 }
 
+const limestone::internal::compaction_policy& datastore_impl::get_compaction_policy() const noexcept {
+    return compaction_policy_;
+}
+
+void datastore_impl::set_compaction_policy(const limestone::internal::compaction_policy& policy) noexcept {
+    compaction_policy_ = policy;
+}
+
+const limestone::internal::compaction_scheduler::thresholds& datastore_impl::get_compaction_thresholds() const noexcept {
+    return compaction_thresholds_;
+}
+
+void datastore_impl::set_compaction_thresholds(const limestone::internal::compaction_scheduler::thresholds& limits) noexcept {
+    compaction_thresholds_ = limits;
+}
+
+limestone::internal::io_rate_limiter& datastore_impl::get_compaction_io_limiter() noexcept {
+    return compaction_io_limiter_;
+}
+
+std::size_t datastore_impl::get_compaction_max_shards() const noexcept {
+    return compaction_max_shards_;
+}
+
+std::uint64_t datastore_impl::get_compaction_min_shard_bytes() const noexcept {
+    return compaction_min_shard_bytes_;
+}
+
+void datastore_impl::set_compaction_sharding(std::size_t max_shards, std::uint64_t min_shard_bytes) noexcept {
+    compaction_max_shards_ = max_shards;
+    compaction_min_shard_bytes_ = min_shard_bytes;
+}
+
+std::size_t datastore_impl::get_blob_gc_snapshot_memory() const noexcept {
+    return blob_gc_snapshot_memory_;
+}
+
+void datastore_impl::set_blob_gc_snapshot_memory(std::size_t memory_bytes) noexcept {
+    blob_gc_snapshot_memory_ = memory_bytes;
+}
+
+void datastore_impl::initialize_compaction_sharding() {
+    if (auto value = limestone::internal::read_unsigned_environment("LIMESTONE_COMPACTION_SHARDS")) {
+        compaction_max_shards_ = static_cast<std::size_t>(*value);
+    }
+    if (auto value = limestone::internal::read_unsigned_environment("LIMESTONE_COMPACTION_MIN_SHARD_MB")) {
+        compaction_min_shard_bytes_ = *value * 1024UL * 1024UL;
+    }
+}
+
 void datastore_impl::generate_hmac_secret_key() {
     // Generate 16 random bytes using OpenSSL RAND_bytes()
     // TODO: Future improvement - throw exception instead of abort when public API allows it
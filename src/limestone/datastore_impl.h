@@ -27,6 +27,10 @@
 #include <cstdint>
 #include <functional>
 
+#include "blob_reference_sorter.h"
+#include "compaction_policy.h"
+#include "compaction_scheduler.h"
+#include "io_rate_limiter.h"
 #include "manifest.h"
 #include "replication/replica_connector.h"
 #include "replication/replication_endpoint.h"
@@ -129,6 +133,36 @@ public:
     // Setter for migration_info_
     void set_migration_info(const manifest::migration_info& info) noexcept;
 
+    // Getter for the policy selecting the compacted generations merged by online compaction
+    [[nodiscard]] const limestone::internal::compaction_policy& get_compaction_policy() const noexcept;
+
+    // Setter for the policy selecting the compacted generations merged by online compaction
+    void set_compaction_policy(const limestone::internal::compaction_policy& policy) noexcept;
+
+    // Getter for the thresholds of the automatic online compaction
+    [[nodiscard]] const limestone::internal::compaction_scheduler::thresholds& get_compaction_thresholds() const noexcept;
+
+    // Setter for the thresholds of the automatic online compaction, effective only before ready()
+    void set_compaction_thresholds(const limestone::internal::compaction_scheduler::thresholds& limits) noexcept;
+
+    // Getter for the limiter of the online compaction I/O, which the log channels report their commit latency to
+    [[nodiscard]] limestone::internal::io_rate_limiter& get_compaction_io_limiter() noexcept;
+
+    // Getter for the maximum number of key-range shards of a compacted file, 0 means the recover parallelism
+    [[nodiscard]] std::size_t get_compaction_max_shards() const noexcept;
+
+    // Getter for the minimum size of a key-range shard of a compacted file
+    [[nodiscard]] std::uint64_t get_compaction_min_shard_bytes() const noexcept;
+
+    // Setter for the key-range sharding of the compacted files written by online compaction
+    void set_compaction_sharding(std::size_t max_shards, std::uint64_t min_shard_bytes) noexcept;
+
+    // Getter for the memory the BLOB GC snapshot uses before spilling its sorted runs
+    [[nodiscard]] std::size_t get_blob_gc_snapshot_memory() const noexcept;
+
+    // Setter for the memory the BLOB GC snapshot uses before spilling its sorted runs
+    void set_blob_gc_snapshot_memory(std::size_t memory_bytes) noexcept;
+
     /**
      * @brief gets the HMAC secret key for BLOB reference tag generation.
      * @return reference to the HMAC secret key.
@@ -277,6 +311,24 @@ private:
     // Migration info for the manifest
     std::optional<manifest::migration_info> migration_info_;
 
+    // Policy for merging compacted generations in online compaction
+    limestone::internal::compaction_policy compaction_policy_{};
+
+    // Thresholds of the automatic online compaction
+    limestone::internal::compaction_scheduler::thresholds compaction_thresholds_{
+        limestone::internal::compaction_scheduler::thresholds::from_environment()};
+
+    // Limiter of the online compaction I/O
+    limestone::internal::io_rate_limiter compaction_io_limiter_{
+        limestone::internal::io_rate_limiter::settings::from_environment()};
+
+    // Key-range sharding of the compacted files
+    std::size_t compaction_max_shards_{0};
+    std::uint64_t compaction_min_shard_bytes_{256UL * 1024UL * 1024UL};
+
+    // Memory limit of the BLOB GC snapshot
+    std::size_t blob_gc_snapshot_memory_{limestone::internal::blob_reference_sorter::memory_limit_from_environment()};
+
     // HMAC secret key for BLOB reference tag generation (16 bytes)
     std::array<std::uint8_t, 16> hmac_secret_key_{};
 
@@ -295,6 +347,8 @@ private:
      */
     void initialize_rdma_slots();
 
+    void initialize_compaction_sharding();
+
     // RDMA sender owned by master for RDMA replication path.
     std::unique_ptr<rdma_sender_base> rdma_sender_{};
 
@@ -20,6 +20,7 @@
 #include <limestone/status.h>
 
 #include "blob_file_resolver.h"
+#include "compaction_catalog.h"
 #include "internal.h"
 #include "logging_helper.h"
 #include "manifest.h"
@@ -45,6 +46,13 @@ status purge_dir(const boost::filesystem::path& dir) {
         LOG_LP(ERROR) << "Failed to iterate directory: " << ex.what() << " dir = " << dir.string();
         return status::err_permission_error;
     }
+    // the BLOB files restored are not known to the scan state of the garbage collector
+    boost::filesystem::path scan_state = blob_file_resolver{dir}.get_scan_state_path();
+    boost::system::error_code ec;
+    if (!boost::filesystem::remove(scan_state, ec) && ec && ec != boost::system::errc::no_such_file_or_directory) {
+        LOG_LP(ERROR) << "Failed to remove file: " << scan_state.string() << " Error: " << ec.message();
+        return status::err_permission_error;
+    }
     return status::ok;
 }
 
@@ -56,7 +64,14 @@ namespace {
 using namespace limestone;
 using namespace limestone::internal;
 
-status check_manifest(const boost::filesystem::path& manifest_path) {
+/**
+ * @brief Checks the persistent format version of a backup.
+ *
+ * @param manifest_path The manifest file of the backup.
+ * @param file_names The names of the files in the backup.
+ * @return status::ok if the backup can be restored, otherwise an error status.
+ */
+status check_manifest(const boost::filesystem::path& manifest_path, const std::vector<std::string>& file_names) {
     std::string ver_err;
     int vc = internal::manifest::is_supported_version(manifest_path, ver_err);
     if (vc == 0) {
@@ -68,6 +83,18 @@ status check_manifest(const boost::filesystem::path& manifest_path) {
         LOG(ERROR) << "/:limestone backup data is corrupted, can not use.";
         return status::err_broken_data;
     }
+    if (vc < internal::manifest::compacted_generations_persistent_format_version) {
+        // a backup of an older version has only pwal_0000.compacted; other compacted files were
+        // written by a build which did not mark the directory, and are ignored by the builds of its version
+        for (const auto& name : file_names) {
+            auto parsed = compaction_catalog::parse_compacted_filename(name);
+            if (parsed && *parsed != std::make_pair(std::uint64_t{0}, std::size_t{0})) {
+                LOG(ERROR) << version_error_prefix << " (version mismatch: version " << vc << " backup contains " << name
+                           << ", which requires version " << internal::manifest::compacted_generations_persistent_format_version << ")";
+                return status::err_broken_data;
+            }
+        }
+    }
     return status::ok;
 }
 
@@ -79,6 +106,11 @@ status check_manifest(const boost::filesystem::path& manifest_path) {
  * @return status::ok if validation succeeds, otherwise an error status.
  */
 status validate_manifest_files(const boost::filesystem::path& from_dir, const std::vector<file_set_entry>& entries) {
+    std::vector<std::string> file_names;
+    file_names.reserve(entries.size());
+    for (const auto& ent : entries) {
+        file_names.emplace_back(ent.destination_path().filename().string());
+    }
     int manifest_count = 0;
     for (auto & ent : entries) {
         if (ent.destination_path().string() != internal::manifest::file_name) {
@@ -99,7 +131,7 @@ status validate_manifest_files(const boost::filesystem::path& from_dir, const st
             LOG_LP(ERROR) << "Filesystem error: " << ex.what() << " file = " << src.string();
             return status::err_permission_error;
         }
-        if (auto rc = check_manifest(src); rc != status::ok) {
+        if (auto rc = check_manifest(src, file_names); rc != status::ok) {
             return rc;
         }
         manifest_count++;
@@ -138,7 +170,14 @@ status copy_backup_files(const boost::filesystem::path& from_dir, const std::vec
             return status::err_not_found;
         }
         try {
-            if (!resolver.is_blob_file(src)) {
+            if (resolver.is_pack_file(src)) {
+                boost::filesystem::create_directories(resolver.get_pack_directory());
+                std::filesystem::copy_file(
+                    std::filesystem::path{src.string()},
+                    std::filesystem::path{(resolver.get_pack_directory() / src.filename()).string()},
+                    std::filesystem::copy_options::overwrite_existing
+                );
+            } else if (!resolver.is_blob_file(src)) {
                 std::filesystem::copy_file(
                     std::filesystem::path{src.string()},
                     std::filesystem::path{(location / dst).string()},
@@ -187,14 +226,30 @@ status datastore::restore(std::string_view from, bool keep_backup) const noexcep
         LOG_LP(ERROR) << "Filesystem error: " << ex.what() << " file = " << manifest_path.string();
         return status::err_permission_error;
     }
-    if (auto rc = check_manifest(manifest_path); rc != status::ok) { return rc; }
+    std::vector<std::string> file_names;
+    try {
+        for (const boost::filesystem::path& p : boost::filesystem::directory_iterator(from_dir)) {
+            file_names.emplace_back(p.filename().string());
+        }
+    } catch (const boost::filesystem::filesystem_error& ex) {
+        LOG_LP(ERROR) << "Failed to iterate directory: " << ex.what() << " dir = " << from_dir.string();
+        return status::err_permission_error;
+    }
+    if (auto rc = check_manifest(manifest_path, file_names); rc != status::ok) { return rc; }
 
     if (auto rc = internal::purge_dir(location_); rc != status::ok) { return rc; }
 
     try {
         for (const boost::filesystem::path& p : boost::filesystem::directory_iterator(from_dir)) {
             try {
-                if (!resolver.is_blob_file(p)) {
+                if (resolver.is_pack_file(p)) {
+                    boost::filesystem::create_directories(resolver.get_pack_directory());
+                    std::filesystem::copy_file(
+                        std::filesystem::path{p.string()},
+                        std::filesystem::path{(resolver.get_pack_directory() / p.filename()).string()},
+                        std::filesystem::copy_options::overwrite_existing
+                    );
+                } else if (!resolver.is_blob_file(p)) {
                     std::filesystem::copy_file(
                         std::filesystem::path{p.string()},
                         std::filesystem::path{(location_ / p.filename()).string()},
@@ -15,11 +15,19 @@
  */
 
 #include <byteswap.h>
+#include <algorithm>
+#include <atomic>
 #include <boost/filesystem/fstream.hpp>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
 
 #include <glog/logging.h>
 #include <limestone/logging.h>
@@ -31,9 +39,13 @@
 #include "dblog_scan.h"
 #include "internal.h"
 #include "log_entry.h"
+#include "online_compaction.h"
 #include "sortdb_wrapper.h"
 #include "snapshot_impl.h"
 #include "sorting_context.h"
+#include "snapshot_block_writer.h"
+#include "storage_offset_table.h"
+#include "blob_reference_index.h"
 
 namespace  {
 using namespace limestone;
@@ -42,6 +54,37 @@ using namespace limestone::internal;
 constexpr std::size_t write_version_size = sizeof(epoch_id_type) + sizeof(std::uint64_t);
 static_assert(write_version_size == 16);
 
+/**
+ * @brief records the current file offset into the table when the entry to be written starts a new storage,
+ * and the write version of the entry as it is written to the file
+ */
+void record_storage_offset(storage_offset_table& offsets, FILE* ostrm, std::string_view key_sid, std::string_view value_etc) {
+    storage_id_type st_bytes{};
+    memcpy(static_cast<void*>(&st_bytes), key_sid.data(), sizeof(storage_id_type));
+    storage_id_type st = le64toh(st_bytes);
+    if (!offsets.is_current(st)) {
+        auto pos = ftell(ostrm);
+        if (pos < 0) {
+            LOG_AND_THROW_IO_EXCEPTION("ftell failed", errno);
+        }
+        offsets.record(st, static_cast<std::uint64_t>(pos));
+    }
+    offsets.record_write_version(write_version_type(log_entry::write_version_epoch_number(value_etc),
+                                                    log_entry::write_version_minor_write_version(value_etc)));
+}
+
+/**
+ * @brief closes the table at the current end of the file and writes it next to @p data_file
+ */
+void finish_storage_offsets(storage_offset_table& offsets, FILE* ostrm, const boost::filesystem::path& data_file) {
+    auto pos = ftell(ostrm);
+    if (pos < 0) {
+        LOG_AND_THROW_IO_EXCEPTION("ftell failed", errno);
+    }
+    offsets.finish(static_cast<std::uint64_t>(pos));
+    offsets.write_file(storage_offset_table::index_file_path(data_file));
+}
+
 [[maybe_unused]]
 void store_bswap64_value(void *dest, const void *src) {
     auto* p64_dest = reinterpret_cast<std::uint64_t*>(dest);  // NOLINT(*-reinterpret-cast)
@@ -127,7 +170,67 @@ void insert_twisted_entry(sortdb_wrapper* sortdb, const log_entry& e) {
     sortdb->put(db_key, db_value);
 }
 
-std::pair<epoch_id_type, sorting_context> create_sorted_from_wals(compaction_options &options) {
+/**
+ * @brief samples key_sid weighted by bytes, to split the key space of a compaction into ranges of about the same size
+ */
+class key_range_sampler {
+public:
+    /**
+     * @param interval a sample is taken every this many bytes passed to add()
+     */
+    explicit key_range_sampler(std::uint64_t interval) : interval_(std::max<std::uint64_t>(interval, 1)) {}
+
+    /**
+     * @brief counts an entry, and takes it as a sample at every interval; this may be called from several threads at once
+     */
+    void add(std::string_view key_sid, std::uint64_t bytes) {
+        std::uint64_t before = counted_.fetch_add(bytes, std::memory_order_relaxed);
+        if (before / interval_ == (before + bytes) / interval_) {
+            return;
+        }
+        add_sample(std::string(key_sid), interval_);
+    }
+
+    /**
+     * @brief adds a sample standing for @p weight bytes starting at @p key_sid
+     */
+    void add_sample(std::string key_sid, std::uint64_t weight) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        samples_.emplace_back(std::move(key_sid), weight);
+    }
+
+    /**
+     * @brief returns at most @p count - 1 increasing keys splitting the samples into ranges of about the same weight
+     */
+    [[nodiscard]] std::vector<std::string> split_keys(std::size_t count) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::sort(samples_.begin(), samples_.end());
+        std::uint64_t total = 0;
+        for (const auto& sample : samples_) {
+            total += sample.second;
+        }
+        std::vector<std::string> keys{};
+        std::uint64_t accumulated = 0;
+        for (const auto& [key_sid, weight] : samples_) {
+            if (keys.size() + 1 >= count) {
+                break;
+            }
+            if (accumulated > 0 && accumulated >= total / count * (keys.size() + 1) && (keys.empty() || keys.back() < key_sid)) {
+                keys.emplace_back(key_sid);
+            }
+            accumulated += weight;
+        }
+        return keys;
+    }
+
+private:
+    std::uint64_t interval_;
+    std::atomic<std::uint64_t> counted_{0};
+    std::mutex mtx_{};
+    std::vector<std::pair<std::string, std::uint64_t>> samples_{};
+};
+
+std::pair<epoch_id_type, sorting_context> create_sorted_from_wals(compaction_options &options, key_range_sampler* sampler = nullptr) {
     auto from_dir = options.get_from_dir();
     auto file_names = options.get_file_names();
     auto num_worker = options.get_num_worker();
@@ -147,7 +250,12 @@ std::pair<epoch_id_type, sorting_context> create_sorted_from_wals(compaction_opt
     const auto add_entry_to_point = insert_entry_or_update_to_max;
     bool works_with_multi_thread = false;
 #endif
-    auto add_entry = [&sctx, &add_entry_to_point, &options](const log_entry& e){
+    auto add_entry = [&sctx, &add_entry_to_point, &options, sampler](const log_entry& e){
+        // the entry is read from the WAL file and written to the sort database
+        options.charge_io(2 * (e.key_sid().size() + e.value_etc().size()));
+        if (sampler != nullptr) {
+            sampler->add(e.key_sid(), e.key_sid().size() + e.value_etc().size());
+        }
         switch (e.type()) {
         case log_entry::entry_type::normal_with_blob:
             if (options.is_gc_enabled()) {
@@ -271,9 +379,21 @@ std::pair<std::string, std::string_view> split_db_value_and_blob_ids(const std::
 
 
 
+/**
+ * @brief range [begin, end) of key_sid, where an empty begin is the first key and std::nullopt end is past the last key
+ */
+struct key_range {
+    std::string begin{};
+    std::optional<std::string> end{};
+
+    [[nodiscard]] bool is_before(std::string_view key_sid) const noexcept { return key_sid < std::string_view(begin); }
+    [[nodiscard]] bool is_after(std::string_view key_sid) const noexcept { return end && key_sid >= std::string_view(*end); }
+};
+
 void sortdb_foreach(
     [[maybe_unused]]  compaction_options &options,
     sorting_context& sctx,
+    const key_range& range,
     const std::function<void(
         const log_entry::entry_type entry_type,
         const std::string_view key_sid,
@@ -281,24 +401,40 @@ void sortdb_foreach(
         const std::string_view blob_ids
     )>& write_snapshot_entry) {
     static_assert(sizeof(log_entry::entry_type) == 1);
+    if (sctx.get_sortdb() == nullptr) {
+        return;  // no unsorted input
+    }
+    // looked up without the lock of sorting_context, as this may run in several threads for disjoint key ranges
+    const std::map<storage_id_type, write_version_type> clear_storage = sctx.get_clear_storage();
+    auto clear_storage_find = [&clear_storage](storage_id_type st) -> std::optional<write_version_type> {
+        if (auto it = clear_storage.find(st); it != clear_storage.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    };
 #if defined SORT_METHOD_PUT_ONLY
-    sctx.get_sortdb()->each([&sctx, &write_snapshot_entry, last_key = std::string{}](const std::string_view db_key, const std::string_view db_value) mutable {
+    // the largest write version comes first for the same key
+    std::string seek_key = range.begin.empty() ? std::string{} : std::string(write_version_size, '\xff') + range.begin;
+    sctx.get_sortdb()->each_from(seek_key, [&sctx, &clear_storage_find, &range, &write_snapshot_entry, last_key = std::string{}](const std::string_view db_key, const std::string_view db_value) mutable {
         // using the first entry in GROUP BY (original-)key
         // NB: max versions comes first (by the custom-comparator)
         std::string_view key(db_key.data() + write_version_size, db_key.size() - write_version_size);
+        if (range.is_after(key)) {
+            return false;
+        }
         if (key == last_key) {  // same (original-)key with prev
-            return; // skip
+            return true; // skip
         }
         last_key.assign(key);
         storage_id_type st_bytes{};
         memcpy(static_cast<void*>(&st_bytes), key.data(), sizeof(storage_id_type));
         storage_id_type st = le64toh(st_bytes);
 
-        if (auto ret = sctx.clear_storage_find(st); ret) {
+        if (auto ret = clear_storage_find(st); ret) {
             // check range delete
             write_version_type range_ver = ret.value();
             if (extract_write_version(db_key) < range_ver) {
-                return;  // skip
+                return true;  // skip
             }
         }
 
@@ -318,18 +454,22 @@ void sortdb_foreach(
                 LOG(ERROR) << "never reach " << static_cast<int>(entry_type);
                 std::abort();
         }
+        return true;
     });
 #else
-    sctx.get_sortdb()->each([&sctx, &write_snapshot_entry](const std::string_view db_key, const std::string_view db_value) {
+    sctx.get_sortdb()->each_from(range.begin, [&sctx, &clear_storage_find, &range, &write_snapshot_entry](const std::string_view db_key, const std::string_view db_value) {
+        if (range.is_after(db_key)) {
+            return false;
+        }
         storage_id_type st_bytes{};
         memcpy(static_cast<void*>(&st_bytes), db_key.data(), sizeof(storage_id_type));
         storage_id_type st = le64toh(st_bytes);
-        if (auto ret = sctx.clear_storage_find(st); ret) {
+        if (auto ret = clear_storage_find(st); ret) {
             // check range delete
             write_version_type range_ver = ret.value();
             write_version_type point_ver{db_value.substr(1)};
             if (point_ver < range_ver) {
-                return;  // skip
+                return true;  // skip
             }
         }
         auto entry_type = static_cast<log_entry::entry_type>(db_value[0]);
@@ -348,16 +488,469 @@ void sortdb_foreach(
                 LOG(ERROR) << "never reach " << static_cast<int>(entry_type);
                 std::abort();
         }
+        return true;
     });
 #endif
 }
 
+/**
+ * @brief reads the entries of an existing compacted file in key_sid order, for merging them into a new compacted file
+ */
+class compacted_file_reader {
+public:
+    /**
+     * @param file the compacted file
+     * @param range the key range to read; the reader starts at the storage of the first key using
+     *        the storage index of the file if it is available
+     */
+    explicit compacted_file_reader(const boost::filesystem::path& file, key_range range = {})
+        : file_(file), range_(std::move(range)), istrm_(file, std::ios_base::in | std::ios_base::binary) {
+        if (!istrm_.is_open()) {
+            LOG_AND_THROW_IO_EXCEPTION("cannot open compacted file (" + file.string() + ")", errno);
+        }
+        if (!range_.begin.empty()) {
+            seek_to_range();
+        }
+        advance();
+    }
+
+    /**
+     * @brief returns the current entry, or nullptr at the end of the file
+     * @note a compacted file of a newer generation may contain remove_entry
+     */
+    [[nodiscard]] const log_entry* head() const noexcept { return has_head_ ? &entry_ : nullptr; }
+
+    void advance() {
+        while (entry_.read(istrm_)) {
+            if (entry_.type() == log_entry::entry_type::normal_entry || entry_.type() == log_entry::entry_type::normal_with_blob
+                || entry_.type() == log_entry::entry_type::remove_entry) {
+                if (!previous_key_sid_.empty() && entry_.key_sid() <= previous_key_sid_) {
+                    LOG_AND_THROW_EXCEPTION("compacted file is not sorted (" + file_.string() + ")");
+                }
+                previous_key_sid_ = entry_.key_sid();
+                if (range_.is_before(entry_.key_sid())) {
+                    continue;
+                }
+                has_head_ = !range_.is_after(entry_.key_sid());
+                return;
+            }
+        }
+        has_head_ = false;
+    }
+
+private:
+    // Entries of the storages ordered before the storage of the first key precede it in the file,
+    // so reading can start at the end of the last of them, or at the start of the storage itself.
+    void seek_to_range() {
+        auto table = storage_offset_table::load_for(file_);
+        if (!table || range_.begin.size() < sizeof(storage_id_type)) {
+            return;
+        }
+        std::string_view begin_sid(range_.begin.data(), sizeof(storage_id_type));
+        std::uint64_t offset = 0;
+        for (const auto& [storage_id, storage_range] : table->ranges()) {
+            storage_id_type le = htole64(storage_id);
+            std::string_view sid(reinterpret_cast<const char*>(&le), sizeof(le));  // NOLINT(*-reinterpret-cast)
+            if (sid < begin_sid) {
+                offset = std::max(offset, storage_range.end);
+            } else if (sid == begin_sid) {
+                offset = std::max(offset, storage_range.begin);
+            }
+        }
+        istrm_.seekg(static_cast<std::streamoff>(offset));
+    }
+
+    boost::filesystem::path file_;
+    key_range range_;
+    boost::filesystem::ifstream istrm_;
+    log_entry entry_{};
+    std::string previous_key_sid_{};
+    bool has_head_{false};
+};
+
+/**
+ * @brief merges the entries of several compacted generations in key_sid order
+ */
+class compacted_generation_merger {
+public:
+    /**
+     * @param files the compacted files, ordered from the newest generation to the oldest;
+     *        the shards of a generation hold disjoint key ranges, so they may be in any order
+     * @param range the key range to merge
+     */
+    explicit compacted_generation_merger(const std::vector<boost::filesystem::path>& files, const key_range& range = {}) {
+        readers_.reserve(files.size());
+        for (const auto& file : files) {
+            readers_.emplace_back(std::make_unique<compacted_file_reader>(file, range));
+        }
+    }
+
+    /**
+     * @brief returns the smallest key_sid among the generations, or std::nullopt if all of them are exhausted
+     */
+    [[nodiscard]] std::optional<std::string> min_key_sid() const {
+        const log_entry* min = nullptr;
+        for (const auto& reader : readers_) {
+            if (const auto* e = reader->head(); e != nullptr && (min == nullptr || e->key_sid() < min->key_sid())) {
+                min = e;
+            }
+        }
+        return min != nullptr ? std::optional<std::string>(min->key_sid()) : std::nullopt;
+    }
+
+    /**
+     * @brief consumes the entries of the key from all generations, newest first
+     * @param key_sid the key_sid to consume
+     * @param consume called with each entry, and whether a newer generation has the same key
+     */
+    void take(std::string_view key_sid, const std::function<void(const log_entry&, bool)>& consume) {
+        bool superseded = false;
+        for (auto& reader : readers_) {
+            if (const auto* e = reader->head(); e != nullptr && std::string_view(e->key_sid()) == key_sid) {
+                consume(*e, superseded);
+                superseded = true;
+                reader->advance();
+            }
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<compacted_file_reader>> readers_{};
+};
+
+/**
+ * @brief tells whether a remove_entry still hides an entry of the older compacted files
+ * @details A remove_entry is needed only while an older file has an entry of the same key,
+ *          otherwise it is purged. Files without the storage of the key are skipped using their
+ *          storage index, and the others are read forward from the key, so the keys must be
+ *          queried in key_sid order.
+ */
+class tombstone_filter {
+public:
+    /**
+     * @param files the older compacted files the remove entries may hide entries of
+     */
+    explicit tombstone_filter(std::vector<boost::filesystem::path> files) : files_(std::move(files)) {
+        for (const auto& file : files_) {
+            std::optional<std::set<storage_id_type>> storages{};
+            if (auto table = storage_offset_table::load_for(file); table) {
+                storages.emplace();
+                for (const auto& [storage_id, storage_range] : table->ranges()) {
+                    storages->insert(storage_id);
+                }
+            }
+            storages_.emplace_back(std::move(storages));
+        }
+        readers_.resize(files_.size());
+        reader_storages_.resize(files_.size());
+    }
+
+    /**
+     * @brief returns whether the remove_entry of the key must be kept, and counts it as kept or purged
+     */
+    bool shadows(std::string_view key_sid) {
+        storage_id_type st_bytes = 0;
+        memcpy(static_cast<void*>(&st_bytes), key_sid.data(), sizeof(storage_id_type));
+        storage_id_type st = le64toh(st_bytes);
+        bool found = false;
+        for (std::size_t i = 0; i < files_.size() && !found; i++) {
+            if (storages_[i] && storages_[i]->find(st) == storages_[i]->end()) {
+                continue;
+            }
+            // a reader is repositioned when the storage changes, not to read the storages in between
+            if (!readers_[i] || reader_storages_[i] != st) {
+                readers_[i] = std::make_unique<compacted_file_reader>(files_[i], key_range{std::string(key_sid), std::nullopt});
+                reader_storages_[i] = st;
+            }
+            auto& reader = *readers_[i];
+            for (const auto* e = reader.head(); e != nullptr && std::string_view(e->key_sid()) < key_sid; e = reader.head()) {
+                reader.advance();
+            }
+            const auto* e = reader.head();
+            found = e != nullptr && std::string_view(e->key_sid()) == key_sid;
+        }
+        (found ? kept_ : purged_)++;
+        return found;
+    }
+
+    [[nodiscard]] std::uint64_t kept() const noexcept { return kept_; }
+    [[nodiscard]] std::uint64_t purged() const noexcept { return purged_; }
+
+private:
+    std::vector<boost::filesystem::path> files_;
+    std::vector<std::optional<std::set<storage_id_type>>> storages_{};
+    std::vector<std::unique_ptr<compacted_file_reader>> readers_{};
+    std::vector<storage_id_type> reader_storages_{};
+    std::uint64_t kept_{0};
+    std::uint64_t purged_{0};
+};
+
+/**
+ * @brief writes one compacted file
+ */
+class compacted_file_writer {
+public:
+    /**
+     * @param file the compacted file to create
+     * @param rewind whether the file is the oldest generation, whose write versions are rewound to 0
+     *        and which has nothing left to remove
+     * @param epoch the epoch of the begin_session entry at the head of the file
+     * @param options the options charged with the written bytes
+     * @param tombstones the filter of the remove entries written to a newer generation,
+     *        or nullptr to keep all of them
+     */
+    compacted_file_writer(boost::filesystem::path file, bool rewind, epoch_id_type epoch, const compaction_options& options,
+                          tombstone_filter* tombstones = nullptr)
+        : file_(std::move(file)), blob_references_(blob_reference_index::index_file_path(file_)), rewind_(rewind), options_(options),
+          tombstones_(tombstones) {
+        ostrm_ = fopen(file_.c_str(), "w");  // NOLINT(*-owning-memory)
+        if (!ostrm_) {
+            LOG_AND_THROW_IO_EXCEPTION("cannot create snapshot file (" + file_.string() + ")", errno);
+        }
+        setvbuf(ostrm_, nullptr, _IOFBF, 128L * 1024L);  // NOLINT, NB. glibc may ignore size when _IOFBF and buffer=NULL
+        log_entry::begin_session(ostrm_, epoch);
+    }
+
+    compacted_file_writer(const compacted_file_writer&) = delete;
+    compacted_file_writer& operator=(const compacted_file_writer&) = delete;
+    compacted_file_writer(compacted_file_writer&&) = delete;
+    compacted_file_writer& operator=(compacted_file_writer&&) = delete;
+
+    ~compacted_file_writer() {
+        if (ostrm_ != nullptr) {
+            fclose(ostrm_);  // NOLINT(*-owning-memory)
+        }
+    }
+
+    void write(log_entry::entry_type entry_type, std::string_view key_sid, std::string_view value_etc, std::string_view blob_ids) {
+        options_.charge_io(key_sid.size() + value_etc.size() + blob_ids.size());
+        switch (entry_type) {
+            case log_entry::entry_type::normal_entry:
+                if (rewind_) {
+                    std::string_view value = rewound(value_etc);
+                    record_storage_offset(offsets_, ostrm_, key_sid, value);
+                    log_entry::write(ostrm_, key_sid, value);
+                } else {
+                    record_storage_offset(offsets_, ostrm_, key_sid, value_etc);
+                    log_entry::write(ostrm_, key_sid, value_etc);
+                }
+                break;
+            case log_entry::entry_type::normal_with_blob: {
+                std::string_view value = rewind_ ? rewound(value_etc) : value_etc;
+                record_storage_offset(offsets_, ostrm_, key_sid, value);
+                blob_references_.record(key_sid, write_version_type(log_entry::write_version_epoch_number(value),
+                                                                    log_entry::write_version_minor_write_version(value)), blob_ids);
+                log_entry::write_with_blob(ostrm_, key_sid, value, blob_ids);
+                break;
+            }
+            case log_entry::entry_type::remove_entry:
+                // the oldest generation has nothing left to remove, and a newer one only the keys of the older ones
+                if (rewind_ || (tombstones_ != nullptr && !tombstones_->shadows(key_sid))) {
+                    purged_tombstones_++;
+                    break;
+                }
+                kept_tombstones_++;
+                record_storage_offset(offsets_, ostrm_, key_sid, value_etc);
+                log_entry::write_remove(ostrm_, key_sid, value_etc);
+                break;
+            default:
+                LOG(ERROR) << "Unexpected entry type: " << static_cast<int>(entry_type);
+                std::abort();
+        }
+    }
+
+    /**
+     * @brief writes the storage index and the BLOB index of the file and closes it
+     */
+    void finish() {
+        //log_entry::end_session(ostrm_, epoch);
+        finish_storage_offsets(offsets_, ostrm_, file_);
+        blob_references_.finish(offsets_.data_size());
+        FILE* ostrm = std::exchange(ostrm_, nullptr);
+        if (fclose(ostrm) != 0) {  // NOLINT(*-owning-memory)
+            LOG_AND_THROW_IO_EXCEPTION("cannot close snapshot file (" + file_.string() + ")", errno);
+        }
+    }
+
+    [[nodiscard]] std::uint64_t kept_tombstones() const noexcept { return kept_tombstones_; }
+    [[nodiscard]] std::uint64_t purged_tombstones() const noexcept { return purged_tombstones_; }
+
+private:
+    // returns value_etc with the write version cleared, in the scratch buffer of this writer
+    std::string_view rewound(std::string_view value_etc) {
+        scratch_.assign(value_etc);
+        std::memset(scratch_.data(), 0, write_version_size);
+        return scratch_;
+    }
+
+    boost::filesystem::path file_;
+    FILE* ostrm_{};
+    storage_offset_table offsets_{};
+    blob_reference_index::writer blob_references_;
+    bool rewind_;
+    const compaction_options& options_;
+    tombstone_filter* tombstones_;
+    std::string scratch_{};
+    std::uint64_t kept_tombstones_{0};
+    std::uint64_t purged_tombstones_{0};
+};
+
+/**
+ * @brief adds the first key of every storage of the compacted file to the sampler, weighted by the size of the storage
+ */
+void sample_compacted_file(key_range_sampler& sampler, const boost::filesystem::path& file) {
+    auto table = storage_offset_table::load_for(file);
+    if (!table) {
+        return;
+    }
+    boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+    if (!istrm.is_open()) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot open compacted file (" + file.string() + ")", errno);
+    }
+    log_entry entry{};
+    for (const auto& [storage_id, storage_range] : table->ranges()) {
+        istrm.clear();
+        istrm.seekg(static_cast<std::streamoff>(storage_range.begin));
+        if (entry.read(istrm)) {
+            sampler.add_sample(entry.key_sid(), storage_range.end - storage_range.begin);
+        }
+    }
+}
+std::uint64_t total_file_size(const boost::filesystem::path& dir, const std::set<std::string>& file_names) {
+    std::uint64_t total = 0;
+    for (const auto& name : file_names) {
+        boost::system::error_code error;
+        auto size = boost::filesystem::file_size(dir / name, error);
+        if (!error) {
+            total += size;
+        }
+    }
+    return total;
+}
+
 }  // namespace
 
 namespace limestone::internal {
 
 blob_id_type create_compact_pwal_and_get_max_blob_id(compaction_options &options) {
-    auto [max_appeared_epoch, sctx] = create_sorted_from_wals(options);
+    // The compacted generations in the input are already sorted and need not be sorted again:
+    // only the other (new) WAL files are sorted, and the result is merged with the generations
+    // selected by the policy while writing. If there are no other files, the sort is skipped
+    // and the generations are just merged.
+    // A generation may consist of several shards, which are merged or left together.
+    //
+    // The compaction of a whole directory (dblogutil) writes the only file of the new directory,
+    // so it picks up the compacted files of the directory the same way, and merges all of them.
+    // Only the generations listed in the catalog of the directory are taken: a generation file
+    // left behind by a crash before the catalog was updated has been merged into another one already.
+    const bool whole_directory = !options.has_file_set();
+    if (whole_directory) {
+        const boost::filesystem::path& from_dir = options.get_from_dir();
+        compaction_catalog catalog = boost::filesystem::exists(from_dir / compaction_catalog::get_catalog_filename())
+                                         ? compaction_catalog::from_catalog_file(from_dir)
+                                         : compaction_catalog(from_dir);
+        std::set<std::string> generation_names{};
+        for (const auto& path : get_compacted_file_paths(from_dir, catalog)) {
+            generation_names.insert(path.filename().string());
+        }
+        bool has_generation = false;
+        std::set<std::string> file_names{};
+        boost::system::error_code error;
+        boost::filesystem::directory_iterator it(options.get_from_dir(), error);
+        if (error) {
+            LOG_AND_THROW_IO_EXCEPTION("Failed to access directory: " + options.get_from_dir().string(), error);
+        }
+        for (; it != boost::filesystem::directory_iterator(); it.increment(error)) {
+            if (error) {
+                LOG_AND_THROW_IO_EXCEPTION("Failed to iterate directory: " + options.get_from_dir().string(), error);
+            }
+            if (dblog_scan::is_wal(it->path()) && boost::filesystem::is_regular_file(it->path())) {
+                std::string name = it->path().filename().string();
+                if (compaction_catalog::get_compacted_generation(name)) {
+                    has_generation = true;
+                    if (generation_names.find(name) == generation_names.end()) {
+                        LOG_LP(WARNING) << "skipping the compacted file not listed in the compaction catalog: " << it->path();
+                        continue;
+                    }
+                }
+                file_names.insert(std::move(name));
+            }
+        }
+        if (has_generation) {
+            options.set_file_names(std::move(file_names));
+        }
+    }
+    std::map<std::uint64_t, std::vector<std::string>, std::greater<>> generations{};
+    if (options.has_file_set()) {
+        for (const auto& name : options.get_file_names()) {
+            if (auto generation = compaction_catalog::get_compacted_generation(name); generation) {
+                generations[*generation].emplace_back(name);
+            }
+        }
+        for (const auto& [generation, names] : generations) {
+            for (const auto& name : names) {
+                options.remove_file_name(name);
+            }
+        }
+    }
+    const bool sorted_only = !generations.empty() && options.get_file_names().empty();
+
+    // Keys are sampled while sorting, to split the output into shards of about the same size.
+    const std::uint64_t new_bytes = options.has_file_set() ? total_file_size(options.get_from_dir(), options.get_file_names()) : 0;
+    std::unique_ptr<key_range_sampler> sampler{};
+    if (options.get_max_shards() > 1) {
+        constexpr std::uint64_t samples = 4096;
+        constexpr std::uint64_t min_interval = 4096;
+        sampler = std::make_unique<key_range_sampler>(std::max(new_bytes / samples, min_interval));
+    }
+    auto [max_appeared_epoch, sctx] = sorted_only ? std::pair<epoch_id_type, sorting_context>{0, sorting_context{}}
+                                                  : create_sorted_from_wals(options, sampler.get());
+    if (sorted_only) {
+        VLOG_LP(log_info) << "all the input files are compacted files; merging them without sorting";
+    }
+
+    std::vector<std::uint64_t> generation_bytes{};
+    for (const auto& [generation, names] : generations) {
+        generation_bytes.emplace_back(total_file_size(options.get_from_dir(), std::set<std::string>(names.begin(), names.end())));
+    }
+    // A clear_storage in the new files must be applied to every older generation,
+    // and it cannot be carried over by a compacted file, so every generation is merged then.
+    std::size_t merge_count = generations.size();
+    if (!generations.empty() && sctx.get_clear_storage().empty() && !whole_directory && !sorted_only) {
+        merge_count = options.get_policy().select(new_bytes, generation_bytes);
+    }
+    std::vector<std::string> merged_generations{};
+    std::vector<boost::filesystem::path> merged_files{};
+    std::uint64_t output_bytes = new_bytes;
+    auto generation_it = generations.begin();
+    for (std::size_t i = 0; i < merge_count; i++, generation_it++) {
+        for (const auto& name : generation_it->second) {
+            merged_generations.emplace_back(name);
+            merged_files.emplace_back(options.get_from_dir() / name);
+            VLOG_LP(log_info) << "merging existing compacted file: " << merged_files.back();
+        }
+        output_bytes += generation_bytes[i];
+    }
+    // The result replaces the oldest generation if every generation is merged, otherwise it is a new generation.
+    const bool oldest = merge_count == generations.size();
+    const std::uint64_t output_generation = oldest ? 0 : generations.begin()->first + 1;
+
+    // The output is split into key ranges written in parallel, if it is large enough.
+    std::vector<key_range> ranges(1);
+    std::size_t shard_count = std::min<std::uint64_t>(options.get_max_shards(), output_bytes / options.get_min_shard_bytes());
+    if (sampler && shard_count > 1) {
+        for (const auto& file : merged_files) {
+            sample_compacted_file(*sampler, file);
+        }
+        for (auto& key : sampler->split_keys(shard_count)) {
+            ranges.back().end = key;
+            ranges.emplace_back(key_range{std::move(key), std::nullopt});
+        }
+    }
+    std::vector<std::string> output_file_names{};
+    for (std::size_t shard = 0; shard < ranges.size(); shard++) {
+        output_file_names.emplace_back(compaction_catalog::get_compacted_filename(output_generation, shard));
+    }
 
     boost::system::error_code error;
     const auto &to_dir = options.get_to_dir();
@@ -369,59 +962,140 @@ blob_id_type create_compact_pwal_and_get_max_blob_id(compaction_options &options
         }
     }
 
-    boost::filesystem::path snapshot_file = to_dir / boost::filesystem::path("pwal_0000.compacted");
-    VLOG_LP(log_info) << "generating compacted pwal file: " << snapshot_file;
-    FILE* ostrm = fopen(snapshot_file.c_str(), "w");  // NOLINT(*-owning-memory)
-    if (!ostrm) {
-        LOG_AND_THROW_IO_EXCEPTION("cannot create snapshot file (" + snapshot_file.string() + ")", errno);
-    }
-    setvbuf(ostrm, nullptr, _IOFBF, 128L * 1024L);  // NOLINT, NB. glibc may ignore size when _IOFBF and buffer=NULL
-    bool rewind = true;  // TODO: change by flag
+    // A newer generation keeps the write versions and the remove entries, which must win over
+    // the entries of the older generations when the generations are merged later, or scanned by dblogutil.
+    // Only the remove entries of the keys the older generations have are kept.
+    // The oldest generation has nothing older to win over, so its write versions are rewound to 0
+    // and its remove entries are dropped.
+    const bool rewind = oldest;
     epoch_id_type epoch = rewind ? 0 : max_appeared_epoch;
-    log_entry::begin_session(ostrm, epoch);
+    std::vector<boost::filesystem::path> older_files{};
+    for (auto it = generation_it; it != generations.end(); it++) {
+        for (const auto& name : it->second) {
+            older_files.emplace_back(options.get_from_dir() / name);
+        }
+    }
+    std::atomic<std::uint64_t> kept_tombstones{0};
+    std::atomic<std::uint64_t> purged_tombstones{0};
+
+    auto write_shard = [&options, &sctx = sctx, &merged_files, &older_files, &to_dir, &output_file_names, &ranges, rewind, epoch,
+                        &kept_tombstones, &purged_tombstones](std::size_t shard) {
+        boost::filesystem::path snapshot_file = to_dir / output_file_names[shard];
+        VLOG_LP(log_info) << "generating compacted pwal file: " << snapshot_file;
+        tombstone_filter tombstones(older_files);
+        compacted_file_writer writer(snapshot_file, rewind, epoch, options, rewind ? nullptr : &tombstones);
+        auto count_tombstones = [&writer, &kept_tombstones, &purged_tombstones]() {
+            kept_tombstones += writer.kept_tombstones();
+            purged_tombstones += writer.purged_tombstones();
+        };
+        auto write_snapshot_entry = [&writer](log_entry::entry_type entry_type, std::string_view key_sid, std::string_view value_etc,
+                                              std::string_view blob_ids) {
+            writer.write(entry_type, key_sid, value_etc, blob_ids);
+        };
+        const key_range& range = ranges[shard];
+        if (merged_files.empty()) {
+            sortdb_foreach(options, sctx, range, write_snapshot_entry);
+            writer.finish();
+            count_tombstones();
+            return;
+        }
 
-    auto write_snapshot_entry = [&ostrm, rewind](
-        log_entry::entry_type entry_type, 
-        std::string_view key_sid, 
-        std::string_view value_etc, 
-                                                        std::string_view blob_ids) {
-        switch (entry_type) {
-            case log_entry::entry_type::normal_entry:
-                if (rewind) {
-                    static std::string value{};
-                    value = value_etc;
-                    std::memset(value.data(), 0, 16);
-                    log_entry::write(ostrm, key_sid, value);
-                } else {
-                log_entry::write(ostrm, key_sid, value_etc);
+        // Entries of the compacted files are older than any entry of the new WAL files,
+        // and entries of a newer generation are newer than those of the older generations,
+        // so an entry of the compacted files is written only if no newer source has an entry of the same key.
+        // As when the compacted files are scanned with the WAL files, every blob entry of them is passed to the GC snapshot.
+        compacted_generation_merger merger(merged_files, range);
+        auto write_base_entry = [&sctx, &write_snapshot_entry](const log_entry& e) {
+            if (auto ret = sctx.clear_storage_find(e.storage()); ret) {
+                write_version_type wv;
+                e.write_version(wv);
+                if (wv < ret.value()) {
+                    return;  // cleared after the compacted file was made
                 }
-                break;
-            case log_entry::entry_type::normal_with_blob:
-                if (rewind) {
-                    static std::string value{};
-                    value = value_etc;
-                    std::memset(value.data(), 0, 16);
-                    log_entry::write_with_blob(ostrm, key_sid, value, blob_ids);
-                } else {
-                log_entry::write_with_blob(ostrm, key_sid, value_etc, blob_ids);
+            }
+            if (e.type() == log_entry::entry_type::normal_with_blob) {
+                sctx.update_max_blob_id(e.get_blob_ids());
+            }
+            write_snapshot_entry(e.type(), e.key_sid(), e.value_etc(), e.raw_blob_ids());
+        };
+        auto take_base_entries = [&options, &merger, &write_base_entry](std::string_view key_sid, bool superseded_by_new) {
+            merger.take(key_sid, [&options, &write_base_entry, superseded_by_new](const log_entry& e, bool superseded) {
+                options.charge_io(e.key_sid().size() + e.value_etc().size());
+                if (e.type() == log_entry::entry_type::normal_with_blob && options.is_gc_enabled()) {
+                    options.get_gc_snapshot().sanitize_and_add_entry(e);
                 }
-                break;
-            case log_entry::entry_type::remove_entry:
-                // No action needed
-                break;
-            default:
-                LOG(ERROR) << "Unexpected entry type: " << static_cast<int>(entry_type);
-                std::abort();
+                if (!superseded && !superseded_by_new) {
+                    write_base_entry(e);
+                }
+            });
+        };
+        sortdb_foreach(options, sctx, range, [&merger, &take_base_entries, &write_snapshot_entry](
+            log_entry::entry_type entry_type, std::string_view key_sid, std::string_view value_etc, std::string_view blob_ids) {
+            for (auto min = merger.min_key_sid(); min && std::string_view(*min) < key_sid; min = merger.min_key_sid()) {
+                take_base_entries(*min, false);
+            }
+            take_base_entries(key_sid, true);  // superseded by the new entry, which may be a remove_entry
+            write_snapshot_entry(entry_type, key_sid, value_etc, blob_ids);
+        });
+        for (auto min = merger.min_key_sid(); min; min = merger.min_key_sid()) {
+            take_base_entries(*min, false);
+        }
+        writer.finish();
+        count_tombstones();
+        if (options.is_gc_enabled()) {
+            options.get_gc_snapshot().finalize_local_entries();
         }
     };
-    
 
-    sortdb_foreach(options, sctx, write_snapshot_entry);
-    //log_entry::end_session(ostrm, epoch);
-    if (fclose(ostrm) != 0) {  // NOLINT(*-owning-memory)
-        LOG_AND_THROW_IO_EXCEPTION("cannot close snapshot file (" + snapshot_file.string() + ")", errno);
+    if (ranges.size() == 1) {
+        write_shard(0);
+    } else {
+        VLOG_LP(log_info) << "writing the compacted file in " << ranges.size() << " shards";
+        std::vector<std::future<void>> futures{};
+        futures.reserve(ranges.size());
+        for (std::size_t shard = 0; shard < ranges.size(); shard++) {
+            futures.emplace_back(std::async(std::launch::async, write_shard, shard));
+        }
+        std::exception_ptr failure{};
+        for (auto& future : futures) {
+            try {
+                future.get();
+            } catch (...) {
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
     }
 
+    // The generations left as they are still refer to their blobs, which are read from their BLOB indexes.
+    if (options.is_gc_enabled() && merge_count < generations.size()) {
+        auto add_reference = [&options](std::string_view key_sid, const write_version_type& version, std::string_view blob_ids) {
+            options.charge_io(key_sid.size() + blob_ids.size());
+            options.get_gc_snapshot().add_reference(key_sid, version, blob_ids);
+        };
+        for (; generation_it != generations.end(); generation_it++) {
+            for (const auto& name : generation_it->second) {
+                if (blob_reference_index::read_for(options.get_from_dir() / name, add_reference)) {
+                    continue;
+                }
+                // written without a BLOB index, or the index does not match the file
+                VLOG_LP(log_info) << "scanning compacted file for BLOB references: " << options.get_from_dir() / name;
+                compacted_file_reader reader(options.get_from_dir() / name);
+                for (const auto* e = reader.head(); e != nullptr; reader.advance(), e = reader.head()) {
+                    options.charge_io(e->key_sid().size() + e->value_etc().size());
+                    options.get_gc_snapshot().sanitize_and_add_entry(*e);
+                }
+            }
+        }
+        options.get_gc_snapshot().finalize_local_entries();
+    }
+    options.set_result(std::move(output_file_names), std::move(merged_generations));
+    options.set_tombstone_counts(kept_tombstones.load(), purged_tombstones.load());
+
     return sctx.get_max_blob_id();
 }
 
@@ -447,7 +1121,8 @@ std::set<std::string> assemble_snapshot_input_filenames(
             std::string filename = it->path().filename().string();
             if (detached_pwals.find(filename) == detached_pwals.end() 
                 && filename != compaction_catalog::get_catalog_filename()
-                && filename != compaction_catalog::get_compacted_filename()) {
+                && filename != compaction_catalog::get_journal_filename()
+                && !compaction_catalog::get_compacted_generation(filename)) {
                 filename_set.insert(filename);
             }
         }
@@ -529,25 +1204,27 @@ blob_id_type datastore::create_snapshot_and_get_max_blob_id() {
     if (!ostrm) {
         LOG_AND_THROW_IO_EXCEPTION("cannot create snapshot file", errno);
     }
-    log_entry::begin_session(ostrm, 0);
     setvbuf(ostrm, nullptr, _IOFBF, 128L * 1024L);  // NOLINT, NB. glibc may ignore size when _IOFBF and buffer=NULL
 
-    const bool should_write_remove_entry = !compaction_catalog_->get_compacted_files().empty();
-    auto write_snapshot_entry = [&ostrm, should_write_remove_entry](
+    // The snapshot is rebuilt from the WAL files and the compacted file at every startup,
+    // so it is always written in the latest (block-based) format.
+    // A remove entry is written only if it hides an entry of the compacted files.
+    tombstone_filter tombstones(get_compacted_file_paths(location_, *compaction_catalog_));
+    storage_offset_table offsets{};
+    snapshot_block_writer writer(ostrm, snapshot_file, &offsets);
+    auto write_snapshot_entry = [&writer, &tombstones](
         log_entry::entry_type entry_type, 
         std::string_view key_sid, 
         std::string_view value_etc, 
         std::string_view blob_ids) {
         switch (entry_type) {
         case log_entry::entry_type::normal_entry:
-            log_entry::write(ostrm, key_sid, value_etc);
-            break;
         case log_entry::entry_type::normal_with_blob:
-            log_entry::write_with_blob(ostrm, key_sid, value_etc, blob_ids);
+            writer.add(entry_type, key_sid, value_etc, blob_ids);
             break;
         case log_entry::entry_type::remove_entry:
-            if (should_write_remove_entry) {
-                log_entry::write_remove(ostrm, key_sid, value_etc);
+            if (tombstones.shadows(key_sid)) {
+                writer.add(entry_type, key_sid, value_etc, blob_ids);
             }
             break;
         default:
@@ -556,7 +1233,10 @@ blob_id_type datastore::create_snapshot_and_get_max_blob_id() {
         }
     };
 
-    sortdb_foreach(options, sctx, write_snapshot_entry);
+    sortdb_foreach(options, sctx, key_range{}, write_snapshot_entry);
+    writer.finish();
+    VLOG_LP(log_info) << "snapshot tombstones kept: " << tombstones.kept() << ", purged: " << tombstones.purged();
+    offsets.write_file(storage_offset_table::index_file_path(snapshot_file));
     if (fclose(ostrm) != 0) {  // NOLINT(*-owning-memory)
         LOG_AND_THROW_IO_EXCEPTION("cannot close snapshot file (" + snapshot_file.string() + ")", errno);
     }
@@ -21,6 +21,7 @@
 #include "logging_helper.h"
 
 #include "limestone/api/datastore.h"
+#include "compaction_estimator.h"
 #include "dblog_scan.h"
 #include "internal.h"
 #include "log_entry.h"
@@ -46,6 +47,7 @@ DEFINE_string(output_format, "human-readable", "format of output (human-readable
 // compaction
 DEFINE_bool(force, false, "(subcommand compaction) skip start prompt");
 DEFINE_bool(dry_run, false, "(subcommand compaction) dry run");
+DEFINE_uint64(sample_mb, 256, "(subcommand compaction) amount of WAL files in MiB read to estimate the compaction in dry run, 0 to read all");
 DEFINE_string(working_dir, "", "(subcommand compaction) working directory");
 DEFINE_bool(make_backup, false, "(subcommand compaction) make backup of target dblogdir");
 
@@ -203,6 +205,15 @@ void compaction(dblog_scan &ds, std::optional<epoch_id_type> epoch) {
             log_and_exit(64);
         }
     }
+    if (FLAGS_dry_run) {
+        // estimate from a sample of the WAL files, without writing anything
+        compaction_options options{from_dir, "/not_exists_dir", FLAGS_thread_num};
+        compaction_estimator estimator(options, FLAGS_sample_mb * 1024UL * 1024UL);
+        compaction_estimate estimate = estimator.estimate();
+        std::cout << estimate;
+        std::cout << "compaction was estimated (dry-run mode)" << std::endl;
+        return;
+    }
     boost::filesystem::path tmp;
     if (!FLAGS_working_dir.empty()) {
         tmp = FLAGS_working_dir;
@@ -247,13 +258,6 @@ void compaction(dblog_scan &ds, std::optional<epoch_id_type> epoch) {
         LOG_AND_THROW_IO_EXCEPTION("fclose failed", errno);
     }
 
-    if (FLAGS_dry_run) {
-        std::cout << "compaction will be successfully completed (dry-run mode)" << std::endl;
-        VLOG_LP(log_info) << "deleting work directory " << tmp;
-        boost::filesystem::remove_all(tmp);
-        return;
-    }
-
     if (FLAGS_make_backup) {
         auto bkdir = make_backup_dir_next_to(from_dir);
         VLOG_LP(log_info) << "renaming " << from_dir << " to " << bkdir << " for backup";
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "environment_helper.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <string_view>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+std::optional<std::uint64_t> read_unsigned_environment(const char* name) {
+    const char* env_val = std::getenv(name);
+    if (env_val == nullptr) {
+        return std::nullopt;
+    }
+    char* endptr = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(env_val, &endptr, 10);  // NOLINT(google-runtime-int)
+    // strtoull accepts a sign and negates the value, so a '-' is rejected explicitly
+    if (errno == ERANGE || endptr == env_val || *endptr != '\0' || std::string_view{env_val}.find('-') != std::string_view::npos) {
+        LOG_LP(WARNING) << "Invalid " << name << ": " << env_val << "; the default value is used";
+        return std::nullopt;
+    }
+    LOG_LP(INFO) << name << ": " << parsed;
+    return static_cast<std::uint64_t>(parsed);
+}
+
+std::optional<double> read_ratio_environment(const char* name) {
+    const char* env_val = std::getenv(name);
+    if (env_val == nullptr) {
+        return std::nullopt;
+    }
+    char* endptr = nullptr;
+    errno = 0;
+    double parsed = std::strtod(env_val, &endptr);
+    if (errno == ERANGE || endptr == env_val || *endptr != '\0' || !(parsed >= 0.0 && parsed <= 1.0)) {
+        LOG_LP(WARNING) << "Invalid " << name << ": " << env_val << "; the default value is used";
+        return std::nullopt;
+    }
+    LOG_LP(INFO) << name << ": " << parsed;
+    return parsed;
+}
+
+}  // namespace limestone::internal
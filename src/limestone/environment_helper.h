@@ -0,0 +1,40 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace limestone::internal {
+
+/**
+ * @brief Reads a non-negative decimal integer from an environment variable.
+ * @details A value given is logged; an invalid one (not a number, negative or out of range)
+ *          is ignored with a warning.
+ * @param name The name of the environment variable.
+ * @return The value, or std::nullopt if the variable is not set or invalid.
+ */
+std::optional<std::uint64_t> read_unsigned_environment(const char* name);
+
+/**
+ * @brief Reads a ratio between 0 and 1 from an environment variable.
+ * @details A value given is logged; an invalid one is ignored with a warning.
+ * @param name The name of the environment variable.
+ * @return The value, or std::nullopt if the variable is not set or invalid.
+ */
+std::optional<double> read_ratio_environment(const char* name);
+
+}  // namespace limestone::internal
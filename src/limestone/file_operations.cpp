@@ -17,8 +17,11 @@
 #include "file_operations.h"
 
 #include <limestone/api/limestone_exception.h>
-#include <sys/file.h> // for flock
-#include <unistd.h>  // for fsync
+#include <linux/fs.h>      // for FICLONE
+#include <sys/file.h>      // for flock
+#include <sys/ioctl.h>     // for ioctl
+#include <sys/sendfile.h>  // for sendfile
+#include <unistd.h>        // for fsync, copy_file_range
 
 #include <array>    // for std::array
 #include <cerrno>   // for errno
@@ -86,6 +89,18 @@ int real_file_operations::close(int fd) {
     return ::close(fd);
 }
 
+int real_file_operations::ficlone(int dest_fd, int src_fd) {
+    return ::ioctl(dest_fd, FICLONE, src_fd); // NOLINT(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+}
+
+ssize_t real_file_operations::copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags) {
+    return ::copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+ssize_t real_file_operations::sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+    return ::sendfile(out_fd, in_fd, offset, count);
+}
+
 // -----------------------------------------
 // C++-style file operations
 // -----------------------------------------
@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <sys/types.h>
+
 #include <cstdio>
 #include <string> 
 #include <memory>
@@ -90,6 +92,15 @@ public:
     // close system call for file closing
     virtual int close(int fd) = 0;
 
+    // Shares the extents of a file with another file (reflink) through ioctl(FICLONE)
+    virtual int ficlone(int dest_fd, int src_fd) = 0;
+
+    // copy_file_range system call for copying data between files in the kernel
+    virtual ssize_t copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags) = 0;
+
+    // sendfile system call for copying data between file descriptors in the kernel
+    virtual ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) = 0;
+
     // -----------------------------------------
     // C++-style file operations
     // -----------------------------------------
@@ -154,6 +165,9 @@ public:
     int flock(int fd, int operation) override;
     int open(const char* filename, int flags) override;
     int close(int fd) override;
+    int ficlone(int dest_fd, int src_fd) override;
+    ssize_t copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags) override;
+    ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) override;
 
     std::unique_ptr<std::ifstream> open_ifstream(const std::string& path) override;
     bool getline(std::ifstream& file, std::string& line) override;
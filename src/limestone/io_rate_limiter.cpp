@@ -0,0 +1,173 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "io_rate_limiter.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "environment_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+namespace {
+
+void update_max(std::atomic<std::uint64_t>& target, std::uint64_t value) noexcept {
+    std::uint64_t current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+io_rate_limiter::settings io_rate_limiter::settings::from_environment() {
+    settings config{};
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_IO_RATE_MB")) {
+        config.bytes_per_second = *value * 1024UL * 1024UL;
+    }
+    if (auto value = read_unsigned_environment("LIMESTONE_COMPACTION_COMMIT_LATENCY_TARGET_MS")) {
+        config.target_commit_latency = std::chrono::milliseconds(*value);
+    }
+    const char* idle_val = std::getenv("LIMESTONE_COMPACTION_IO_IDLE");
+    config.idle_io_priority = idle_val != nullptr && std::string_view{idle_val} == "1";
+    return config;
+}
+
+io_rate_limiter::io_rate_limiter(const settings& config) noexcept {
+    configure(config);
+}
+
+void io_rate_limiter::configure(const settings& config) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    settings_ = config;
+    current_rate_.store(config.bytes_per_second, std::memory_order_relaxed);
+}
+
+void io_rate_limiter::begin() noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    current_rate_.store(settings_.bytes_per_second, std::memory_order_relaxed);
+    tokens_ = static_cast<double>(settings_.bytes_per_second);
+    last_refill_ = now_();
+    last_adjust_ = last_refill_;
+    uncharged_bytes_.store(0, std::memory_order_relaxed);
+    charged_bytes_.store(0, std::memory_order_relaxed);
+    throttled_us_.store(0, std::memory_order_relaxed);
+    max_commit_latency_us_.store(0, std::memory_order_relaxed);
+    recent_commit_latency_us_.store(0, std::memory_order_relaxed);
+}
+
+void io_rate_limiter::request(std::uint64_t bytes) {
+    if (current_rate_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    if (uncharged_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes < charge_unit) {
+        return;
+    }
+    std::uint64_t charge = uncharged_bytes_.exchange(0, std::memory_order_relaxed);
+    if (charge == 0) {
+        return;  // charged by another thread
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    consume(charge, lock);
+}
+
+void io_rate_limiter::consume(std::uint64_t bytes, [[maybe_unused]] std::unique_lock<std::mutex>& lock) {
+    auto now = now_();
+    if (now - last_adjust_ >= adjust_interval) {
+        adjust(now);
+    }
+    auto rate = static_cast<double>(current_rate_.load(std::memory_order_relaxed));
+    charged_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    if (rate == 0) {
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    tokens_ = std::min(tokens_ + rate * elapsed, rate);
+    last_refill_ = now;
+    tokens_ -= static_cast<double>(bytes);
+    if (tokens_ >= 0) {
+        return;
+    }
+    // Sleep while holding the lock, so that the other compaction threads wait as well;
+    // the tokens borrowed here are paid back by the refill on the next request.
+    auto wait = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-tokens_ / rate));
+    throttled_us_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(wait).count(), std::memory_order_relaxed);
+    if (sleep_) {
+        sleep_(wait);
+    } else {
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+void io_rate_limiter::adjust(clock::time_point now) {
+    last_adjust_ = now;
+    if (settings_.target_commit_latency.count() <= 0 || settings_.bytes_per_second == 0) {
+        return;
+    }
+    auto latency = recent_commit_latency_us_.exchange(0, std::memory_order_relaxed);
+    std::uint64_t max_rate = settings_.bytes_per_second;
+    std::uint64_t min_rate = std::max<std::uint64_t>(max_rate / min_rate_divisor, 1);
+    std::uint64_t rate = current_rate_.load(std::memory_order_relaxed);
+    if (latency > static_cast<std::uint64_t>(settings_.target_commit_latency.count())) {
+        rate = std::max(rate / 2, min_rate);
+    } else {
+        rate = std::min(rate + std::max<std::uint64_t>(max_rate / 10, 1), max_rate);
+    }
+    if (rate != current_rate_.load(std::memory_order_relaxed)) {
+        VLOG_LP(log_debug) << "compaction I/O rate: " << rate << " bytes/s, commit latency: " << latency << " us";
+    }
+    current_rate_.store(rate, std::memory_order_relaxed);
+}
+
+void io_rate_limiter::report_commit_latency(std::chrono::microseconds latency) noexcept {
+    auto us = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 0));
+    update_max(recent_commit_latency_us_, us);
+    update_max(max_commit_latency_us_, us);
+}
+
+void io_rate_limiter::set_clock_for_tests(std::function<clock::time_point()> now, std::function<void(clock::duration)> sleep) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    now_ = std::move(now);
+    sleep_ = std::move(sleep);
+}
+
+bool set_idle_io_priority() noexcept {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    // see linux/ioprio.h
+    constexpr int ioprio_who_process = 1;
+    constexpr int ioprio_class_idle = 3;
+    constexpr int ioprio_class_shift = 13;
+    if (syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift) != 0) {
+        LOG_LP(WARNING) << "failed to set the idle I/O priority class, errno = " << errno;
+        return false;
+    }
+    return true;
+#else
+    LOG_LP(WARNING) << "the idle I/O priority class is not supported on this platform";
+    return false;
+#endif
+}
+
+}  // namespace limestone::internal
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace limestone::internal {
+
+/**
+ * @brief Token bucket limiting the I/O bandwidth of online compaction.
+ * @details Compaction reads the WAL files, writes the sort database and writes the compacted file,
+ *          and every such I/O is charged to this bucket with request(). The bucket is refilled at
+ *          the current rate and holds at most one second of it.
+ *          The log channels report the latency of their commits (fsync of end_session) with
+ *          report_commit_latency(). While compaction is running, the rate is halved when a commit
+ *          took longer than the target latency, and otherwise raised again step by step up to
+ *          the configured rate.
+ *          A rate of 0 disables the limiter.
+ */
+class io_rate_limiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Settings of the limiter.
+     */
+    struct settings {
+        /// maximum I/O bandwidth of compaction in bytes per second, 0 means unlimited
+        std::uint64_t bytes_per_second{0};
+
+        /// commit latency above which the rate is lowered, 0 disables the adaptation
+        std::chrono::microseconds target_commit_latency{std::chrono::milliseconds(20)};
+
+        /// whether the compaction thread runs in the idle I/O priority class
+        bool idle_io_priority{false};
+
+        /**
+         * @brief Returns the default settings, overridden by the environment variables if set.
+         * @details LIMESTONE_COMPACTION_IO_RATE_MB (MiB per second), LIMESTONE_COMPACTION_COMMIT_LATENCY_TARGET_MS
+         *          and LIMESTONE_COMPACTION_IO_IDLE (1 to enable) are read. Invalid values are ignored with a warning.
+         */
+        static settings from_environment();
+    };
+
+    /// the amount of I/O charged at once, to keep the lock out of the per-entry path
+    static constexpr std::uint64_t charge_unit = 64UL * 1024UL;
+
+    /// the rate is not lowered below this fraction of the configured rate
+    static constexpr std::uint64_t min_rate_divisor = 16;
+
+    /// interval of the rate adaptation
+    static constexpr std::chrono::milliseconds adjust_interval{100};
+
+    io_rate_limiter() noexcept = default;
+    explicit io_rate_limiter(const settings& config) noexcept;
+
+    io_rate_limiter(const io_rate_limiter&) = delete;
+    io_rate_limiter& operator=(const io_rate_limiter&) = delete;
+    io_rate_limiter(io_rate_limiter&&) = delete;
+    io_rate_limiter& operator=(io_rate_limiter&&) = delete;
+    ~io_rate_limiter() = default;
+
+    /**
+     * @brief Changes the settings; must not be called while compaction is running.
+     */
+    void configure(const settings& config) noexcept;
+
+    [[nodiscard]] const settings& get_settings() const noexcept { return settings_; }
+
+    /**
+     * @brief Starts a compaction: restores the configured rate and forgets the commit latencies seen so far.
+     */
+    void begin() noexcept;
+
+    /**
+     * @brief Charges I/O of the given size, blocking the caller while the bucket is empty.
+     * @details This may be called from several threads at once.
+     */
+    void request(std::uint64_t bytes);
+
+    /**
+     * @brief Records the latency of a commit; cheap enough to be called on every commit.
+     */
+    void report_commit_latency(std::chrono::microseconds latency) noexcept;
+
+    /// the current rate in bytes per second, 0 if unlimited
+    [[nodiscard]] std::uint64_t current_rate() const noexcept { return current_rate_.load(std::memory_order_relaxed); }
+
+    /// the longest commit latency reported since begin()
+    [[nodiscard]] std::chrono::microseconds max_commit_latency() const noexcept {
+        return std::chrono::microseconds(max_commit_latency_us_.load(std::memory_order_relaxed));
+    }
+
+    /// the total time request() has blocked since begin()
+    [[nodiscard]] std::chrono::microseconds throttled_time() const noexcept {
+        return std::chrono::microseconds(throttled_us_.load(std::memory_order_relaxed));
+    }
+
+    /// the total I/O charged since begin()
+    [[nodiscard]] std::uint64_t charged_bytes() const noexcept { return charged_bytes_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Replaces the clock and the sleep function, for testing.
+     */
+    void set_clock_for_tests(std::function<clock::time_point()> now, std::function<void(clock::duration)> sleep);
+
+private:
+    void consume(std::uint64_t bytes, std::unique_lock<std::mutex>& lock);
+    void adjust(clock::time_point now);
+
+    settings settings_{};
+    std::atomic<std::uint64_t> current_rate_{0};
+    std::atomic<std::uint64_t> uncharged_bytes_{0};
+    std::atomic<std::uint64_t> charged_bytes_{0};
+    std::atomic<std::uint64_t> throttled_us_{0};
+    std::atomic<std::uint64_t> max_commit_latency_us_{0};
+    std::atomic<std::uint64_t> recent_commit_latency_us_{0};
+
+    std::mutex mtx_{};
+    double tokens_{0};
+    clock::time_point last_refill_{};
+    clock::time_point last_adjust_{};
+    std::function<clock::time_point()> now_{[]() { return clock::now(); }};
+    std::function<void(clock::duration)> sleep_{};
+};
+
+/**
+ * @brief Puts the calling thread into the idle I/O priority class.
+ * @return true if succeeded
+ */
+bool set_idle_io_priority() noexcept;
+
+}  // namespace limestone::internal
@@ -46,6 +46,18 @@ log_channel::log_channel(boost::filesystem::path location, std::size_t id, datas
 
 void log_channel::begin_session() {
     try {
+        // A rotation requested since the last session is done before the file is reopened,
+        // so the rotated file holds only the sessions that began before the rotation cut.
+        bool rotated = false;
+        {
+            std::lock_guard<std::mutex> lock(mtx_rotation_);
+            rotated = rotate_if_requested_locked();
+            in_session_ = true;
+        }
+        if (rotated) {
+            envelope_.notify_rotation_progress();
+        }
+
         // Synchronize `current_epoch_id_` with `epoch_id_switched_`.
         // This loop is necessary to prevent inconsistencies in `current_epoch_id_`
         // that could occur if `epoch_id_switched_` changes at a specific timing.
@@ -93,12 +105,16 @@ void log_channel::begin_session() {
 void log_channel::finalize_session_file() {
     uint64_t epoch_id = current_epoch_id_.load();
     log_entry::end_session(strm_, static_cast<epoch_id_type>(epoch_id));
+    auto sync_start = std::chrono::steady_clock::now();
     if (fflush(strm_) != 0) {
         LOG_AND_THROW_IO_EXCEPTION("fflush failed", errno);
     }
     if (fsync(fileno(strm_)) != 0) {
         LOG_AND_THROW_IO_EXCEPTION("fsync failed", errno);
     }
+    // the online compaction slows down its I/O when commits get slow
+    envelope_.impl_->get_compaction_io_limiter().report_commit_latency(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sync_start));
     envelope_.on_end_session_finished_epoch_id_store(); // for testing
     finished_epoch_id_.store(current_epoch_id_.load());
     envelope_.update_min_epoch_id();
@@ -108,6 +124,17 @@ void log_channel::finalize_session_file() {
     if (fclose(strm_) != 0) {  // NOLINT(*-owning-memory)
         LOG_AND_THROW_IO_EXCEPTION("fclose failed", errno);
     }
+
+    // the rename for a pending rotation is left to the rotating thread, off the committing thread
+    bool rotation_pending = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_rotation_);
+        in_session_ = false;
+        rotation_pending = rotation_requested_epoch_.load() > rotated_epoch_;
+    }
+    if (rotation_pending) {
+        envelope_.notify_rotation_progress();
+    }
 }
 
 void log_channel::end_session() {
@@ -265,14 +292,60 @@ std::string log_channel::do_rotate_file(epoch_id_type epoch) {
         std::string err_msg = "Failed to rename file from " + file_path().string() + " to " + new_file.string() + ". Error: " + ec.message();
         LOG_AND_THROW_IO_EXCEPTION(err_msg, ec);
     }
-    envelope_.add_file(new_file);
-
     registered_ = false;
-    envelope_.subtract_file(location_ / file_);
+    envelope_.replace_file(location_ / file_, new_file);
 
     return new_name;
 }
 
+void log_channel::request_rotation(epoch_id_type epoch) noexcept {
+    epoch_id_type requested = rotation_requested_epoch_.load();
+    while (requested < epoch && !rotation_requested_epoch_.compare_exchange_weak(requested, epoch)) {
+    }
+}
+
+bool log_channel::rotate_if_requested_locked() {
+    epoch_id_type requested = rotation_requested_epoch_.load();
+    if (requested <= rotated_epoch_) {
+        return false;
+    }
+    boost::system::error_code error;
+    bool exists = boost::filesystem::exists(file_path(), error);
+    rotated_files_[requested] = exists && !error ? do_rotate_file(requested) : std::string{};
+    rotated_epoch_ = requested;
+    return true;
+}
+
+void log_channel::rotate_if_idle() {
+    bool rotated = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_rotation_);
+        if (!in_session_) {
+            rotated = rotate_if_requested_locked();
+        }
+    }
+    if (rotated) {
+        envelope_.notify_rotation_progress();
+    }
+}
+
+bool log_channel::has_rotated(epoch_id_type epoch) {
+    std::lock_guard<std::mutex> lock(mtx_rotation_);
+    return rotated_epoch_ >= epoch;
+}
+
+std::string log_channel::rotated_file(epoch_id_type epoch) {
+    std::lock_guard<std::mutex> lock(mtx_rotation_);
+    // the first rotation done at or after the cut
+    auto it = rotated_files_.lower_bound(epoch);
+    return it != rotated_files_.end() ? it->second : std::string{};
+}
+
+void log_channel::forget_rotations_before(epoch_id_type epoch) {
+    std::lock_guard<std::mutex> lock(mtx_rotation_);
+    rotated_files_.erase(rotated_files_.begin(), rotated_files_.lower_bound(epoch));
+}
+
 
 
 
@@ -541,6 +541,24 @@ public:
     }
 
 
+    /**
+     * @brief Overwrites this log_entry with a data entry built from raw data.
+     *
+     * Unlike make_normal_with_blob_log_entry(), this method reuses the buffers already held by
+     * this object, so decoding many entries into the same log_entry does not allocate for each entry.
+     *
+     * @param type the entry type, one of normal_entry, normal_with_blob or remove_entry
+     * @param key_sid the key_sid field
+     * @param value_etc the value_etc field
+     * @param blob_ids the blob_ids field (empty for entries without blobs)
+     */
+    void assign(entry_type type, std::string_view key_sid, std::string_view value_etc, std::string_view blob_ids = std::string_view()) {
+        entry_type_ = type;
+        key_sid_.assign(key_sid.data(), key_sid.size());
+        value_etc_.assign(value_etc.data(), value_etc.size());
+        blob_ids_.assign(blob_ids.data(), blob_ids.size());
+    }
+
 private:
     entry_type entry_type_{};
     epoch_id_type epoch_id_{};
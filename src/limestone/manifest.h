@@ -98,7 +98,14 @@ public:
      * @brief Default persistent format version for new manifest files.
      * @note Update this value when upgrading the manifest persistent format version.
      */
-    static constexpr int default_persistent_format_version = 7;
+    static constexpr int default_persistent_format_version = 10;
+
+    /**
+     * @brief Persistent format version which introduced the compacted files other than pwal_0000.compacted.
+     * @details The newer generations (pwal_0000.compacted.<generation>) and the shards (pwal_0000.compacted.<generation>.<shard>)
+     *          are ignored by the builds of older versions.
+     */
+    static constexpr int compacted_generations_persistent_format_version = 8;
 
     /**
      * @brief Constructs a manifest object with the default version information.
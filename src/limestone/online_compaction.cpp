@@ -23,6 +23,8 @@
 #include "limestone_exception_helper.h"
 #include "logging_helper.h"
 #include "compaction_catalog.h"
+#include "storage_offset_table.h"
+#include "blob_reference_index.h"
 
 namespace limestone::internal {
 
@@ -119,4 +121,43 @@ void remove_file_safely(const boost::filesystem::path& file) {
     }
 }
 
-}
\ No newline at end of file
+std::vector<boost::filesystem::path> get_compacted_file_paths(const boost::filesystem::path& location, const compaction_catalog& catalog) {
+    std::vector<boost::filesystem::path> paths;
+    bool has_oldest = false;
+    for (const auto& name : catalog.get_compacted_generations()) {
+        boost::filesystem::path path = location / name;
+        if (boost::filesystem::exists(path)) {
+            paths.emplace_back(path);
+            has_oldest = has_oldest || name == compaction_catalog::get_compacted_filename();
+        }
+    }
+    boost::filesystem::path oldest = location / compaction_catalog::get_compacted_filename();
+    if (!has_oldest && boost::filesystem::exists(oldest)) {
+        paths.emplace_back(oldest);
+    }
+    return paths;
+}
+
+std::vector<boost::filesystem::path> remove_stale_compacted_files(const boost::filesystem::path& location, const compaction_catalog& catalog) {
+    std::set<std::string> recorded;
+    for (const auto& file_info : catalog.get_compacted_files()) {
+        recorded.insert(file_info.get_file_name());
+    }
+    std::vector<boost::filesystem::path> removed;
+    for (const auto& name : get_files_in_directory(location)) {
+        // pwal_0000.compacted itself is handled by handle_existing_compacted_file()
+        if (!compaction_catalog::get_compacted_generation(name) || name == compaction_catalog::get_compacted_filename()
+            || recorded.find(name) != recorded.end()) {
+            continue;
+        }
+        boost::filesystem::path path = location / name;
+        LOG_LP(INFO) << "removing compacted file not recorded in the compaction catalog: " << path;
+        remove_file_safely(storage_offset_table::index_file_path(path));
+        remove_file_safely(blob_reference_index::index_file_path(path));
+        remove_file_safely(path);
+        removed.emplace_back(path);
+    }
+    return removed;
+}
+
+}
@@ -20,9 +20,12 @@
 #include <boost/filesystem.hpp>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace limestone::internal {
 
+class compaction_catalog;
+
 /**
  * @brief Safely renames a file or directory.
  * 
@@ -94,6 +97,33 @@ std::set<std::string> get_files_in_directory(const boost::filesystem::path& dire
  */
 void remove_file_safely(const boost::filesystem::path& file);
 
+/**
+ * @brief Retrieves the paths of the compacted files to be merged by a snapshot.
+ * 
+ * The compacted files of the generations recorded in the catalog are returned, ordered from the newest
+ * generation to the oldest. pwal_0000.compacted is returned as the oldest generation if it exists,
+ * even if it is not recorded in the catalog.
+ * 
+ * @param location The log directory.
+ * @param catalog The compaction catalog of the log directory.
+ * @return The paths of the compacted files that exist.
+ */
+std::vector<boost::filesystem::path> get_compacted_file_paths(const boost::filesystem::path& location, const compaction_catalog& catalog);
+
+/**
+ * @brief Removes the compacted files of newer generations that are not recorded in the catalog.
+ * 
+ * Such files are left behind if the process stops during an online compaction, either before the
+ * catalog records the new generation or before the merged generations are removed. Their entries
+ * are also held by the files recorded in the catalog, so they are removed with their storage index files.
+ * 
+ * @param location The log directory.
+ * @param catalog The compaction catalog of the log directory.
+ * @return The paths of the removed compacted files.
+ * @throws limestone_exception if a file cannot be removed.
+ */
+std::vector<boost::filesystem::path> remove_stale_compacted_files(const boost::filesystem::path& location, const compaction_catalog& catalog);
+
 }  // namespace limestone::internal
 
 #endif  // ONLINE_COMPACTION_H
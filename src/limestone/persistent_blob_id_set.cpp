@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "persistent_blob_id_set.h"
+
+namespace limestone::internal {
+
+void persistent_blob_id_set::add(const std::vector<blob_id_type>& blob_ids) {
+    for (const auto& blob_id : blob_ids) {
+        shard& s = shard_of(blob_id);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.ids.insert(blob_id);
+    }
+}
+
+std::vector<blob_id_type> persistent_blob_id_set::check_and_remove(const std::vector<blob_id_type>& blob_ids) {
+    std::vector<blob_id_type> not_found_blob_ids;
+    for (const auto& blob_id : blob_ids) {
+        shard& s = shard_of(blob_id);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        if (s.ids.erase(blob_id) == 0) {
+            not_found_blob_ids.push_back(blob_id);
+        }
+    }
+    return not_found_blob_ids;
+}
+
+std::set<blob_id_type> persistent_blob_id_set::to_set() const {
+    std::set<blob_id_type> result{};
+    for (const auto& s : shards_) {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        result.insert(s.ids.begin(), s.ids.end());
+    }
+    return result;
+}
+
+}  // namespace limestone::internal
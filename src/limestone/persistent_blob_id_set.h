@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+#include <limestone/api/blob_id_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::blob_id_type;
+
+/**
+ * @brief The set of BLOB IDs written in log entries whose pools have not been released yet.
+ * @details Every log channel adds the BLOB IDs of its entries here, so the set is split into
+ *          shards, each guarded by its own mutex, and a BLOB ID only locks the shard it belongs to.
+ *          As BLOB IDs are allocated sequentially, the IDs written concurrently by different
+ *          channels spread over the shards, and the channels rarely wait for each other.
+ */
+class persistent_blob_id_set {
+public:
+    /// the number of shards
+    static constexpr std::size_t shard_count = 64;
+
+    /**
+     * @brief Adds the given BLOB IDs.
+     * @param blob_ids The BLOB IDs to add.
+     */
+    void add(const std::vector<blob_id_type>& blob_ids);
+
+    /**
+     * @brief Removes the given BLOB IDs that are in the set.
+     * @param blob_ids The BLOB IDs to check.
+     * @return The BLOB IDs that were not in the set, in the given order.
+     */
+    std::vector<blob_id_type> check_and_remove(const std::vector<blob_id_type>& blob_ids);
+
+    /**
+     * @brief Returns a copy of all the BLOB IDs, for tests.
+     */
+    [[nodiscard]] std::set<blob_id_type> to_set() const;
+
+private:
+    // aligned so that the mutexes of neighbouring shards do not share a cache line
+    struct alignas(64) shard {
+        mutable std::mutex mtx{};
+        std::unordered_set<blob_id_type> ids{};
+    };
+
+    shard& shard_of(blob_id_type id) noexcept { return shards_[id % shard_count]; }
+
+    std::array<shard, shard_count> shards_{};
+};
+
+}  // namespace limestone::internal
@@ -16,11 +16,9 @@
 
 #pragma once
 
-#include <cstdio>
+#include <string_view>
 #include <vector>
 
-#include <boost/filesystem.hpp>
-
 #include <rdma/rdma_send_stream_base.h>
 #include <replication/socket_io.h>
 #include <limestone/api/blob_id_type.h>
@@ -35,8 +33,8 @@ using limestone::api::blob_id_type;
  * @brief A socket_io subclass for the RDMA send path.
  *
  * Inherits all serialization methods from socket_io (used for non-blob data).
- * Overrides send_blob() to read the blob file in chunks and transmit each chunk
- * directly via rdma_send_stream_base::send_all_bytes(), avoiding full in-memory buffering.
+ * Overrides send_blob() to map the blob file into memory and transmit it in chunks
+ * via rdma_send_stream_base::send_all_bytes(), avoiding full in-memory buffering.
  *
  * receive_blob() is not supported on this class (FATAL if called); RDMA receive
  * uses blob_socket_io in string mode instead.
@@ -68,7 +66,7 @@ public:
      * @brief Send a blob file via RDMA.
      *
      * First flushes any accumulated non-blob data from the inherited output buffer,
-     * then reads the blob file in blob_buffer_size chunks and sends each chunk via
+     * then sends the mapped blob file in blob_buffer_size chunks via
      * rdma_send_stream_base::send_all_bytes().  The wire format is identical to
      * blob_socket_io::send_blob(): [blob_id: 8B][size: 4B][data: size bytes].
      *
@@ -77,24 +75,11 @@ public:
     void send_blob(blob_id_type blob_id) override;
 
 private:
-    void safe_close(FILE* fp);
-
-    /**
-     * @brief Open a blob file and return its size as uint32_t.
-     *        Throws on any I/O error or if the file is too large (> uint32_t max).
-     * @param path Resolved filesystem path to the blob file.
-     * @param[out] out_size File size in bytes.
-     * @return Open FILE pointer; caller must call safe_close() when done.
-     */
-    FILE* open_blob_file(boost::filesystem::path const& path, uint32_t& out_size);
-
     /**
-     * @brief Read the blob file and send its content in chunks via RDMA.
-     * @param fp Open FILE pointer positioned at the beginning of the blob data.
-     * @param path Path used only for error messages.
-     * @param remaining Total bytes to send.
+     * @brief Send the blob content in blob_buffer_size chunks via RDMA.
+     * @param data The content of the blob file, mapped into memory.
      */
-    void send_blob_data(FILE* fp, boost::filesystem::path const& path, uint32_t remaining);
+    void send_blob_data(std::string_view data);
 
     rdma_send_stream_base& rdma_stream_;
     datastore& datastore_;
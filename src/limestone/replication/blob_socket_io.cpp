@@ -8,6 +8,7 @@
 #include <stdexcept>
 #include <vector>
 #include <cstdio>
+#include "blob_read_cache.h"
 #include "limestone_exception_helper.h"
 
 namespace limestone::replication {
@@ -18,77 +19,18 @@ blob_socket_io::blob_socket_io(int fd, datastore &ds)
 blob_socket_io::blob_socket_io(const std::string &initial, datastore &ds)
     : socket_io(initial), datastore_(ds) {}
 
-// TODO: The blob file open/size-check/chunk-read logic below is duplicated in
-//       rdma_socket_io::send_blob. Consider extracting a shared helper.
 void blob_socket_io::send_blob(const blob_id_type blob_id) {
     auto blob_file = datastore_.get_blob_file(blob_id);
-    auto path = blob_file.path();
-    auto status = boost::filesystem::symlink_status(path);
-    if (boost::filesystem::is_symlink(status)) {
-        path = boost::filesystem::canonical(path);
-        status = boost::filesystem::status(path);
-    }
-    if (!boost::filesystem::is_regular_file(status)) {
-        LOG_AND_THROW_IO_EXCEPTION("Unsupported blob path type: " + path.string(), errno);
-    }
-
-    FILE* fp = std::fopen(path.string().c_str(), "rb");  // NOLINT(cppcoreguidelines-owning-memory)
-    if (!fp) {
-        LOG_AND_THROW_IO_EXCEPTION("Failed to open blob for reading: " + path.string(), errno);
-    }
-
-    if (std::fseek(fp, 0, SEEK_END) != 0) {
-        int ec = errno;
-        safe_close(fp);
-        LOG_AND_THROW_IO_EXCEPTION("Failed to seek blob file: " + path.string(), ec);
-    }
-    int64_t pos = std::ftell(fp);
-    if (pos == -1) {
-        int ec = errno;
-        safe_close(fp);
-        LOG_AND_THROW_IO_EXCEPTION("Failed to tell blob file: " + path.string(), ec);
-    }
-    if (static_cast<uint64_t>(pos) > std::numeric_limits<uint32_t>::max()) {
-        safe_close(fp);
-        LOG_AND_THROW_IO_EXCEPTION("Blob file too large: " + path.string(), EIO);
-    }
-    auto remaining = static_cast<uint32_t>(pos);
-    if (std::fseek(fp, 0, SEEK_SET) != 0) {
-        int ec = errno;
-        safe_close(fp);
-        LOG_AND_THROW_IO_EXCEPTION("Failed to rewind blob file: " + path.string(), ec);
+    auto view = datastore_.get_blob_read_cache().read(blob_id, blob_file.path());
+    auto data = view.data();
+    if (data.size() > std::numeric_limits<uint32_t>::max()) {
+        LOG_AND_THROW_IO_EXCEPTION("Blob file too large: " + blob_file.path().string(), EIO);
     }
 
     send_uint64(blob_id);
-    send_uint32(remaining);
-
-    std::vector<char> buffer(blob_buffer_size);
-    while (remaining > 0) {
-        std::size_t chunk = std::min(blob_buffer_size, static_cast<std::size_t>(remaining));
-        std::size_t total_read = 0;
-        while (total_read < chunk) {
-            std::size_t r = std::fread(&*std::next(buffer.begin(), static_cast<std::vector<char>::difference_type>(total_read)), 1, chunk - total_read, fp);
-            if (r == 0) {
-                // Capture errno immediately after fread before any other call may clobber it.
-                int ec = errno;
-                if (ec == EINTR) {
-                    std::clearerr(fp);
-                    continue;
-                }
-                if (std::feof(fp) != 0) {
-                    safe_close(fp);
-                    LOG_AND_THROW_IO_EXCEPTION("Unexpected EOF reading blob: " + path.string(), ec);
-                }
-                safe_close(fp);
-                LOG_AND_THROW_IO_EXCEPTION("Failed to read blob chunk: " + path.string(), ec);
-            }
-            total_read += r;
-        }
-        get_out_stream().write(buffer.data(), static_cast<std::streamsize>(total_read));
-        remaining -= static_cast<uint32_t>(total_read);
-    }
-
-    safe_close(fp);
+    send_uint32(static_cast<uint32_t>(data.size()));
+    // written straight from the mapping, without copying into a buffer first
+    get_out_stream().write(data.data(), static_cast<std::streamsize>(data.size()));
     flush();
 }
 
@@ -115,10 +57,18 @@ blob_id_type blob_socket_io::receive_blob() {
         );
     }
 
-    FILE* fp = std::fopen(path.string().c_str(), "wb"); // NOLINT(cppcoreguidelines-owning-memory)
+    // The BLOB is written to a temporary file and renamed into place, so that a reader mapping
+    // the existing file keeps seeing its old contents instead of a truncated file.
+    boost::filesystem::path tmp_path = path.string() + ".tmp";
+    FILE* fp = std::fopen(tmp_path.string().c_str(), "wb"); // NOLINT(cppcoreguidelines-owning-memory)
     if (!fp) {
-        LOG_AND_THROW_IO_EXCEPTION("Failed to open blob for writing: " + path.string(), errno);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to open blob for writing: " + tmp_path.string(), errno);
     }
+    auto discard = [this, &tmp_path, &fp]() {
+        safe_close(fp);
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmp_path, ec);
+    };
 
     std::vector<char> buffer(blob_buffer_size);
     while (remaining > 0) {
@@ -126,29 +76,39 @@ blob_id_type blob_socket_io::receive_blob() {
         get_in_stream().read(buffer.data(), static_cast<std::streamsize>(chunk));
         std::streamsize got = get_in_stream().gcount();
         if (got <= 0) {
-            safe_close(fp);
+            discard();
             LOG_AND_THROW_IO_EXCEPTION("Failed to read blob from stream", EIO);
         }
         if (std::fwrite(buffer.data(), 1, static_cast<std::size_t>(got), fp) != static_cast<std::size_t>(got)) {
             int ec = errno;
-            safe_close(fp);
-            LOG_AND_THROW_IO_EXCEPTION("Failed to write blob chunk: " + path.string(), ec);
+            discard();
+            LOG_AND_THROW_IO_EXCEPTION("Failed to write blob chunk: " + tmp_path.string(), ec);
         }
         remaining -= static_cast<uint32_t>(got);
     }
 
     if (std::fflush(fp) != 0) {
         int ec = errno;
-        safe_close(fp);
-        LOG_AND_THROW_IO_EXCEPTION("Failed to flush blob file: " + path.string(), ec);
+        discard();
+        LOG_AND_THROW_IO_EXCEPTION("Failed to flush blob file: " + tmp_path.string(), ec);
     }
     if (fsync(fileno(fp)) == -1) {
         int ec = errno;
-        safe_close(fp);
-        LOG_LP(WARNING) << "fsync failed: " << strerror(ec);
+        discard();
+        LOG_AND_THROW_IO_EXCEPTION("Failed to fsync blob file: " + tmp_path.string(), ec);
     }
     safe_close(fp);
 
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        boost::system::error_code ignored;
+        boost::filesystem::remove(tmp_path, ignored);
+        LOG_AND_THROW_IO_EXCEPTION("Failed to rename blob file from " + tmp_path.string() + " to " + path.string(), ec);
+    }
+    // a cached mapping still refers to the replaced file
+    datastore_.get_blob_read_cache().evict({blob_id});
+
     return blob_id;
 }
 
@@ -35,4 +35,8 @@ void rotation_result::add_rotated_file(const std::string& filename) {
     latest_rotated_files_.insert(filename);
 }
 
+const std::set<std::string>& rotation_result::get_rotated_files() const {
+    return latest_rotated_files_;
+}
+
 } // namespace limestone::api
@@ -32,6 +32,12 @@ snapshot::snapshot(boost::filesystem::path location,
 
 }
 
+snapshot::snapshot(boost::filesystem::path location,
+                   std::map<storage_id_type, write_version_type> clear_storage,
+                   std::vector<boost::filesystem::path> compacted_files) noexcept
+    : pimpl(std::make_unique<snapshot_impl>(std::move(location), std::move(clear_storage), std::move(compacted_files))) {
+}
+
 std::unique_ptr<cursor> snapshot::get_cursor() const {
     try {
         return pimpl->get_cursor();
@@ -41,6 +47,15 @@ std::unique_ptr<cursor> snapshot::get_cursor() const {
     }
 }
 
+std::unique_ptr<cursor> snapshot::get_cursor(storage_id_type storage_id) const {
+    try {
+        return pimpl->get_cursor(storage_id);
+    } catch (...) {
+        HANDLE_EXCEPTION_AND_ABORT();
+        throw;  // Unreachable, but required to satisfy the compiler
+    }
+}
+
 std::vector<std::unique_ptr<cursor>> snapshot::get_partitioned_cursors(std::size_t n) {
     try {
         return pimpl->get_partitioned_cursors(n);
@@ -50,6 +65,15 @@ std::vector<std::unique_ptr<cursor>> snapshot::get_partitioned_cursors(std::size
     }
 }
 
+std::vector<std::unique_ptr<cursor>> snapshot::get_partitioned_cursors(std::size_t n, storage_id_type storage_id) {
+    try {
+        return pimpl->get_partitioned_cursors(n, storage_id);
+    } catch (...) {
+        HANDLE_EXCEPTION_AND_ABORT();
+        throw;  // Unreachable, but required to satisfy the compiler
+    }
+}
+
 std::unique_ptr<cursor> snapshot::find([[maybe_unused]] storage_id_type storage_id, [[maybe_unused]] std::string_view entry_key) const noexcept {
     LOG_LP(ERROR) << "not implemented";
     std::abort();  // FIXME should implement
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "snapshot_block_cache.h"
+
+#include <sys/stat.h>
+
+namespace limestone::internal {
+
+std::optional<snapshot_block_cache::file_id> snapshot_block_cache::identify(const boost::filesystem::path& file) {
+    struct stat st{};
+    if (::stat(file.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    return file_id{static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino)};
+}
+
+std::shared_ptr<const snapshot_block_cache::block> snapshot_block_cache::find(const file_id& file, std::uint64_t offset) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(key_type{file, offset});
+    if (it == index_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+void snapshot_block_cache::insert(const file_id& file, std::uint64_t offset, std::shared_ptr<const block> b) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    key_type key{file, offset};
+    if (index_.find(key) != index_.end()) {
+        // another reader decoded the same block concurrently
+        return;
+    }
+    size_ += b->raw.size();
+    lru_.emplace_front(key, std::move(b));
+    index_.emplace(key, lru_.begin());
+    // keep at least the block just inserted, even if it alone exceeds the capacity
+    while (size_ > capacity_ && lru_.size() > 1) {
+        auto& victim = lru_.back();
+        size_ -= victim.second->raw.size();
+        index_.erase(victim.first);
+        lru_.pop_back();
+    }
+}
+
+std::uint64_t snapshot_block_cache::hits() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return hits_;
+}
+
+std::uint64_t snapshot_block_cache::misses() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return misses_;
+}
+
+} // namespace limestone::internal
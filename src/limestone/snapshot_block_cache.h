@@ -0,0 +1,117 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+namespace limestone::internal {
+
+/**
+ * @brief LRU cache of decoded blocks of block-based snapshot files, shared by the cursors of a snapshot.
+ * @details When several cursors scan the same snapshot at the same time (e.g. multiple partitioned
+ *          cursor sessions loading different tables), the first cursor to reach a block reads and decodes it,
+ *          and the others take it from this cache instead of reading the same bytes again.
+ *          Blocks are immutable once inserted, so they can be handed out to any number of readers.
+ *          This class is thread-safe.
+ */
+class snapshot_block_cache {
+public:
+    /**
+     * @brief Identity of a file, which does not change when the file is renamed or replaced by another one at the same path.
+     */
+    struct file_id {
+        std::uint64_t device;
+        std::uint64_t inode;
+
+        bool operator<(const file_id& other) const noexcept {
+            return std::tie(device, inode) < std::tie(other.device, other.inode);
+        }
+    };
+
+    /**
+     * @brief A decoded block.
+     */
+    struct block {
+        // the uncompressed payload
+        std::string raw;
+        std::uint32_t entry_count;
+        // the file offset just past the block
+        std::uint64_t next_offset;
+    };
+
+    /**
+     * @brief Default total size of the cached payloads in bytes.
+     */
+    static constexpr std::size_t default_capacity = 64L * 1024L * 1024L;
+
+    /**
+     * @brief Creates an empty cache.
+     * @param capacity the total size of the cached payloads above which the least recently used blocks are evicted
+     */
+    explicit snapshot_block_cache(std::size_t capacity = default_capacity) noexcept : capacity_(capacity) {}
+
+    /**
+     * @brief Returns the identity of the given file.
+     * @return the identity, or std::nullopt if the file cannot be examined
+     */
+    static std::optional<file_id> identify(const boost::filesystem::path& file);
+
+    /**
+     * @brief Returns the block starting at @p offset in the file, or nullptr if it is not cached.
+     */
+    std::shared_ptr<const block> find(const file_id& file, std::uint64_t offset);
+
+    /**
+     * @brief Adds the block starting at @p offset in the file, evicting old blocks if the cache is full.
+     */
+    void insert(const file_id& file, std::uint64_t offset, std::shared_ptr<const block> b);
+
+    /**
+     * @brief Returns the number of find() calls that returned a block.
+     */
+    [[nodiscard]] std::uint64_t hits() const;
+
+    /**
+     * @brief Returns the number of find() calls that returned nullptr.
+     */
+    [[nodiscard]] std::uint64_t misses() const;
+
+private:
+    using key_type = std::pair<file_id, std::uint64_t>;
+    using lru_list = std::list<std::pair<key_type, std::shared_ptr<const block>>>;
+
+    mutable std::mutex mtx_{};
+    std::size_t capacity_;
+    std::size_t size_{0};
+    // most recently used first
+    lru_list lru_{};
+    std::map<key_type, lru_list::iterator> index_{};
+    std::uint64_t hits_{0};
+    std::uint64_t misses_{0};
+};
+
+} // namespace limestone::internal
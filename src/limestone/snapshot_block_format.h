@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace limestone::internal {
+
+/**
+ * @brief Constants of the block-based snapshot file format (format version 2).
+ *
+ * A version 1 snapshot is a plain concatenation of log_entry records, the same as a WAL file.
+ * A version 2 snapshot is laid out as follows (all integers are little endian):
+ *
+ *   file   := magic block*
+ *   block  := codec(u8) raw_size(u32) stored_size(u32) entry_count(u32) crc32c(u32) payload[stored_size]
+ *
+ * The payload is the (possibly compressed) sequence of entry_count entries. The checksum covers the
+ * stored payload, so corruption is detected before decompression. Each entry is encoded as
+ *
+ *   entry  := type(u8) shared(varint) unshared(varint) key_sid_suffix[unshared]
+ *             value_len(varint) value_etc[value_len] [blob_count(varint) blob_ids[blob_count * 8]]
+ *
+ * where the key_sid is stored as the length of the prefix shared with the previous entry of the block
+ * and the remaining suffix. blob_count and blob_ids are present only for normal_with_blob entries.
+ * A block never contains entries of more than one storage, so each storage starts at a block boundary
+ * and the storage offset table can point at it.
+ */
+struct snapshot_block_format {
+    /**
+     * @brief Magic bytes at the beginning of a version 2 snapshot file.
+     * @details The first byte is not a valid log_entry type, so a version 1 file is never mistaken for version 2.
+     */
+    static constexpr std::string_view magic{"\xd3LSBLK02", 8};
+
+    /**
+     * @brief Size of the block header in bytes.
+     */
+    static constexpr std::size_t block_header_size = 1 + 4 + 4 + 4 + 4;
+
+    /**
+     * @brief Uncompressed size at which the writer closes a block.
+     */
+    static constexpr std::size_t default_block_size = 64L * 1024L;
+
+    /**
+     * @brief Compression codec of a block payload.
+     */
+    enum class codec : std::uint8_t {
+        none = 0,
+        lz4 = 1,
+    };
+
+    /**
+     * @brief Returns whether blocks can be compressed with the given codec in this build.
+     */
+    static constexpr bool is_supported(codec c) noexcept {
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+        return c == codec::none || c == codec::lz4;
+#else
+        return c == codec::none;
+#endif
+    }
+
+    /**
+     * @brief Codec used by the snapshot writer.
+     */
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+    static constexpr codec default_codec = codec::lz4;
+#else
+    static constexpr codec default_codec = codec::none;
+#endif
+};
+
+} // namespace limestone::internal
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "snapshot_block_reader.h"
+
+#include <endian.h>
+
+#include <array>
+#include <cstring>
+
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+#include <lz4.h>
+#endif
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "crc32c.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+namespace {
+
+std::uint32_t load_uint32le(const char* p) {
+    std::uint32_t value{};
+    std::memcpy(&value, p, sizeof(value));
+    return le32toh(value);
+}
+
+} // namespace
+
+bool snapshot_block_reader::read_file_header(std::istream& in) {
+    std::array<char, snapshot_block_format::magic.size()> buf{};
+    in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    if (in.gcount() == static_cast<std::streamsize>(buf.size())
+        && std::string_view(buf.data(), buf.size()) == snapshot_block_format::magic) {
+        return true;
+    }
+    in.clear();
+    in.seekg(0);
+    return false;
+}
+
+bool snapshot_block_reader::read(std::istream& in, log_entry& entry) {
+    while (remaining_ == 0) {
+        if (!load_block(in)) {
+            return false;
+        }
+    }
+
+    const std::string_view raw = block_->raw;
+    auto read_varint = [&]() -> std::uint64_t {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (position_ >= raw.size()) {
+                broken("truncated entry");
+            }
+            auto byte = static_cast<std::uint8_t>(raw[position_++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7fU) << shift;
+            if ((byte & 0x80U) == 0) {
+                return value;
+            }
+        }
+        broken("invalid varint");
+    };
+    auto read_bytes = [&](std::uint64_t size) -> std::string_view {
+        if (size > raw.size() - position_) {
+            broken("truncated entry");
+        }
+        std::string_view bytes = raw.substr(position_, size);
+        position_ += size;
+        return bytes;
+    };
+
+    if (position_ >= raw.size()) {
+        broken("truncated entry");
+    }
+    auto type = static_cast<log_entry::entry_type>(raw[position_++]);
+    if (type != log_entry::entry_type::normal_entry && type != log_entry::entry_type::normal_with_blob
+        && type != log_entry::entry_type::remove_entry) {
+        broken("unexpected entry type " + std::to_string(static_cast<int>(type)));
+    }
+    std::uint64_t shared = read_varint();
+    if (shared > key_sid_.size()) {
+        broken("invalid key prefix length");
+    }
+    std::uint64_t unshared = read_varint();
+    key_sid_.resize(shared);
+    key_sid_.append(read_bytes(unshared));
+    std::string_view value_etc = read_bytes(read_varint());
+    std::string_view blob_ids{};
+    if (type == log_entry::entry_type::normal_with_blob) {
+        blob_ids = read_bytes(read_varint() * sizeof(limestone::api::blob_id_type));
+    }
+    entry.assign(type, key_sid_, value_etc, blob_ids);
+    remaining_--;
+    return true;
+}
+
+bool snapshot_block_reader::load_block(std::istream& in) {
+    std::uint64_t offset = 0;
+    bool cacheable = cache_ && file_;
+    if (cacheable) {
+        auto pos = in.tellg();
+        cacheable = pos >= 0;
+        offset = static_cast<std::uint64_t>(pos);
+    }
+    if (cacheable) {
+        if (auto cached = cache_->find(*file_, offset); cached) {
+            in.seekg(static_cast<std::streamoff>(cached->next_offset));
+            start_block(std::move(cached));
+            return true;
+        }
+    }
+
+    std::array<char, snapshot_block_format::block_header_size> header{};
+    in.read(header.data(), static_cast<std::streamsize>(header.size()));
+    if (in.gcount() == 0 && in.eof()) {
+        return false;
+    }
+    if (in.gcount() != static_cast<std::streamsize>(header.size())) {
+        broken("truncated block header");
+    }
+    auto codec = static_cast<snapshot_block_format::codec>(header[0]);
+    std::uint32_t raw_size = load_uint32le(&header[1]);
+    std::uint32_t stored_size = load_uint32le(&header[5]);
+    std::uint32_t entry_count = load_uint32le(&header[9]);
+    std::uint32_t checksum = load_uint32le(&header[13]);
+
+    stored_.resize(stored_size);
+    in.read(stored_.data(), static_cast<std::streamsize>(stored_size));
+    if (in.gcount() != static_cast<std::streamsize>(stored_size)) {
+        broken("truncated block");
+    }
+    if (crc32c(stored_.data(), stored_.size()) != checksum) {
+        broken("block checksum mismatch");
+    }
+
+    auto decoded = std::make_shared<snapshot_block_cache::block>();
+    decoded->entry_count = entry_count;
+    decoded->next_offset = offset + header.size() + stored_size;
+    switch (codec) {
+    case snapshot_block_format::codec::none:
+        if (raw_size != stored_size) {
+            broken("block size mismatch");
+        }
+        decoded->raw.swap(stored_);
+        break;
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+    case snapshot_block_format::codec::lz4: {
+        decoded->raw.resize(raw_size);
+        int size = LZ4_decompress_safe(stored_.data(), decoded->raw.data(), static_cast<int>(stored_size), static_cast<int>(raw_size));
+        if (size < 0 || static_cast<std::uint32_t>(size) != raw_size) {
+            broken("cannot decompress block");
+        }
+        break;
+    }
+#endif
+    default:
+        broken("unsupported block codec " + std::to_string(static_cast<int>(codec)));
+    }
+
+    if (cacheable) {
+        cache_->insert(*file_, offset, decoded);
+    }
+    start_block(std::move(decoded));
+    return true;
+}
+
+void snapshot_block_reader::start_block(std::shared_ptr<const snapshot_block_cache::block> b) noexcept {
+    block_ = std::move(b);
+    position_ = 0;
+    remaining_ = block_->entry_count;
+    key_sid_.clear();
+}
+
+void snapshot_block_reader::broken(const std::string& reason) const {
+    LOG_AND_THROW_EXCEPTION("snapshot file is broken (" + name_ + "): " + reason);
+}
+
+} // namespace limestone::internal
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "log_entry.h"
+#include "snapshot_block_cache.h"
+#include "snapshot_block_format.h"
+
+namespace limestone::internal {
+
+using limestone::api::log_entry;
+
+/**
+ * @brief Decodes the entries of a block-based (version 2) snapshot file.
+ * @details The reader decodes one block at a time and hands out its entries in order.
+ *          It keeps no position of its own, so the stream may be repositioned to a block boundary
+ *          (e.g. the beginning of a storage) before the first call to read().
+ * @see snapshot_block_format
+ */
+class snapshot_block_reader {
+public:
+    /**
+     * @brief Creates a reader.
+     * @param name the name of the file, used in error messages
+     * @param cache if not null, decoded blocks are taken from and added to this cache
+     * @param file the identity of the file in the cache; the cache is not used if this is not given
+     */
+    explicit snapshot_block_reader(std::string name, std::shared_ptr<snapshot_block_cache> cache = nullptr,
+                                   std::optional<snapshot_block_cache::file_id> file = std::nullopt) noexcept
+        : name_(std::move(name)), cache_(std::move(cache)), file_(file) {}
+
+    /**
+     * @brief Consumes the file header if the stream is a version 2 snapshot file.
+     * @param in the stream positioned at the beginning of the file
+     * @return true if the file is a version 2 snapshot file, false otherwise;
+     *         in the latter case the stream is left at the beginning of the file
+     */
+    static bool read_file_header(std::istream& in);
+
+    /**
+     * @brief Reads the next entry.
+     * @param in the stream of the file
+     * @param entry the entry to overwrite
+     * @return true if an entry was read, false at the end of the file
+     * @exception limestone_exception if the file is broken
+     */
+    bool read(std::istream& in, log_entry& entry);
+
+    /**
+     * @brief Discards the rest of the current block.
+     * @details Call this after repositioning the stream to another block boundary,
+     *          so that the next read() starts at the new position.
+     */
+    void reset() noexcept {
+        position_ = 0;
+        remaining_ = 0;
+        key_sid_.clear();
+    }
+
+private:
+    bool load_block(std::istream& in);
+    void start_block(std::shared_ptr<const snapshot_block_cache::block> b) noexcept;
+    [[noreturn]] void broken(const std::string& reason) const;
+
+    std::string name_;
+    std::shared_ptr<snapshot_block_cache> cache_;
+    std::optional<snapshot_block_cache::file_id> file_;
+    std::string stored_{};
+    std::shared_ptr<const snapshot_block_cache::block> block_{};
+    std::string key_sid_{};
+    std::size_t position_{0};
+    std::uint32_t remaining_{0};
+};
+
+} // namespace limestone::internal
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "snapshot_block_writer.h"
+
+#include <endian.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+#include <lz4.h>
+#endif
+
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "crc32c.h"
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+namespace {
+
+void append_varint(std::string& buf, std::uint64_t value) {
+    while (value >= 0x80U) {
+        buf.push_back(static_cast<char>((value & 0x7fU) | 0x80U));
+        value >>= 7U;
+    }
+    buf.push_back(static_cast<char>(value));
+}
+
+void append_uint32le(std::string& buf, std::uint32_t value) {
+    std::uint32_t le = htole32(value);
+    buf.append(reinterpret_cast<const char*>(&le), sizeof(le));  // NOLINT(*-reinterpret-cast)
+}
+
+storage_id_type storage_of(std::string_view key_sid) {
+    storage_id_type storage_id{};
+    std::memcpy(&storage_id, key_sid.data(), sizeof(storage_id_type));
+    return le64toh(storage_id);
+}
+
+} // namespace
+
+snapshot_block_writer::snapshot_block_writer(FILE* out, boost::filesystem::path file, storage_offset_table* offsets,
+                                             snapshot_block_format::codec codec, std::size_t block_size)
+    : out_(out), file_(std::move(file)), offsets_(offsets), codec_(codec), block_size_(block_size) {
+    if (!snapshot_block_format::is_supported(codec_)) {
+        LOG_AND_THROW_EXCEPTION("snapshot block codec " + std::to_string(static_cast<int>(codec_)) + " is not supported in this build");
+    }
+    block_.reserve(block_size_ + block_size_ / 4);
+    write_bytes(snapshot_block_format::magic.data(), snapshot_block_format::magic.size());
+}
+
+void snapshot_block_writer::add(log_entry::entry_type type, std::string_view key_sid, std::string_view value_etc, std::string_view blob_ids) {
+    storage_id_type storage_id = storage_of(key_sid);
+    if (!storage_id_ || *storage_id_ != storage_id) {
+        // Blocks never span storages, so that every storage starts at a block boundary.
+        flush_block();
+        if (offsets_ != nullptr) {
+            offsets_->record(storage_id, written_bytes_);
+        }
+        storage_id_ = storage_id;
+    }
+    if (offsets_ != nullptr) {
+        offsets_->record_write_version(write_version_type(log_entry::write_version_epoch_number(value_etc),
+                                                          log_entry::write_version_minor_write_version(value_etc)));
+    }
+
+    std::size_t shared = 0;
+    std::size_t limit = std::min(previous_key_sid_.size(), key_sid.size());
+    while (shared < limit && previous_key_sid_[shared] == key_sid[shared]) {
+        shared++;
+    }
+    block_.push_back(static_cast<char>(type));
+    append_varint(block_, shared);
+    append_varint(block_, key_sid.size() - shared);
+    block_.append(key_sid.substr(shared));
+    append_varint(block_, value_etc.size());
+    block_.append(value_etc);
+    if (type == log_entry::entry_type::normal_with_blob) {
+        append_varint(block_, blob_ids.size() / sizeof(limestone::api::blob_id_type));
+        block_.append(blob_ids);
+    }
+    previous_key_sid_.assign(key_sid.data(), key_sid.size());
+    entry_count_++;
+
+    if (block_.size() >= block_size_) {
+        flush_block();
+    }
+}
+
+void snapshot_block_writer::finish() {
+    flush_block();
+    if (offsets_ != nullptr) {
+        offsets_->finish(written_bytes_);
+    }
+}
+
+void snapshot_block_writer::flush_block() {
+    if (entry_count_ == 0) {
+        return;
+    }
+    auto codec = snapshot_block_format::codec::none;
+    std::string_view payload = block_;
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+    if (codec_ == snapshot_block_format::codec::lz4) {
+        compressed_.resize(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(block_.size()))));
+        int size = LZ4_compress_default(block_.data(), compressed_.data(), static_cast<int>(block_.size()), static_cast<int>(compressed_.size()));
+        // Keep the block uncompressed if compression does not pay off.
+        if (size > 0 && static_cast<std::size_t>(size) < block_.size()) {
+            codec = snapshot_block_format::codec::lz4;
+            payload = std::string_view(compressed_.data(), static_cast<std::size_t>(size));
+        }
+    }
+#endif
+
+    std::string header{};
+    header.push_back(static_cast<char>(codec));
+    append_uint32le(header, static_cast<std::uint32_t>(block_.size()));
+    append_uint32le(header, static_cast<std::uint32_t>(payload.size()));
+    append_uint32le(header, entry_count_);
+    append_uint32le(header, crc32c(payload.data(), payload.size()));
+    write_bytes(header.data(), header.size());
+    write_bytes(payload.data(), payload.size());
+    DVLOG_LP(log_trace_fine) << "snapshot block written: entries=" << entry_count_ << ", raw=" << block_.size() << ", stored=" << payload.size();
+
+    block_.clear();
+    previous_key_sid_.clear();
+    entry_count_ = 0;
+}
+
+void snapshot_block_writer::write_bytes(const void* data, std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (fwrite(data, size, 1, out_) != 1) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot write snapshot file (" + file_.string() + ")", errno);
+    }
+    written_bytes_ += size;
+}
+
+} // namespace limestone::internal
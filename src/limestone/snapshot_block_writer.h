@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <boost/filesystem.hpp>
+
+#include "log_entry.h"
+#include "snapshot_block_format.h"
+#include "storage_offset_table.h"
+
+namespace limestone::internal {
+
+using limestone::api::log_entry;
+
+/**
+ * @brief Writes key_sid-sorted entries as a block-based (version 2) snapshot file.
+ * @see snapshot_block_format
+ */
+class snapshot_block_writer {
+public:
+    /**
+     * @brief Creates a writer and writes the file header.
+     * @param out the stream to write to, positioned at the beginning of the file
+     * @param file the path of the file, used in error messages
+     * @param offsets if not null, the byte range of each storage is recorded to this table
+     * @param codec the compression codec of the blocks
+     * @param block_size the uncompressed size at which a block is closed
+     * @exception limestone_io_exception if the header cannot be written
+     */
+    snapshot_block_writer(FILE* out, boost::filesystem::path file, storage_offset_table* offsets = nullptr,
+                          snapshot_block_format::codec codec = snapshot_block_format::default_codec,
+                          std::size_t block_size = snapshot_block_format::default_block_size);
+
+    /**
+     * @brief Appends an entry.
+     * @details Entries must be added in key_sid order.
+     * @param type the entry type, one of normal_entry, normal_with_blob or remove_entry
+     * @exception limestone_io_exception if a block cannot be written
+     */
+    void add(log_entry::entry_type type, std::string_view key_sid, std::string_view value_etc, std::string_view blob_ids);
+
+    /**
+     * @brief Writes the last block and closes the storage offset table, if any.
+     * @exception limestone_io_exception if the block cannot be written
+     */
+    void finish();
+
+    /**
+     * @brief Returns the number of bytes written to the file so far.
+     */
+    [[nodiscard]] std::uint64_t written_bytes() const noexcept { return written_bytes_; }
+
+private:
+    void flush_block();
+    void write_bytes(const void* data, std::size_t size);
+
+    FILE* out_;
+    boost::filesystem::path file_;
+    storage_offset_table* offsets_;
+    snapshot_block_format::codec codec_;
+    std::size_t block_size_;
+
+    std::string block_{};
+    std::string compressed_{};
+    std::string previous_key_sid_{};
+    std::uint32_t entry_count_{0};
+    std::optional<storage_id_type> storage_id_{};
+    std::uint64_t written_bytes_{0};
+};
+
+} // namespace limestone::internal
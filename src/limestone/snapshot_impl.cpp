@@ -33,27 +33,50 @@
 namespace limestone::internal {
 
 snapshot_impl::snapshot_impl(boost::filesystem::path location, 
-                             std::map<storage_id_type, write_version_type> clear_storage) noexcept
-    : location_(std::move(location)), clear_storage(std::move(clear_storage)) {
+                             std::map<storage_id_type, write_version_type> clear_storage,
+                             std::optional<std::vector<boost::filesystem::path>> compacted_files) noexcept
+    : location_(std::move(location)), clear_storage(std::move(clear_storage)), compacted_files_(std::move(compacted_files)),
+      block_cache_(std::make_shared<snapshot_block_cache>()) {
 }
 
 std::unique_ptr<cursor> snapshot_impl::get_cursor() const {
-    boost::filesystem::path compacted_file = location_ / limestone::internal::compaction_catalog::get_compacted_filename();
-    boost::filesystem::path snapshot_file = location_ / std::string(snapshot::subdirectory_name_) / std::string(snapshot::file_name_);
+    return create_cursor(std::nullopt);
+}
+
+std::unique_ptr<cursor> snapshot_impl::get_cursor(storage_id_type storage_id) const {
+    return create_cursor(storage_id);
+}
+
+std::vector<std::unique_ptr<limestone::api::cursor>> snapshot_impl::get_partitioned_cursors(std::size_t n) const {
+    return create_partitioned_cursors(n, std::nullopt);
+}
+
+std::vector<std::unique_ptr<limestone::api::cursor>> snapshot_impl::get_partitioned_cursors(std::size_t n, storage_id_type storage_id) const {
+    return create_partitioned_cursors(n, storage_id);
+}
 
+std::vector<boost::filesystem::path> snapshot_impl::cursor_source_files() const {
+    // ordered from newest to oldest, as required by cursor_impl
+    std::vector<boost::filesystem::path> files{location_ / std::string(snapshot::subdirectory_name_) / std::string(snapshot::file_name_)};
+    if (compacted_files_) {
+        files.insert(files.end(), compacted_files_->begin(), compacted_files_->end());
+        return files;
+    }
+    boost::filesystem::path compacted_file = location_ / limestone::internal::compaction_catalog::get_compacted_filename();
     if (boost::filesystem::exists(compacted_file)) {
-        return cursor_impl::create_cursor(snapshot_file, compacted_file, clear_storage);
+        files.emplace_back(compacted_file);
     }
-    return cursor_impl::create_cursor(snapshot_file, clear_storage);  
+    return files;
+}
+
+std::unique_ptr<cursor> snapshot_impl::create_cursor(std::optional<storage_id_type> storage_id) const {
+    return cursor_impl::create_cursor(cursor_source_files(), clear_storage, storage_id, block_cache_);
 }
 
-std::vector<std::unique_ptr<limestone::api::cursor>> snapshot_impl::get_partitioned_cursors(std::size_t n) {
+std::vector<std::unique_ptr<limestone::api::cursor>> snapshot_impl::create_partitioned_cursors(std::size_t n, std::optional<storage_id_type> storage_id) const {
     if (n == 0) {
         throw std::invalid_argument("partition count must be greater than 0");
     }
-    if (partitioned_called_.exchange(true)) {
-        THROW_LIMESTONE_EXCEPTION("get_partitioned_cursors() was already called once");
-    }
 
     namespace li = limestone::internal;
     namespace la = limestone::api;
@@ -67,15 +90,7 @@ std::vector<std::unique_ptr<limestone::api::cursor>> snapshot_impl::get_partitio
         cursors.emplace_back(li::partitioned_cursor_impl::create_cursor(queue));
     }
 
-    boost::filesystem::path snapshot_file = location_ / std::string(la::snapshot::subdirectory_name_) / std::string(la::snapshot::file_name_);
-    boost::filesystem::path compacted_file = location_ / li::compaction_catalog::get_compacted_filename();
-
-    std::unique_ptr<li::cursor_impl_base> base_cursor;
-    if (boost::filesystem::exists(compacted_file)) {
-        base_cursor = std::make_unique<li::cursor_impl>(snapshot_file, compacted_file, clear_storage);
-    } else {
-        base_cursor = std::make_unique<li::cursor_impl>(snapshot_file, clear_storage);
-    }
+    std::unique_ptr<li::cursor_impl_base> base_cursor = std::make_unique<li::cursor_impl>(cursor_source_files(), clear_storage, storage_id, block_cache_);
 
     auto distributor = std::make_shared<li::cursor_distributor>(
         std::move(base_cursor),
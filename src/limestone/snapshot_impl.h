@@ -19,13 +19,15 @@
 #include <limestone/api/cursor.h>
 #include <limestone/api/write_version_type.h>
 
-#include <atomic>
 #include <boost/filesystem.hpp>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <vector>
 
+#include "snapshot_block_cache.h"
+
 namespace limestone::internal {
 
 using limestone::api::cursor;
@@ -34,14 +36,28 @@ using limestone::api::write_version_type;
 
 class snapshot_impl {
 public:
-    explicit snapshot_impl(boost::filesystem::path location, std::map<storage_id_type, write_version_type> clear_storage) noexcept;
-    std::vector<std::unique_ptr<limestone::api::cursor>> get_partitioned_cursors(std::size_t n);
+    /**
+     * @param compacted_files the compacted files to merge, ordered from the newest generation to the oldest;
+     *        if not given, pwal_0000.compacted in the location is merged if it exists
+     */
+    explicit snapshot_impl(boost::filesystem::path location, std::map<storage_id_type, write_version_type> clear_storage,
+                           std::optional<std::vector<boost::filesystem::path>> compacted_files = std::nullopt) noexcept;
+    std::vector<std::unique_ptr<limestone::api::cursor>> get_partitioned_cursors(std::size_t n) const;
+    std::vector<std::unique_ptr<limestone::api::cursor>> get_partitioned_cursors(std::size_t n, storage_id_type storage_id) const;
+    [[nodiscard]] const snapshot_block_cache& block_cache() const noexcept { return *block_cache_; }
     [[nodiscard]] std::unique_ptr<cursor> get_cursor() const;
+    [[nodiscard]] std::unique_ptr<cursor> get_cursor(storage_id_type storage_id) const;
 
 private:
+    [[nodiscard]] std::vector<boost::filesystem::path> cursor_source_files() const;
+    [[nodiscard]] std::unique_ptr<cursor> create_cursor(std::optional<storage_id_type> storage_id) const;
+    std::vector<std::unique_ptr<limestone::api::cursor>> create_partitioned_cursors(std::size_t n, std::optional<storage_id_type> storage_id) const;
+
     boost::filesystem::path location_;
     std::map<storage_id_type, write_version_type> clear_storage;
-    std::atomic<bool> partitioned_called_{false};
+    std::optional<std::vector<boost::filesystem::path>> compacted_files_;
+    // shared by all cursors of this snapshot, so that concurrent scans decode each block only once
+    std::shared_ptr<snapshot_block_cache> block_cache_;
 };
 
 } // namespace limestone::internal
\ No newline at end of file
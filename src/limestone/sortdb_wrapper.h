@@ -105,6 +105,31 @@ public:
             LOG_AND_THROW_EXCEPTION("sortdb iterator invalidated, status: " + it->status().ToString());
         }
     }
+
+    /**
+     * @brief iterates the entries from the first key not less than @p begin, while @p fun returns true
+     * @param begin the key to start from, or empty to start from the first entry
+     * @param fun called with each key and value; returns false to stop the iteration
+     * @note this may be called from several threads at once, each of them iterating a different key range
+     */
+    void each_from(std::string_view begin, const std::function<bool(std::string_view, std::string_view)>& fun) {
+        std::unique_ptr<Iterator> it{sortdb_->NewIterator(ReadOptions())};
+        if (begin.empty()) {
+            it->SeekToFirst();
+        } else {
+            it->Seek(Slice(begin.data(), begin.size()));
+        }
+        for (; it->Valid(); it->Next()) {
+            Slice key = it->key();
+            Slice value = it->value();
+            if (!fun(std::string_view(key.data(), key.size()), std::string_view(value.data(), value.size()))) {
+                break;
+            }
+        }
+        if (!it->status().ok()) {
+            LOG_AND_THROW_EXCEPTION("sortdb iterator invalidated, status: " + it->status().ToString());
+        }
+    }
     
 private:
     DB* sortdb_{};
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "storage_offset_table.h"
+
+#include <endian.h>
+
+#include <cstdio>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+#include <glog/logging.h>
+#include <limestone/logging.h>
+
+#include "limestone_exception_helper.h"
+#include "logging_helper.h"
+
+namespace limestone::internal {
+
+namespace {
+
+void write_uint64le(FILE* out, std::uint64_t value, const boost::filesystem::path& file) {
+    std::uint64_t buf = htole64(value);
+    if (fwrite(&buf, sizeof(buf), 1, out) != 1) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot write storage index file (" + file.string() + ")", errno);
+    }
+}
+
+bool read_uint64le(std::istream& in, std::uint64_t& value) {
+    std::uint64_t buf{};
+    in.read(reinterpret_cast<char*>(&buf), sizeof(buf));  // NOLINT(*-reinterpret-cast)
+    if (!in) {
+        return false;
+    }
+    value = le64toh(buf);
+    return true;
+}
+
+} // namespace
+
+void storage_offset_table::record(storage_id_type storage_id, std::uint64_t offset) {
+    if (current_ && *current_ == storage_id) {
+        return;
+    }
+    close_current(offset);
+    ranges_[storage_id] = range{offset, offset};
+    current_ = storage_id;
+}
+
+void storage_offset_table::finish(std::uint64_t end_offset) {
+    close_current(end_offset);
+    current_ = std::nullopt;
+    data_size_ = end_offset;
+}
+
+void storage_offset_table::close_current(std::uint64_t end_offset) {
+    if (current_) {
+        auto& r = ranges_[*current_];
+        r.end = end_offset;
+        r.max_version = current_max_;
+    }
+    current_max_ = write_version_type{};
+}
+
+std::optional<storage_offset_table::range> storage_offset_table::find(storage_id_type storage_id) const {
+    auto it = ranges_.find(storage_id);
+    if (it == ranges_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void storage_offset_table::write_file(const boost::filesystem::path& index_file) const {
+    FILE* ostrm = fopen(index_file.c_str(), "w");  // NOLINT(*-owning-memory)
+    if (!ostrm) {
+        LOG_AND_THROW_IO_EXCEPTION("cannot create storage index file (" + index_file.string() + ")", errno);
+    }
+    write_uint64le(ostrm, format_magic, index_file);
+    write_uint64le(ostrm, data_size_, index_file);
+    write_uint64le(ostrm, ranges_.size(), index_file);
+    for (const auto& [storage_id, r] : ranges_) {
+        write_uint64le(ostrm, storage_id, index_file);
+        write_uint64le(ostrm, r.begin, index_file);
+        write_uint64le(ostrm, r.end, index_file);
+        write_uint64le(ostrm, static_cast<std::uint64_t>(r.max_version.get_major()), index_file);
+        write_uint64le(ostrm, r.max_version.get_minor(), index_file);
+    }
+    if (fclose(ostrm) != 0) {  // NOLINT(*-owning-memory)
+        LOG_AND_THROW_IO_EXCEPTION("cannot close storage index file (" + index_file.string() + ")", errno);
+    }
+}
+
+std::optional<storage_offset_table> storage_offset_table::load_for(const boost::filesystem::path& data_file) {
+    boost::filesystem::path index_file = index_file_path(data_file);
+    boost::system::error_code error;
+    if (!boost::filesystem::exists(index_file, error) || error) {
+        return std::nullopt;
+    }
+    std::uint64_t actual_size = boost::filesystem::file_size(data_file, error);
+    if (error) {
+        return std::nullopt;
+    }
+
+    boost::filesystem::ifstream istrm(index_file, std::ios_base::in | std::ios_base::binary);
+    std::uint64_t magic{};
+    std::uint64_t data_size{};
+    std::uint64_t count{};
+    if (!read_uint64le(istrm, magic) || magic != format_magic
+        || !read_uint64le(istrm, data_size) || !read_uint64le(istrm, count)) {
+        VLOG_LP(log_info) << "ignoring broken storage index file: " << index_file;
+        return std::nullopt;
+    }
+    if (data_size != actual_size) {
+        VLOG_LP(log_info) << "ignoring stale storage index file: " << index_file;
+        return std::nullopt;
+    }
+
+    storage_offset_table table{};
+    table.data_size_ = data_size;
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::uint64_t storage_id{};
+        range r{};
+        std::uint64_t major{};
+        std::uint64_t minor{};
+        if (!read_uint64le(istrm, storage_id) || !read_uint64le(istrm, r.begin) || !read_uint64le(istrm, r.end)
+            || !read_uint64le(istrm, major) || !read_uint64le(istrm, minor)
+            || r.begin > r.end || r.end > data_size) {
+            VLOG_LP(log_info) << "ignoring broken storage index file: " << index_file;
+            return std::nullopt;
+        }
+        r.max_version = write_version_type(static_cast<limestone::api::epoch_id_type>(major), minor);
+        table.ranges_.emplace(storage_id, r);
+    }
+    return table;
+}
+
+boost::filesystem::path storage_offset_table::index_file_path(const boost::filesystem::path& data_file) {
+    return data_file.parent_path() / (std::string(index_file_prefix) + data_file.filename().string());
+}
+
+} // namespace limestone::internal
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string_view>
+
+#include <boost/filesystem.hpp>
+
+#include <limestone/api/storage_id_type.h>
+#include <limestone/api/write_version_type.h>
+
+namespace limestone::internal {
+
+using limestone::api::storage_id_type;
+using limestone::api::write_version_type;
+
+/**
+ * @brief Table of byte ranges occupied by each storage in a key-sorted snapshot-shaped file.
+ *
+ * Files such as `data/snapshot` and `pwal_0000.compacted` are written in key_sid order,
+ * so all entries of one storage are stored contiguously. This table records, for each storage,
+ * the offset of its first entry and the offset just past its last entry, which lets a reader
+ * seek directly to a single storage instead of scanning the whole file.
+ *
+ * The table is kept in a sidecar file (see index_file_path()). It is an optional accelerator:
+ * readers must fall back to a sequential scan if the sidecar is missing or does not match the data file.
+ */
+class storage_offset_table {
+public:
+    /**
+     * @brief Byte range [begin, end) of one storage in the data file.
+     */
+    struct range {
+        std::uint64_t begin;
+        std::uint64_t end;
+        // the largest write version of the entries in the range; if it is older than the
+        // clear_storage cutoff of the storage, readers may skip the whole range
+        write_version_type max_version{};
+    };
+
+    /**
+     * @brief Records that the entry about to be written at @p offset belongs to @p storage_id.
+     * @details Only transitions between storages are stored, so this may be called for every entry.
+     *          Entries must be recorded in file order.
+     * @param storage_id the storage ID of the entry
+     * @param offset the file offset at which the entry starts
+     */
+    void record(storage_id_type storage_id, std::uint64_t offset);
+
+    /**
+     * @brief Records the write version of an entry of the storage passed to the last record() call.
+     * @details This should be called for every entry written, with the write version as stored in the file.
+     */
+    void record_write_version(const write_version_type& version) noexcept {
+        if (current_max_ < version) {
+            current_max_ = version;
+        }
+    }
+
+    /**
+     * @brief Returns whether the last recorded entry belongs to @p storage_id.
+     * @details Writers use this to avoid querying the file offset for every entry.
+     */
+    [[nodiscard]] bool is_current(storage_id_type storage_id) const noexcept { return current_ && *current_ == storage_id; }
+
+    /**
+     * @brief Closes the last open range.
+     * @param end_offset the size of the data file after the last entry has been written
+     */
+    void finish(std::uint64_t end_offset);
+
+    /**
+     * @brief Returns the byte range of the given storage.
+     * @param storage_id the storage ID to look up
+     * @return the range, or std::nullopt if the file has no entries for the storage
+     */
+    [[nodiscard]] std::optional<range> find(storage_id_type storage_id) const;
+
+    /**
+     * @brief Returns all recorded ranges keyed by storage ID.
+     */
+    [[nodiscard]] const std::map<storage_id_type, range>& ranges() const noexcept { return ranges_; }
+
+    /**
+     * @brief Returns the size of the data file this table describes.
+     */
+    [[nodiscard]] std::uint64_t data_size() const noexcept { return data_size_; }
+
+    /**
+     * @brief Writes the table to the given sidecar file.
+     * @exception limestone_io_exception if the file cannot be written
+     */
+    void write_file(const boost::filesystem::path& index_file) const;
+
+    /**
+     * @brief Loads the sidecar of the given data file.
+     * @param data_file the snapshot-shaped file described by the table
+     * @return the table, or std::nullopt if the sidecar is missing, broken, or stale
+     *         (i.e. it was written for a data file of a different size)
+     */
+    static std::optional<storage_offset_table> load_for(const boost::filesystem::path& data_file);
+
+    /**
+     * @brief Returns the path of the sidecar file for the given data file.
+     * @details The sidecar is placed next to the data file with index_file_prefix prepended to its name.
+     *          A prefix is used rather than a suffix so that the sidecar of a `pwal_` file is never
+     *          mistaken for a WAL file.
+     */
+    static boost::filesystem::path index_file_path(const boost::filesystem::path& data_file);
+
+    /**
+     * @brief Prefix of sidecar file names.
+     */
+    static constexpr std::string_view index_file_prefix = "storage_index.";
+
+private:
+    static constexpr std::uint64_t format_magic = 0x3230305844494c53ULL;  // "SLIDX002" in little endian
+
+    void close_current(std::uint64_t end_offset);
+
+    std::map<storage_id_type, range> ranges_{};
+    std::optional<storage_id_type> current_{};
+    write_version_type current_max_{};
+    std::uint64_t data_size_{0};
+};
+
+} // namespace limestone::internal
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_dedup_index.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+
+TEST(blob_dedup_index_test, digest) {
+    auto digest = blob_dedup_index::digest_of("test data");
+    EXPECT_EQ(blob_dedup_index::digest_of("test data"), digest);
+    EXPECT_NE(blob_dedup_index::digest_of("test datb"), digest);
+    EXPECT_NE(blob_dedup_index::digest_of(""), digest);
+
+    // the same digest, whichever pieces the data is given in
+    blob_dedup_index::hasher hasher{};
+    hasher.update("test ", 5);
+    hasher.update("data", 4);
+    EXPECT_EQ(hasher.finish(), digest);
+}
+
+TEST(blob_dedup_index_test, find_add_remove) {
+    blob_dedup_index index{8};
+    auto digest1 = blob_dedup_index::digest_of("data1");
+    auto digest2 = blob_dedup_index::digest_of("data2");
+    EXPECT_FALSE(index.find(digest1).has_value());
+
+    index.add(digest1, 1);
+    index.add(digest2, 2);
+    EXPECT_EQ(index.find(digest1), std::optional<blob_id_type>{1});
+    EXPECT_EQ(index.find(digest2), std::optional<blob_id_type>{2});
+
+    // a BLOB that could not be linked is replaced by the one written instead
+    index.add(digest1, 3);
+    EXPECT_EQ(index.find(digest1), std::optional<blob_id_type>{3});
+    index.remove(digest1, 1);
+    EXPECT_EQ(index.find(digest1), std::optional<blob_id_type>{3});
+    index.remove(digest1, 3);
+    EXPECT_FALSE(index.find(digest1).has_value());
+    EXPECT_EQ(index.size(), 1);
+}
+
+TEST(blob_dedup_index_test, oldest_are_dropped) {
+    blob_dedup_index index{3};
+    for (blob_id_type id = 1; id <= 5; id++) {
+        index.add(blob_dedup_index::digest_of("data" + std::to_string(id)), id);
+    }
+    EXPECT_EQ(index.size(), 3);
+    EXPECT_FALSE(index.find(blob_dedup_index::digest_of("data1")).has_value());
+    EXPECT_FALSE(index.find(blob_dedup_index::digest_of("data2")).has_value());
+    EXPECT_EQ(index.find(blob_dedup_index::digest_of("data5")), std::optional<blob_id_type>{5});
+}
+
+TEST(blob_dedup_index_test, capacity_from_environment) {
+    unsetenv("LIMESTONE_BLOB_DEDUP_ENTRIES");
+    EXPECT_EQ(blob_dedup_index::capacity_from_environment(), 0);
+    setenv("LIMESTONE_BLOB_DEDUP_ENTRIES", "1000", 1);
+    EXPECT_EQ(blob_dedup_index::capacity_from_environment(), 1000);
+    setenv("LIMESTONE_BLOB_DEDUP_ENTRIES", "many", 1);
+    EXPECT_EQ(blob_dedup_index::capacity_from_environment(), 0);
+    unsetenv("LIMESTONE_BLOB_DEDUP_ENTRIES");
+}
+
+}  // namespace limestone::testing
@@ -9,6 +9,7 @@
 #include "blob_file_garbage_collector.h"
 #include "limestone/logging.h"
 #include "blob_file_resolver.h"
+#include "blob_scan_state.h"
 
 namespace limestone::testing {
 
@@ -305,6 +306,54 @@ TEST_F(blob_file_garbage_collector_test, finalize_scan_and_cleanup_deletes_non_e
     EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_path(102)));
 }
 
+TEST_F(blob_file_garbage_collector_test, next_scan_uses_saved_scan_state) {
+    create_blob_file(*resolver_, 100);
+    create_blob_file(*resolver_, 200);
+    create_blob_file(*resolver_, 300);
+
+    gc_->scan_blob_files(300);
+    gc_->start_add_gc_exempt_blob_ids();
+    gc_->add_gc_exempt_blob_id(200);
+    gc_->finalize_add_gc_exempt_blob_ids();
+    gc_->wait_for_cleanup();
+
+    // Only the file left by the cleanup is recorded.
+    auto state = blob_scan_state::load(resolver_->get_scan_state_path());
+    ASSERT_TRUE(state.has_value());
+    EXPECT_EQ(state->max_scanned_blob_id(), 300);
+    EXPECT_EQ(state->blob_ids(), std::vector<blob_id_type>{200});
+    EXPECT_EQ(state->incremental_scans(), 0);
+
+    // The next scan only looks up the IDs from 300 on, so a file placed below it is not found.
+    gc_->shutdown();
+    create_blob_file(*resolver_, 150);
+    create_blob_file(*resolver_, 300);
+    create_blob_file(*resolver_, 400);
+    gc_ = std::make_unique<testable_blob_file_garbage_collector>(*resolver_);
+    gc_->scan_blob_files(500);
+    gc_->wait_for_blob_file_scan();
+    EXPECT_EQ(get_sorted_blob_ids(gc_->get_blob_file_list()), (std::vector<blob_id_type>{200, 300, 400}));
+
+    // A maximum below that of the state requires listing the directories.
+    gc_->shutdown();
+    gc_ = std::make_unique<testable_blob_file_garbage_collector>(*resolver_);
+    gc_->scan_blob_files(250);
+    gc_->wait_for_blob_file_scan();
+    EXPECT_EQ(get_sorted_blob_ids(gc_->get_blob_file_list()), (std::vector<blob_id_type>{150, 200}));
+}
+
+TEST_F(blob_file_garbage_collector_test, broken_scan_state_is_ignored) {
+    create_blob_file(*resolver_, 100);
+    create_blob_file(*resolver_, 200);
+    {
+        std::ofstream ofs(resolver_->get_scan_state_path().string());
+        ofs << "broken";
+    }
+    gc_->scan_blob_files(1000);
+    gc_->wait_for_blob_file_scan();
+    EXPECT_EQ(get_sorted_blob_ids(gc_->get_blob_file_list()), (std::vector<blob_id_type>{100, 200}));
+}
+
 TEST_F(blob_file_garbage_collector_test, finalize_scan_and_cleanup_handles_deletion_failure) {
     FLAGS_v = 100;
     // Arrange:
@@ -5,6 +5,8 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
+#include <thread>
 #include <boost/filesystem.hpp>
 
 #include "blob_file_gc_snapshot.h"
@@ -98,65 +100,41 @@ protected:
         return entry;
     }
 
-    // Helper function to check log_entry fields.
-    // Checking order: storage_id, key, value, write_version.
-    void check_log_entry(const log_entry& entry,
-                         storage_id_type expected_storage,
-                         const std::string& expected_key,
-                         const std::string& expected_value,
-                         const write_version_type& expected_wv) {
-        EXPECT_EQ(entry.storage(), expected_storage);
-
-        std::string key_buf;
-        entry.key(key_buf);
-        EXPECT_EQ(key_buf, expected_key);
-
-        std::string value_buf;
-        entry.value(value_buf);
-        EXPECT_EQ(value_buf, expected_value);
-
-        write_version_type actual_wv;
-        entry.write_version(actual_wv);
-        EXPECT_EQ(actual_wv, expected_wv);
+    // Helper function to collect the BLOB IDs consumed from the snapshot, in ascending order.
+    template <class Finalize>
+    static std::vector<blob_id_type> collect(Finalize&& finalize) {
+        std::vector<blob_id_type> blob_ids;
+        finalize([&blob_ids](blob_id_type blob_id) { blob_ids.push_back(blob_id); });
+        std::sort(blob_ids.begin(), blob_ids.end());
+        return blob_ids;
+    }
+
+    static std::vector<blob_id_type> finalize(blob_file_gc_snapshot& snapshot) {
+        return collect([&snapshot](const auto& consumer) { snapshot.finalize_snapshot(consumer); });
     }
 };
 
 /**
- * @brief Test that a valid blob entry is sanitized and added.
- *
- * The sanitize_and_add_entry() method should truncate the value portion (leaving only
- * the write_version header) and add the entry if its write_version is below the threshold.
+ * @brief Test that the BLOB IDs of a valid blob entry are added.
  */
 TEST_F(blob_file_gc_snapshot_test, sanitize_and_add_entry_valid) {
     storage_id_type storage = 100;
     std::string key = "testKey";
-    std::string value = "testValue"; // This payload should be truncated.
+    std::string value = "testValue"; // This payload is not kept.
     write_version_type wv(50, 1);      // Entry write_version.
     
     // Create a blob log entry.
-    log_entry entry = create_blob_log_entry(storage, key, value, wv);
-    
-    // Verify that the entry is of type normal_with_blob and value_etc contains header + payload.
+    log_entry entry = create_blob_log_entry(storage, key, value, wv, {1, 2});
     EXPECT_EQ(entry.type(), log_entry::entry_type::normal_with_blob);
-    constexpr std::size_t headerSize = sizeof(epoch_id_type) + sizeof(std::uint64_t);
-    EXPECT_EQ(entry.value_etc().size(), headerSize + value.size());
     
     // Create a blob_file_gc_snapshot with a threshold higher than the entry's write_version.
     blob_file_gc_snapshot snapshot(write_version_type(100, 1));
     snapshot.sanitize_and_add_entry(entry);
     snapshot.finalize_local_entries();
-    const log_entry_container& snap = snapshot.finalize_snapshot();
-    
-    // Expect one entry in the snapshot.
-    EXPECT_EQ(snap.size(), 1u);
-    
-    // The added entry should have its value truncated (i.e. extracted value is empty),
-    // while storage, key, and write_version remain unchanged.
-    log_entry sanitized_entry = *snap.begin();
-    std::string extracted_value;
-    sanitized_entry.value(extracted_value);
-    EXPECT_TRUE(extracted_value.empty());
-    check_log_entry(sanitized_entry, storage, key, "", wv);
+    EXPECT_EQ(finalize(snapshot), (std::vector<blob_id_type>{1, 2}));
+
+    // The entries are consumed by finalize_snapshot().
+    EXPECT_TRUE(finalize(snapshot).empty());
 }
 
 /**
@@ -189,10 +167,9 @@ TEST_F(blob_file_gc_snapshot_test, sanitize_and_add_entry_invalid_type) {
     blob_file_gc_snapshot snapshot(write_version_type(100, 1));
     snapshot.sanitize_and_add_entry(entry);
     snapshot.finalize_local_entries();
-    const log_entry_container& snap = snapshot.finalize_snapshot();
     
     // Since the entry is not normal_with_blob, it should not be added.
-    EXPECT_EQ(snap.size(), 0u);
+    EXPECT_TRUE(finalize(snapshot).empty());
 }
 
 /**
@@ -204,26 +181,23 @@ TEST_F(blob_file_gc_snapshot_test, reset_snapshot) {
     std::string value = "resetValue";
     write_version_type wv(50, 1);
     
-    log_entry entry = create_blob_log_entry(storage, key, value, wv);
     blob_file_gc_snapshot snapshot(write_version_type(100, 1));
-    snapshot.sanitize_and_add_entry(entry);
+    snapshot.sanitize_and_add_entry(create_blob_log_entry(storage, key, value, wv, {1}));
+    snapshot.sanitize_and_add_entry(create_blob_log_entry(storage, key, value, write_version_type(100, 1), {2}));
     snapshot.finalize_local_entries();
-    const log_entry_container& snap = snapshot.finalize_snapshot();
-    EXPECT_EQ(snap.size(), 1u);
     
     // Reset the snapshot.
     snapshot.reset();
     
-    // After reset, finalize_snapshot should return an empty snapshot.
-    const log_entry_container& snap2 = snapshot.finalize_snapshot();
-    EXPECT_EQ(snap2.size(), 0u);
+    // After reset, finalize_snapshot should consume no BLOB IDs.
+    EXPECT_TRUE(finalize(snapshot).empty());
 }
 
 /**
  * @brief Test that finalize_snapshot() merges duplicate entries.
  *
  * When multiple entries with the same key are added, finalize_snapshot() should remove duplicates,
- * keeping only the entry with the maximum write_version (since the container is sorted in descending order).
+ * keeping only the entry with the maximum write_version.
  */
 TEST_F(blob_file_gc_snapshot_test, finalize_snapshot_merging_duplicates) {
     storage_id_type storage = 400;
@@ -233,25 +207,60 @@ TEST_F(blob_file_gc_snapshot_test, finalize_snapshot_merging_duplicates) {
     write_version_type wv_low(10, 1);  // Lower version.
     write_version_type wv_high(10, 2); // Higher version.
     
-    // Create two blob entries with the same key.
-    log_entry entry1 = create_blob_log_entry(storage, key, value1, wv_low);
-    log_entry entry2 = create_blob_log_entry(storage, key, value2, wv_high);
+    // Create two blob entries with the same key, added in reverse order.
+    log_entry entry1 = create_blob_log_entry(storage, key, value1, wv_low, {1, 2});
+    log_entry entry2 = create_blob_log_entry(storage, key, value2, wv_high, {3});
     
     blob_file_gc_snapshot snapshot(write_version_type(100, 1));
-    snapshot.sanitize_and_add_entry(entry1);
     snapshot.sanitize_and_add_entry(entry2);
+    snapshot.sanitize_and_add_entry(entry1);
     snapshot.finalize_local_entries();
-    const log_entry_container& snap = snapshot.finalize_snapshot();
-    
-    // After merging and duplicate removal, only one entry should remain.
-    EXPECT_EQ(snap.size(), 1u);
     
-    // The remaining entry should have the maximum write_version (wv_high).
-    log_entry merged_entry = *snap.begin();
-    write_version_type merged_wv;
-    merged_entry.write_version(merged_wv);
-    EXPECT_EQ(merged_wv.get_major(), wv_high.get_major());
-    EXPECT_EQ(merged_wv.get_minor(), wv_high.get_minor());
+    // Only the BLOB IDs of the entry with the maximum write_version (wv_high) should remain.
+    EXPECT_EQ(finalize(snapshot), (std::vector<blob_id_type>{3}));
+}
+
+/**
+ * @brief Test that duplicate entries are merged across threads and spilled runs.
+ */
+TEST_F(blob_file_gc_snapshot_test, finalize_snapshot_spilled_runs) {
+    boost::filesystem::path spill_dir = boost::filesystem::path(temp_dir) / "spill";
+    boost::filesystem::create_directories(spill_dir);
+
+    // A memory limit this small writes every run to the spill directory.
+    blob_file_gc_snapshot snapshot(write_version_type(100, 1), spill_dir, 1);
+    std::vector<log_entry> entries;
+    for (int i = 0; i < 10; i++) {
+        std::string key = "key" + std::to_string(i);
+        entries.emplace_back(create_blob_log_entry(500, key, "old", write_version_type(10, 1), {static_cast<blob_id_type>(100 + i)}));
+        entries.emplace_back(create_blob_log_entry(500, key, "new", write_version_type(20, 1), {static_cast<blob_id_type>(200 + i)}));
+        entries.emplace_back(create_blob_log_entry(500, key, "high", write_version_type(200, 1), {static_cast<blob_id_type>(300 + i)}));
+    }
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 3; t++) {
+        threads.emplace_back([&snapshot, &entries, t]() {
+            for (std::size_t i = t; i < entries.size(); i += 3) {
+                snapshot.sanitize_and_add_entry(entries[i]);
+            }
+            snapshot.finalize_local_entries();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_FALSE(boost::filesystem::is_empty(spill_dir));
+
+    std::vector<blob_id_type> expected;
+    for (blob_id_type i = 0; i < 10; i++) {
+        expected.push_back(200 + i);
+    }
+    for (blob_id_type i = 0; i < 10; i++) {
+        expected.push_back(300 + i);
+    }
+    EXPECT_EQ(finalize(snapshot), expected);
+
+    // The run files are removed once merged.
+    EXPECT_TRUE(boost::filesystem::is_empty(spill_dir));
 }
 
 TEST_F(blob_file_gc_snapshot_test, tls_container_null_state_behavior) {
@@ -259,69 +268,65 @@ TEST_F(blob_file_gc_snapshot_test, tls_container_null_state_behavior) {
     blob_file_gc_snapshot snapshot(write_version_type(100, 1));
     EXPECT_EQ(snapshot.boundary_version(), write_version_type(100, 1));
 
-    // Ensure the internal state is reset so that tls_container_ becomes nullptr.
+    // Ensure the internal state is reset so that tls_entries_ becomes nullptr.
     snapshot.reset();
 
-    // Calling finalize_local_entries() when tls_container_ is nullptr should not crash.
+    // Calling finalize_local_entries() when tls_entries_ is nullptr should not crash.
     EXPECT_NO_THROW(snapshot.finalize_local_entries());
-    const log_entry_container& snap1 = snapshot.finalize_snapshot();
-    EXPECT_EQ(snap1.size(), 0u);
+    EXPECT_TRUE(finalize(snapshot).empty());
 
     // Now, create a valid blob entry.
     storage_id_type storage = 500;
     std::string key = "boundaryKey";
     std::string value = "boundaryValue";
     write_version_type wv(50, 1);
-    log_entry entry = create_blob_log_entry(storage, key, value, wv);
+    log_entry entry = create_blob_log_entry(storage, key, value, wv, {7});
 
-    // Calling sanitize_and_add_entry() when tls_container_ is nullptr should not crash
-    // and should create a new container to add the entry.
+    // Calling sanitize_and_add_entry() when tls_entries_ is nullptr should not crash
+    // and should create new entries to add the entry to.
     EXPECT_NO_THROW(snapshot.sanitize_and_add_entry(entry));
+
+    // The entries are finalized even if finalize_local_entries() has not been called.
+    EXPECT_EQ(finalize(snapshot), (std::vector<blob_id_type>{7}));
     snapshot.finalize_local_entries();
-    const log_entry_container& snap2 = snapshot.finalize_snapshot();
-    EXPECT_EQ(snap2.size(), 1u);
 }
 
 TEST_F(blob_file_gc_snapshot_test, threshold_boundary_test) {
     // Create a snapshot with threshold write_version (100, 1)
     testable_blob_file_gc_snapshot snapshot(write_version_type(100, 1));
     EXPECT_EQ(snapshot.boundary_version(), write_version_type(100, 1));
+    auto low = [&snapshot]() { return collect([&snapshot](const auto& consumer) { snapshot.finalize_low_entries_impl(consumer); }); };
+    auto high = [&snapshot]() { return collect([&snapshot](const auto& consumer) { snapshot.finalize_high_entries_impl(consumer); }); };
 
     // Case 1: Entry with write_version exactly equal to threshold.
-    // Expected: The entry should NOT be added (because it's not less than the threshold).
-    log_entry entry_equal = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(100, 1));
+    // Expected: The entry should NOT be added to the low entries (because it's not less than the threshold).
+    log_entry entry_equal = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(100, 1), {1});
     snapshot.sanitize_and_add_entry(entry_equal);
     snapshot.finalize_local_entries();
-    log_entry_container snap_equal = snapshot.finalize_low_entries_impl();
-    EXPECT_EQ(snap_equal.size(), 0u);
-    snap_equal = snapshot.finalize_high_entries_impl();
-    EXPECT_EQ(snap_equal.size(), 1u);
+    EXPECT_TRUE(low().empty());
+    EXPECT_EQ(high(), (std::vector<blob_id_type>{1}));
 
     // Reset snapshot state.
     snapshot.reset();
 
     // Case 2: Entry with write_version just below the threshold.
-    // For example, (100, 0) is less than (100, 1); expected: the entry should be added.
-    log_entry entry_lower = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(100, 0));
+    // For example, (100, 0) is less than (100, 1); expected: the entry should be added to the low entries.
+    log_entry entry_lower = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(100, 0), {2});
     snapshot.sanitize_and_add_entry(entry_lower);
     snapshot.finalize_local_entries();
-    log_entry_container snap_lower = snapshot.finalize_low_entries_impl();
-    EXPECT_EQ(snap_lower.size(), 1u);
-    snap_lower = snapshot.finalize_high_entries_impl();
-    EXPECT_EQ(snap_lower.size(), 1u);
+    EXPECT_EQ(low(), (std::vector<blob_id_type>{2}));
+    EXPECT_TRUE(high().empty());
 
     // Reset snapshot state.
     snapshot.reset();
 
     // Case 3: Entry with write_version above the threshold.
-    // For example, (101, 0) is greater than (100, 1); expected: the entry should NOT be added.
-    log_entry entry_higher = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(101, 0));
+    // For example, (101, 0) is greater than (100, 1); expected: the entry should NOT be added to the low entries.
+    log_entry entry_higher = create_blob_log_entry(600, "boundaryKey", "boundaryValue", write_version_type(101, 0), {3});
     snapshot.sanitize_and_add_entry(entry_higher);
     snapshot.finalize_local_entries();
-    log_entry_container snap_higher = snapshot.finalize_low_entries_impl();
-    EXPECT_EQ(snap_higher.size(), 0u);
-    snap_higher = snapshot.finalize_high_entries_impl();
-    EXPECT_EQ(snap_higher.size(), 1u);
+    EXPECT_TRUE(low().empty());
+    EXPECT_EQ(high(), (std::vector<blob_id_type>{3}));
 }
 
 
@@ -5,6 +5,7 @@
 namespace limestone::testing {
 
 using limestone::api::blob_id_type;    
+using limestone::internal::blob_file_resolver;
 
 constexpr const char* base_directory = "/tmp/blob_file_resolver_test";
 
@@ -103,4 +104,22 @@ TEST_F(blob_file_resolver_test, extract_blob_id_returns_correct_id) {
     EXPECT_EQ(extracted, expected);
 }
 
+// Test for parse_blob_file_name() and format_blob_file_name()
+TEST_F(blob_file_resolver_test, parse_and_format_blob_file_name) {
+    blob_id_type id = 0;
+    EXPECT_TRUE(blob_file_resolver::parse_blob_file_name("FFFFFFFFFFFFFFFF.blob", id));
+    EXPECT_EQ(id, UINT64_MAX);
+    EXPECT_TRUE(blob_file_resolver::parse_blob_file_name("0123456789abcdef.blob", id));
+    EXPECT_EQ(id, 0x0123456789abcdefULL);
+    EXPECT_FALSE(blob_file_resolver::parse_blob_file_name("0123456789abcdef.blob2", id));
+    EXPECT_FALSE(blob_file_resolver::parse_blob_file_name("0123456789abcde.blob", id));
+    EXPECT_FALSE(blob_file_resolver::parse_blob_file_name("", id));
+
+    std::array<char, blob_file_resolver::blob_file_name_length + 1> name{};
+    blob_file_resolver::format_blob_file_name(0x0123456789abcdefULL, name.data());
+    EXPECT_STREQ(name.data(), "0123456789abcdef.blob");
+    blob_file_resolver::format_blob_file_name(0, name.data());
+    EXPECT_STREQ(name.data(), "0000000000000000.blob");
+}
+
 }  // namespace limestone::testing
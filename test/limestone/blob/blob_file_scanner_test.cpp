@@ -17,11 +17,16 @@
  #include <gtest/gtest.h>
  #include <boost/filesystem.hpp>
  #include <fstream>
+ #include <algorithm>
+ #include <iterator>
  #include <set>
+ #include <vector>
  #include "blob_file_scanner.h"
  #include "blob_file_resolver.h"
  
  namespace limestone::testing {
+
+ using limestone::api::blob_id_type;
  
  class blob_file_scanner_test : public ::testing::Test {
  protected:
@@ -112,6 +117,44 @@
      EXPECT_TRUE(found_files.count(resolver_->resolve_path(100)) > 0);
  }
  
+ // Test case to verify that scan_blob_ids lists the blob files of all subdirectories in order
+ TEST_F(blob_file_scanner_test, scan_blob_ids_lists_all_blob_files) {
+     std::vector<blob_id_type> expected{};
+     for (blob_id_type id = 1; id <= 1000; id += 7) {
+         create_blob_file(id);
+         expected.emplace_back(id);
+     }
+     std::ofstream non_blob_file((resolver_->get_blob_root() / "dir_00" / "non_blob.txt").string());
+     non_blob_file << "not a blob";
+     boost::filesystem::create_directories(resolver_->get_blob_root() / "dir_01" / "0000000000000065.blob");
+     // a missing subdirectory has no blob files
+     boost::filesystem::remove_all(resolver_->get_blob_root() / "dir_99");
+
+     for (std::size_t thread_count : {1, 4, 200}) {
+         auto ids = scanner_->scan_blob_ids(thread_count);
+         std::vector<blob_id_type> expected_existing{};
+         std::copy_if(expected.begin(), expected.end(), std::back_inserter(expected_existing), [](blob_id_type id) { return id % 100 != 99; });
+         EXPECT_EQ(ids, expected_existing);
+     }
+ }
+
+ // Test case to verify that probe_blob_ids finds the blob files in the given range
+ TEST_F(blob_file_scanner_test, probe_blob_ids_finds_blob_files_in_range) {
+     create_blob_file(5);
+     create_blob_file(100);
+     create_blob_file(150);
+     create_blob_file(299);
+     create_blob_file(300);
+     create_blob_file(301);
+
+     EXPECT_EQ(scanner_->probe_blob_ids(100, 300, 4), (std::vector<blob_id_type>{100, 150, 299, 300}));
+     EXPECT_EQ(scanner_->probe_blob_ids(101, 298, 1), (std::vector<blob_id_type>{150}));
+     EXPECT_EQ(scanner_->probe_blob_ids(300, 300, 4), (std::vector<blob_id_type>{300}));
+     EXPECT_TRUE(scanner_->probe_blob_ids(302, 100000, 4).empty());
+     EXPECT_TRUE(scanner_->probe_blob_ids(300, 299, 4).empty());
+     EXPECT_EQ(scanner_->probe_blob_ids(UINT64_MAX - 10, UINT64_MAX, 4), std::vector<blob_id_type>{});
+ }
+
  // Test case to verify that the scanner handles an empty directory correctly
  TEST_F(blob_file_scanner_test, scan_handles_empty_directory) {
      // Set to store found file paths
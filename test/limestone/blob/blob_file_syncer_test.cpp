@@ -0,0 +1,93 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_file_syncer.h"
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+#include "blob_file_resolver.h"
+#include "blob_pack_store.h"
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+
+constexpr const char* base_directory = "/tmp/blob_file_syncer_test";
+
+class blob_file_syncer_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(base_directory);
+        boost::filesystem::create_directories(base_directory);
+        resolver_ = std::make_unique<blob_file_resolver>(base_directory);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(base_directory);
+    }
+
+    boost::filesystem::path write_blob(blob_id_type id) {
+        boost::filesystem::path path = resolver_->resolve_path(id);
+        boost::filesystem::create_directories(path.parent_path());
+        std::ofstream(path.string()) << "blob " << id;
+        return path;
+    }
+
+    std::unique_ptr<blob_file_resolver> resolver_;
+};
+
+TEST_F(blob_file_syncer_test, sync_clears_pending_files) {
+    blob_file_syncer syncer{};
+    syncer.add(1, write_blob(1));
+    syncer.add(2, write_blob(2));
+    syncer.add(3, write_blob(3));
+    EXPECT_EQ(syncer.pending_count(), 3);
+
+    syncer.discard({2, 99});
+    EXPECT_EQ(syncer.pending_count(), 2);
+
+    syncer.sync();
+    EXPECT_EQ(syncer.pending_count(), 0);
+    EXPECT_NO_THROW(syncer.sync());
+}
+
+TEST_F(blob_file_syncer_test, removed_files_are_skipped) {
+    blob_file_syncer syncer{};
+    syncer.add(1, write_blob(1));
+    syncer.add(2, write_blob(2));
+    boost::filesystem::remove(resolver_->resolve_path(1));
+
+    EXPECT_NO_THROW(syncer.sync());
+    EXPECT_EQ(syncer.pending_count(), 0);
+}
+
+TEST_F(blob_file_syncer_test, sync_flushes_deferred_pack_appends) {
+    blob_pack_store::settings config{};
+    config.max_blob_bytes = 1024;
+    blob_pack_store store(*resolver_, config);
+    store.load();
+    store.append(1, "packed data", false);
+
+    blob_file_syncer syncer{&store};
+    EXPECT_NO_THROW(syncer.sync());
+    EXPECT_EQ(store.read(1), "packed data");
+}
+
+}  // namespace limestone::testing
@@ -1,5 +1,9 @@
 #include "blob_id_container.h" 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
 #include <vector>
 
 namespace limestone::testing {
@@ -363,9 +367,9 @@ TEST(blob_id_container_test, merge_with_overlap) {
     // Merge other into our container.
     container.merge(other);
     
-    // Expected result: raw merge gives {1, 3, 1, 2} then sorted to {1, 1, 2, 3}.
+    // Expected result: the union {1, 2, 3}, holding 1 once.
     std::vector<blob_id_type> result = get_blob_ids(container);
-    std::vector<blob_id_type> expected {1, 1, 2, 3};
+    std::vector<blob_id_type> expected {1, 2, 3};
     EXPECT_EQ(result, expected);
 }
 
@@ -418,6 +422,75 @@ TEST(blob_id_container_test, merge_with_both_empty) {
     EXPECT_EQ(container.begin(), container.end());
 }
 
+TEST(blob_id_container_test, add_duplicates_are_held_once) {
+    blob_id_container container;
+    container.add_blob_id(2);
+    container.add_blob_id(1);
+    container.add_blob_id(2);
+    EXPECT_EQ(container.size(), 2);
+    std::vector<blob_id_type> expected {1, 2};
+    EXPECT_EQ(get_blob_ids(container), expected);
+}
+
+TEST(blob_id_container_test, end_obtained_before_begin) {
+    blob_id_container container;
+    container.add_blob_id(5);
+    container.add_blob_id(3);
+    auto last = container.end();
+    std::vector<blob_id_type> result(container.begin(), last);
+    std::vector<blob_id_type> expected {3, 5};
+    EXPECT_EQ(result, expected);
+}
+
+TEST(blob_id_container_test, large_sets_match_reference) {
+    // Mixes sparse chunks, dense chunks turned into bitmaps, and IDs beyond 32 bits.
+    std::set<blob_id_type> reference_a{};
+    std::set<blob_id_type> reference_b{};
+    blob_id_container a;
+    blob_id_container b;
+    std::mt19937_64 random{42};
+    for (int i = 0; i < 300000; i++) {
+        blob_id_type id = (i % 3 == 0) ? random() : random() % 200000;
+        a.add_blob_id(id);
+        reference_a.insert(id);
+        if (i % 2 == 0) {
+            b.add_blob_id(id + 1);
+            reference_b.insert(id + 1);
+        }
+    }
+    for (blob_id_type id = 70000; id < 140000; id++) {
+        b.add_blob_id(id);
+        reference_b.insert(id);
+    }
+
+    blob_id_container merged;
+    merged.merge(a);
+    merged.merge(b);
+    std::set<blob_id_type> reference_merged = reference_a;
+    reference_merged.insert(reference_b.begin(), reference_b.end());
+    EXPECT_EQ(merged.size(), reference_merged.size());
+    EXPECT_EQ(get_blob_ids(merged), std::vector<blob_id_type>(reference_merged.begin(), reference_merged.end()));
+
+    a.diff(b);
+    std::vector<blob_id_type> reference_diff{};
+    std::set_difference(reference_a.begin(), reference_a.end(), reference_b.begin(), reference_b.end(), std::back_inserter(reference_diff));
+    EXPECT_EQ(a.size(), reference_diff.size());
+    EXPECT_EQ(get_blob_ids(a), reference_diff);
+}
+
+TEST(blob_id_container_test, diff_empties_dense_chunk) {
+    blob_id_container container;
+    blob_id_container other;
+    for (blob_id_type id = 0; id < 65536; id++) {
+        container.add_blob_id(id);
+        other.add_blob_id(id);
+    }
+    container.add_blob_id(65536);
+    container.diff(other);
+    std::vector<blob_id_type> expected {65536};
+    EXPECT_EQ(get_blob_ids(container), expected);
+}
+
 TEST(blob_id_container_test, modification_after_iterator_throws) {
     blob_id_container container;
     container.add_blob_id(1);
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_io_executor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <future>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+
+TEST(blob_io_executor_test, runs_all_submitted_tasks) {
+    std::atomic<int> count{0};
+    {
+        blob_io_executor executor{3};
+        for (int i = 0; i < 100; i++) {
+            executor.submit([&count]() { count++; });
+        }
+    }
+    // the destructor runs the remaining tasks before joining
+    EXPECT_EQ(count.load(), 100);
+}
+
+TEST(blob_io_executor_test, runs_tasks_concurrently) {
+    std::promise<void> first_started{};
+    std::promise<void> second_done{};
+    // declared last, so that the tasks are joined before the promises are destroyed
+    blob_io_executor executor{2};
+    executor.submit([&]() {
+        first_started.set_value();
+        second_done.get_future().wait();
+    });
+    first_started.get_future().wait();
+    // would never run if the first task held the only thread
+    executor.submit([&]() { second_done.set_value(); });
+}
+
+TEST(blob_io_executor_test, thread_count_from_environment) {
+    unsetenv("LIMESTONE_BLOB_IO_THREADS");
+    EXPECT_EQ(blob_io_executor::thread_count_from_environment(), blob_io_executor::default_thread_count);
+    setenv("LIMESTONE_BLOB_IO_THREADS", "8", 1);
+    EXPECT_EQ(blob_io_executor::thread_count_from_environment(), 8);
+    setenv("LIMESTONE_BLOB_IO_THREADS", "0", 1);
+    EXPECT_EQ(blob_io_executor::thread_count_from_environment(), blob_io_executor::default_thread_count);
+    setenv("LIMESTONE_BLOB_IO_THREADS", "abc", 1);
+    EXPECT_EQ(blob_io_executor::thread_count_from_environment(), blob_io_executor::default_thread_count);
+    unsetenv("LIMESTONE_BLOB_IO_THREADS");
+
+    blob_io_executor executor{0};
+    EXPECT_EQ(executor.thread_count(), 1);
+}
+
+}  // namespace limestone::testing
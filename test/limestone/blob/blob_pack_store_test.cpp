@@ -0,0 +1,240 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_pack_store.h"
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "blob_file_resolver.h"
+#include "limestone/api/limestone_exception.h"
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+
+constexpr const char* base_directory = "/tmp/blob_pack_store_test";
+
+class blob_pack_store_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(base_directory);
+        boost::filesystem::create_directories(base_directory);
+        resolver_ = std::make_unique<blob_file_resolver>(base_directory);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(base_directory);
+    }
+
+    std::unique_ptr<blob_pack_store> make_store(std::uint64_t segment_bytes = 64UL * 1024UL * 1024UL) {
+        blob_pack_store::settings config{};
+        config.max_blob_bytes = 1024;
+        config.segment_bytes = segment_bytes;
+        auto store = std::make_unique<blob_pack_store>(*resolver_, config);
+        store->load();
+        return store;
+    }
+
+    static std::string data_of(blob_id_type id, std::size_t size = 40) {
+        std::string data = "blob-" + std::to_string(id) + "-";
+        data.resize(size, static_cast<char>('a' + id % 26));
+        return data;
+    }
+
+    static std::string read_file(const boost::filesystem::path& path) {
+        std::ifstream in(path.string(), std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    std::size_t count_segments() const {
+        std::size_t count = 0;
+        for (const auto& entry : boost::filesystem::directory_iterator(resolver_->get_pack_directory())) {
+            if (resolver_->is_pack_file(entry.path())) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    std::unique_ptr<blob_file_resolver> resolver_;
+};
+
+TEST_F(blob_pack_store_test, accepts_only_small_blobs) {
+    auto store = make_store();
+    EXPECT_TRUE(store->accepts(0));
+    EXPECT_TRUE(store->accepts(1024));
+    EXPECT_FALSE(store->accepts(1025));
+
+    blob_pack_store disabled(*resolver_, blob_pack_store::settings{});
+    EXPECT_FALSE(disabled.accepts(1));
+}
+
+TEST_F(blob_pack_store_test, append_and_read) {
+    auto store = make_store();
+    for (blob_id_type id = 1; id <= 3; id++) {
+        store->append(id, data_of(id));
+    }
+    store->append(4, "");
+    EXPECT_EQ(count_segments(), 1);
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{1, 2, 3, 4}));
+    EXPECT_TRUE(store->contains(2));
+    EXPECT_FALSE(store->contains(5));
+    EXPECT_EQ(store->read(2), data_of(2));
+    EXPECT_EQ(store->read(4), "");
+    EXPECT_THROW(static_cast<void>(store->read(5)), limestone::api::limestone_blob_exception);
+
+    auto path = store->extract(3);
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(*path, store->cache_path(3));
+    EXPECT_EQ(read_file(*path), data_of(3));
+    EXPECT_FALSE(resolver_->is_blob_file(*path));  // not mistaken for a BLOB file by the scanner
+    EXPECT_FALSE(store->extract(5).has_value());
+}
+
+TEST_F(blob_pack_store_test, concurrent_extract) {
+    auto store = make_store();
+    for (blob_id_type id = 1; id <= 8; id++) {
+        store->append(id, data_of(id));
+    }
+    // each thread extracts every BLOB, so the same BLOB is extracted by several threads at once
+    std::vector<std::thread> threads{};
+    std::vector<int> failures(4, 0);
+    for (std::size_t t = 0; t < failures.size(); t++) {
+        threads.emplace_back([&store, &failures, t]() {
+            for (blob_id_type id = 1; id <= 8; id++) {
+                auto path = store->extract(id);
+                if (!path || read_file(*path) != data_of(id)) {
+                    failures[t]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures, std::vector<int>(4, 0));
+    for (blob_id_type id = 1; id <= 8; id++) {
+        EXPECT_FALSE(boost::filesystem::exists(store->cache_path(id).string() + ".tmp"));
+    }
+
+    // a removed BLOB is no longer extracted
+    store->remove(2);
+    EXPECT_FALSE(store->extract(2).has_value());
+    EXPECT_FALSE(boost::filesystem::exists(store->cache_path(2)));
+}
+
+TEST_F(blob_pack_store_test, load_rebuilds_index_and_truncates_torn_record) {
+    auto store = make_store();
+    store->append(1, data_of(1));
+    store->append(2, data_of(2));
+    store->extract(1);
+    store.reset();
+
+    // a record torn by a crash
+    boost::filesystem::path segment = resolver_->resolve_pack_path(1);
+    auto valid_size = boost::filesystem::file_size(segment);
+    {
+        std::ofstream out(segment.string(), std::ios::binary | std::ios::app);
+        out << "torn record";
+    }
+
+    store = make_store();
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{1, 2}));
+    EXPECT_EQ(store->read(1), data_of(1));
+    EXPECT_EQ(store->read(2), data_of(2));
+    EXPECT_EQ(boost::filesystem::file_size(segment), valid_size);
+    EXPECT_FALSE(boost::filesystem::exists(store->cache_path(1)));  // extracted copies are cleared
+
+    // appending continues in a new segment
+    store->append(3, data_of(3));
+    EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_pack_path(2)));
+    EXPECT_EQ(boost::filesystem::file_size(segment), valid_size);
+}
+
+TEST_F(blob_pack_store_test, dead_segments_are_removed) {
+    // four records of 56 bytes fill a segment
+    auto store = make_store(200);
+    for (blob_id_type id = 1; id <= 10; id++) {
+        store->append(id, data_of(id));
+    }
+    EXPECT_EQ(count_segments(), 3);
+
+    store->collect_garbage({1, 2, 3, 4, 99});
+    EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_pack_path(1)));
+    EXPECT_EQ(count_segments(), 2);
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{5, 6, 7, 8, 9, 10}));
+
+    // the current segment is kept even if empty of live BLOBs
+    store->collect_garbage({9, 10});
+    EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_pack_path(3)));
+
+    // a released provisional BLOB is dropped at once
+    store->remove(5);
+    store->remove(6);
+    store->remove(7);
+    EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_pack_path(2)));
+    store->remove(8);
+    EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_pack_path(2)));
+}
+
+TEST_F(blob_pack_store_test, sparse_segments_are_rewritten) {
+    auto store = make_store(200);
+    for (blob_id_type id = 1; id <= 6; id++) {
+        store->append(id, data_of(id));
+    }
+    store->extract(4);
+
+    // a quarter of the first segment is alive
+    store->collect_garbage({1, 2, 3});
+    EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_pack_path(1)));
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{4, 5, 6}));
+    EXPECT_EQ(store->read(4), data_of(4));
+    EXPECT_EQ(read_file(store->cache_path(4)), data_of(4));
+
+    store.reset();
+    store = make_store(200);
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{4, 5, 6}));
+    for (blob_id_type id = 4; id <= 6; id++) {
+        EXPECT_EQ(store->read(id), data_of(id));
+    }
+}
+
+TEST_F(blob_pack_store_test, newer_copy_wins_on_load) {
+    // a rewrite interrupted before removing the old segment leaves two copies of a BLOB
+    auto store = make_store(200);
+    for (blob_id_type id = 1; id <= 4; id++) {
+        store->append(id, data_of(id));
+    }
+    store->append(5, data_of(5));
+    store.reset();
+    boost::filesystem::copy_file(resolver_->resolve_pack_path(1), resolver_->resolve_pack_path(3));
+
+    store = make_store(200);
+    EXPECT_EQ(store->blob_ids(), (std::vector<blob_id_type>{1, 2, 3, 4, 5}));
+    // the segment 1 is left without live BLOBs, and removed
+    EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_pack_path(1)));
+    EXPECT_EQ(store->read(1), data_of(1));
+}
+
+}  // namespace limestone::testing
@@ -8,7 +8,10 @@
 #include <fstream>
 #include <algorithm>
 
+#include "blob_dedup_index.h"
 #include "blob_file_resolver.h"
+#include "blob_file_syncer.h"
+#include "blob_io_executor.h"
 #include "file_operations.h"
 #include "limestone/api/limestone_exception.h"
 
@@ -46,6 +49,23 @@ public:
     using blob_pool_impl::handle_hmac_result;
 };
 
+// Reports the in-kernel copy methods as unsupported, so that copy_file goes through its buffer
+class buffered_copy_file_operations : public real_file_operations {
+public:
+    int ficlone(int, int) override {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    ssize_t copy_file_range(int, off_t*, int, off_t*, size_t, unsigned int) override {
+        errno = EXDEV;
+        return -1;
+    }
+    ssize_t sendfile(int, int, off_t*, size_t) override {
+        errno = EINVAL;
+        return -1;
+    }
+};
+
 class blob_pool_impl_test : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -652,7 +672,7 @@ TEST_F(blob_pool_impl_test, copy_file_fsync_fails) {
 }
 
 TEST_F(blob_pool_impl_test, copy_file_read_fails) {
-    class : public real_file_operations {
+    class : public buffered_copy_file_operations {
     public:
         size_t fread_attempts = 0;  // Number of fread attempts
         size_t fail_on_fread_attempt = 1;  // Fail on the nth fread attempt
@@ -665,7 +685,7 @@ TEST_F(blob_pool_impl_test, copy_file_read_fails) {
                 errno = EIO;  // Simulate input/output error
                 return 0;
             }
-            return real_file_operations::fread(ptr, size, count, stream);
+            return buffered_copy_file_operations::fread(ptr, size, count, stream);
         }
 
         int ferror(FILE* stream) override {
@@ -695,7 +715,7 @@ TEST_F(blob_pool_impl_test, copy_file_read_fails) {
 
 
 TEST_F(blob_pool_impl_test, copy_file_write_fails) {
-    class : public real_file_operations {
+    class : public buffered_copy_file_operations {
     public:
         size_t fwrite_attempts = 0;  // Number of fwrite attempts
         size_t fail_on_fwrite_attempt = 1;  // Fail on the nth fwrite attempt
@@ -730,8 +750,96 @@ TEST_F(blob_pool_impl_test, copy_file_write_fails) {
     EXPECT_FALSE(boost::filesystem::exists(destination_path)) << "The destination file should not exist.";
 }
 
-TEST_F(blob_pool_impl_test, copy_file_fails_and_cleans_up_existing_destination) {
+TEST_F(blob_pool_impl_test, copy_file_copies_in_kernel) {
+    class : public real_file_operations {
+    public:
+        size_t fread_calls = 0;
+        int ficlone(int, int) override {
+            errno = EOPNOTSUPP;  // Simulate a filesystem without reflinks
+            return -1;
+        }
+        size_t fread(void* ptr, size_t size, size_t count, FILE* stream) override {
+            ++fread_calls;
+            return real_file_operations::fread(ptr, size, count, stream);
+        }
+    } mock_ops;
+
+    pool_->set_file_operations(mock_ops);
+
+    boost::filesystem::path source_path("/tmp/blob_pool_impl_test/source_blob");
+    boost::filesystem::path destination_path("/tmp/blob_pool_impl_test/blob/1");
+    std::string data(testable_blob_pool_impl::copy_buffer_size * 3 + 1, 'k');
+    std::ofstream(source_path.string()) << data;
+
+    EXPECT_NO_THROW(pool_->copy_file(source_path, destination_path));
+
+    std::ifstream in(destination_path.string());
+    std::string copied((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(copied, data);
+    EXPECT_EQ(mock_ops.fread_calls, 0) << "The data should not go through the user-space buffer.";
+}
+
+TEST_F(blob_pool_impl_test, copy_file_falls_back_to_sendfile) {
+    class : public real_file_operations {
+    public:
+        size_t sendfile_calls = 0;
+        int ficlone(int, int) override {
+            errno = EXDEV;
+            return -1;
+        }
+        ssize_t copy_file_range(int, off_t*, int, off_t*, size_t, unsigned int) override {
+            errno = EXDEV;  // Simulate a copy across filesystems on a kernel not supporting it
+            return -1;
+        }
+        ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) override {
+            ++sendfile_calls;
+            return real_file_operations::sendfile(out_fd, in_fd, offset, count);
+        }
+    } mock_ops;
+
+    pool_->set_file_operations(mock_ops);
+
+    boost::filesystem::path source_path("/tmp/blob_pool_impl_test/source_blob");
+    boost::filesystem::path destination_path("/tmp/blob_pool_impl_test/blob/1");
+    std::ofstream(source_path.string()) << "test data";
+
+    EXPECT_NO_THROW(pool_->copy_file(source_path, destination_path));
+
+    std::ifstream in(destination_path.string());
+    std::string copied((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(copied, "test data");
+    EXPECT_GE(mock_ops.sendfile_calls, 1);
+}
+
+TEST_F(blob_pool_impl_test, copy_file_in_kernel_fails) {
     class : public real_file_operations {
+    public:
+        int ficlone(int, int) override {
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+        ssize_t copy_file_range(int, off_t*, int, off_t*, size_t, unsigned int) override {
+            errno = EIO;  // Simulate input/output error
+            return -1;
+        }
+    } mock_ops;
+
+    pool_->set_file_operations(mock_ops);
+
+    boost::filesystem::path source_path("/tmp/blob_pool_impl_test/source_blob");
+    boost::filesystem::path destination_path("/tmp/blob_pool_impl_test/blob/1");
+    std::ofstream(source_path.string()) << "test data";
+
+    EXPECT_THROW_WITH_PARTIAL_MESSAGE(
+        pool_->copy_file(source_path, destination_path),
+        limestone_blob_exception,
+        "Failed to write data to destination file"
+    );
+    EXPECT_FALSE(boost::filesystem::exists(destination_path)) << "The destination file should not exist.";
+}
+
+TEST_F(blob_pool_impl_test, copy_file_fails_and_cleans_up_existing_destination) {
+    class : public buffered_copy_file_operations {
     public:
         size_t fwrite_calls = 0;
         size_t fail_after_calls = 1;  // Fail on the second fwrite
@@ -771,7 +879,7 @@ TEST_F(blob_pool_impl_test, copy_file_fails_and_cleans_up_existing_destination)
 }
 
 TEST_F(blob_pool_impl_test, copy_file_logs_when_cleanup_fails) {
-    class : public real_file_operations {
+    class : public buffered_copy_file_operations {
     public:
         size_t fwrite_calls = 0;
         size_t fail_after_calls = 1;  // Simulate failure on the second fwrite
@@ -1198,6 +1306,91 @@ TEST_F(blob_pool_impl_test, register_data_fails_to_sync_data) {
 }
 
 
+TEST_F(blob_pool_impl_test, register_with_syncer_defers_fsync) {
+    class : public real_file_operations {
+    public:
+        int fsync(int fd) override {
+            ++fsync_calls;
+            return real_file_operations::fsync(fd);
+        }
+        int fsync_calls = 0;
+    } counting_ops;
+
+    blob_file_syncer syncer{};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, &syncer);
+    pool->set_file_operations(counting_ops);
+
+    boost::filesystem::path source_file = std::string(base_directory) + "/source_file";
+    std::ofstream(source_file.string()) << "source data";
+
+    blob_id_type data_id = pool->register_data("test data");
+    blob_id_type file_id = pool->register_file(source_file, false);
+    blob_id_type duplicated_id = pool->duplicate_data(data_id);
+    EXPECT_EQ(counting_ops.fsync_calls, 0);
+    EXPECT_EQ(syncer.pending_count(), 3);
+
+    // the BLOBs are readable before being synchronized
+    std::ifstream in(resolver_->resolve_path(file_id).string());
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, "source data");
+
+    // the BLOBs of a released pool are no longer synchronized
+    pool->release();
+    EXPECT_EQ(syncer.pending_count(), 0);
+    EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_path(duplicated_id)));
+}
+
+
+TEST_F(blob_pool_impl_test, register_async) {
+    blob_io_executor executor{4};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, nullptr, &executor);
+
+    boost::filesystem::path source_file = std::string(base_directory) + "/source_file";
+    std::ofstream(source_file.string()) << "source data";
+
+    std::vector<std::future<blob_id_type>> futures{};
+    for (int i = 0; i < 8; i++) {
+        futures.emplace_back(pool->register_data_async("data " + std::to_string(i)));
+    }
+    auto file_future = pool->register_file_async(source_file, false);
+    auto missing_future = pool->register_file_async(std::string(base_directory) + "/missing_file", false);
+
+    std::vector<blob_id_type> ids{};
+    for (auto& future : futures) {
+        ids.emplace_back(future.get());
+    }
+    for (int i = 0; i < 8; i++) {
+        std::ifstream in(resolver_->resolve_path(ids[i]).string());
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(content, "data " + std::to_string(i));
+    }
+    EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_path(file_future.get())));
+    EXPECT_THROW(missing_future.get(), limestone_blob_exception);
+    EXPECT_EQ(pool->get_blob_ids().size(), 9);
+
+    // release waits for the registrations in progress, and removes their BLOBs as well
+    auto pending_future = pool->register_data_async("pending data");
+    pool->release();
+    try {
+        blob_id_type id = pending_future.get();
+        EXPECT_FALSE(boost::filesystem::exists(resolver_->resolve_path(id)));
+    } catch (const std::logic_error&) {
+        // not started before the release
+    }
+    EXPECT_TRUE(pool->get_blob_ids().empty());
+    EXPECT_THROW(pool->register_data_async("released").get(), std::logic_error);
+}
+
+TEST_F(blob_pool_impl_test, register_async_without_executor) {
+    auto future = pool_->register_data_async("test data");
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_TRUE(boost::filesystem::exists(resolver_->resolve_path(future.get())));
+
+    pool_->release();
+    EXPECT_THROW(pool_->register_file_async("/tmp/blob_pool_impl_test/nonexistent_file", false).get(), std::logic_error);
+}
+
+
 TEST_F(blob_pool_impl_test, register_data_fsync_fails_remove_fails_file_not_found) {
     class fail_on_fsync_and_remove_file_not_found_ops : public real_file_operations {
     public:
@@ -1273,6 +1466,117 @@ TEST_F(blob_pool_impl_test, duplicate_data_success) {
 }
 
 
+TEST_F(blob_pool_impl_test, register_with_dedup_index_links_same_contents) {
+    blob_dedup_index dedup_index{16};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, nullptr, nullptr,
+                                                          &dedup_index);
+    auto inode_of = [this](blob_id_type id) {
+        struct stat st{};
+        EXPECT_EQ(stat(resolver_->resolve_path(id).c_str(), &st), 0);
+        return st.st_ino;
+    };
+
+    blob_id_type data_id = pool->register_data("test data");
+    blob_id_type same_data_id = pool->register_data("test data");
+    blob_id_type other_data_id = pool->register_data("other data");
+    EXPECT_EQ(inode_of(same_data_id), inode_of(data_id));
+    EXPECT_NE(inode_of(other_data_id), inode_of(data_id));
+
+    // a copied source file is linked, while a temporary one is moved without being read
+    boost::filesystem::path source_file = std::string(base_directory) + "/source_file";
+    std::ofstream(source_file.string()) << "test data";
+    blob_id_type file_id = pool->register_file(source_file, false);
+    blob_id_type temporary_file_id = pool->register_file(source_file, true);
+    EXPECT_EQ(inode_of(file_id), inode_of(data_id));
+    EXPECT_NE(inode_of(temporary_file_id), inode_of(data_id));
+    EXPECT_FALSE(boost::filesystem::exists(source_file));
+    EXPECT_EQ(pool->get_blob_ids().size(), 5);
+
+    // the links keep the contents after the indexed BLOB is removed, and the next one is written again
+    auto linked_inode = inode_of(same_data_id);
+    boost::filesystem::remove(resolver_->resolve_path(data_id));
+    EXPECT_EQ(inode_of(same_data_id), linked_inode);
+    blob_id_type written_id = pool->register_data("test data");
+    EXPECT_NE(inode_of(written_id), linked_inode);
+    EXPECT_EQ(inode_of(pool->register_data("test data")), inode_of(written_id));
+}
+
+TEST_F(blob_pool_impl_test, register_with_dedup_index_checks_sizes) {
+    blob_dedup_index dedup_index{16, 4};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, nullptr, nullptr,
+                                                          &dedup_index);
+    auto inode_of = [this](blob_id_type id) {
+        struct stat st{};
+        EXPECT_EQ(stat(resolver_->resolve_path(id).c_str(), &st), 0);
+        return st.st_ino;
+    };
+
+    // a file larger than the bound is copied without being read for its digest
+    blob_id_type data_id = pool->register_data("test data");
+    boost::filesystem::path source_file = std::string(base_directory) + "/source_file";
+    std::ofstream(source_file.string()) << "test data";
+    EXPECT_NE(inode_of(pool->register_file(source_file, false)), inode_of(data_id));
+
+    // an indexed BLOB whose file has been replaced by one of another size is not linked
+    boost::filesystem::remove(resolver_->resolve_path(data_id));
+    std::ofstream(resolver_->resolve_path(data_id).string()) << "replaced";
+    blob_id_type written_id = pool->register_data("test data");
+    EXPECT_NE(inode_of(written_id), inode_of(data_id));
+    EXPECT_EQ(dedup_index.find(blob_dedup_index::digest_of("test data")), std::optional<blob_id_type>{written_id});
+}
+
+TEST_F(blob_pool_impl_test, register_with_dedup_index_writes_if_link_fails) {
+    class fail_on_create_hard_link_ops : public real_file_operations {
+    public:
+        void create_hard_link(const boost::filesystem::path&, const boost::filesystem::path&, boost::system::error_code& ec) override {
+            ec = boost::system::errc::make_error_code(boost::system::errc::too_many_links);
+        }
+    } custom_ops;
+
+    blob_dedup_index dedup_index{16};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, nullptr, nullptr,
+                                                          &dedup_index);
+    pool->set_file_operations(custom_ops);
+
+    (void) pool->register_data("test data");
+    blob_id_type same_data_id = pool->register_data("test data");
+    std::ifstream in(resolver_->resolve_path(same_data_id).string());
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, "test data");
+
+    // the BLOB written instead is linked next
+    EXPECT_EQ(dedup_index.find(blob_dedup_index::digest_of("test data")), std::optional<blob_id_type>{same_data_id});
+}
+
+TEST_F(blob_pool_impl_test, register_with_dedup_index_indexes_copied_contents) {
+    boost::filesystem::path source_file = std::string(base_directory) + "/source_file";
+    std::ofstream(source_file.string()) << "test data";
+
+    // the source file is modified after it is read for its digest, before it is copied
+    class modify_on_second_open_ops : public real_file_operations {
+    public:
+        explicit modify_on_second_open_ops(std::string source) : source_(std::move(source)) {}
+        FILE* fopen(const char* filename, const char* mode) override {
+            if (source_ == filename && ++opened_ == 2) {
+                std::ofstream(source_) << "new data!";
+            }
+            return real_file_operations::fopen(filename, mode);
+        }
+    private:
+        std::string source_;
+        int opened_ = 0;
+    } custom_ops{source_file.string()};
+
+    blob_dedup_index dedup_index{16};
+    auto pool = std::make_unique<testable_blob_pool_impl>(id_generator_, *resolver_, *datastore_, nullptr, nullptr, nullptr,
+                                                          &dedup_index);
+    pool->set_file_operations(custom_ops);
+
+    blob_id_type file_id = pool->register_file(source_file, false);
+    EXPECT_FALSE(dedup_index.find(blob_dedup_index::digest_of("test data")).has_value());
+    EXPECT_EQ(dedup_index.find(blob_dedup_index::digest_of("new data!")), std::optional<blob_id_type>{file_id});
+}
+
 TEST_F(blob_pool_impl_test, duplicate_data__fails_if_pool_released) {
     pool_->release();
 
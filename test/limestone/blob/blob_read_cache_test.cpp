@@ -0,0 +1,146 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_read_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+
+#include <limestone/api/limestone_exception.h>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+using limestone::api::limestone_io_exception;
+
+constexpr const char* base_directory = "/tmp/blob_read_cache_test";
+
+class blob_read_cache_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(base_directory);
+        boost::filesystem::create_directories(base_directory);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(base_directory);
+    }
+
+    static boost::filesystem::path write_file(blob_id_type id, const std::string& data) {
+        auto path = boost::filesystem::path(base_directory) / (std::to_string(id) + ".blob");
+        // written to another file and renamed, as a BLOB file is never modified in place
+        auto tmp_path = boost::filesystem::path(base_directory) / "tmp";
+        {
+            std::ofstream out(tmp_path.string(), std::ios::binary);
+            out << data;
+        }
+        boost::filesystem::rename(tmp_path, path);
+        return path;
+    }
+};
+
+TEST_F(blob_read_cache_test, read_keeps_files_mapped) {
+    blob_read_cache cache{2};
+    auto path1 = write_file(1, "data1");
+    auto path2 = write_file(2, "data2");
+    auto path3 = write_file(3, "data3");
+
+    auto view1 = cache.read(1, path1);
+    ASSERT_TRUE(static_cast<bool>(view1));
+    EXPECT_EQ(view1.data(), "data1");
+    EXPECT_EQ(cache.read(1, path1).data().data(), view1.data().data());
+    EXPECT_EQ(cache.read(2, path2).data(), "data2");
+    EXPECT_EQ(cache.size(), 2);
+
+    // 1 was read before 2, so it is evicted, but its view stays valid
+    EXPECT_EQ(cache.read(3, path3).data(), "data3");
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(view1.data(), "data1");
+    EXPECT_NE(cache.read(1, path1).data().data(), view1.data().data());
+}
+
+TEST_F(blob_read_cache_test, replaced_file_is_mapped_again) {
+    blob_read_cache cache{8};
+    auto path = write_file(1, "old data");
+    auto old_view = cache.read(1, path);
+
+    write_file(1, "new data!");
+    EXPECT_EQ(cache.read(1, path).data(), "new data!");
+    EXPECT_EQ(old_view.data(), "old data");
+
+    boost::filesystem::remove(path);
+    EXPECT_THROW(cache.read(1, path), limestone_io_exception);
+    EXPECT_EQ(old_view.data(), "old data");
+}
+
+TEST_F(blob_read_cache_test, evict_and_clear) {
+    blob_read_cache cache{8};
+    for (blob_id_type id = 1; id <= 4; id++) {
+        cache.read(id, write_file(id, "data" + std::to_string(id)));
+    }
+    EXPECT_EQ(cache.size(), 4);
+    cache.evict({2, 3, 5});
+    EXPECT_EQ(cache.size(), 2);
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(blob_read_cache_test, zero_capacity) {
+    blob_read_cache cache{0};
+    auto path = write_file(1, "data");
+    EXPECT_EQ(cache.read(1, path).data(), "data");
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(blob_read_cache_test, empty_file) {
+    blob_read_cache cache{8};
+    auto view = cache.read(1, write_file(1, ""));
+    EXPECT_TRUE(static_cast<bool>(view));
+    EXPECT_TRUE(view.data().empty());
+}
+
+TEST_F(blob_read_cache_test, symbolic_link) {
+    blob_read_cache cache{8};
+    auto target = write_file(1, "data");
+    auto link = boost::filesystem::path(base_directory) / "link.blob";
+    boost::filesystem::create_symlink(target, link);
+    EXPECT_EQ(cache.read(2, link).data(), "data");
+}
+
+TEST_F(blob_read_cache_test, unsupported_path_type) {
+    blob_read_cache cache{8};
+    auto dir = boost::filesystem::path(base_directory) / "dir.blob";
+    boost::filesystem::create_directories(dir);
+    EXPECT_THROW(cache.read(1, dir), limestone_io_exception);
+    EXPECT_THROW(cache.read(2, boost::filesystem::path(base_directory) / "missing.blob"), limestone_io_exception);
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(blob_read_cache_test, capacity_from_environment) {
+    unsetenv("LIMESTONE_BLOB_READ_CACHE_ENTRIES");
+    EXPECT_EQ(blob_read_cache::capacity_from_environment(), blob_read_cache::default_capacity);
+    setenv("LIMESTONE_BLOB_READ_CACHE_ENTRIES", "0", 1);
+    EXPECT_EQ(blob_read_cache::capacity_from_environment(), 0);
+    setenv("LIMESTONE_BLOB_READ_CACHE_ENTRIES", "-1", 1);
+    EXPECT_EQ(blob_read_cache::capacity_from_environment(), blob_read_cache::default_capacity);
+    unsetenv("LIMESTONE_BLOB_READ_CACHE_ENTRIES");
+}
+
+}  // namespace limestone::testing
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_reference_sorter.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <limestone/api/limestone_exception.h>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::limestone_io_exception;
+using limestone::api::write_version_type;
+
+constexpr const char* base_directory = "/tmp/blob_reference_sorter_test";
+
+class blob_reference_sorter_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(base_directory);
+        boost::filesystem::create_directories(base_directory);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(base_directory);
+    }
+
+    static blob_reference_sorter::record make_record(const std::string& key, std::uint64_t minor, const std::string& blob_ids) {
+        return blob_reference_sorter::record{key, write_version_type(1, minor), blob_ids};
+    }
+
+    static blob_reference_sorter::run_type make_run(std::vector<blob_reference_sorter::record> records) {
+        blob_reference_sorter::sort_run(records);
+        return records;
+    }
+
+    // returns "key:minor:blob_ids" of each record merged
+    static std::vector<std::string> merge(blob_reference_sorter& sorter) {
+        std::vector<std::string> result;
+        sorter.merge([&result](const blob_reference_sorter::record& r) {
+            result.emplace_back(r.key_sid + ":" + std::to_string(r.version.get_minor()) + ":" + r.blob_ids);
+        });
+        return result;
+    }
+};
+
+TEST_F(blob_reference_sorter_test, sort_run_keeps_newest) {
+    auto run = make_run({make_record("b", 1, "b1"), make_record("a", 1, "a1"), make_record("b", 3, "b3"), make_record("a", 2, "a2")});
+    ASSERT_EQ(run.size(), 2);
+    EXPECT_EQ(run[0].key_sid, "a");
+    EXPECT_EQ(run[0].blob_ids, "a2");
+    EXPECT_EQ(run[1].key_sid, "b");
+    EXPECT_EQ(run[1].blob_ids, "b3");
+}
+
+TEST_F(blob_reference_sorter_test, merge_in_memory) {
+    blob_reference_sorter sorter{"", 1};
+    sorter.add_run(make_run({make_record("a", 1, "a1"), make_record("c", 2, "c2")}));
+    sorter.add_run(make_run({make_record("a", 3, "a3"), make_record("b", 1, "b1")}));
+    sorter.add_run({});
+    EXPECT_EQ(sorter.spilled_runs(), 0);
+    EXPECT_EQ(merge(sorter), (std::vector<std::string>{"a:3:a3", "b:1:b1", "c:2:c2"}));
+
+    // the runs are discarded once merged
+    EXPECT_TRUE(merge(sorter).empty());
+}
+
+TEST_F(blob_reference_sorter_test, merge_spilled_runs) {
+    blob_reference_sorter sorter{base_directory, 1};
+    sorter.add_run(make_run({make_record("a", 1, std::string("\0\1", 2)), make_record("c", 2, "c2")}));
+    sorter.add_run(make_run({make_record("a", 3, ""), make_record("b", 1, "b1")}));
+    sorter.add_run(make_run({make_record("c", 1, "c1"), make_record("d", 5, "d5")}));
+    EXPECT_EQ(sorter.spilled_runs(), 3);
+    EXPECT_FALSE(boost::filesystem::is_empty(base_directory));
+
+    EXPECT_EQ(merge(sorter), (std::vector<std::string>{"a:3:", "b:1:b1", "c:2:c2", "d:5:d5"}));
+    EXPECT_EQ(sorter.spilled_runs(), 0);
+    EXPECT_TRUE(boost::filesystem::is_empty(base_directory));
+}
+
+TEST_F(blob_reference_sorter_test, runs_within_memory_limit_are_not_spilled) {
+    auto run = make_run({make_record("a", 1, "a1")});
+    blob_reference_sorter sorter{base_directory, run[0].footprint()};
+    sorter.add_run(std::move(run));
+    sorter.add_run(make_run({make_record("b", 1, "b1")}));
+    EXPECT_EQ(sorter.spilled_runs(), 1);
+    EXPECT_EQ(merge(sorter), (std::vector<std::string>{"a:1:a1", "b:1:b1"}));
+}
+
+TEST_F(blob_reference_sorter_test, clear_removes_run_files) {
+    {
+        blob_reference_sorter sorter{base_directory, 1};
+        sorter.add_run(make_run({make_record("a", 1, "a1")}));
+        sorter.clear();
+        EXPECT_TRUE(boost::filesystem::is_empty(base_directory));
+        EXPECT_TRUE(merge(sorter).empty());
+
+        // left to the destructor
+        sorter.add_run(make_run({make_record("a", 1, "a1")}));
+        EXPECT_FALSE(boost::filesystem::is_empty(base_directory));
+    }
+    EXPECT_TRUE(boost::filesystem::is_empty(base_directory));
+}
+
+TEST_F(blob_reference_sorter_test, missing_spill_directory) {
+    blob_reference_sorter sorter{boost::filesystem::path(base_directory) / "missing", 1};
+    EXPECT_THROW(sorter.add_run(make_run({make_record("a", 1, "a1")})), limestone_io_exception);
+}
+
+TEST_F(blob_reference_sorter_test, drain_spilled_blob_ids) {
+    blob_reference_sorter sorter{base_directory, 1};
+    sorter.add_blob_ids({1, 2, 3});
+    sorter.add_blob_ids({});
+    sorter.add_blob_ids({10, 20});
+    sorter.add_run(make_run({make_record("a", 1, "a1")}));
+    EXPECT_EQ(sorter.spilled_runs(), 3);
+
+    // the runs of references are merged apart from the BLOB IDs
+    EXPECT_EQ(merge(sorter), (std::vector<std::string>{"a:1:a1"}));
+    std::vector<blob_id_type> blob_ids;
+    sorter.drain_blob_ids([&blob_ids](blob_id_type id) { blob_ids.push_back(id); });
+    std::sort(blob_ids.begin(), blob_ids.end());
+    EXPECT_EQ(blob_ids, (std::vector<blob_id_type>{1, 2, 3, 10, 20}));
+    EXPECT_EQ(sorter.spilled_runs(), 0);
+    EXPECT_TRUE(boost::filesystem::is_empty(base_directory));
+}
+
+TEST_F(blob_reference_sorter_test, blob_ids_within_memory_limit_are_not_spilled) {
+    blob_reference_sorter sorter{base_directory, 2 * sizeof(blob_id_type)};
+    sorter.add_blob_ids({1, 2});
+    EXPECT_EQ(sorter.spilled_runs(), 0);
+    sorter.add_blob_ids({3});
+    EXPECT_EQ(sorter.spilled_runs(), 1);
+    std::vector<blob_id_type> blob_ids;
+    sorter.drain_blob_ids([&blob_ids](blob_id_type id) { blob_ids.push_back(id); });
+    std::sort(blob_ids.begin(), blob_ids.end());
+    EXPECT_EQ(blob_ids, (std::vector<blob_id_type>{1, 2, 3}));
+}
+
+TEST_F(blob_reference_sorter_test, broken_run_file_is_detected) {
+    blob_reference_sorter sorter{base_directory, 1};
+    sorter.add_run(make_run({make_record("a", 1, "a1"), make_record("b", 1, "b1")}));
+    ASSERT_EQ(sorter.spilled_runs(), 1);
+    boost::filesystem::path path = boost::filesystem::directory_iterator(base_directory)->path();
+
+    // flip the last byte of the body
+    std::fstream file(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-1, std::ios::end);
+    char c = static_cast<char>(file.get());
+    file.seekp(-1, std::ios::end);
+    file.put(static_cast<char>(c ^ 1));
+    file.close();
+    EXPECT_THROW(merge(sorter), limestone_io_exception);
+}
+
+TEST_F(blob_reference_sorter_test, broken_run_file_header_is_detected) {
+    blob_reference_sorter sorter{base_directory, 1};
+    sorter.add_blob_ids({1, 2, 3});
+    ASSERT_EQ(sorter.spilled_runs(), 1);
+    boost::filesystem::path path = boost::filesystem::directory_iterator(base_directory)->path();
+
+    // flip a byte of the magic
+    std::fstream file(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+    char c = static_cast<char>(file.get());
+    file.seekp(0);
+    file.put(static_cast<char>(c ^ 1));
+    file.close();
+    EXPECT_THROW(sorter.drain_blob_ids([](blob_id_type) {}), limestone_io_exception);
+}
+
+TEST_F(blob_reference_sorter_test, memory_limit_from_environment) {
+    unsetenv("LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY");
+    EXPECT_EQ(blob_reference_sorter::memory_limit_from_environment(), blob_reference_sorter::default_memory_limit);
+    setenv("LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY", "1048576", 1);
+    EXPECT_EQ(blob_reference_sorter::memory_limit_from_environment(), 1048576);
+    setenv("LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY", "large", 1);
+    EXPECT_EQ(blob_reference_sorter::memory_limit_from_environment(), blob_reference_sorter::default_memory_limit);
+    unsetenv("LIMESTONE_BLOB_GC_SNAPSHOT_MEMORY");
+}
+
+}  // namespace limestone::testing
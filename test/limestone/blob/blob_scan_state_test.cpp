@@ -0,0 +1,98 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blob_scan_state.h"
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+
+constexpr const char* base_directory = "/tmp/blob_scan_state_test";
+
+class blob_scan_state_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(base_directory);
+        boost::filesystem::create_directories(base_directory);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(base_directory);
+    }
+
+    boost::filesystem::path path_ = boost::filesystem::path(base_directory) / "gc_scan_state";
+};
+
+TEST_F(blob_scan_state_test, save_and_load) {
+    blob_scan_state{1000, {1, 5, 999, 1000}, 3}.save(path_);
+    EXPECT_FALSE(boost::filesystem::exists(path_.string() + ".tmp"));
+
+    auto state = blob_scan_state::load(path_);
+    ASSERT_TRUE(state.has_value());
+    EXPECT_EQ(state->max_scanned_blob_id(), 1000);
+    EXPECT_EQ(state->blob_ids(), (std::vector<blob_id_type>{1, 5, 999, 1000}));
+    EXPECT_EQ(state->incremental_scans(), 3);
+
+    // overwritten by the next save
+    blob_scan_state{2000, {}, 0}.save(path_);
+    state = blob_scan_state::load(path_);
+    ASSERT_TRUE(state.has_value());
+    EXPECT_EQ(state->max_scanned_blob_id(), 2000);
+    EXPECT_TRUE(state->blob_ids().empty());
+}
+
+TEST_F(blob_scan_state_test, missing_file) {
+    EXPECT_FALSE(blob_scan_state::load(path_).has_value());
+}
+
+TEST_F(blob_scan_state_test, broken_file) {
+    blob_scan_state{1000, {1, 5, 999}, 0}.save(path_);
+    std::string content{};
+    {
+        std::ifstream in(path_.string(), std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto write = [this](const std::string& data) {
+        std::ofstream out(path_.string(), std::ios::binary | std::ios::trunc);
+        out << data;
+    };
+
+    // a flipped bit in an ID
+    std::string corrupted = content;
+    corrupted[30] ^= 0x01;
+    write(corrupted);
+    EXPECT_FALSE(blob_scan_state::load(path_).has_value());
+
+    // truncated
+    write(content.substr(0, content.size() - 1));
+    EXPECT_FALSE(blob_scan_state::load(path_).has_value());
+
+    // unknown format
+    write("LSBSCAN0" + content.substr(8));
+    EXPECT_FALSE(blob_scan_state::load(path_).has_value());
+
+    write(content);
+    EXPECT_TRUE(blob_scan_state::load(path_).has_value());
+}
+
+}  // namespace limestone::testing
@@ -15,6 +15,9 @@
  */
 
  #include "limestone/compaction/compaction_test_fixture.h"
+ #include "blob_reference_index.h"
+ #include "datastore_impl.h"
+ #include <map>
 
 namespace limestone::testing {
 
@@ -345,6 +348,58 @@ TEST_F(compaction_test, blob_gc_executes_after_new_backup_test) {
     EXPECT_TRUE(boost::filesystem::exists(path2002_));
 }
 
+// Test that blob GC keeps the BLOBs of a generation left unmerged, read from its BLOB index or from the generation itself.
+TEST_F(compaction_test, blob_gc_keeps_blobs_of_unmerged_generation_test) {
+    gen_datastore();
+    datastore_->get_impl()->set_compaction_policy(compaction_policy(4, 8, 0));
+    datastore_->switch_epoch(1);
+
+    std::map<int, boost::filesystem::path> blob_paths;
+    lc0_->begin_session();
+    for (int i = 10; i < 50; i++) {
+        lc0_->add_entry(1, "k" + std::to_string(i), "v" + std::to_string(i), {1, 0}, {static_cast<blob_id_type>(1000 + i)});
+        blob_paths[1000 + i] = create_dummy_blob_files(1000 + i);
+    }
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+    auto blob_index = blob_reference_index::index_file_path(boost::filesystem::path(location) / compacted_filename);
+    EXPECT_TRUE(boost::filesystem::exists(blob_index));
 
+    // the delta becomes a new generation, and the oldest generation is found in its BLOB index
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k10", "x10", {2, 0}, {2010});
+    lc0_->end_session();
+    blob_paths[2010] = create_dummy_blob_files(2010);
+    datastore_->set_next_blob_id(2011);
+    datastore_->switch_epoch(3);
+    datastore_->switch_available_boundary_version({3, 0});
+    run_compact_with_epoch_switch(4);
+    ASSERT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(1)));
+    EXPECT_TRUE(boost::filesystem::exists(blob_index));
+    EXPECT_FALSE(boost::filesystem::exists(blob_paths[1010]));
+    for (int i = 11; i < 50; i++) {
+        EXPECT_TRUE(boost::filesystem::exists(blob_paths[1000 + i])) << i;
+    }
+    EXPECT_TRUE(boost::filesystem::exists(blob_paths[2010]));
+
+    // without the BLOB index, the oldest generation is read instead
+    boost::filesystem::remove(blob_index);
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k11", "x11", {4, 0}, {2011});
+    lc0_->end_session();
+    blob_paths[2011] = create_dummy_blob_files(2011);
+    datastore_->set_next_blob_id(2012);
+    datastore_->switch_epoch(5);
+    datastore_->switch_available_boundary_version({5, 0});
+    run_compact_with_epoch_switch(6);
+    ASSERT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(2)));
+    EXPECT_FALSE(boost::filesystem::exists(blob_reference_index::index_file_path(boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(1))));
+    EXPECT_FALSE(boost::filesystem::exists(blob_paths[1011]));
+    for (int i = 12; i < 50; i++) {
+        EXPECT_TRUE(boost::filesystem::exists(blob_paths[1000 + i])) << i;
+    }
+    EXPECT_TRUE(boost::filesystem::exists(blob_paths[2010]));
+    EXPECT_TRUE(boost::filesystem::exists(blob_paths[2011]));
+}
 
 }  // namespace limestone::testing
@@ -6,8 +6,11 @@
 #include <algorithm>
 #include <string>
 #include <memory>
+#include <functional>
 #include <boost/filesystem.hpp>
 #include "test_root.h"
+#include "blob_file_resolver.h"
+#include "manifest.h"
 
 namespace limestone::testing {
 
@@ -47,9 +50,12 @@ protected:
         boost::filesystem::remove_all(location_);
     }
 
-    void gen_datastore() {
+    void gen_datastore(const std::function<void(limestone::api::configuration&)>& configure = {}) {
         limestone::api::configuration conf{};
         conf.set_data_location(data_location);
+        if (configure) {
+            configure(conf);
+        }
 
         datastore_ = std::make_unique<limestone::api::datastore_test>(conf);
 
@@ -131,6 +137,29 @@ TEST_F(datastore_blob_test, get_blob_file_basic) {
         << "File should be available for next_blob_id if it exists";
 }
 
+TEST_F(datastore_blob_test, read_blob_basic) {
+    auto pool = datastore_->acquire_blob_pool();
+    auto id = pool->register_data("test data");
+    auto released_id = pool->register_data("released data");
+
+    auto view = datastore_->read_blob(id);
+    ASSERT_TRUE(static_cast<bool>(view));
+    EXPECT_EQ(view.data(), "test data");
+    // read again from the same mapping
+    EXPECT_EQ(datastore_->read_blob(id).data().data(), view.data().data());
+
+    ASSERT_TRUE(static_cast<bool>(datastore_->read_blob(released_id)));
+    lc0_->begin_session();
+    lc0_->add_entry(1, "key1", "value1", {1, 1}, {id});
+    lc0_->end_session();
+    pool->release();
+    EXPECT_FALSE(static_cast<bool>(datastore_->read_blob(released_id)));
+    EXPECT_EQ(datastore_->read_blob(id).data(), "test data");
+
+    // not registered yet
+    EXPECT_FALSE(static_cast<bool>(datastore_->read_blob(released_id + 1)));
+}
+
 // Environment-dependent part (disabled in CI environment)
 // This test simulates a permission error so that boost::filesystem::exists() fails,
 // causing the catch block to mark the file as unavailable.
@@ -330,6 +359,82 @@ TEST_F(datastore_blob_test, scenario01) {
     EXPECT_TRUE(datastore_->get_persistent_blob_ids().empty());
 }
 
+TEST_F(datastore_blob_test, small_blobs_are_packed) {
+    datastore_->shutdown();
+    // the configuration takes precedence over the environment variable
+    setenv("LIMESTONE_BLOB_PACK_MAX_BYTES", "0", 1);
+    gen_datastore([](limestone::api::configuration& conf) { conf.set_blob_pack_max_bytes(64); });
+    unsetenv("LIMESTONE_BLOB_PACK_MAX_BYTES");
+    auto read_file = [](const boost::filesystem::path& path) {
+        boost::filesystem::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    limestone::internal::blob_file_resolver resolver{data_location};
+
+    auto pool = datastore_->acquire_blob_pool();
+    std::string small_data = "small data";
+    std::string large_data(100, 'x');
+    auto small_id = pool->register_data(small_data);
+    auto large_id = pool->register_data(large_data);
+    auto released_id = pool->register_data("released data");
+    auto unreferenced_id = pool->register_data("unreferenced data");
+    auto duplicated_id = pool->duplicate_data(small_id);
+
+    EXPECT_FALSE(boost::filesystem::exists(resolver.resolve_path(small_id)));
+    EXPECT_TRUE(boost::filesystem::exists(resolver.resolve_path(large_id)));
+    auto small_file = datastore_->get_blob_file(small_id);
+    ASSERT_TRUE(static_cast<bool>(small_file));
+    EXPECT_EQ(read_file(small_file.path()), small_data);
+    EXPECT_EQ(read_file(datastore_->get_blob_file(duplicated_id).path()), small_data);
+    EXPECT_EQ(datastore_->get_blob_file(large_id).path(), resolver.resolve_path(large_id));
+
+    lc0_->begin_session();
+    lc0_->add_entry(1, "key1", "value1", {1, 1}, {small_id, large_id, duplicated_id});
+    lc0_->add_entry(1, "key2", "value2", {1, 1}, {unreferenced_id});
+    lc0_->remove_entry(1, "key2", {1, 2});
+    lc0_->end_session();
+    pool->release();
+    EXPECT_FALSE(static_cast<bool>(datastore_->get_blob_file(released_id)));
+
+    // after a restart, the BLOBs still referenced are read from the segments, and the others are collected
+    datastore_->shutdown();
+    datastore_ = nullptr;
+    gen_datastore();
+    datastore_->wait_for_blob_file_garbace_collector();
+    EXPECT_EQ(read_file(datastore_->get_blob_file(small_id).path()), small_data);
+    EXPECT_EQ(read_file(datastore_->get_blob_file(duplicated_id).path()), small_data);
+    EXPECT_EQ(read_file(datastore_->get_blob_file(large_id).path()), large_data);
+    EXPECT_FALSE(static_cast<bool>(datastore_->get_blob_file(released_id)));
+    EXPECT_FALSE(static_cast<bool>(datastore_->get_blob_file(unreferenced_id)));
+
+    // the segments are kept from builds which cannot read them by the persistent format version
+    std::string errmsg;
+    auto manifest_path = boost::filesystem::path(data_location) / std::string(limestone::internal::manifest::file_name);
+    EXPECT_GE(limestone::internal::manifest::is_supported_version(manifest_path, errmsg), 10);
+
+    // the segments are backed up with the BLOB files
+    auto& backup = datastore_->begin_backup();
+    bool segment_found = false;
+    for (const auto& file : backup.files()) {
+        segment_found |= resolver.is_pack_file(file);
+    }
+    EXPECT_TRUE(segment_found);
+    backup.notify_end_backup();
+}
+
+TEST_F(datastore_blob_test, duplicated_blobs_are_linked) {
+    datastore_->shutdown();
+    datastore_ = nullptr;
+    gen_datastore([](limestone::api::configuration& conf) { conf.set_blob_dedup_entries(16); });
+
+    auto pool = datastore_->acquire_blob_pool();
+    auto first_id = pool->register_data("duplicated data");
+    auto second_id = pool->register_data("duplicated data");
+    EXPECT_NE(first_id, second_id);
+    EXPECT_TRUE(boost::filesystem::equivalent(datastore_->get_blob_file(first_id).path(), datastore_->get_blob_file(second_id).path()));
+    pool->release();
+}
+
 TEST_F(datastore_blob_test, next_blob_id) {
     // On the first startup, it should be 1
     {
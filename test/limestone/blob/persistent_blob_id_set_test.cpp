@@ -0,0 +1,65 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistent_blob_id_set.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace limestone::testing {
+
+using namespace limestone::internal;
+using limestone::api::blob_id_type;
+
+TEST(persistent_blob_id_set_test, check_and_remove_returns_ids_not_added) {
+    persistent_blob_id_set ids{};
+    ids.add({1, 2, 3, 64, 65});
+    EXPECT_EQ(ids.to_set(), (std::set<blob_id_type>{1, 2, 3, 64, 65}));
+
+    // 4 and 66 were never added, and 2 is removed by the first call only
+    EXPECT_EQ(ids.check_and_remove({4, 2, 66, 64}), (std::vector<blob_id_type>{4, 66}));
+    EXPECT_EQ(ids.check_and_remove({2}), (std::vector<blob_id_type>{2}));
+    EXPECT_EQ(ids.to_set(), (std::set<blob_id_type>{1, 3, 65}));
+}
+
+TEST(persistent_blob_id_set_test, concurrent_channels) {
+    constexpr blob_id_type ids_per_thread = 10000;
+    constexpr std::size_t thread_count = 8;
+    persistent_blob_id_set ids{};
+    std::vector<std::thread> threads{};
+    for (std::size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&ids, t]() {
+            for (blob_id_type i = 0; i < ids_per_thread; i++) {
+                ids.add({t * ids_per_thread + i});
+            }
+            for (blob_id_type i = 0; i < ids_per_thread; i += 2) {
+                EXPECT_TRUE(ids.check_and_remove({t * ids_per_thread + i}).empty());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto remaining = ids.to_set();
+    EXPECT_EQ(remaining.size(), thread_count * ids_per_thread / 2);
+    for (const auto& id : remaining) {
+        EXPECT_EQ(id % 2, 1);
+    }
+}
+
+}  // namespace limestone::testing
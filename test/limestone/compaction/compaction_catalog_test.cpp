@@ -16,7 +16,10 @@
 
 #include <gtest/gtest.h>
 #include <boost/filesystem.hpp>
+#include <fstream>
+#include <nlohmann/json.hpp>
 #include "compaction_catalog.h"
+#include "manifest.h"
 #include "limestone/api/limestone_exception.h"
 #include "limestone/api/blob_file.h"
 
@@ -141,8 +144,28 @@ public:
     using compaction_catalog::parse_catalog_entry;
     using compaction_catalog::set_file_operations;
     using compaction_catalog::reset_file_operations;
+    using compaction_catalog::journal_min_checkpoint_bytes_;
 };
 
+static const boost::filesystem::path journal_file_path = test_dir / "compaction_catalog.journal";
+
+static std::set<std::string> make_detached_pwals(int first, int count) {
+    std::set<std::string> pwals;
+    for (int i = first; i < first + count; i++) {
+        pwals.insert("pwal_0000." + std::to_string(1000000 + i) + ".1");
+    }
+    return pwals;
+}
+
+static void expect_loaded(epoch_id_type max_epoch_id, blob_id_type max_blob_id, const std::set<compacted_file_info>& compacted_files,
+                          const std::set<std::string>& detached_pwals) {
+    compaction_catalog loaded = compaction_catalog::from_catalog_file(test_dir);
+    EXPECT_EQ(loaded.get_max_epoch_id(), max_epoch_id);
+    EXPECT_EQ(loaded.get_max_blob_id(), max_blob_id);
+    EXPECT_EQ(loaded.get_compacted_files(), compacted_files);
+    EXPECT_EQ(loaded.get_detached_pwals(), detached_pwals);
+}
+
 TEST_F(compaction_catalog_test, create_catalog) {
     compaction_catalog catalog(test_dir);
 
@@ -413,6 +436,194 @@ TEST_F(compaction_catalog_test, update_and_load_catalog_file) {
     EXPECT_EQ(loaded_catalog.get_detached_pwals(), detached_pwals);
 }
 
+TEST_F(compaction_catalog_test, compacted_generations) {
+    EXPECT_EQ(compaction_catalog::get_compacted_filename(0), "pwal_0000.compacted");
+    EXPECT_EQ(compaction_catalog::get_compacted_filename(12), "pwal_0000.compacted.12");
+    EXPECT_EQ(compaction_catalog::get_compacted_generation("pwal_0000.compacted"), 0);
+    EXPECT_EQ(compaction_catalog::get_compacted_generation("pwal_0000.compacted.12"), 12);
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted.prev"));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted.012"));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted."));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted1"));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000"));
+
+    // key-range shards
+    EXPECT_EQ(compaction_catalog::get_compacted_filename(0, 0), "pwal_0000.compacted");
+    EXPECT_EQ(compaction_catalog::get_compacted_filename(0, 1), "pwal_0000.compacted.0.1");
+    EXPECT_EQ(compaction_catalog::get_compacted_filename(3, 2), "pwal_0000.compacted.3.2");
+    EXPECT_EQ(compaction_catalog::parse_compacted_filename("pwal_0000.compacted.3.2"), std::make_pair(std::uint64_t{3}, std::size_t{2}));
+    EXPECT_EQ(compaction_catalog::parse_compacted_filename("pwal_0000.compacted.3"), std::make_pair(std::uint64_t{3}, std::size_t{0}));
+    EXPECT_EQ(compaction_catalog::get_compacted_generation("pwal_0000.compacted.0.1"), 0);
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted.0"));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted.1.0"));
+    EXPECT_FALSE(compaction_catalog::get_compacted_generation("pwal_0000.compacted.1.2.3"));
+
+    testable_compaction_catalog catalog(test_dir);
+    std::set<compacted_file_info> compacted_files = {
+        {"pwal_0000.compacted.2", 1},
+        {"pwal_0000.compacted", 1},
+        {"pwal_0000.compacted.10", 1},
+        {"pwal_0000.compacted.0.1", 1},
+        {"pwal_0000.compacted.2.1", 1},
+    };
+    catalog.update_catalog_file(1, 0, compacted_files, {});
+    std::vector<std::string> expected = {"pwal_0000.compacted.10", "pwal_0000.compacted.2", "pwal_0000.compacted.2.1",
+                                         "pwal_0000.compacted", "pwal_0000.compacted.0.1"};
+    EXPECT_EQ(catalog.get_compacted_generations(), expected);
+}
+
+TEST_F(compaction_catalog_test, journal_appends_changes) {
+    testable_compaction_catalog catalog(test_dir);
+    catalog.journal_min_checkpoint_bytes_ = 0;
+
+    // the first update writes the catalog file
+    std::set<compacted_file_info> compacted_files = {{"pwal_0000.compacted", 1}};
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, compacted_files, detached_pwals);
+    EXPECT_FALSE(boost::filesystem::exists(journal_file_path));
+    auto checkpoint_size = boost::filesystem::file_size(catalog_file_path);
+
+    // small updates are appended to the journal
+    auto new_pwals = make_detached_pwals(100, 2);
+    detached_pwals.insert(new_pwals.begin(), new_pwals.end());
+    compacted_files.insert({"pwal_0000.compacted.1", 1});
+    catalog.update_catalog_file(11, 110, compacted_files, detached_pwals);
+    EXPECT_TRUE(boost::filesystem::exists(journal_file_path));
+    EXPECT_EQ(boost::filesystem::file_size(catalog_file_path), checkpoint_size);
+    expect_loaded(11, 110, compacted_files, detached_pwals);
+
+    detached_pwals.erase(detached_pwals.begin());
+    compacted_files.erase({"pwal_0000.compacted", 1});
+    catalog.update_catalog_file(12, 120, compacted_files, detached_pwals);
+    EXPECT_EQ(boost::filesystem::file_size(catalog_file_path), checkpoint_size);
+    expect_loaded(12, 120, compacted_files, detached_pwals);
+
+    // a loaded catalog keeps appending to the journal
+    auto loaded = std::make_unique<testable_compaction_catalog>(test_dir);
+    loaded->journal_min_checkpoint_bytes_ = 0;
+    loaded->load();
+    detached_pwals.erase(detached_pwals.begin());
+    loaded->update_catalog_file(13, 130, compacted_files, detached_pwals);
+    EXPECT_EQ(boost::filesystem::file_size(catalog_file_path), checkpoint_size);
+    expect_loaded(13, 130, compacted_files, detached_pwals);
+
+    // the catalog file is rewritten when the journal would grow larger than it
+    detached_pwals = make_detached_pwals(200, 100);
+    loaded->update_catalog_file(14, 140, compacted_files, detached_pwals);
+    EXPECT_FALSE(boost::filesystem::exists(journal_file_path));
+    expect_loaded(14, 140, compacted_files, detached_pwals);
+}
+
+TEST_F(compaction_catalog_test, journal_appends_given_changes) {
+    testable_compaction_catalog catalog(test_dir);
+    catalog.journal_min_checkpoint_bytes_ = 0;
+    std::set<compacted_file_info> compacted_files = {{"pwal_0000.compacted", 1}, {"pwal_0000.compacted.1", 1}};
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, compacted_files, detached_pwals);
+    auto checkpoint_size = boost::filesystem::file_size(catalog_file_path);
+
+    // the generation 1 is merged into the oldest one, which is replaced in place
+    compaction_catalog::changes delta{};
+    delta.removed_files = {{"pwal_0000.compacted", 1}, {"pwal_0000.compacted.1", 1}};
+    delta.added_files = {{"pwal_0000.compacted", 1}};
+    delta.removed_pwals = {*detached_pwals.begin()};
+    delta.added_pwals = {"pwal_0001.1000000.1"};
+    catalog.update_catalog_file(11, 110, delta);
+
+    compacted_files = {{"pwal_0000.compacted", 1}};
+    detached_pwals.erase(detached_pwals.begin());
+    detached_pwals.insert("pwal_0001.1000000.1");
+    EXPECT_EQ(catalog.get_compacted_files(), compacted_files);
+    EXPECT_EQ(catalog.get_detached_pwals(), detached_pwals);
+    EXPECT_EQ(boost::filesystem::file_size(catalog_file_path), checkpoint_size);
+    // the record holds only the changes
+    EXPECT_LT(boost::filesystem::file_size(journal_file_path), 512);
+    expect_loaded(11, 110, compacted_files, detached_pwals);
+}
+
+TEST_F(compaction_catalog_test, journal_is_not_used_for_small_catalogs) {
+    testable_compaction_catalog catalog(test_dir);
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, {}, detached_pwals);
+    detached_pwals.insert("pwal_0001.1000000.1");
+    catalog.update_catalog_file(11, 110, {}, detached_pwals);
+    EXPECT_FALSE(boost::filesystem::exists(journal_file_path));
+    expect_loaded(11, 110, {}, detached_pwals);
+}
+
+TEST_F(compaction_catalog_test, torn_journal_record_is_discarded) {
+    testable_compaction_catalog catalog(test_dir);
+    catalog.journal_min_checkpoint_bytes_ = 0;
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, {}, detached_pwals);
+    detached_pwals.insert("pwal_0001.1000000.1");
+    catalog.update_catalog_file(11, 110, {}, detached_pwals);
+    auto journal_size = boost::filesystem::file_size(journal_file_path);
+
+    // a record cut by a crash, with and without its last newline
+    test_file_writer writer(journal_file_path.string());
+    writer << "COMPACTION_CATALOG_DELTA 3\nDETACHED_PWAL pwal_0002.1000000.1\nMAX_EPOCH_ID 12\nMAX_BLOB_ID 120\nCOMPACTION_CATALOG_DELTA_END";
+    expect_loaded(11, 110, {}, detached_pwals);
+    EXPECT_EQ(boost::filesystem::file_size(journal_file_path), journal_size);
+
+    writer << "COMPACTION_CATALOG_DELTA 3\nDETACHED_PWAL pwal_0002.1000000.1\n";
+    testable_compaction_catalog loaded(test_dir);
+    loaded.journal_min_checkpoint_bytes_ = 0;
+    loaded.load();
+    EXPECT_EQ(loaded.get_detached_pwals(), detached_pwals);
+    EXPECT_EQ(boost::filesystem::file_size(journal_file_path), journal_size);
+
+    // the next record follows the last complete one
+    detached_pwals.insert("pwal_0003.1000000.1");
+    loaded.update_catalog_file(13, 130, {}, detached_pwals);
+    expect_loaded(13, 130, {}, detached_pwals);
+}
+
+TEST_F(compaction_catalog_test, journal_left_by_crash_during_checkpoint_is_skipped) {
+    testable_compaction_catalog catalog(test_dir);
+    catalog.journal_min_checkpoint_bytes_ = 0;
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, {}, detached_pwals);
+    detached_pwals.insert("pwal_0001.1000000.1");
+    catalog.update_catalog_file(11, 110, {}, detached_pwals);
+    boost::filesystem::copy_file(journal_file_path, test_dir / "journal.saved");
+
+    // the checkpoint removes pwal_0001 added by the journal, then the crash leaves the journal in place
+    detached_pwals = make_detached_pwals(200, 100);
+    catalog.update_catalog_file(12, 120, {}, detached_pwals);
+    ASSERT_FALSE(boost::filesystem::exists(journal_file_path));
+    boost::filesystem::rename(test_dir / "journal.saved", journal_file_path);
+    expect_loaded(12, 120, {}, detached_pwals);
+}
+
+TEST_F(compaction_catalog_test, journal_written_at_persistent_format_version_8_is_migrated) {
+    // a catalog with a journal, left by a build which wrote the journal without bumping the format version
+    testable_compaction_catalog catalog(test_dir);
+    catalog.journal_min_checkpoint_bytes_ = 0;
+    std::set<compacted_file_info> compacted_files = {{"pwal_0000.compacted", 1}};
+    std::set<std::string> detached_pwals = make_detached_pwals(0, 100);
+    catalog.update_catalog_file(10, 100, compacted_files, detached_pwals);
+    detached_pwals.insert("pwal_0001.1000000.1");
+    catalog.update_catalog_file(11, 110, compacted_files, detached_pwals);
+    ASSERT_TRUE(boost::filesystem::exists(journal_file_path));
+
+    auto manifest_path = test_dir / std::string(limestone::internal::manifest::file_name);
+    nlohmann::json j = {
+        {"format_version", "1.1"},
+        {"persistent_format_version", 8},
+        {"instance_uuid", "5b6f8a0e-2f4c-4d1a-9e3b-7c8d9e0f1a2b"}
+    };
+    std::ofstream(manifest_path.string()) << j.dump();
+
+    // the journal is applied as it is, and older builds are kept out by the new version
+    auto info = limestone::internal::manifest::check_and_migrate(test_dir);
+    EXPECT_EQ(info.get_old_version(), 8);
+    EXPECT_EQ(info.get_new_version(), limestone::internal::manifest::default_persistent_format_version);
+    std::string errmsg;
+    EXPECT_EQ(limestone::internal::manifest::is_supported_version(manifest_path, errmsg), limestone::internal::manifest::default_persistent_format_version);
+    expect_loaded(11, 110, compacted_files, detached_pwals);
+}
+
 TEST_F(compaction_catalog_test, load_catalog_file) {
     test_file_writer writer(catalog_file_path.string());
     testable_compaction_catalog catalog(test_dir);
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include "compaction_catalog.h"
+#include "compaction_estimator.h"
+
+using namespace limestone::internal;
+namespace limestone::testing {
+
+extern void create_file(const boost::filesystem::path& path, std::string_view content);
+extern const std::string_view data_case1_epoch;
+extern const std::string_view data_case1_pwal0;
+extern const std::string_view data_case1_pwal1;
+
+static const boost::filesystem::path test_dir = "/tmp/compaction_estimator_test";
+
+class compaction_estimator_test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        boost::filesystem::remove_all(test_dir);
+        boost::filesystem::create_directory(test_dir);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(test_dir);
+    }
+};
+
+TEST_F(compaction_estimator_test, selects_all_files_within_sample_size) {
+    std::map<std::string, std::uint64_t> files = {{"pwal_0000.1.1", 100}, {"pwal_0001.1.1", 200}};
+    std::set<std::string> all = {"pwal_0000.1.1", "pwal_0001.1.1"};
+    EXPECT_EQ(compaction_estimator::select_samples(files, 300), all);
+    EXPECT_EQ(compaction_estimator::select_samples(files, 0), all);
+    EXPECT_TRUE(compaction_estimator::select_samples({}, 300).empty());
+}
+
+TEST_F(compaction_estimator_test, selects_files_evenly) {
+    std::map<std::string, std::uint64_t> files{};
+    for (int i = 0; i < 10; i++) {
+        files.emplace("pwal_000" + std::to_string(i) + ".1.1", 100);
+    }
+    std::set<std::string> expected = {"pwal_0000.1.1", "pwal_0003.1.1", "pwal_0006.1.1"};
+    EXPECT_EQ(compaction_estimator::select_samples(files, 300), expected);
+}
+
+TEST_F(compaction_estimator_test, projected_duration) {
+    compaction_estimate estimate{};
+    estimate.input_bytes = 1000;
+    estimate.estimated_output_bytes = 500;
+    EXPECT_EQ(estimate.projected_io_bytes(), 2500);
+    // unknown bandwidth
+    EXPECT_EQ(estimate.projected_duration(), std::chrono::seconds(0));
+    EXPECT_EQ(estimate.projected_duration(1000), std::chrono::seconds(3));
+    estimate.measured_bytes_per_second = 2500;
+    EXPECT_EQ(estimate.projected_duration(), std::chrono::seconds(1));
+}
+
+TEST_F(compaction_estimator_test, dead_ratio) {
+    compaction_estimate::storage_estimate storage{};
+    EXPECT_DOUBLE_EQ(storage.dead_ratio(), 0.0);
+    storage.versions = 4;
+    storage.live_versions = 1;
+    EXPECT_DOUBLE_EQ(storage.dead_ratio(), 0.75);
+
+    compaction_estimate estimate{};
+    estimate.storages[7] = storage;
+    std::ostringstream out;
+    out << estimate;
+    EXPECT_NE(out.str().find("storage-7: versions=4, live-versions=1, bytes=0, live-bytes=0, dead-ratio=0.75\n"), std::string::npos);
+
+    compaction_estimate::storage_estimate other{};
+    other.versions = 4;
+    other.live_versions = 3;
+    estimate.storages[8] = other;
+    EXPECT_DOUBLE_EQ(estimate.dead_ratio(), 0.5);
+    EXPECT_DOUBLE_EQ(compaction_estimate{}.dead_ratio(), 0.0);
+}
+
+TEST_F(compaction_estimator_test, keys_beyond_limit_are_counted_as_live) {
+    create_file(test_dir / "epoch", data_case1_epoch);
+    create_file(test_dir / "pwal_0000.1.1", data_case1_pwal0);
+
+    compaction_options options(test_dir, 1, {"pwal_0000.1.1"});
+    compaction_estimate all = compaction_estimator(options, 0).estimate();
+    EXPECT_EQ(all.untracked_versions, 0);
+
+    // the third key is not tracked
+    compaction_estimate limited = compaction_estimator(options, 0, 2).estimate();
+    EXPECT_EQ(limited.untracked_versions, 1);
+    ASSERT_EQ(limited.storages.size(), 1);
+    EXPECT_EQ(limited.storages.begin()->second.versions, 3);
+    EXPECT_EQ(limited.storages.begin()->second.live_versions, 3);
+    EXPECT_EQ(limited.estimated_output_bytes, all.estimated_output_bytes);
+}
+
+TEST_F(compaction_estimator_test, estimate_online_compaction) {
+    create_file(test_dir / "epoch", data_case1_epoch);
+    create_file(test_dir / "pwal_0000.1.1", data_case1_pwal0);
+    create_file(test_dir / "pwal_0001.1.1", data_case1_pwal1);  // detached
+    create_file(test_dir / "pwal_0001", data_case1_pwal1);  // active
+    create_file(test_dir / "pwal_0000.compacted", data_case1_pwal0);
+    compaction_catalog catalog(test_dir);
+    catalog.update_catalog_file(0, 0, {{"pwal_0000.compacted", 1}}, {"pwal_0001.1.1"});
+
+    compaction_estimate estimate = estimate_online_compaction(test_dir, catalog, 1);
+    EXPECT_EQ(estimate.input_files, 1);
+    EXPECT_EQ(estimate.sampled_files, 1);
+    EXPECT_EQ(estimate.input_bytes, data_case1_pwal0.size());
+    ASSERT_EQ(estimate.storages.size(), 1);
+    EXPECT_EQ(estimate.storages.begin()->second.versions, 3);
+    EXPECT_EQ(estimate.storages.begin()->second.live_versions, 3);
+    EXPECT_EQ(estimate.estimated_output_bytes, estimate.storages.begin()->second.live_bytes);
+}
+
+}  // namespace limestone::testing
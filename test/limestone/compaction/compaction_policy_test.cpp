@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "compaction_policy.h"
+
+using namespace limestone::internal;
+namespace limestone::testing {
+
+class compaction_policy_test : public ::testing::Test {};
+
+TEST_F(compaction_policy_test, no_generations) {
+    compaction_policy policy(4, 8, 0);
+    EXPECT_EQ(policy.select(100, {}), 0);
+}
+
+TEST_F(compaction_policy_test, merges_while_within_size_ratio) {
+    compaction_policy policy(4, 8, 0);
+    // 100 * 4 >= 300, (100 + 300) * 4 >= 1600, (100 + 300 + 1600) * 4 < 10000
+    EXPECT_EQ(policy.select(100, {300, 1600, 10000}), 2);
+    // 100 * 4 < 401
+    EXPECT_EQ(policy.select(100, {401, 1600}), 0);
+    EXPECT_EQ(policy.select(100, {400, 2001}), 1);
+}
+
+TEST_F(compaction_policy_test, always_merges_small_generations) {
+    compaction_policy policy(4, 8, 1000);
+    EXPECT_EQ(policy.select(1, {999, 1000000}), 1);
+    EXPECT_EQ(policy.select(1, {500, 999}), 2);
+}
+
+TEST_F(compaction_policy_test, limits_number_of_generations) {
+    compaction_policy policy(2, 3, 0);
+    // the new generation and the three existing ones would exceed the limit of three generations
+    EXPECT_EQ(policy.select(1, {1000, 10000, 100000}), 1);
+    EXPECT_EQ(policy.select(1, {1000, 10000}), 0);
+}
+
+TEST_F(compaction_policy_test, merge_all) {
+    compaction_policy policy = compaction_policy::merge_all();
+    EXPECT_EQ(policy.select(0, {1000, 10000, 100000}), 3);
+    EXPECT_EQ(policy.select(0, {}), 0);
+}
+
+TEST_F(compaction_policy_test, ratio_and_limit_are_at_least_one) {
+    compaction_policy policy(0, 0, 0);
+    EXPECT_EQ(policy.size_ratio(), 1);
+    EXPECT_EQ(policy.max_generations(), 1);
+}
+
+}  // namespace limestone::testing
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include "compaction_catalog.h"
+#include "compaction_scheduler.h"
+
+using namespace limestone::internal;
+namespace limestone::testing {
+
+static const boost::filesystem::path test_dir = "/tmp/compaction_scheduler_test";
+
+class compaction_scheduler_test : public ::testing::Test {
+protected:
+    using clock = compaction_scheduler::clock;
+
+    void SetUp() override {
+        boost::filesystem::remove_all(test_dir);
+        boost::filesystem::create_directory(test_dir);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(test_dir);
+        for (const char* name : {"LIMESTONE_COMPACTION_AUTO", "LIMESTONE_COMPACTION_PENDING_BYTES",
+                                 "LIMESTONE_COMPACTION_DEAD_RATIO", "LIMESTONE_COMPACTION_IDLE_SECONDS"}) {
+            unsetenv(name);
+        }
+    }
+
+    static void create_file(const std::string& name, std::size_t size) {
+        std::ofstream out((test_dir / name).string(), std::ios::binary);
+        out << std::string(size, 'x');
+    }
+
+    static compaction_scheduler::thresholds only(compaction_scheduler::thresholds limits) {
+        limits.min_interval = std::chrono::seconds(0);
+        return limits;
+    }
+};
+
+TEST_F(compaction_scheduler_test, measure) {
+    create_file("pwal_0000", 10);
+    create_file("pwal_0000.1.1", 100);
+    create_file("pwal_0001.1.1", 1000);
+    create_file("pwal_0001.2.2", 10000);
+    create_file("pwal_0000.compacted", 200);
+    create_file("pwal_0000.compacted.3", 20);
+    create_file("pwal_0000.compacted.prev", 5000);
+    create_file("epoch", 7);
+    compaction_catalog catalog(test_dir);
+    catalog.update_catalog_file(0, 0, {{"pwal_0000.compacted", 1}, {"pwal_0000.compacted.3", 1}}, {"pwal_0001.2.2"});
+
+    log_dir_usage usage = log_dir_usage::measure(test_dir, catalog);
+    EXPECT_EQ(usage.pending_bytes, 1110);
+    EXPECT_EQ(usage.pending_files, 2);
+    EXPECT_EQ(usage.compacted_bytes, 220);
+    // counting the dead versions reads the WAL files, so it is left to the caller
+    EXPECT_FALSE(usage.dead_ratio.has_value());
+}
+
+TEST_F(compaction_scheduler_test, nothing_to_compact) {
+    compaction_scheduler scheduler(compaction_scheduler::thresholds{});
+    EXPECT_EQ(scheduler.check(log_dir_usage{}, clock::now()), compaction_scheduler::trigger::none);
+}
+
+TEST_F(compaction_scheduler_test, pending_bytes) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.pending_bytes = 1000;
+    compaction_scheduler scheduler(only(limits));
+    auto now = clock::now();
+    EXPECT_EQ(scheduler.check(log_dir_usage{999, 1, 0}, now), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{1000, 1, 0}, now), compaction_scheduler::trigger::pending_bytes);
+}
+
+TEST_F(compaction_scheduler_test, pending_files) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.pending_files = 3;
+    compaction_scheduler scheduler(only(limits));
+    auto now = clock::now();
+    EXPECT_EQ(scheduler.check(log_dir_usage{10, 2, 0}, now), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{10, 3, 0}, now), compaction_scheduler::trigger::pending_files);
+}
+
+TEST_F(compaction_scheduler_test, dead_ratio) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.dead_ratio = 0.5;
+    limits.dead_ratio_min_bytes = 100;
+    compaction_scheduler scheduler(only(limits));
+    auto now = clock::now();
+    EXPECT_TRUE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, now));
+    // below the minimum size
+    EXPECT_FALSE(scheduler.needs_dead_ratio(log_dir_usage{99, 1, 0}, now));
+    EXPECT_EQ(scheduler.check(log_dir_usage{99, 1, 0, 0.9}, now), compaction_scheduler::trigger::none);
+    // not counted
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0}, now), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0, 0.49}, now), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0, 0.5}, now), compaction_scheduler::trigger::dead_ratio);
+}
+
+TEST_F(compaction_scheduler_test, dead_ratio_interval) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.dead_ratio = 0.5;
+    limits.dead_ratio_min_bytes = 100;
+    limits.dead_ratio_interval = std::chrono::seconds(30);
+    limits.min_interval = std::chrono::seconds(60);
+    compaction_scheduler scheduler(limits);
+    auto start = clock::now();
+    EXPECT_TRUE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, start));
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0, 0.1}, start), compaction_scheduler::trigger::none);
+    // counted recently
+    EXPECT_FALSE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, start + std::chrono::seconds(29)));
+    EXPECT_TRUE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, start + std::chrono::seconds(30)));
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0, 0.6}, start + std::chrono::seconds(30)), compaction_scheduler::trigger::dead_ratio);
+    scheduler.compaction_finished(start + std::chrono::seconds(30));
+    // no compaction can start within the min interval, so there is no need to count
+    EXPECT_FALSE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, start + std::chrono::seconds(89)));
+    EXPECT_TRUE(scheduler.needs_dead_ratio(log_dir_usage{100, 1, 0}, start + std::chrono::seconds(90)));
+}
+
+TEST_F(compaction_scheduler_test, idle) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.idle_window = std::chrono::seconds(10);
+    limits.idle_min_bytes = 100;
+    compaction_scheduler scheduler(only(limits));
+    auto start = clock::now();
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0}, start), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{100, 1, 0}, start + std::chrono::seconds(9)), compaction_scheduler::trigger::none);
+    // a write restarts the idle window
+    EXPECT_EQ(scheduler.check(log_dir_usage{200, 1, 0}, start + std::chrono::seconds(9)), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{200, 1, 0}, start + std::chrono::seconds(18)), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{200, 1, 0}, start + std::chrono::seconds(19)), compaction_scheduler::trigger::idle);
+}
+
+TEST_F(compaction_scheduler_test, idle_requires_min_bytes) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.idle_window = std::chrono::seconds(10);
+    limits.idle_min_bytes = 100;
+    compaction_scheduler scheduler(only(limits));
+    auto start = clock::now();
+    EXPECT_EQ(scheduler.check(log_dir_usage{99, 1, 0}, start), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{99, 1, 0}, start + std::chrono::hours(1)), compaction_scheduler::trigger::none);
+}
+
+TEST_F(compaction_scheduler_test, min_interval) {
+    compaction_scheduler::thresholds limits = compaction_scheduler::thresholds::disabled();
+    limits.pending_bytes = 1000;
+    limits.min_interval = std::chrono::seconds(60);
+    compaction_scheduler scheduler(limits);
+    auto start = clock::now();
+    // the first compaction is not delayed
+    EXPECT_EQ(scheduler.check(log_dir_usage{1000, 1, 0}, start), compaction_scheduler::trigger::pending_bytes);
+    scheduler.compaction_finished(start);
+    EXPECT_EQ(scheduler.check(log_dir_usage{5000, 1, 0}, start + std::chrono::seconds(59)), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(log_dir_usage{5000, 1, 0}, start + std::chrono::seconds(60)), compaction_scheduler::trigger::pending_bytes);
+}
+
+TEST_F(compaction_scheduler_test, disabled) {
+    compaction_scheduler scheduler(compaction_scheduler::thresholds::disabled());
+    auto start = clock::now();
+    log_dir_usage usage{1UL << 40U, 100000, 1};
+    EXPECT_EQ(scheduler.check(usage, start), compaction_scheduler::trigger::none);
+    EXPECT_EQ(scheduler.check(usage, start + std::chrono::hours(24)), compaction_scheduler::trigger::none);
+    EXPECT_FALSE(scheduler.needs_dead_ratio(usage, start));
+    EXPECT_FALSE(compaction_scheduler::thresholds::disabled().enabled());
+    EXPECT_TRUE(compaction_scheduler::thresholds{}.enabled());
+}
+
+TEST_F(compaction_scheduler_test, from_environment) {
+    // disabled by default
+    EXPECT_FALSE(compaction_scheduler::thresholds::from_environment().enabled());
+
+    setenv("LIMESTONE_COMPACTION_AUTO", "1", 1);
+    setenv("LIMESTONE_COMPACTION_PENDING_BYTES", "12345", 1);
+    setenv("LIMESTONE_COMPACTION_DEAD_RATIO", "0.25", 1);
+    setenv("LIMESTONE_COMPACTION_IDLE_SECONDS", "-1", 1);
+    auto limits = compaction_scheduler::thresholds::from_environment();
+    EXPECT_EQ(limits.pending_bytes, 12345);
+    EXPECT_DOUBLE_EQ(limits.dead_ratio, 0.25);
+    // invalid values are ignored
+    EXPECT_EQ(limits.idle_window, compaction_scheduler::thresholds{}.idle_window);
+    EXPECT_EQ(limits.pending_files, compaction_scheduler::thresholds{}.pending_files);
+
+    setenv("LIMESTONE_COMPACTION_AUTO", "0", 1);
+    limits = compaction_scheduler::thresholds::from_environment();
+    EXPECT_FALSE(limits.enabled());
+    EXPECT_EQ(limits.pending_bytes, 0);
+    EXPECT_EQ(limits.pending_files, 0);
+
+    setenv("LIMESTONE_COMPACTION_AUTO", "yes", 1);
+    EXPECT_FALSE(compaction_scheduler::thresholds::from_environment().enabled());
+}
+
+TEST_F(compaction_scheduler_test, trigger_label) {
+    EXPECT_EQ(to_string_view(compaction_scheduler::trigger::dead_ratio), "dead_ratio");
+    EXPECT_EQ(to_string_view(compaction_scheduler::trigger::none), "none");
+}
+
+}  // namespace limestone::testing
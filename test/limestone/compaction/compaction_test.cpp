@@ -15,6 +15,8 @@
  */
 
  #include "compaction_test_fixture.h"
+ #include "datastore_impl.h"
+ #include <map>
 
 namespace limestone::testing {
 
@@ -750,12 +752,11 @@ TEST_F(compaction_test, scenario03) {
     EXPECT_TRUE(AssertLogEntry(log_entries[0], 1, "key3", "value3", 0, 0, {}, log_entry::entry_type::normal_entry));  // write version changed to 0
     EXPECT_TRUE(AssertLogEntry(log_entries[1], 2, "key2", "value2", 0, 0, {}, log_entry::entry_type::normal_entry));  // write version changed to 0
 
+    // the remove entries of key11 and key41 are dropped, as the compacted file has neither of them
     log_entries = read_log_file("data/snapshot", location);
-    ASSERT_EQ(log_entries.size(), 4);  // Ensure that there are log entries
-    EXPECT_TRUE(AssertLogEntry(log_entries[0], 1, "key11", std::nullopt, 2, 1, {}, log_entry::entry_type::remove_entry));
-    EXPECT_TRUE(AssertLogEntry(log_entries[1], 1, "key31", "value3", 2, 3, {}, log_entry::entry_type::normal_entry));
-    EXPECT_TRUE(AssertLogEntry(log_entries[2], 1, "key41", std::nullopt, 2, 0, {}, log_entry::entry_type::remove_entry));
-    EXPECT_TRUE(AssertLogEntry(log_entries[3], 2, "key21", "value2", 2, 0, {}, log_entry::entry_type::normal_entry));
+    ASSERT_EQ(log_entries.size(), 2);  // Ensure that there are log entries
+    EXPECT_TRUE(AssertLogEntry(log_entries[0], 1, "key31", "value3", 2, 3, {}, log_entry::entry_type::normal_entry));
+    EXPECT_TRUE(AssertLogEntry(log_entries[1], 2, "key21", "value2", 2, 0, {}, log_entry::entry_type::normal_entry));
 
     // 5. Verify the snapshot contents after restart
     std::vector<std::pair<std::string, std::string>> kv_list = restart_datastore_and_read_snapshot();
@@ -1307,6 +1308,351 @@ TEST_F(compaction_test, get_files_in_directory_not_a_directory) {
     ASSERT_THROW(get_files_in_directory(file_path), std::runtime_error);
 }
 
+TEST_F(compaction_test, per_storage_cursor_uses_storage_index) {
+    gen_datastore();
+    datastore_->switch_epoch(1);
+
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k1", "v1", {1, 0});
+    lc0_->add_entry(2, "k2", "v2", {1, 0});
+    lc0_->add_entry(3, "k3", "v3", {1, 0});
+    lc0_->end_session();
+
+    run_compact_with_epoch_switch(2);
+    EXPECT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / "storage_index.pwal_0000.compacted"));
+
+    lc0_->begin_session();
+    lc0_->add_entry(2, "k4", "v4", {2, 0});
+    lc0_->end_session();
+    datastore_->switch_epoch(3);
+
+    restart_datastore_and_read_snapshot();
+    EXPECT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / "data" / "storage_index.snapshot"));
+
+    auto read_all = [](cursor& c) {
+        std::vector<std::pair<std::string, std::string>> kv_list;
+        while (c.next()) {
+            std::string key, value;
+            c.key(key);
+            c.value(value);
+            kv_list.emplace_back(key, value);
+        }
+        return kv_list;
+    };
+
+    std::unique_ptr<snapshot> snapshot = datastore_->get_snapshot();
+    auto kv_list = read_all(*snapshot->get_cursor(2));
+    ASSERT_EQ(kv_list.size(), 2);
+    EXPECT_EQ(kv_list[0].first, "k2");
+    EXPECT_EQ(kv_list[0].second, "v2");
+    EXPECT_EQ(kv_list[1].first, "k4");
+    EXPECT_EQ(kv_list[1].second, "v4");
+
+    kv_list = read_all(*snapshot->get_cursor(3));
+    ASSERT_EQ(kv_list.size(), 1);
+    EXPECT_EQ(kv_list[0].first, "k3");
+
+    EXPECT_TRUE(read_all(*snapshot->get_cursor(4)).empty());
+
+    auto cursors = snapshot->get_partitioned_cursors(2, 1);
+    std::vector<std::pair<std::string, std::string>> partitioned;
+    for (auto& c : cursors) {
+        auto part = read_all(*c);
+        partitioned.insert(partitioned.end(), part.begin(), part.end());
+    }
+    ASSERT_EQ(partitioned.size(), 1);
+    EXPECT_EQ(partitioned[0].first, "k1");
+    EXPECT_EQ(partitioned[0].second, "v1");
+}
+
+TEST_F(compaction_test, compaction_merges_new_wals_into_compacted_file) {
+    gen_datastore();
+    datastore_->switch_epoch(1);
+
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k1", "v1", {1, 0});
+    lc0_->add_entry(1, "k2", "v2", {1, 0});
+    lc0_->add_entry(1, "k3", "v3", {1, 0});
+    lc0_->add_entry(1, "k5", "v5", {1, 0});
+    lc0_->add_entry(2, "k1", "s2v1", {1, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k2", "v2b", {2, 0});
+    lc0_->remove_entry(1, "k3", {2, 0});
+    lc0_->add_entry(1, "k4", "v4", {2, 0});
+    lc0_->add_entry(1, "k6", "v6", {2, 0});
+    lc0_->truncate_storage(2, {2, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(3);
+
+    // The new compacted file holds the entries of the old one merged with the new entries, in key order.
+    std::vector<std::pair<std::string, std::string>> compacted;
+    for (const auto& e : read_log_file(compacted_filename, location)) {
+        if (e.type() != log_entry::entry_type::normal_entry) {
+            continue;
+        }
+        EXPECT_EQ(e.storage(), 1);
+        write_version_type wv;
+        e.write_version(wv);
+        EXPECT_EQ(wv, write_version_type(0, 0));
+        std::string key, value;
+        e.key(key);
+        e.value(value);
+        compacted.emplace_back(key, value);
+    }
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"k1", "v1"}, {"k2", "v2b"}, {"k4", "v4"}, {"k5", "v5"}, {"k6", "v6"},
+    };
+    EXPECT_EQ(compacted, expected);
+
+    EXPECT_EQ(restart_datastore_and_read_snapshot(), expected);
+}
+
+TEST_F(compaction_test, compaction_keeps_newer_generations_by_size_ratio) {
+    gen_datastore();
+    datastore_->get_impl()->set_compaction_policy(compaction_policy(4, 8, 0));
+    datastore_->switch_epoch(1);
+
+    std::vector<std::pair<std::string, std::string>> expected;
+    lc0_->begin_session();
+    for (int i = 10; i < 50; i++) {
+        std::string key = "k" + std::to_string(i);
+        lc0_->add_entry(1, key, "v" + std::to_string(i), {1, 0});
+        expected.emplace_back(key, "v" + std::to_string(i));
+    }
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+    EXPECT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / compacted_filename));
+    auto oldest_size = boost::filesystem::file_size(boost::filesystem::path(location) / compacted_filename);
+
+    // a small delta becomes a new generation, leaving the large oldest generation as it is
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k11", "x11", {2, 0});
+    lc0_->remove_entry(1, "k12", {2, 0});
+    lc0_->add_entry(1, "k99", "v99", {2, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(3);
+    const std::string generation1 = compaction_catalog::get_compacted_filename(1);
+    ASSERT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / generation1));
+    EXPECT_EQ(boost::filesystem::file_size(boost::filesystem::path(location) / compacted_filename), oldest_size);
+    std::vector<log_entry> entries = read_log_file(generation1, location);
+    ASSERT_EQ(entries.size(), 3);
+    EXPECT_TRUE(AssertLogEntry(entries[0], 1, "k11", "x11", 2, 0, {}, log_entry::entry_type::normal_entry));  // write version kept
+    EXPECT_EQ(entries[1].type(), log_entry::entry_type::remove_entry);  // kept to hide k12 of the older generation
+    EXPECT_TRUE(AssertLogEntry(entries[2], 1, "k99", "v99", 2, 0, {}, log_entry::entry_type::normal_entry));
+    expected[1].second = "x11";
+    expected.erase(expected.begin() + 2);
+    expected.emplace_back("k99", "v99");
+
+    // the next small delta is merged with the newest generation, which is within the size ratio
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k13", "x13", {3, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(4);
+    const std::string generation2 = compaction_catalog::get_compacted_filename(2);
+    EXPECT_FALSE(boost::filesystem::exists(boost::filesystem::path(location) / generation1));
+    EXPECT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / generation2));
+    EXPECT_EQ(boost::filesystem::file_size(boost::filesystem::path(location) / compacted_filename), oldest_size);
+    compaction_catalog catalog = compaction_catalog::from_catalog_file(location);
+    std::vector<std::string> generations = {generation2, compacted_filename};
+    EXPECT_EQ(catalog.get_compacted_generations(), generations);
+    expected[2].second = "x13";
+
+    EXPECT_EQ(restart_datastore_and_read_snapshot(), expected);
+
+    // a truncated storage cannot be carried over by a newer generation, so every generation is merged
+    datastore_->get_impl()->set_compaction_policy(compaction_policy(4, 8, 0));
+    datastore_->switch_epoch(5);
+    lc0_->begin_session();
+    lc0_->truncate_storage(1, {5, 0});
+    lc0_->add_entry(1, "k50", "v50", {5, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(6);
+    EXPECT_FALSE(boost::filesystem::exists(boost::filesystem::path(location) / generation2));
+    catalog = compaction_catalog::from_catalog_file(location);
+    generations = {compacted_filename};
+    EXPECT_EQ(catalog.get_compacted_generations(), generations);
+    expected = {{"k50", "v50"}};
+    EXPECT_EQ(restart_datastore_and_read_snapshot(), expected);
+}
+
+TEST_F(compaction_test, compacted_files_are_merged_without_sorting) {
+    gen_datastore();
+    datastore_->get_impl()->set_compaction_policy(compaction_policy(4, 8, 0));
+    datastore_->switch_epoch(1);
+
+    lc0_->begin_session();
+    for (int i = 10; i < 50; i++) {
+        lc0_->add_entry(1, "k" + std::to_string(i), "v" + std::to_string(i), {1, 0});
+    }
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k11", "x11", {2, 0});
+    lc0_->remove_entry(1, "k12", {2, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(3);
+    const std::string generation1 = compaction_catalog::get_compacted_filename(1);
+    ASSERT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / generation1));
+
+    // not compacted yet
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k99", "v99", {3, 0});
+    lc0_->end_session();
+    datastore_->switch_epoch(4);
+    datastore_->shutdown();
+    datastore_ = nullptr;
+
+    auto check_merged = [this](const boost::filesystem::path& to_dir, bool with_new_wal) {
+        std::vector<log_entry> entries = read_log_file(compacted_filename, to_dir);
+        ASSERT_EQ(entries.size(), with_new_wal ? 40 : 39);
+        EXPECT_TRUE(AssertLogEntry(entries[0], 1, "k10", "v10", 0, 0, {}, log_entry::entry_type::normal_entry));
+        EXPECT_TRUE(AssertLogEntry(entries[1], 1, "k11", "x11", 0, 0, {}, log_entry::entry_type::normal_entry));
+        EXPECT_TRUE(AssertLogEntry(entries[2], 1, "k13", "v13", 0, 0, {}, log_entry::entry_type::normal_entry));
+        if (with_new_wal) {
+            EXPECT_TRUE(AssertLogEntry(entries[39], 1, "k99", "v99", 0, 0, {}, log_entry::entry_type::normal_entry));
+        }
+    };
+
+    // only compacted files: merged without the sort database
+    boost::filesystem::path to_dir = boost::filesystem::path(location) / "merged";
+    boost::filesystem::create_directory(to_dir);
+    compaction_options options(location, to_dir, 1, {compacted_filename, generation1});
+    create_compact_pwal_and_get_max_blob_id(options);
+    check_merged(to_dir, false);
+
+    // the whole directory, as dblogutil compacts it: the compacted files are merged with the sorted WAL files,
+    // but a generation file not listed in the catalog is not, even if it is the newest one
+    boost::filesystem::copy_file(boost::filesystem::path(location) / compacted_filename,
+                                 boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(9));
+    to_dir = boost::filesystem::path(location) / "offline";
+    boost::filesystem::create_directory(to_dir);
+    compaction_options offline_options(location, to_dir, 1);
+    create_compact_pwal_and_get_max_blob_id(offline_options);
+    check_merged(to_dir, true);
+}
+
+TEST_F(compaction_test, tombstones_are_purged_when_they_hide_nothing_older) {
+    gen_datastore();
+    datastore_->get_impl()->set_compaction_policy(compaction_policy(4, 8, 0));
+    datastore_->switch_epoch(1);
+
+    lc0_->begin_session();
+    for (int i = 10; i < 50; i++) {
+        lc0_->add_entry(1, "k" + std::to_string(i), "v" + std::to_string(i), {1, 0});
+    }
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+
+    // a new generation keeps only the remove entries of the keys in the older generation
+    lc0_->begin_session();
+    lc0_->remove_entry(1, "k11", {2, 0});
+    lc0_->remove_entry(1, "k5", {2, 0});
+    lc0_->remove_entry(2, "k11", {2, 0});
+    lc0_->add_entry(1, "k99", "v99", {2, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(3);
+    const std::string generation1 = compaction_catalog::get_compacted_filename(1);
+    std::vector<log_entry> entries = read_log_file(generation1, location);
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_TRUE(AssertLogEntry(entries[0], 1, "k11", std::nullopt, 2, 0, {}, log_entry::entry_type::remove_entry));
+    EXPECT_TRUE(AssertLogEntry(entries[1], 1, "k99", "v99", 2, 0, {}, log_entry::entry_type::normal_entry));
+
+    // so does the snapshot made at startup
+    lc0_->begin_session();
+    lc0_->remove_entry(1, "k12", {3, 0});
+    lc0_->remove_entry(1, "k98", {3, 0});
+    lc0_->remove_entry(1, "k99", {3, 0});
+    lc0_->end_session();
+    datastore_->switch_epoch(4);
+    std::vector<std::pair<std::string, std::string>> kv_list = restart_datastore_and_read_snapshot();
+    entries = read_log_file("data/snapshot", location);
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_TRUE(AssertLogEntry(entries[0], 1, "k12", std::nullopt, 3, 0, {}, log_entry::entry_type::remove_entry));
+    EXPECT_TRUE(AssertLogEntry(entries[1], 1, "k99", std::nullopt, 3, 0, {}, log_entry::entry_type::remove_entry));
+    EXPECT_EQ(kv_list.size(), 38);
+    EXPECT_EQ(kv_list.front(), std::make_pair(std::string("k10"), std::string("v10")));
+    EXPECT_EQ(kv_list.back(), std::make_pair(std::string("k49"), std::string("v49")));
+}
+
+TEST_F(compaction_test, compaction_writes_key_range_shards) {
+    gen_datastore();
+    datastore_->get_impl()->set_compaction_sharding(4, 1);
+    datastore_->switch_epoch(1);
+
+    std::map<std::string, std::string> expected_map;
+    lc0_->begin_session();
+    for (int i = 100; i < 500; i++) {
+        std::string key = "k" + std::to_string(i);
+        std::string value = "v" + std::to_string(i) + std::string(100, 'x');
+        lc0_->add_entry(1, key, value, {1, 0});
+        expected_map[key] = value;
+    }
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+
+    // the shards of the oldest generation hold disjoint key ranges, in the order of the shard number
+    compaction_catalog catalog = compaction_catalog::from_catalog_file(location);
+    std::vector<std::string> shards = catalog.get_compacted_generations();
+    ASSERT_GE(shards.size(), 2);
+    ASSERT_LE(shards.size(), 4);
+    EXPECT_EQ(shards.front(), compacted_filename);
+    std::vector<std::pair<std::string, std::string>> compacted;
+    for (std::size_t shard = 0; shard < shards.size(); shard++) {
+        EXPECT_EQ(shards[shard], compaction_catalog::get_compacted_filename(0, shard));
+        std::vector<log_entry> entries = read_log_file(shards[shard], location);
+        EXPECT_FALSE(entries.empty());
+        for (const auto& e : entries) {
+            std::string key, value;
+            e.key(key);
+            e.value(value);
+            compacted.emplace_back(key, value);
+        }
+    }
+    std::vector<std::pair<std::string, std::string>> expected(expected_map.begin(), expected_map.end());
+    EXPECT_EQ(compacted, expected);
+    EXPECT_EQ(restart_datastore_and_read_snapshot(), expected);
+
+    // the next compaction rewrites every shard, and the shards no longer written are removed
+    datastore_->get_impl()->set_compaction_sharding(1, 1);
+    datastore_->switch_epoch(3);
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k100", "new", {3, 0});
+    lc0_->remove_entry(1, "k499", {3, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(4);
+    catalog = compaction_catalog::from_catalog_file(location);
+    std::vector<std::string> generations = {compacted_filename};
+    EXPECT_EQ(catalog.get_compacted_generations(), generations);
+    for (std::size_t shard = 1; shard < shards.size(); shard++) {
+        EXPECT_FALSE(boost::filesystem::exists(boost::filesystem::path(location) / shards[shard]));
+    }
+    expected_map["k100"] = "new";
+    expected_map.erase("k499");
+    expected.assign(expected_map.begin(), expected_map.end());
+    EXPECT_EQ(restart_datastore_and_read_snapshot(), expected);
+}
+
+TEST_F(compaction_test, stale_compacted_generation_is_removed_at_startup) {
+    gen_datastore();
+    datastore_->switch_epoch(1);
+    lc0_->begin_session();
+    lc0_->add_entry(1, "k1", "v1", {1, 0});
+    lc0_->end_session();
+    run_compact_with_epoch_switch(2);
+    datastore_->shutdown();
+    datastore_ = nullptr;
+
+    // left behind by an online compaction that stopped before updating the catalog
+    boost::filesystem::copy_file(boost::filesystem::path(location) / compacted_filename,
+                                 boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(1));
+    gen_datastore();
+    EXPECT_FALSE(boost::filesystem::exists(boost::filesystem::path(location) / compaction_catalog::get_compacted_filename(1)));
+    EXPECT_TRUE(boost::filesystem::exists(boost::filesystem::path(location) / compacted_filename));
+}
+
 TEST_F(compaction_test, get_files_in_directory_with_files) {
     boost::filesystem::path test_dir = boost::filesystem::path(location) / "test_dir";
     boost::filesystem::create_directory(test_dir);
@@ -21,6 +21,7 @@
 #include <sys/stat.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <thread>
 
 #include "compaction_catalog.h"
@@ -29,6 +30,7 @@
 #include "log_entry.h"
 #include "manifest.h"
 #include "online_compaction.h"
+#include "snapshot_block_reader.h"
 #include "test_root.h"
 
 namespace limestone::testing {
@@ -272,6 +274,23 @@ protected:
         boost::filesystem::path log_path = log_dir / log_file;
 
         std::vector<log_entry> log_entries;
+
+        // The snapshot file is written in the block-based format, which dblog_scan does not read.
+        boost::filesystem::ifstream istrm(log_path, std::ios_base::in | std::ios_base::binary);
+        if (snapshot_block_reader::read_file_header(istrm)) {
+            snapshot_block_reader reader(log_path.string());
+            log_entry e;
+            while (reader.read(istrm, e)) {
+                log_entries.push_back(e);
+            }
+            std::cout << std::endl << "Log entries read from " << log_path.string() << ":" << std::endl;
+            for (const auto& entry : log_entries) {
+                print_log_entry(entry);
+            }
+            return log_entries;
+        }
+        istrm.close();
+
         limestone::internal::dblog_scan::parse_error pe;
 
         // Define a lambda function to capture and store log entries
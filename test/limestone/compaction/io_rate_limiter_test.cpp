@@ -0,0 +1,136 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "io_rate_limiter.h"
+
+using namespace limestone::internal;
+namespace limestone::testing {
+
+class io_rate_limiter_test : public ::testing::Test {
+protected:
+    using clock = io_rate_limiter::clock;
+
+    void SetUp() override {
+        now_ = clock::time_point{} + std::chrono::hours(1);
+        slept_ = clock::duration::zero();
+    }
+
+    void use_fake_clock(io_rate_limiter& limiter) {
+        limiter.set_clock_for_tests([this]() { return now_; },
+                                    [this](clock::duration d) {
+                                        slept_ += d;
+                                        now_ += d;
+                                    });
+    }
+
+    static io_rate_limiter::settings rate(std::uint64_t bytes_per_second, std::chrono::microseconds target = std::chrono::microseconds(0)) {
+        io_rate_limiter::settings config{};
+        config.bytes_per_second = bytes_per_second;
+        config.target_commit_latency = target;
+        return config;
+    }
+
+    clock::time_point now_{};
+    clock::duration slept_{};
+};
+
+TEST_F(io_rate_limiter_test, unlimited_by_default) {
+    io_rate_limiter limiter{};
+    use_fake_clock(limiter);
+    limiter.begin();
+    for (int i = 0; i < 1000; i++) {
+        limiter.request(1024UL * 1024UL);
+    }
+    EXPECT_EQ(slept_, clock::duration::zero());
+    EXPECT_EQ(limiter.current_rate(), 0);
+}
+
+TEST_F(io_rate_limiter_test, small_requests_are_batched) {
+    io_rate_limiter limiter{rate(1)};
+    use_fake_clock(limiter);
+    limiter.begin();
+    limiter.request(io_rate_limiter::charge_unit - 1);
+    EXPECT_EQ(limiter.charged_bytes(), 0);
+    limiter.request(1);
+    EXPECT_EQ(limiter.charged_bytes(), io_rate_limiter::charge_unit);
+}
+
+TEST_F(io_rate_limiter_test, limits_bandwidth) {
+    constexpr std::uint64_t bytes_per_second = 1024UL * 1024UL;
+    io_rate_limiter limiter{rate(bytes_per_second)};
+    use_fake_clock(limiter);
+    limiter.begin();
+    // the first second is the burst of the full bucket, the other four seconds are throttled
+    for (std::uint64_t i = 0; i < 5 * bytes_per_second / io_rate_limiter::charge_unit; i++) {
+        limiter.request(io_rate_limiter::charge_unit);
+    }
+    auto slept = std::chrono::duration_cast<std::chrono::milliseconds>(slept_).count();
+    EXPECT_GE(slept, 3990);
+    EXPECT_LE(slept, 4010);
+    EXPECT_EQ(limiter.charged_bytes(), 5 * bytes_per_second);
+    EXPECT_GE(limiter.throttled_time(), std::chrono::milliseconds(3990));
+}
+
+TEST_F(io_rate_limiter_test, slows_down_on_slow_commits) {
+    constexpr std::uint64_t bytes_per_second = 1600UL * 1024UL;
+    io_rate_limiter limiter{rate(bytes_per_second, std::chrono::milliseconds(10))};
+    use_fake_clock(limiter);
+    limiter.begin();
+
+    limiter.report_commit_latency(std::chrono::milliseconds(50));
+    now_ += io_rate_limiter::adjust_interval;
+    limiter.request(io_rate_limiter::charge_unit);
+    EXPECT_EQ(limiter.current_rate(), bytes_per_second / 2);
+    EXPECT_EQ(limiter.max_commit_latency(), std::chrono::milliseconds(50));
+
+    // never below 1/16 of the configured rate
+    for (int i = 0; i < 10; i++) {
+        limiter.report_commit_latency(std::chrono::milliseconds(50));
+        now_ += io_rate_limiter::adjust_interval;
+        limiter.request(io_rate_limiter::charge_unit);
+    }
+    EXPECT_EQ(limiter.current_rate(), bytes_per_second / io_rate_limiter::min_rate_divisor);
+
+    // recovers step by step while commits are fast
+    limiter.report_commit_latency(std::chrono::milliseconds(1));
+    now_ += io_rate_limiter::adjust_interval;
+    limiter.request(io_rate_limiter::charge_unit);
+    EXPECT_EQ(limiter.current_rate(), bytes_per_second / io_rate_limiter::min_rate_divisor + bytes_per_second / 10);
+    for (int i = 0; i < 20; i++) {
+        now_ += io_rate_limiter::adjust_interval;
+        limiter.request(io_rate_limiter::charge_unit);
+    }
+    EXPECT_EQ(limiter.current_rate(), bytes_per_second);
+}
+
+TEST_F(io_rate_limiter_test, begin_restores_the_configured_rate) {
+    constexpr std::uint64_t bytes_per_second = 1024UL * 1024UL;
+    io_rate_limiter limiter{rate(bytes_per_second, std::chrono::milliseconds(10))};
+    use_fake_clock(limiter);
+    limiter.begin();
+    limiter.report_commit_latency(std::chrono::milliseconds(50));
+    now_ += io_rate_limiter::adjust_interval;
+    limiter.request(io_rate_limiter::charge_unit);
+    EXPECT_LT(limiter.current_rate(), bytes_per_second);
+
+    limiter.begin();
+    EXPECT_EQ(limiter.current_rate(), bytes_per_second);
+    EXPECT_EQ(limiter.max_commit_latency(), std::chrono::microseconds(0));
+    EXPECT_EQ(limiter.charged_bytes(), 0);
+}
+
+}  // namespace limestone::testing
@@ -154,8 +154,23 @@ TEST_F(log_dir_test, accept_manifest_version_v7) {
     gen_datastore();   // success
 }
 
-TEST_F(log_dir_test, reject_manifest_version_v8) {
+TEST_F(log_dir_test, accept_manifest_version_v8) {
     create_manifest_file(8);
+    gen_datastore();   // success
+}
+
+TEST_F(log_dir_test, accept_manifest_version_v9) {
+    create_manifest_file(9);
+    gen_datastore();   // success
+}
+
+TEST_F(log_dir_test, accept_manifest_version_v10) {
+    create_manifest_file(10);
+    gen_datastore();   // success
+}
+
+TEST_F(log_dir_test, reject_manifest_version_v11) {
+    create_manifest_file(11);
     EXPECT_THROW({ gen_datastore(); }, std::exception);
 }
 
@@ -181,11 +196,30 @@ TEST_F(log_dir_test, rotate_old_rejects_unsupported_data) {
         LOG(FATAL) << "cannot make directory";
     }
     create_file(bk_path / "epoch", epoch_0_str);
-    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(8));
+    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(11));
+
+    gen_datastore();
+
+    EXPECT_EQ(datastore_->restore(bk_path.string(), true), limestone::status::err_broken_data);
+}
+
+TEST_F(log_dir_test, rotate_old_rejects_compacted_generations_in_v7_dir) {
+    // setup backups
+    boost::filesystem::path bk_path = boost::filesystem::path(location) / "bk";
+    if (!boost::filesystem::create_directory(bk_path)) {
+        LOG(FATAL) << "cannot make directory";
+    }
+    create_file(bk_path / "epoch", epoch_0_str);
+    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(7));
+    create_file(bk_path / "pwal_0000.compacted", "");
+    create_file(bk_path / "pwal_0000.compacted.1", "");
 
     gen_datastore();
 
     EXPECT_EQ(datastore_->restore(bk_path.string(), true), limestone::status::err_broken_data);
+
+    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(8));
+    EXPECT_EQ(datastore_->restore(bk_path.string(), true), limestone::status::ok);
 }
 
 TEST_F(log_dir_test, rotate_old_rejects_v0_logdir_missing_manifest) {
@@ -241,11 +275,31 @@ TEST_F(log_dir_test, rotate_prusik_rejects_unsupported_data) {
         LOG(FATAL) << "cannot make directory";
     }
     create_file(bk_path / "epoch", epoch_0_str);
-    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(8));
+    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(11));
+    // setup entries
+    std::vector<limestone::api::file_set_entry> entries;
+    entries.emplace_back("epoch", "epoch", false);
+    entries.emplace_back(std::string(limestone::internal::manifest::file_name), std::string(limestone::internal::manifest::file_name), false);
+
+    gen_datastore();
+
+    EXPECT_EQ(datastore_->restore(bk_path.string(), entries), limestone::status::err_broken_data);
+}
+
+TEST_F(log_dir_test, rotate_prusik_rejects_compacted_generations_in_v7_dir) {
+    // setup backups
+    boost::filesystem::path bk_path = boost::filesystem::path(location) / "bk";
+    if (!boost::filesystem::create_directory(bk_path)) {
+        LOG(FATAL) << "cannot make directory";
+    }
+    create_file(bk_path / "epoch", epoch_0_str);
+    create_file(bk_path / std::string(limestone::internal::manifest::file_name), data_manifest(7));
+    create_file(bk_path / "pwal_0000.compacted.0.1", "");
     // setup entries
     std::vector<limestone::api::file_set_entry> entries;
     entries.emplace_back("epoch", "epoch", false);
     entries.emplace_back(std::string(limestone::internal::manifest::file_name), std::string(limestone::internal::manifest::file_name), false);
+    entries.emplace_back("pwal_0000.compacted.0.1", "pwal_0000.compacted.0.1", false);
 
     gen_datastore();
 
@@ -373,7 +427,7 @@ TEST_F(log_dir_test, setup_initial_logdir_creates_manifest_file) {
     manifest_file >> manifest;
 
     EXPECT_EQ(manifest["format_version"], "1.1");
-    EXPECT_EQ(manifest["persistent_format_version"], 7);
+    EXPECT_EQ(manifest["persistent_format_version"], 10);
 }
 
 TEST_F(log_dir_test, setup_initial_logdir_creates_compaction_catalog_if_not_exists) {
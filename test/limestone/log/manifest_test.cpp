@@ -241,8 +241,8 @@ TEST_F(manifest_test, is_supported_version_returns_supported_version) {
 }
 
 TEST_F(manifest_test, is_supported_version_returns_zero_and_message_on_unsupported_version) {
-    // persistent_format_version = 10 (unsupported)
-    nlohmann::json j = { {"format_version", "1.0"}, {"persistent_format_version", 10} };
+    // persistent_format_version = 11 (unsupported)
+    nlohmann::json j = { {"format_version", "1.0"}, {"persistent_format_version", 11} };
     auto path = logdir / std::string(manifest::file_name);
     std::ofstream(path.string()) << j.dump();
 
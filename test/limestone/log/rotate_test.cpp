@@ -440,6 +440,111 @@ TEST_F(rotate_test, restore_prusik_all_rel) { // NOLINT
     EXPECT_EQ(files.size(), 3 + manifest_file_num);
 }
 
+TEST_F(rotate_test, channel_in_session_rotates_after_end_session) { // NOLINT
+    using namespace limestone::api;
+    datastore_->ready();
+
+    log_channel& active_channel = datastore_->create_channel();
+    log_channel& idle_channel = datastore_->create_channel();
+
+    datastore_->switch_epoch(42);
+    idle_channel.begin_session();
+    idle_channel.add_entry(42, "k1", "v1", {42, 0});
+    idle_channel.end_session();
+    active_channel.begin_session();
+    active_channel.add_entry(42, "k2", "v2", {42, 1});
+    datastore_->switch_epoch(43);
+
+    // the rotation is cut at epoch 43 and waits for the session of active_channel
+    auto future = datastore_->rotate_log_files_async();
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+    EXPECT_FALSE(boost::filesystem::exists(idle_channel.file_path()));
+    EXPECT_TRUE(boost::filesystem::exists(active_channel.file_path()));
+
+    // the file is renamed by the rotation task, not by end_session()
+    active_channel.end_session();
+    datastore_->switch_epoch(44);
+    rotation_result result = future.get();
+    EXPECT_FALSE(boost::filesystem::exists(active_channel.file_path()));
+
+    EXPECT_EQ(result.get_epoch_id(), 43);
+    EXPECT_EQ(result.get_rotated_files().size(), 2);
+    int rotated_pwals = 0;
+    for (const auto& file : result.get_rotation_end_files()) {
+        std::string filename = file.filename().string();
+        EXPECT_NE(filename, "pwal_0000");
+        EXPECT_NE(filename, "pwal_0001");
+        if (starts_with(filename, "pwal_000")) {
+            EXPECT_EQ(filename.substr(filename.size() - 3), ".43");
+            rotated_pwals++;
+        }
+    }
+    EXPECT_EQ(rotated_pwals, 2);
+
+    // the next session starts a new file
+    active_channel.begin_session();
+    active_channel.add_entry(42, "k3", "v3", {44, 0});
+    active_channel.end_session();
+    EXPECT_TRUE(boost::filesystem::exists(active_channel.file_path()));
+}
+
+TEST_F(rotate_test, rotated_files_are_reported_once) { // NOLINT
+    using namespace limestone::api;
+    datastore_->ready();
+
+    log_channel& channel = datastore_->create_channel();
+    datastore_->switch_epoch(42);
+    channel.begin_session();
+    channel.add_entry(42, "k1", "v1", {42, 0});
+    channel.end_session();
+    datastore_->switch_epoch(43);
+
+    auto first_future = datastore_->rotate_log_files_async();
+    datastore_->switch_epoch(44);
+    rotation_result first = first_future.get();
+    ASSERT_EQ(first.get_rotated_files().size(), 1);
+    EXPECT_EQ(first.get_rotated_files().begin()->substr(0, 9), "pwal_0000");
+
+    // the channel has no file to rotate, so the file rotated before is not reported again
+    auto second_future = datastore_->rotate_log_files_async();
+    datastore_->switch_epoch(45);
+    rotation_result second = second_future.get();
+    EXPECT_EQ(second.get_epoch_id(), 44);
+    EXPECT_TRUE(second.get_rotated_files().empty());
+}
+
+TEST_F(rotate_test, overlapping_rotations_report_their_files) { // NOLINT
+    using namespace limestone::api;
+    datastore_->ready();
+
+    log_channel& channel = datastore_->create_channel();
+    datastore_->switch_epoch(42);
+    channel.begin_session();
+    channel.add_entry(42, "k1", "v1", {42, 0});
+
+    // both rotations wait for the session, and are served by one rename at the later cut
+    datastore_->switch_epoch(43);
+    auto first = datastore_->rotate_log_files_async();
+    datastore_->switch_epoch(44);
+    auto second = datastore_->rotate_log_files_async();
+    channel.end_session();
+    datastore_->switch_epoch(45);
+
+    rotation_result first_result = first.get();
+    rotation_result second_result = second.get();
+    EXPECT_EQ(first_result.get_epoch_id(), 43);
+    EXPECT_EQ(second_result.get_epoch_id(), 44);
+    ASSERT_EQ(first_result.get_rotated_files().size(), 1);
+    EXPECT_EQ(first_result.get_rotated_files(), second_result.get_rotated_files());
+    const std::string& rotated = *first_result.get_rotated_files().begin();
+    EXPECT_EQ(rotated.substr(rotated.size() - 3), ".44");
+
+    // a later rotation does not report them again
+    auto third = datastore_->rotate_log_files_async();
+    datastore_->switch_epoch(46);
+    EXPECT_TRUE(third.get().get_rotated_files().empty());
+}
+
 TEST_F(rotate_test, get_snapshot_works) { // NOLINT
     using namespace limestone::api;
 
@@ -628,13 +733,14 @@ TEST_F(rotate_test, restore_file_set_entries_with_blob) {
     boost::filesystem::remove_all(backup_dest);
     boost::filesystem::rename(backup_src, backup_dest);
 
-    // Collect only files that are inside `bk1/blob/`
+    // Collect only the BLOB files inside `bk1/blob/`; the GC scan state there is not a backup target
     std::vector<boost::filesystem::path> files_to_move;
     boost::filesystem::path blob_dir = backup_dest / "blob";
     
     for (boost::filesystem::recursive_directory_iterator it(backup_dest), end; it != end; ++it) {
         // Ensure the file is inside `blob/` by checking if its path starts with `blob_dir`
-        if (boost::filesystem::is_regular_file(*it) && it->path().string().find(blob_dir.string()) == 0) {
+        if (boost::filesystem::is_regular_file(*it) && it->path().string().find(blob_dir.string()) == 0
+            && it->path().extension() == ".blob") {
             files_to_move.push_back(it->path());
         }
     }
@@ -765,13 +871,14 @@ TEST_F(rotate_test, restore_from_directory_with_blob) {
     boost::filesystem::remove_all(backup_dest);
     boost::filesystem::rename(backup_src, backup_dest);
 
-    // Collect only files that are inside `bk1/blob/`
+    // Collect only the BLOB files inside `bk1/blob/`; the GC scan state there is not a backup target
     std::vector<boost::filesystem::path> files_to_move;
     boost::filesystem::path blob_dir = backup_dest / "blob";
     
     for (boost::filesystem::recursive_directory_iterator it(backup_dest), end; it != end; ++it) {
         // Ensure the file is inside `blob/` by checking if its path starts with `blob_dir`
-        if (boost::filesystem::is_regular_file(*it) && it->path().string().find(blob_dir.string()) == 0) {
+        if (boost::filesystem::is_regular_file(*it) && it->path().string().find(blob_dir.string()) == 0
+            && it->path().extension() == ".blob") {
             files_to_move.push_back(it->path());
         }
     }
@@ -3,6 +3,7 @@
 #include <fstream>
 #include "test_root.h"
 #include "blob_file_resolver.h"
+#include "blob_read_cache.h"
 #include "replication/blob_socket_io.h"
 #include "limestone/api/blob_id_type.h"
 
@@ -70,6 +71,35 @@ TEST_F(blob_socket_io_test, round_trip_blob) {
     EXPECT_EQ(oss.str(), "limestone_blob_data");
 }
 
+TEST_F(blob_socket_io_test, receive_replaces_mapped_blob) {
+    blob_id_type blob_id = 246813579;
+    auto path = datastore_->get_blob_file(blob_id).path();
+    boost::filesystem::create_directories(path.parent_path());
+    {
+        std::ofstream ofs(path.string(), std::ios::binary);
+        ofs << "new_blob_data";
+    }
+    blob_socket_io sender("", *datastore_);
+    sender.send_blob(blob_id);
+    std::string wire = sender.get_out_string();
+
+    // a reader maps the BLOB before it is received again
+    datastore_->get_blob_read_cache().clear();
+    {
+        std::ofstream ofs(path.string(), std::ios::binary | std::ios::trunc);
+        ofs << "old_blob_data_in_use";
+    }
+    auto view = datastore_->get_blob_read_cache().read(blob_id, path);
+
+    blob_socket_io receiver(wire, *datastore_);
+    EXPECT_EQ(receiver.receive_blob(), blob_id);
+
+    // the mapped file is replaced, not rewritten
+    EXPECT_EQ(view.data(), "old_blob_data_in_use");
+    EXPECT_EQ(datastore_->get_blob_read_cache().read(blob_id, path).data(), "new_blob_data");
+    EXPECT_FALSE(boost::filesystem::exists(path.string() + ".tmp"));
+}
+
 TEST_F(blob_socket_io_test, unsupported_path_type_throws) {
     blob_id_type blob_id = 987654321;
     auto dir = datastore_->get_blob_file(blob_id).path();
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <string>
+#include <vector>
+
+#include "blob_reference_index.h"
+
+namespace limestone::testing {
+
+using limestone::api::write_version_type;
+using limestone::internal::blob_reference_index;
+
+class blob_reference_index_test : public ::testing::Test {
+protected:
+    static constexpr const char* location = "/tmp/blob_reference_index_test";
+    const boost::filesystem::path data_file = boost::filesystem::path(location) / "pwal_0000.compacted";
+
+    void SetUp() override {
+        boost::filesystem::remove_all(location);
+        boost::filesystem::create_directory(location);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(location);
+    }
+
+    void create_data_file(std::size_t size) {
+        boost::filesystem::ofstream ostrm(data_file, std::ios_base::out | std::ios_base::binary);
+        ostrm << std::string(size, 'x');
+    }
+
+    void write_index(std::size_t data_size) {
+        blob_reference_index::writer writer{blob_reference_index::index_file_path(data_file)};
+        writer.record("k1", {0, 0}, std::string("\1\0\0\0\0\0\0\0", 8));
+        writer.record("k2", {3, 7}, "");
+        writer.finish(data_size);
+    }
+
+    // returns "key:major:minor:blob_ids_size" of each entry read, or nothing if not read
+    std::vector<std::string> read() {
+        std::vector<std::string> result;
+        bool read = blob_reference_index::read_for(data_file, [&result](std::string_view key_sid, const write_version_type& version, std::string_view blob_ids) {
+            result.emplace_back(std::string(key_sid) + ":" + std::to_string(version.get_major()) + ":" + std::to_string(version.get_minor()) + ":"
+                                + std::to_string(blob_ids.size()));
+        });
+        if (!read) {
+            result.clear();
+            result.emplace_back("not read");
+        }
+        return result;
+    }
+};
+
+TEST_F(blob_reference_index_test, index_file_path) {
+    EXPECT_EQ(blob_reference_index::index_file_path(data_file), boost::filesystem::path(location) / "blob_index.pwal_0000.compacted");
+}
+
+TEST_F(blob_reference_index_test, write_and_read) {
+    create_data_file(120);
+    write_index(120);
+    EXPECT_EQ(read(), (std::vector<std::string>{"k1:0:0:8", "k2:3:7:0"}));
+}
+
+TEST_F(blob_reference_index_test, read_empty) {
+    create_data_file(0);
+    blob_reference_index::writer writer{blob_reference_index::index_file_path(data_file)};
+    writer.finish(0);
+    EXPECT_TRUE(read().empty());
+}
+
+TEST_F(blob_reference_index_test, missing_index_is_not_read) {
+    create_data_file(120);
+    EXPECT_EQ(read(), std::vector<std::string>{"not read"});
+}
+
+TEST_F(blob_reference_index_test, stale_index_is_not_read) {
+    create_data_file(121);
+    write_index(120);
+    EXPECT_EQ(read(), std::vector<std::string>{"not read"});
+}
+
+TEST_F(blob_reference_index_test, unfinished_index_is_not_read) {
+    create_data_file(120);
+    {
+        blob_reference_index::writer writer{blob_reference_index::index_file_path(data_file)};
+        writer.record("k1", {0, 0}, "");
+    }
+    EXPECT_EQ(read(), std::vector<std::string>{"not read"});
+}
+
+TEST_F(blob_reference_index_test, broken_index_is_not_read) {
+    create_data_file(120);
+    write_index(120);
+    auto index_file = blob_reference_index::index_file_path(data_file);
+    boost::filesystem::resize_file(index_file, boost::filesystem::file_size(index_file) - 1);
+    EXPECT_EQ(read(), std::vector<std::string>{"not read"});
+
+    boost::filesystem::ofstream ostrm(index_file, std::ios_base::out | std::ios_base::binary);
+    ostrm << std::string(24, 'x');
+    ostrm.close();
+    EXPECT_EQ(read(), std::vector<std::string>{"not read"});
+}
+
+}  // namespace limestone::testing
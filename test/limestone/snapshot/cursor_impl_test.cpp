@@ -14,9 +14,17 @@
  * limitations under the License.
  */
 
+#include <endian.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
 #include <gtest/gtest.h>
 #include <boost/filesystem.hpp>
 #include "cursor_impl.h"
+#include "snapshot_block_writer.h"
+#include "storage_offset_table.h"
 
 
 #include "test_root.h"
@@ -763,4 +771,188 @@ TEST_F(cursor_impl_test, current_returns_latest_entry_after_next) {
 }
 
 
+TEST_F(cursor_impl_test, merge_three_files_newest_wins) {
+    create_log_file("newest", {
+        {1, "b", "b_newest", {3, 0}},
+    });
+    lc0_->begin_session();
+    lc0_->add_entry(1, "a", "a_middle", {2, 0});
+    lc0_->remove_entry(1, "c", {2, 0});
+    lc0_->end_session();
+    rename_pwal_to("middle");
+    create_log_file("oldest", {
+        {1, "a", "a_oldest", {1, 0}},
+        {1, "b", "b_oldest", {1, 0}},
+        {1, "c", "c_oldest", {1, 0}},
+        {1, "d", "d_oldest", {1, 0}},
+    });
+
+    std::vector<boost::filesystem::path> files{
+        boost::filesystem::path(location) / "newest",
+        boost::filesystem::path(location) / "middle",
+        boost::filesystem::path(location) / "oldest",
+    };
+    cursor_impl_testable cursor(files, {});
+
+    std::vector<std::pair<std::string, std::string>> actual;
+    while (cursor.next()) {
+        std::string key, value;
+        cursor.key(key);
+        cursor.value(value);
+        actual.emplace_back(key, value);
+    }
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"a", "a_middle"},
+        {"b", "b_newest"},
+        {"d", "d_oldest"},
+    };
+    EXPECT_EQ(actual, expected) << "newer files must shadow older ones, including remove entries";
+}
+
+TEST_F(cursor_impl_test, merge_many_files_interleaved) {
+    // file i holds the keys whose number is congruent to i modulo 5, and key "k00" in every file
+    const std::size_t file_count = 5;
+    std::vector<boost::filesystem::path> files;
+    for (std::size_t i = 0; i < file_count; i++) {
+        std::vector<std::tuple<limestone::api::storage_id_type, std::string, std::string, limestone::api::write_version_type>> entries;
+        entries.emplace_back(1, "k00", "file" + std::to_string(i), limestone::api::write_version_type{1, 0});
+        for (std::size_t n = i + file_count; n < 40; n += file_count) {
+            char key[8];
+            std::snprintf(key, sizeof(key), "k%02zu", n);
+            entries.emplace_back(1, key, "v", limestone::api::write_version_type{1, 0});
+        }
+        std::string name = "segment" + std::to_string(i);
+        create_log_file(name, entries);
+        files.emplace_back(boost::filesystem::path(location) / name);
+    }
+
+    cursor_impl_testable cursor(files, {});
+    std::vector<std::string> keys;
+    std::string first_value;
+    while (cursor.next()) {
+        std::string key;
+        cursor.key(key);
+        if (keys.empty()) {
+            cursor.value(first_value);
+        }
+        keys.emplace_back(key);
+    }
+    ASSERT_EQ(keys.size(), 40 - file_count + 1);
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    EXPECT_EQ(std::adjacent_find(keys.begin(), keys.end()), keys.end()) << "duplicate keys must be merged";
+    EXPECT_EQ(first_value, "file0") << "the first file in the list is the newest";
+}
+
+TEST_F(cursor_impl_test, merge_files_with_clear_storage) {
+    create_log_file("newer", {
+        {1, "a", "a_newer", {2, 0}},
+        {2, "a", "a2_newer", {2, 0}},
+    });
+    create_log_file("older", {
+        {1, "b", "b_older", {1, 0}},
+        {2, "b", "b2_older", {1, 0}},
+    });
+
+    std::map<limestone::api::storage_id_type, limestone::api::write_version_type> clear_storage;
+    clear_storage[2] = limestone::api::write_version_type(2, 0);
+    std::vector<boost::filesystem::path> files{
+        boost::filesystem::path(location) / "newer",
+        boost::filesystem::path(location) / "older",
+    };
+    cursor_impl_testable cursor(files, clear_storage);
+
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> actual;
+    while (cursor.next()) {
+        std::string key;
+        cursor.key(key);
+        actual.emplace_back(cursor.storage(), key);
+    }
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> expected = {
+        {1, "a"}, {1, "b"}, {2, "a"},
+    };
+    EXPECT_EQ(actual, expected);
+}
+
+TEST_F(cursor_impl_test, clear_storage_follows_key_sid_order_of_storages) {
+    // key_sid starts with the storage ID in little endian, so storage 256 sorts before storage 1
+    create_log_file("snapshot", {
+        {256, "a", "a256", {1, 0}},
+        {256, "b", "b256", {2, 0}},
+        {1, "a", "a1", {1, 0}},
+        {1, "b", "b1", {1, 1}},
+    });
+    std::map<limestone::api::storage_id_type, limestone::api::write_version_type> clear_storage;
+    clear_storage[1] = limestone::api::write_version_type(1, 1);
+    clear_storage[256] = limestone::api::write_version_type(2, 0);
+    cursor_impl_testable cursor(boost::filesystem::path(location) / "snapshot", clear_storage);
+
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> actual;
+    while (cursor.next()) {
+        std::string key;
+        cursor.key(key);
+        actual.emplace_back(cursor.storage(), key);
+    }
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> expected = {
+        {256, "b"}, {1, "b"},
+    };
+    EXPECT_EQ(actual, expected);
+}
+
+TEST_F(cursor_impl_test, clear_storage_skips_entirely_cleared_storage) {
+    auto key_sid = [](limestone::api::storage_id_type storage_id, const std::string& key) {
+        std::uint64_t le = htole64(storage_id);
+        return std::string(reinterpret_cast<const char*>(&le), sizeof(le)) + key;  // NOLINT(*-reinterpret-cast)
+    };
+    auto value_etc = [](std::uint64_t epoch, const std::string& value) {
+        std::uint64_t version[] = {htole64(epoch), 0};
+        return std::string(reinterpret_cast<const char*>(version), sizeof(version)) + value;  // NOLINT(*-reinterpret-cast)
+    };
+    boost::filesystem::path snapshot_file = boost::filesystem::path(location) / "snapshot";
+    limestone::internal::storage_offset_table offsets{};
+    FILE* out = fopen(snapshot_file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    // every entry gets a block of its own
+    limestone::internal::snapshot_block_writer writer(out, snapshot_file, &offsets, limestone::internal::snapshot_block_format::codec::none, 1);
+    writer.add(limestone::api::log_entry::entry_type::normal_entry, key_sid(1, "a"), value_etc(1, "a1"), "");
+    writer.add(limestone::api::log_entry::entry_type::normal_entry, key_sid(2, "a"), value_etc(1, "a2"), "");
+    writer.add(limestone::api::log_entry::entry_type::normal_entry, key_sid(2, "b"), value_etc(2, "b2"), "");
+    writer.add(limestone::api::log_entry::entry_type::normal_entry, key_sid(3, "a"), value_etc(1, "a3"), "");
+    writer.finish();
+    fclose(out);
+    offsets.write_file(limestone::internal::storage_offset_table::index_file_path(snapshot_file));
+    ASSERT_EQ(offsets.find(2)->max_version, limestone::api::write_version_type(2, 0));
+
+    // Break the last block of storage 2: the cursor must not read it, because every entry is older than the cutoff.
+    {
+        std::fstream f(snapshot_file.string(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        f.seekp(static_cast<std::streamoff>(offsets.find(2)->end - 1));
+        f.put('\xff');
+    }
+
+    std::map<limestone::api::storage_id_type, limestone::api::write_version_type> clear_storage;
+    clear_storage[2] = limestone::api::write_version_type(3, 0);
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> actual;
+    {
+        cursor_impl_testable cursor(snapshot_file, clear_storage);
+        while (cursor.next()) {
+            std::string key;
+            cursor.key(key);
+            actual.emplace_back(cursor.storage(), key);
+        }
+    }
+    std::vector<std::pair<limestone::api::storage_id_type, std::string>> expected = {
+        {1, "a"}, {3, "a"},
+    };
+    EXPECT_EQ(actual, expected);
+
+    // The same holds for a cursor restricted to the cleared storage.
+    cursor_impl_testable storage_cursor(snapshot_file, clear_storage, 2);
+    EXPECT_FALSE(storage_cursor.next());
+
+    // Without a cutoff covering the whole storage, the broken block is read and detected.
+    clear_storage[2] = limestone::api::write_version_type(2, 0);
+    cursor_impl_testable partial_cursor(snapshot_file, clear_storage);
+    EXPECT_THROW({ while (partial_cursor.next()) {} }, limestone::limestone_exception);
+}
+
 }  // namespace limestone::testing
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <endian.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include "crc32c.h"
+#include "limestone/api/limestone_exception.h"
+#include "log_entry.h"
+#include "snapshot_block_cache.h"
+#include "snapshot_block_reader.h"
+#include "snapshot_block_writer.h"
+#include "storage_offset_table.h"
+
+namespace limestone::testing {
+
+using limestone::api::log_entry;
+using limestone::internal::crc32c;
+using limestone::internal::snapshot_block_cache;
+using limestone::internal::snapshot_block_format;
+using limestone::internal::snapshot_block_reader;
+using limestone::internal::snapshot_block_writer;
+using limestone::internal::storage_offset_table;
+
+class snapshot_block_format_test : public ::testing::Test {
+protected:
+    static constexpr const char* location = "/tmp/snapshot_block_format_test";
+    const boost::filesystem::path file = boost::filesystem::path(location) / "snapshot";
+
+    void SetUp() override {
+        boost::filesystem::remove_all(location);
+        boost::filesystem::create_directory(location);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(location);
+    }
+
+    static std::string key_sid(std::uint64_t storage_id, const std::string& key) {
+        std::uint64_t le = htole64(storage_id);
+        return std::string(reinterpret_cast<const char*>(&le), sizeof(le)) + key;  // NOLINT(*-reinterpret-cast)
+    }
+
+    static std::string value_etc(std::uint64_t epoch, const std::string& value) {
+        std::uint64_t e = htole64(epoch);
+        std::uint64_t minor = 0;
+        return std::string(reinterpret_cast<const char*>(&e), sizeof(e))  // NOLINT(*-reinterpret-cast)
+            + std::string(reinterpret_cast<const char*>(&minor), sizeof(minor)) + value;  // NOLINT(*-reinterpret-cast)
+    }
+
+    std::vector<log_entry> read_all() {
+        boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+        EXPECT_TRUE(snapshot_block_reader::read_file_header(istrm));
+        snapshot_block_reader reader(file.string());
+        std::vector<log_entry> entries;
+        log_entry e;
+        while (reader.read(istrm, e)) {
+            entries.push_back(e);
+        }
+        return entries;
+    }
+};
+
+TEST_F(snapshot_block_format_test, crc32c_known_value) {
+    std::string data = "123456789";
+    EXPECT_EQ(crc32c(data.data(), data.size()), 0xe3069283U);
+    EXPECT_EQ(crc32c(data.data() + 4, data.size() - 4, crc32c(data.data(), 4)), 0xe3069283U);
+    EXPECT_EQ(crc32c(nullptr, 0), 0U);
+}
+
+TEST_F(snapshot_block_format_test, round_trip) {
+    std::uint64_t blob_ids[] = {htole64(11), htole64(12)};
+    std::string raw_blob_ids(reinterpret_cast<const char*>(blob_ids), sizeof(blob_ids));  // NOLINT(*-reinterpret-cast)
+
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file);
+    writer.add(log_entry::entry_type::normal_entry, key_sid(1, "prefix_a"), value_etc(1, "v1"), "");
+    writer.add(log_entry::entry_type::normal_with_blob, key_sid(1, "prefix_b"), value_etc(2, "v2"), raw_blob_ids);
+    writer.add(log_entry::entry_type::remove_entry, key_sid(1, "prefix_c"), value_etc(3, ""), "");
+    writer.add(log_entry::entry_type::normal_entry, key_sid(2, "prefix_a"), value_etc(4, "v4"), "");
+    writer.finish();
+    fclose(out);
+    EXPECT_EQ(writer.written_bytes(), boost::filesystem::file_size(file));
+
+    auto entries = read_all();
+    ASSERT_EQ(entries.size(), 4);
+    EXPECT_EQ(entries[0].type(), log_entry::entry_type::normal_entry);
+    EXPECT_EQ(entries[0].key_sid(), key_sid(1, "prefix_a"));
+    EXPECT_EQ(entries[0].value_etc(), value_etc(1, "v1"));
+    EXPECT_EQ(entries[1].type(), log_entry::entry_type::normal_with_blob);
+    EXPECT_EQ(entries[1].key_sid(), key_sid(1, "prefix_b"));
+    EXPECT_EQ(entries[1].get_blob_ids(), (std::vector<limestone::api::blob_id_type>{11, 12}));
+    EXPECT_EQ(entries[2].type(), log_entry::entry_type::remove_entry);
+    EXPECT_EQ(entries[2].key_sid(), key_sid(1, "prefix_c"));
+    EXPECT_EQ(entries[3].storage(), 2);
+    EXPECT_EQ(entries[3].key_sid(), key_sid(2, "prefix_a"));
+    EXPECT_EQ(entries[3].value_etc(), value_etc(4, "v4"));
+}
+
+TEST_F(snapshot_block_format_test, many_blocks_and_prefix_compression) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file, nullptr, snapshot_block_format::codec::none, 1024);
+    std::size_t plain_bytes = 0;  // size of the same entries as plain log_entry records
+    for (int i = 0; i < 1000; i++) {
+        char key[64];
+        std::snprintf(key, sizeof(key), "a_rather_long_common_key_prefix_%06d", i);
+        plain_bytes += 1 + 4 + 4 + key_sid(1, key).size() + value_etc(1, "v").size();
+        writer.add(log_entry::entry_type::normal_entry, key_sid(1, key), value_etc(1, "v"), "");
+    }
+    writer.finish();
+    fclose(out);
+
+    // key prefixes are shared within a block, so the file is much smaller than the plain records
+    EXPECT_LT(boost::filesystem::file_size(file), plain_bytes / 2);
+
+    auto entries = read_all();
+    ASSERT_EQ(entries.size(), 1000);
+    std::string key;
+    entries[999].key(key);
+    EXPECT_EQ(key, "a_rather_long_common_key_prefix_000999");
+}
+
+TEST_F(snapshot_block_format_test, storage_starts_at_block_boundary) {
+    storage_offset_table offsets{};
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file, &offsets);
+    writer.add(log_entry::entry_type::normal_entry, key_sid(1, "k1"), value_etc(1, "v1"), "");
+    writer.add(log_entry::entry_type::normal_entry, key_sid(2, "k2"), value_etc(1, "v2"), "");
+    writer.add(log_entry::entry_type::normal_entry, key_sid(2, "k3"), value_etc(1, "v3"), "");
+    writer.finish();
+    fclose(out);
+
+    ASSERT_EQ(offsets.ranges().size(), 2);
+    EXPECT_EQ(offsets.find(1)->begin, snapshot_block_format::magic.size());
+    EXPECT_EQ(offsets.find(1)->end, offsets.find(2)->begin);
+    EXPECT_EQ(offsets.find(2)->end, boost::filesystem::file_size(file));
+
+    boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+    ASSERT_TRUE(snapshot_block_reader::read_file_header(istrm));
+    istrm.seekg(static_cast<std::streamoff>(offsets.find(2)->begin));
+    snapshot_block_reader reader(file.string());
+    log_entry e;
+    ASSERT_TRUE(reader.read(istrm, e));
+    EXPECT_EQ(e.key_sid(), key_sid(2, "k2"));
+    ASSERT_TRUE(reader.read(istrm, e));
+    EXPECT_EQ(e.key_sid(), key_sid(2, "k3"));
+    EXPECT_FALSE(reader.read(istrm, e));
+}
+
+TEST_F(snapshot_block_format_test, detects_corrupted_block) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file);
+    writer.add(log_entry::entry_type::normal_entry, key_sid(1, "key"), value_etc(1, "value"), "");
+    writer.finish();
+    fclose(out);
+
+    // flip the last byte of the payload
+    {
+        std::fstream f(file.string(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        f.seekg(-1, std::ios_base::end);
+        char c{};
+        f.get(c);
+        f.seekp(-1, std::ios_base::end);
+        f.put(static_cast<char>(c ^ 0x01));
+    }
+
+    boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+    ASSERT_TRUE(snapshot_block_reader::read_file_header(istrm));
+    snapshot_block_reader reader(file.string());
+    log_entry e;
+    EXPECT_THROW(reader.read(istrm, e), limestone::limestone_exception);
+}
+
+TEST_F(snapshot_block_format_test, detects_truncated_file) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file);
+    writer.add(log_entry::entry_type::normal_entry, key_sid(1, "key"), value_etc(1, "value"), "");
+    writer.finish();
+    fclose(out);
+    boost::filesystem::resize_file(file, boost::filesystem::file_size(file) - 3);
+
+    boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+    ASSERT_TRUE(snapshot_block_reader::read_file_header(istrm));
+    snapshot_block_reader reader(file.string());
+    log_entry e;
+    EXPECT_THROW(reader.read(istrm, e), limestone::limestone_exception);
+}
+
+TEST_F(snapshot_block_format_test, plain_log_file_is_not_block_file) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    log_entry::begin_session(out, 0);
+    log_entry::write(out, key_sid(1, "key"), value_etc(1, "value"));
+    fclose(out);
+
+    boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+    EXPECT_FALSE(snapshot_block_reader::read_file_header(istrm));
+    EXPECT_EQ(istrm.tellg(), 0);
+    log_entry e;
+    ASSERT_TRUE(e.read(istrm));
+    EXPECT_EQ(e.type(), log_entry::entry_type::marker_begin);
+}
+
+TEST_F(snapshot_block_format_test, readers_share_cached_blocks) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file, nullptr, snapshot_block_format::codec::none, 1);
+    for (int i = 0; i < 3; i++) {
+        writer.add(log_entry::entry_type::normal_entry, key_sid(1, "k" + std::to_string(i)), value_etc(1, "v"), "");
+    }
+    writer.finish();
+    fclose(out);
+
+    auto cache = std::make_shared<snapshot_block_cache>();
+    auto id = snapshot_block_cache::identify(file);
+    ASSERT_TRUE(id.has_value());
+    auto scan = [&]() {
+        boost::filesystem::ifstream istrm(file, std::ios_base::in | std::ios_base::binary);
+        EXPECT_TRUE(snapshot_block_reader::read_file_header(istrm));
+        snapshot_block_reader reader(file.string(), cache, id);
+        std::vector<std::string> keys;
+        log_entry e;
+        while (reader.read(istrm, e)) {
+            keys.emplace_back(e.key_sid());
+        }
+        return keys;
+    };
+    auto first = scan();
+    EXPECT_EQ(cache->hits(), 0);
+    EXPECT_EQ(first.size(), 3);
+
+    // break the file: the second scan must not read it again
+    {
+        std::fstream f(file.string(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        f.seekp(-1, std::ios_base::end);
+        f.put('\xff');
+    }
+    EXPECT_EQ(scan(), first);
+    EXPECT_EQ(cache->hits(), 3);
+}
+
+TEST_F(snapshot_block_format_test, block_cache_evicts_least_recently_used) {
+    snapshot_block_cache cache(10);
+    snapshot_block_cache::file_id id{1, 2};
+    auto make_block = [](std::size_t size) {
+        return std::make_shared<const snapshot_block_cache::block>(snapshot_block_cache::block{std::string(size, 'x'), 1, 0});
+    };
+    cache.insert(id, 0, make_block(4));
+    cache.insert(id, 100, make_block(4));
+    EXPECT_NE(cache.find(id, 0), nullptr);  // makes offset 100 the least recently used
+    cache.insert(id, 200, make_block(4));
+    EXPECT_NE(cache.find(id, 0), nullptr);
+    EXPECT_EQ(cache.find(id, 100), nullptr);
+    EXPECT_NE(cache.find(id, 200), nullptr);
+    EXPECT_EQ(cache.find(snapshot_block_cache::file_id{1, 3}, 0), nullptr);
+
+    // a block larger than the capacity is kept until the next insertion
+    cache.insert(id, 300, make_block(20));
+    EXPECT_NE(cache.find(id, 300), nullptr);
+    EXPECT_EQ(cache.find(id, 0), nullptr);
+}
+
+#ifdef LIMESTONE_ENABLE_SNAPSHOT_LZ4
+TEST_F(snapshot_block_format_test, lz4_round_trip) {
+    FILE* out = fopen(file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    snapshot_block_writer writer(out, file, nullptr, snapshot_block_format::codec::lz4);
+    for (int i = 0; i < 1000; i++) {
+        writer.add(log_entry::entry_type::normal_entry, key_sid(1, "key" + std::to_string(100000 + i)), value_etc(1, std::string(100, 'x')), "");
+    }
+    writer.finish();
+    fclose(out);
+    EXPECT_LT(boost::filesystem::file_size(file), 1000U * 100U / 2);
+
+    auto entries = read_all();
+    ASSERT_EQ(entries.size(), 1000);
+    std::string value;
+    entries[500].value(value);
+    EXPECT_EQ(value, std::string(100, 'x'));
+}
+#endif
+
+} // namespace limestone::testing
@@ -1,8 +1,13 @@
+#include <endian.h>
+
+#include <cstdio>
+
 #include <gtest/gtest.h>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
 #include "limestone/api/log_channel.h"
+#include "snapshot_block_writer.h"
 #include "snapshot_impl.h"
 #include "cursor_impl.h"
 #include "test_root.h"
@@ -106,20 +111,83 @@ TEST_F(snapshot_impl_test, get_partitioned_cursors_throws_on_zero_partition) {
     EXPECT_THROW(snapshot.get_partitioned_cursors(0), std::invalid_argument);
 }
 
-TEST_F(snapshot_impl_test, get_partitioned_cursors_throws_on_second_call) {
-    // 有効な log entry を含む snapshot を作成
-    std::vector<std::tuple<api::storage_id_type, std::string, std::string, api::write_version_type>> entries = {
-        {1, "key", "value", {1, 0}},
-    };
-    create_log_file("data/snapshot", entries);
+TEST_F(snapshot_impl_test, get_partitioned_cursors_can_be_called_repeatedly) {
+    create_log_file("data/snapshot", {
+        {1, "key1", "value1", {1, 0}},
+        {2, "key2", "value2", {1, 1}},
+    });
 
     limestone::internal::snapshot_impl snapshot(location, {});
-    auto cursors = snapshot.get_partitioned_cursors(1);
+    // two scans of the same snapshot in progress at the same time
+    auto first = snapshot.get_partitioned_cursors(2);
+    auto second = snapshot.get_partitioned_cursors(1, 2);
+
+    auto collect = [](std::vector<std::unique_ptr<limestone::api::cursor>>& cursors) {
+        std::set<std::pair<std::string, std::string>> actual;
+        for (auto& cursor : cursors) {
+            while (cursor->next()) {
+                std::string key, value;
+                cursor->key(key);
+                cursor->value(value);
+                actual.emplace(key, value);
+            }
+        }
+        return actual;
+    };
+    std::set<std::pair<std::string, std::string>> expected_all = {
+        {"key1", "value1"},
+        {"key2", "value2"},
+    };
+    std::set<std::pair<std::string, std::string>> expected_storage2 = {
+        {"key2", "value2"},
+    };
+    EXPECT_EQ(collect(second), expected_storage2);
+    EXPECT_EQ(collect(first), expected_all);
 
-    // 2回目の呼び出しで例外が投げられることを確認
-    EXPECT_THROW(snapshot.get_partitioned_cursors(1), limestone::api::limestone_exception);
+    auto third = snapshot.get_partitioned_cursors(3);
+    EXPECT_EQ(collect(third), expected_all);
 }
 
+TEST_F(snapshot_impl_test, cursors_share_decoded_blocks) {
+    boost::filesystem::path snapshot_file = boost::filesystem::path(location) / "data" / "snapshot";
+    boost::filesystem::create_directories(snapshot_file.parent_path());
+    FILE* out = fopen(snapshot_file.c_str(), "w");
+    ASSERT_NE(out, nullptr);
+    limestone::internal::snapshot_block_writer writer(out, snapshot_file, nullptr, limestone::internal::snapshot_block_format::codec::none, 256);
+    for (int i = 0; i < 100; i++) {
+        std::uint64_t storage_id = htole64(1);
+        std::uint64_t version[] = {htole64(1), 0};
+        std::string key = "key" + std::to_string(1000 + i);
+        writer.add(api::log_entry::entry_type::normal_entry,
+                   std::string(reinterpret_cast<const char*>(&storage_id), sizeof(storage_id)) + key,  // NOLINT(*-reinterpret-cast)
+                   std::string(reinterpret_cast<const char*>(version), sizeof(version)) + "value",  // NOLINT(*-reinterpret-cast)
+                   "");
+    }
+    writer.finish();
+    fclose(out);
+
+    limestone::internal::snapshot_impl snapshot(location, {});
+    auto count_entries = [](limestone::api::cursor& cursor) {
+        std::size_t count = 0;
+        while (cursor.next()) {
+            count++;
+        }
+        return count;
+    };
+    EXPECT_EQ(count_entries(*snapshot.get_cursor()), 100);
+    auto misses = snapshot.block_cache().misses();
+    EXPECT_EQ(snapshot.block_cache().hits(), 0);
+    EXPECT_GT(misses, 1);
+
+    // the second scan is served from the cache
+    auto cursors = snapshot.get_partitioned_cursors(2);
+    std::size_t total = 0;
+    for (auto& cursor : cursors) {
+        total += count_entries(*cursor);
+    }
+    EXPECT_EQ(total, 100);
+    EXPECT_EQ(snapshot.block_cache().hits(), misses - 1);  // every block; the last miss is the end of the file
+}
 
 TEST_F(snapshot_impl_test, get_partitioned_cursors_reads_compacted_file_if_exists) {
     // snapshot 側のエントリ
@@ -209,4 +277,40 @@ TEST_F(snapshot_impl_test, get_cursor_reads_compacted_if_exists) {
     EXPECT_EQ(std::set(actual.begin(), actual.end()), expected);
 }
 
+TEST_F(snapshot_impl_test, get_cursor_with_storage_id_without_storage_index) {
+    // files created here have no storage offset table, so the cursor falls back to a sequential scan
+    create_log_file("data/snapshot", {
+        {1, "key1", "value1", {1, 1}},
+        {2, "key2", "value2", {1, 2}},
+        {2, "key3", "value3", {1, 3}},
+        {3, "key4", "value4", {1, 4}},
+    });
+    create_log_file("pwal_0000.compacted", {
+        {2, "key0", "value0", {1, 0}},
+        {4, "key5", "value5", {1, 0}},
+    });
+
+    limestone::internal::snapshot_impl snapshot(location, {});
+    auto cursor = snapshot.get_cursor(2);
+
+    std::vector<std::pair<std::string, std::string>> actual;
+    while (cursor->next()) {
+        EXPECT_EQ(cursor->storage(), 2);
+        std::string key, value;
+        cursor->key(key);
+        cursor->value(value);
+        actual.emplace_back(key, value);
+    }
+
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"key0", "value0"},
+        {"key2", "value2"},
+        {"key3", "value3"},
+    };
+    EXPECT_EQ(actual, expected);
+
+    auto empty_cursor = snapshot.get_cursor(5);
+    EXPECT_FALSE(empty_cursor->next());
+}
+
 } // namespace limestone::testing
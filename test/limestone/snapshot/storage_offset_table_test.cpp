@@ -0,0 +1,139 @@
+/*
+ * Copyright 2022-2026 Project Tsurugi.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include "storage_offset_table.h"
+
+namespace limestone::testing {
+
+using limestone::internal::storage_offset_table;
+
+class storage_offset_table_test : public ::testing::Test {
+protected:
+    static constexpr const char* location = "/tmp/storage_offset_table_test";
+    const boost::filesystem::path data_file = boost::filesystem::path(location) / "pwal_0000.compacted";
+
+    void SetUp() override {
+        boost::filesystem::remove_all(location);
+        boost::filesystem::create_directory(location);
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(location);
+    }
+
+    void create_data_file(std::size_t size) {
+        boost::filesystem::ofstream ostrm(data_file, std::ios_base::out | std::ios_base::binary);
+        ostrm << std::string(size, 'x');
+    }
+};
+
+TEST_F(storage_offset_table_test, record_only_transitions) {
+    storage_offset_table table{};
+    table.record(1, 9);
+    table.record(1, 30);
+    table.record(1, 50);
+    EXPECT_TRUE(table.is_current(1));
+    table.record(3, 70);
+    EXPECT_FALSE(table.is_current(1));
+    table.record(2, 100);
+    table.finish(120);
+
+    ASSERT_EQ(table.ranges().size(), 3);
+    auto r1 = table.find(1);
+    ASSERT_TRUE(r1.has_value());
+    EXPECT_EQ(r1->begin, 9);
+    EXPECT_EQ(r1->end, 70);
+    auto r3 = table.find(3);
+    ASSERT_TRUE(r3.has_value());
+    EXPECT_EQ(r3->begin, 70);
+    EXPECT_EQ(r3->end, 100);
+    auto r2 = table.find(2);
+    ASSERT_TRUE(r2.has_value());
+    EXPECT_EQ(r2->begin, 100);
+    EXPECT_EQ(r2->end, 120);
+    EXPECT_FALSE(table.find(4).has_value());
+    EXPECT_EQ(table.data_size(), 120);
+}
+
+TEST_F(storage_offset_table_test, record_max_write_version) {
+    storage_offset_table table{};
+    table.record(1, 9);
+    table.record_write_version({3, 1});
+    table.record_write_version({5, 0});
+    table.record_write_version({4, 7});
+    table.record(2, 70);
+    table.record_write_version({0, 0});
+    table.finish(120);
+
+    EXPECT_EQ(table.find(1)->max_version, limestone::api::write_version_type(5, 0));
+    EXPECT_EQ(table.find(2)->max_version, limestone::api::write_version_type(0, 0));
+}
+
+TEST_F(storage_offset_table_test, index_file_path_does_not_look_like_wal) {
+    auto index_file = storage_offset_table::index_file_path(data_file);
+    EXPECT_EQ(index_file.parent_path(), data_file.parent_path());
+    EXPECT_EQ(index_file.filename().string(), "storage_index.pwal_0000.compacted");
+}
+
+TEST_F(storage_offset_table_test, write_and_load) {
+    create_data_file(120);
+    storage_offset_table table{};
+    table.record(1, 9);
+    table.record_write_version({7, 2});
+    table.record(2, 60);
+    table.finish(120);
+    table.write_file(storage_offset_table::index_file_path(data_file));
+
+    auto loaded = storage_offset_table::load_for(data_file);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->data_size(), 120);
+    ASSERT_EQ(loaded->ranges().size(), 2);
+    EXPECT_EQ(loaded->find(1)->begin, 9);
+    EXPECT_EQ(loaded->find(1)->end, 60);
+    EXPECT_EQ(loaded->find(2)->begin, 60);
+    EXPECT_EQ(loaded->find(2)->end, 120);
+    EXPECT_EQ(loaded->find(1)->max_version, limestone::api::write_version_type(7, 2));
+    EXPECT_EQ(loaded->find(2)->max_version, limestone::api::write_version_type(0, 0));
+}
+
+TEST_F(storage_offset_table_test, load_without_index_file) {
+    create_data_file(120);
+    EXPECT_FALSE(storage_offset_table::load_for(data_file).has_value());
+}
+
+TEST_F(storage_offset_table_test, load_ignores_stale_index_file) {
+    create_data_file(121);
+    storage_offset_table table{};
+    table.record(1, 9);
+    table.finish(120);
+    table.write_file(storage_offset_table::index_file_path(data_file));
+
+    EXPECT_FALSE(storage_offset_table::load_for(data_file).has_value());
+}
+
+TEST_F(storage_offset_table_test, load_ignores_broken_index_file) {
+    create_data_file(120);
+    boost::filesystem::ofstream ostrm(storage_offset_table::index_file_path(data_file), std::ios_base::out | std::ios_base::binary);
+    ostrm << "broken";
+    ostrm.close();
+
+    EXPECT_FALSE(storage_offset_table::load_for(data_file).has_value());
+}
+
+} // namespace limestone::testing
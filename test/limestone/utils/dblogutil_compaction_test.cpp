@@ -142,6 +142,35 @@ TEST_F(dblogutil_compaction_test, case1prompt) {
     EXPECT_EQ(read_entire_file(dir / "epoch"), data_case1_epochcompact);
 }
 
+TEST_F(dblogutil_compaction_test, case1dryrun) {
+    boost::filesystem::path dir{location};
+    dir /= "log";
+    boost::filesystem::create_directory(dir);
+    create_file(dir / "epoch", data_case1_epoch);
+    create_file(dir / std::string(manifest::file_name), data_manifest());
+    create_file(dir / "pwal_0000", data_case1_pwal0);
+    create_file(dir / "pwal_0001", data_case1_pwal1);
+    std::string command;
+    command = UTIL_COMMAND " compaction --dry_run " + dir.string() + " 2>&1";
+    std::string out;
+    int rc = invoke(command, out);
+    EXPECT_EQ(rc, 0);
+    EXPECT_FALSE(contains(out, "y/N"));
+    EXPECT_TRUE(contains_line_starts_with(out, "input-files: 2"));
+    EXPECT_TRUE(contains_line_starts_with(out, "sampled-files: 2"));
+    EXPECT_TRUE(contains_line_starts_with(out, "reclaimable-blob-files: 0"));
+    // A, B, C, A and the removal of C; the latest A and B are live
+    EXPECT_TRUE(contains_line_starts_with(out, "storage-3559364748735640691: versions=5, live-versions=2"));
+    EXPECT_TRUE(contains(out, "dead-ratio=0.6"));
+    EXPECT_TRUE(contains(out, "compaction was estimated (dry-run mode)"));
+    // nothing is modified
+    EXPECT_EQ(read_entire_file(dir / "pwal_0000"), data_case1_pwal0);
+    EXPECT_EQ(read_entire_file(dir / "pwal_0001"), data_case1_pwal1);
+    EXPECT_EQ(read_entire_file(dir / "epoch"), data_case1_epoch);
+    // no working directory is made
+    EXPECT_EQ(std::distance(boost::filesystem::directory_iterator(location), boost::filesystem::directory_iterator()), 1);
+}
+
 TEST_F(dblogutil_compaction_test, unreadable) {
     // root can read directories w/o permissions
     if (geteuid() == 0) { GTEST_SKIP() << "skip when run by root"; }
@@ -37,6 +37,7 @@ public:
     auto next_blob_id() const noexcept { return next_blob_id_for_tests(); }
     auto& files() const noexcept { return files_for_tests(); }
     void rotate_epoch_file() { rotate_epoch_file_for_tests(); }
+    auto rotate_log_files_async() { return rotate_log_files_async_for_tests(); }
     void set_next_blob_id(blob_id_type next_blob_id) noexcept { set_next_blob_id_for_tests(next_blob_id); }
     std::set<blob_id_type> get_persistent_blob_ids() noexcept { return get_persistent_blob_ids_for_tests(); }
     write_version_type get_available_boundary_version() const noexcept { return get_available_boundary_version_for_tests(); }